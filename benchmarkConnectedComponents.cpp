@@ -0,0 +1,130 @@
+#include "rpiCam/ConnectedComponents.hpp"
+#include "rpiCam/MemoryPixelSampleBuffer.hpp"
+#include "rpiCam/Logging.hpp"
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace rpiCam;
+
+// the per-pixel flood fill with a label image the run based labeller replaces
+std::size_t naiveLabel(BinaryMask const &mask, std::uint32_t minArea, std::vector<std::int32_t> &labels, std::vector<Vec2ui> &stack)
+{
+    std::uint32_t const w = mask.size()(0);
+    std::uint32_t const h = mask.size()(1);
+    labels.assign(std::size_t(w) * h, -1);
+
+    std::size_t numBlobs = 0;
+    std::int32_t next = 0;
+    for (std::uint32_t y = 0; y < h; ++y)
+    {
+        for (std::uint32_t x = 0; x < w; ++x)
+        {
+            if (!mask.test(x, y) || labels[y * w + x] >= 0)
+                continue;
+
+            std::uint32_t area = 0;
+            labels[y * w + x] = next;
+            stack.assign(1, Vec2ui(x, y));
+            while (!stack.empty())
+            {
+                Vec2ui const p = stack.back();
+                stack.pop_back();
+                area++;
+                for (int dy = -1; dy <= 1; ++dy)
+                {
+                    for (int dx = -1; dx <= 1; ++dx)
+                    {
+                        std::int64_t const nx = std::int64_t(p(0)) + dx, ny = std::int64_t(p(1)) + dy;
+                        if (nx < 0 || ny < 0 || nx >= w || ny >= h)
+                            continue;
+                        if (mask.test(std::uint32_t(nx), std::uint32_t(ny)) && labels[ny * w + nx] < 0)
+                        {
+                            labels[ny * w + nx] = next;
+                            stack.push_back(Vec2ui(std::uint32_t(nx), std::uint32_t(ny)));
+                        }
+                    }
+                }
+            }
+            next++;
+            if (area >= minArea)
+                numBlobs++;
+        }
+    }
+    return numBlobs;
+}
+
+// blobs of different sizes with speckle noise, roughly what a foreground mask looks like
+void renderMask(MemoryPixelSampleBuffer &frame, std::mt19937 &random)
+{
+    std::uint8_t *data = static_cast<std::uint8_t*>(frame.planeData(0));
+    std::size_t const rowBytes = frame.planeRowBytes(0);
+    Vec2ui const size = frame.planeSize(0);
+    std::uniform_int_distribution<std::uint32_t> noise(0, 99);
+    for (std::uint32_t y = 0; y < size(1); ++y)
+    {
+        for (std::uint32_t x = 0; x < size(0); ++x)
+            data[y * rowBytes + x] = noise(random) < 2 ? 255 : 0;
+    }
+
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int ib = 0; ib < 60; ++ib)
+    {
+        float const cx = unit(random) * size(0), cy = unit(random) * size(1);
+        float const rx = 4.0f + unit(random) * size(0) / 16, ry = 4.0f + unit(random) * size(1) / 16;
+        for (std::uint32_t y = std::uint32_t(std::max(0.0f, cy - ry)); y < std::min<float>(size(1), cy + ry); ++y)
+        {
+            for (std::uint32_t x = std::uint32_t(std::max(0.0f, cx - rx)); x < std::min<float>(size(0), cx + rx); ++x)
+            {
+                float const u = (x - cx) / rx, v = (y - cy) / ry;
+                if (u * u + v * v <= 1.0f)
+                    data[y * rowBytes + x] = 255;
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    setLogLevel(LOG_SILENT);
+
+    std::size_t const numIterations = argc > 1 ? std::stoul(argv[1]) : 100;
+    std::vector<Vec2ui> const sizes = { Vec2ui(640, 480), Vec2ui(1280, 720) };
+    std::mt19937 random(7);
+
+    for (auto const &size : sizes)
+    {
+        MemoryPixelSampleBuffer frame(kPixelFormatGRAY8, size);
+        renderMask(frame, random);
+
+        for (auto format : { BinaryMask::Format::Bytes, BinaryMask::Format::Bits })
+        {
+            BinaryMask mask;
+            thresholdPixelBuffer(frame, 0, 127, format, mask);
+
+            ConnectedComponents labeller;
+            BlobList blobs;
+            std::vector<std::int32_t> labels;
+            std::vector<Vec2ui> stack;
+
+            std::size_t const numNaive = naiveLabel(mask, labeller.options().minArea, labels, stack);
+            auto start = std::chrono::high_resolution_clock::now();
+            for (std::size_t it = 0; it < numIterations; ++it)
+                naiveLabel(mask, labeller.options().minArea, labels, stack);
+            auto end = std::chrono::high_resolution_clock::now();
+            double const naive = std::chrono::duration<double>(end - start).count() / numIterations;
+
+            start = std::chrono::high_resolution_clock::now();
+            for (std::size_t it = 0; it < numIterations; ++it)
+                labeller.label(mask, blobs);
+            end = std::chrono::high_resolution_clock::now();
+            double const runs = std::chrono::duration<double>(end - start).count() / numIterations;
+
+            std::cout << size(0) << "x" << size(1) << " " << format << ": naive " << 1.0e+6 * naive << "us/frame, "
+                << "runs " << 1.0e+6 * runs << "us/frame, " << naive / runs << "x, "
+                << blobs.numComponents << " components, " << numNaive << " above minArea, "
+                << blobs.blobs.size() << " kept" << (blobs.bTruncated ? " (truncated)" : "") << std::endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include "rpiCam/EdgeDetector.hpp"
+#include "rpiCam/MemoryPixelSampleBuffer.hpp"
+#include "rpiCam/Logging.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace rpiCam;
+
+// shaded background, filled shapes and sensor noise, so there are real edges and flat areas
+void renderFrame(MemoryPixelSampleBuffer &frame, std::mt19937 &random)
+{
+    std::uint8_t *data = static_cast<std::uint8_t*>(frame.planeData(0));
+    std::size_t const rowBytes = frame.planeRowBytes(0);
+    Vec2ui const size = frame.planeSize(0);
+    for (std::uint32_t y = 0; y < size(1); ++y)
+    {
+        for (std::uint32_t x = 0; x < size(0); ++x)
+            data[y * rowBytes + x] = std::uint8_t(64 + (x + y) * 64 / (size(0) + size(1)));
+    }
+
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int is = 0; is < 80; ++is)
+    {
+        float const cx = unit(random) * size(0), cy = unit(random) * size(1);
+        float const rx = 8.0f + unit(random) * size(0) / 12, ry = 8.0f + unit(random) * size(1) / 12;
+        std::uint8_t const value = std::uint8_t(unit(random) * 255.0f);
+        bool const bBox = unit(random) < 0.5f;
+        for (std::uint32_t y = std::uint32_t(std::max(0.0f, cy - ry)); y < std::min<float>(size(1), cy + ry); ++y)
+        {
+            for (std::uint32_t x = std::uint32_t(std::max(0.0f, cx - rx)); x < std::min<float>(size(0), cx + rx); ++x)
+            {
+                float const u = (x - cx) / rx, v = (y - cy) / ry;
+                if (bBox || u * u + v * v <= 1.0f)
+                    data[y * rowBytes + x] = value;
+            }
+        }
+    }
+
+    std::normal_distribution<float> noise(0.0f, 3.0f);
+    for (std::uint32_t y = 0; y < size(1); ++y)
+    {
+        for (std::uint32_t x = 0; x < size(0); ++x)
+        {
+            float const v = data[y * rowBytes + x] + noise(random);
+            data[y * rowBytes + x] = std::uint8_t(std::max(0.0f, std::min(255.0f, v)));
+        }
+    }
+}
+
+template <typename F>
+double megapixelsPerSecond(Vec2ui const &size, std::size_t numIterations, F const &f)
+{
+    f();
+    auto start = std::chrono::high_resolution_clock::now();
+    for (std::size_t it = 0; it < numIterations; ++it)
+        f();
+    auto end = std::chrono::high_resolution_clock::now();
+    double const seconds = std::chrono::duration<double>(end - start).count() / numIterations;
+    return 1.0e-6 * size.prod() / seconds;
+}
+
+int main(int argc, char *argv[])
+{
+    setLogLevel(LOG_SILENT);
+
+    std::size_t const numIterations = argc > 1 ? std::stoul(argv[1]) : 20;
+    Vec2ui const size(1920, 1080);
+    std::mt19937 random(11);
+
+    MemoryPixelSampleBuffer frame(kPixelFormatGRAY8, size);
+    renderFrame(frame, random);
+
+    std::shared_ptr<ThreadPool> pool = ThreadPool::shared();
+
+    for (auto op : { EdgeDetectorOptions::Operator::Sobel, EdgeDetectorOptions::Operator::Scharr })
+    {
+        EdgeDetectorOptions options;
+        options.gradientOperator = op;
+        if (op == EdgeDetectorOptions::Operator::Scharr)
+        {
+            options.lowThreshold *= 4;
+            options.highThreshold *= 4;
+        }
+
+        struct Variant
+        {
+            char const *name;
+            bool bSimd;
+            std::shared_ptr<ThreadPool> pool;
+        };
+
+        for (auto const &variant : { Variant{"scalar", false, nullptr}, Variant{"simd", true, nullptr}, Variant{"simd+pool", true, pool} })
+        {
+            EdgeDetector detector(options, variant.pool);
+            detector.setSimdEnabled(variant.bSimd);
+            BinaryMask edges;
+
+            double const gradients = megapixelsPerSecond(size, numIterations, [&]() { detector.computeGradients(frame); });
+            double const canny = megapixelsPerSecond(size, numIterations, [&]() { detector.detect(frame, edges); });
+
+            options.bOrientation = true;
+            detector.setOptions(options);
+            double const oriented = megapixelsPerSecond(size, numIterations, [&]() { detector.computeGradients(frame); });
+            options.bOrientation = false;
+
+            std::cout << "1920x1080 " << op << " " << variant.name << ": gradients " << gradients << "MP/s, "
+                << "with orientation " << oriented << "MP/s, canny " << canny << "MP/s, "
+                << edges.count() << " edge pixels" << std::endl;
+        }
+    }
+    return 0;
+}
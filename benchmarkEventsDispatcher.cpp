@@ -0,0 +1,94 @@
+#include "rpiCam/Camera.hpp"
+#include "rpiCam/Logging.hpp"
+#include <iostream>
+#include <vector>
+
+using namespace rpiCam;
+
+class VideoFrameEvents
+    : public Camera::Events
+{
+public:
+    void onCameraVideoFrame(std::shared_ptr<PixelSampleBuffer> const &buffer) override
+    {
+        numFrames++;
+    }
+
+    std::size_t numFrames = 0;
+};
+
+class SnapshotEvents
+    : public Camera::Events
+{
+public:
+    void onCameraSnapshotTaken(std::shared_ptr<PixelSampleBuffer> const &buffer) override
+    {
+        numSnapshots++;
+    }
+
+    std::size_t numSnapshots = 0;
+};
+
+class VideoFrameListener
+{
+public:
+    inline void on(Camera::Event::VideoFrame, std::shared_ptr<PixelSampleBuffer> const &buffer)
+    {
+        numFrames++;
+    }
+
+    std::size_t numFrames = 0;
+};
+
+template <typename F>
+double measureNanosecondsPerDispatch(std::size_t numDispatches, F &&f)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    for (std::size_t id = 0; id < numDispatches; ++id)
+        f();
+    auto end = std::chrono::high_resolution_clock::now();
+    return double(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()) / numDispatches;
+}
+
+int main(int argc, char *argv[])
+{
+    setLogLevel(LOG_SILENT);
+
+    std::size_t const numDispatches = 1000000;
+    std::size_t const numSubscribers = argc > 1 ? std::stoul(argv[1]) : 4;
+
+    std::shared_ptr<PixelSampleBuffer> buffer;
+
+    std::vector<VideoFrameEvents> videoFrameEvents(numSubscribers);
+    std::vector<SnapshotEvents> snapshotEvents(numSubscribers);
+    std::vector<VideoFrameListener> videoFrameListeners(numSubscribers);
+    std::size_t numLambdaFrames = 0;
+
+    EventsDispatcher<Camera::Events> events;
+    Camera::CameraTypedEvents typedEvents;
+
+    for (std::size_t is = 0; is < numSubscribers; ++is)
+    {
+        events += &videoFrameEvents[is];
+        events += &snapshotEvents[is];
+
+        typedEvents.subscribe<Camera::Event::VideoFrame>(&videoFrameListeners[is]);
+        typedEvents.subscribe<Camera::Event::SnapshotTaken>([&numLambdaFrames](std::shared_ptr<PixelSampleBuffer> const &) { numLambdaFrames++; });
+    }
+
+    std::cout << "video frame dispatch, " << numSubscribers << " frame + " << numSubscribers << " snapshot subscribers:" << std::endl;
+
+    std::cout << "\tEventsDispatcher<Camera::Events>: "
+        << measureNanosecondsPerDispatch(numDispatches, [&]() { events.dispatch(&Camera::Events::onCameraVideoFrame, buffer); })
+        << " ns" << std::endl;
+
+    std::cout << "\tCamera::CameraTypedEvents (listeners): "
+        << measureNanosecondsPerDispatch(numDispatches, [&]() { typedEvents.dispatch<Camera::Event::VideoFrame>(buffer); })
+        << " ns" << std::endl;
+
+    std::cout << "\tCamera::CameraTypedEvents (lambdas): "
+        << measureNanosecondsPerDispatch(numDispatches, [&]() { typedEvents.dispatch<Camera::Event::SnapshotTaken>(buffer); })
+        << " ns" << std::endl;
+
+    return 0;
+}
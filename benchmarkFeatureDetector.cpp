@@ -0,0 +1,104 @@
+#include "rpiCam/FeatureDetector.hpp"
+#include "rpiCam/MemoryPixelSampleBuffer.hpp"
+#include "rpiCam/Logging.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace rpiCam;
+
+// textured rectangles over a noisy background, plenty of corners and flat areas
+void renderFrame(MemoryPixelSampleBuffer &frame, std::mt19937 &random, Vec2i const &shift)
+{
+    std::uint8_t *data = static_cast<std::uint8_t*>(frame.planeData(0));
+    std::size_t const rowBytes = frame.planeRowBytes(0);
+    Vec2ui const size = frame.planeSize(0);
+
+    std::mt19937 scene(3);
+    std::vector<std::uint8_t> background(size.prod());
+    for (auto &v : background)
+        v = std::uint8_t(96 + scene() % 8);
+    for (int ir = 0; ir < 400; ++ir)
+    {
+        std::int32_t const x0 = std::int32_t(scene() % size(0)), y0 = std::int32_t(scene() % size(1));
+        std::int32_t const w = 4 + std::int32_t(scene() % 40), h = 4 + std::int32_t(scene() % 40);
+        std::uint8_t const value = std::uint8_t(scene() % 256);
+        for (std::int32_t y = y0; y < std::min<std::int32_t>(size(1), y0 + h); ++y)
+            std::fill(background.begin() + y * size(0) + x0, background.begin() + y * size(0) + std::min<std::int32_t>(size(0), x0 + w), value);
+    }
+
+    for (std::uint32_t y = 0; y < size(1); ++y)
+    {
+        for (std::uint32_t x = 0; x < size(0); ++x)
+        {
+            std::uint32_t const sx = std::uint32_t(std::max(0, std::min<std::int32_t>(size(0) - 1, std::int32_t(x) + shift(0))));
+            std::uint32_t const sy = std::uint32_t(std::max(0, std::min<std::int32_t>(size(1) - 1, std::int32_t(y) + shift(1))));
+            data[y * rowBytes + x] = std::uint8_t(std::min<std::uint32_t>(255, background[sy * size(0) + sx] + random() % 4));
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    setLogLevel(LOG_SILENT);
+
+    std::size_t const numIterations = argc > 1 ? std::stoul(argv[1]) : 50;
+    std::vector<Vec2ui> const sizes = { Vec2ui(640, 480), Vec2ui(1280, 720) };
+    std::mt19937 random(5);
+
+    for (auto const &size : sizes)
+    {
+        MemoryPixelSampleBuffer frame(kPixelFormatGRAY8, size), next(kPixelFormatGRAY8, size);
+        renderFrame(frame, random, Vec2i(0, 0));
+        renderFrame(next, random, Vec2i(3, 2));
+
+        for (bool bDescriptors : { false, true })
+        {
+            FeatureOptions options;
+            options.bDescriptors = bDescriptors;
+
+            double seconds[2];
+            FeatureSet features(options), nextFeatures(options);
+            for (bool bSimd : { false, true })
+            {
+                FeatureDetector detector(options);
+                detector.setSimdEnabled(bSimd);
+                detector.detect(frame, 0, 1.0f, features);
+
+                auto start = std::chrono::high_resolution_clock::now();
+                for (std::size_t it = 0; it < numIterations; ++it)
+                    detector.detect(frame, 0, 1.0f, features);
+                auto end = std::chrono::high_resolution_clock::now();
+                seconds[bSimd] = std::chrono::duration<double>(end - start).count() / numIterations;
+
+                detector.detect(next, 0, 1.0f, nextFeatures);
+            }
+
+            std::cout << size(0) << "x" << size(1) << (bDescriptors ? " FAST+BRIEF" : " FAST") << ": scalar "
+                << 1.0e+3 * seconds[0] << "ms/frame, simd " << 1.0e+3 * seconds[1] << "ms/frame, "
+                << seconds[0] / seconds[1] << "x, " << features.keypoints.size() << " keypoints" << std::endl;
+
+            if (!bDescriptors)
+                continue;
+
+            FeatureMatchOptions matchOptions;
+            matchOptions.maxOffset = 16.0f;
+            std::vector<FeatureMatch> matches;
+            for (bool bSimd : { false, true })
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+                for (std::size_t it = 0; it < numIterations; ++it)
+                    matchFeatures(features, nextFeatures, matchOptions, matches, bSimd);
+                auto end = std::chrono::high_resolution_clock::now();
+                seconds[bSimd] = std::chrono::duration<double>(end - start).count() / numIterations;
+            }
+
+            std::cout << "  matching " << features.keypoints.size() << "x" << nextFeatures.keypoints.size()
+                << ": scalar " << 1.0e+3 * seconds[0] << "ms, simd " << 1.0e+3 * seconds[1] << "ms, "
+                << matches.size() << " matches" << std::endl;
+        }
+    }
+    return 0;
+}
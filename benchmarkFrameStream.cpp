@@ -0,0 +1,181 @@
+#include "rpiCam/FrameStream.hpp"
+#include "rpiCam/Logging.hpp"
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+#if defined(RPI_CAM_HAS_COROUTINES)
+
+using namespace rpiCam;
+
+// fire and forget coroutine, enough to drive the stream from main()
+struct DetachedTask
+{
+    struct promise_type
+    {
+        DetachedTask get_return_object() { return DetachedTask(); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+class SyntheticFrame
+    : public PixelSampleBuffer
+{
+public:
+    bool isValid() const override { return true; }
+    void* data() override { return nullptr; }
+    std::size_t size() const override { return 0; }
+    ePixelFormat format() const override { return kPixelFormatYUV420; }
+    std::size_t planeCount() const override { return 0; }
+    Vec2ui planeSize(std::size_t pi) const override { return Vec2ui(0, 0); }
+    void* planeData(std::size_t pi) override { return nullptr; }
+    std::size_t planeRowBytes(std::size_t pi) const override { return 0; }
+    std::error_code lock() override { return std::error_code(); }
+    std::error_code unlock() override { return std::error_code(); }
+};
+
+class ResumeLatency
+{
+public:
+    void add(std::shared_ptr<PixelSampleBuffer> const &frame)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(TimeClock::now() - frame->time).count());
+    }
+
+    std::size_t count() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_Samples.size();
+    }
+
+    void print(char const *name)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_Samples.empty())
+        {
+            std::cout << "\t" << name << ": no frames" << std::endl;
+            return;
+        }
+
+        std::sort(m_Samples.begin(), m_Samples.end());
+        double mean = 0.0;
+        for (auto s : m_Samples)
+            mean += double(s) / m_Samples.size();
+
+        std::cout << "\t" << name << ": " << m_Samples.size() << " frames"
+            << ", mean " << mean << "ns"
+            << ", p50 " << m_Samples[m_Samples.size() / 2] << "ns"
+            << ", p99 " << m_Samples[m_Samples.size() * 99 / 100] << "ns"
+            << ", max " << m_Samples.back() << "ns" << std::endl;
+    }
+
+private:
+    mutable std::mutex m_Mutex;
+    std::vector<std::int64_t> m_Samples;
+};
+
+DetachedTask consumeFrames(VideoFrameStream &frames, ResumeLatency &latency, std::atomic<bool> &done)
+{
+    while (auto frame = co_await frames.next())
+        latency.add(frame);
+    done = true;
+}
+
+void runSynthetic(char const *name, FrameStreamExecutor &executor, std::size_t numFrames)
+{
+    Camera::CameraEvents events;
+    VideoFrameStream frames(events, executor);
+    ResumeLatency latency;
+    std::atomic<bool> done(false);
+
+    consumeFrames(frames, latency, done);
+
+    auto frame = std::make_shared<SyntheticFrame>();
+    for (std::size_t ifr = 0; ifr < numFrames; ++ifr)
+    {
+        // wait for the consumer so every frame measures a parked coroutine
+        while (latency.count() < ifr)
+            std::this_thread::yield();
+
+        frame->time = TimeClock::now();
+        events.dispatch(&Camera::Events::onCameraVideoFrame, frame);
+    }
+
+    while (latency.count() < numFrames)
+        std::this_thread::yield();
+
+    events.dispatch(&Camera::Events::onCameraVideoStopped);
+    while (!done)
+        std::this_thread::yield();
+
+    latency.print(name);
+}
+
+void runCamera(std::shared_ptr<Camera> cam, char const *name, FrameStreamExecutor &executor, std::chrono::seconds duration)
+{
+    VideoFrameStream frames(*cam, executor);
+    ResumeLatency latency;
+    std::atomic<bool> done(false);
+
+    consumeFrames(frames, latency, done);
+
+    if (cam->startVideo())
+    {
+        std::cout << "\t" << name << ": NA" << std::endl;
+        frames.cancel();
+        return;
+    }
+
+    std::this_thread::sleep_for(duration);
+    cam->stopVideo();
+
+    while (!done)
+        std::this_thread::yield();
+
+    latency.print(name);
+    std::cout << "\t\tdropped: " << frames.numDropped() << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    setLogLevel(LOG_SILENT);
+
+    std::size_t const numFrames = argc > 1 ? std::stoul(argv[1]) : 10000;
+
+    InlineFrameStreamExecutor inlineExecutor;
+    ThreadPoolFrameStreamExecutor poolExecutor;
+
+    std::cout << "synthetic frame-to-resume latency:" << std::endl;
+    runSynthetic("inline", inlineExecutor, numFrames);
+    runSynthetic("thread pool", poolExecutor, numFrames);
+
+    for (auto cam : Device::list<Camera>())
+    {
+        if (cam->open())
+            continue;
+
+        std::cout << "camera: " << cam->name() << std::endl;
+        cam->setVideoFormat(kPixelFormatYUV420);
+        cam->setVideoSize(Vec2ui(1280, 720));
+
+        runCamera(cam, "inline", inlineExecutor, std::chrono::seconds(5));
+        runCamera(cam, "thread pool", poolExecutor, std::chrono::seconds(5));
+
+        cam->close();
+    }
+    return 0;
+}
+
+#else
+
+int main(int argc, char *argv[])
+{
+    std::cout << "benchmarkFrameStream needs a compiler with coroutine support" << std::endl;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,96 @@
+#include "rpiCam/ImageScaler.hpp"
+#include "rpiCam/MemoryPixelSampleBuffer.hpp"
+#include "rpiCam/Logging.hpp"
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+using namespace rpiCam;
+
+// straightforward per-pixel floating point bilinear resize, the baseline the scaler replaces
+void naiveBilinear(PixelBuffer &src, PixelBuffer &dst)
+{
+    for (std::size_t pi = 0; pi < src.planeCount(); ++pi)
+    {
+        std::uint8_t const *s = static_cast<std::uint8_t const*>(src.planeData(pi));
+        std::uint8_t *d = static_cast<std::uint8_t*>(dst.planeData(pi));
+        Vec2ui const srcSize = src.planeSize(pi);
+        Vec2ui const dstSize = dst.planeSize(pi);
+        float const sx = float(srcSize(0)) / dstSize(0);
+        float const sy = float(srcSize(1)) / dstSize(1);
+
+        for (std::uint32_t y = 0; y < dstSize(1); ++y)
+        {
+            float const fy = std::max(0.0f, (y + 0.5f) * sy - 0.5f);
+            std::uint32_t const y0 = std::min(std::uint32_t(fy), srcSize(1) - 1);
+            std::uint32_t const y1 = std::min(y0 + 1, srcSize(1) - 1);
+            float const wy = fy - y0;
+            for (std::uint32_t x = 0; x < dstSize(0); ++x)
+            {
+                float const fx = std::max(0.0f, (x + 0.5f) * sx - 0.5f);
+                std::uint32_t const x0 = std::min(std::uint32_t(fx), srcSize(0) - 1);
+                std::uint32_t const x1 = std::min(x0 + 1, srcSize(0) - 1);
+                float const wx = fx - x0;
+                float const top = s[y0 * src.planeRowBytes(pi) + x0] * (1.0f - wx) + s[y0 * src.planeRowBytes(pi) + x1] * wx;
+                float const bottom = s[y1 * src.planeRowBytes(pi) + x0] * (1.0f - wx) + s[y1 * src.planeRowBytes(pi) + x1] * wx;
+                d[y * dst.planeRowBytes(pi) + x] = std::uint8_t(top * (1.0f - wy) + bottom * wy + 0.5f);
+            }
+        }
+    }
+}
+
+template <typename Scale>
+double measure(std::size_t numIterations, std::vector< std::shared_ptr<PixelSampleBuffer> > const &frames, Scale &&scale)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    for (std::size_t it = 0; it < numIterations; ++it)
+        scale(*frames[it % frames.size()]);
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double>(end - start).count() / numIterations;
+}
+
+int main(int argc, char *argv[])
+{
+    setLogLevel(LOG_SILENT);
+
+    Vec2ui const frameSize(1920, 1080);
+    std::size_t const numIterations = argc > 1 ? std::stoul(argv[1]) : 100;
+
+    // a gradient with some texture, several frames so every pass streams from memory
+    std::vector< std::shared_ptr<PixelSampleBuffer> > frames;
+    for (std::size_t ifr = 0; ifr < 8; ++ifr)
+    {
+        frames.push_back(std::make_shared<MemoryPixelSampleBuffer>(kPixelFormatYUV420, frameSize));
+        std::uint8_t *data = static_cast<std::uint8_t*>(frames.back()->data());
+        for (std::size_t i = 0; i < frames.back()->size(); ++i)
+            data[i] = std::uint8_t((i * 7 + ifr * 13 + (i >> 11)) & 0xff);
+    }
+
+    std::vector<Vec2ui> const targets = { Vec2ui(320, 240), Vec2ui(640, 360), Vec2ui(960, 540), Vec2ui(480, 270) };
+    std::vector<ImageScaler::Mode> const modes = { ImageScaler::Mode::Nearest, ImageScaler::Mode::Bilinear, ImageScaler::Mode::Area };
+
+    for (auto const &target : targets)
+    {
+        MemoryPixelSampleBuffer dst(kPixelFormatYUV420, target);
+
+        double const baseline = measure(numIterations, frames, [&dst](PixelBuffer &src) { naiveBilinear(src, dst); });
+        std::cout << frameSize(0) << "x" << frameSize(1) << " -> " << target(0) << "x" << target(1) << std::endl;
+        std::cout << "  naive float bilinear: " << 1.0e+6 * baseline << "us/frame" << std::endl;
+
+        for (auto mode : modes)
+        {
+            for (bool bSimd : { false, true })
+            {
+                ImageScaler scaler(mode);
+                scaler.setSimdEnabled(bSimd);
+                double const seconds = measure(numIterations, frames, [&scaler, &dst](PixelBuffer &src) { scaler.scale(src, dst); });
+
+                std::cout << "  " << mode << (bSimd ? " simd: " : " scalar: ")
+                    << 1.0e+6 * seconds << "us/frame, "
+                    << double(frameSize.prod()) * 1.5 / seconds / 1.0e+6 << "MB/s, "
+                    << baseline / seconds << "x vs naive" << std::endl;
+            }
+        }
+    }
+    return 0;
+}
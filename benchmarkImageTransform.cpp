@@ -0,0 +1,91 @@
+#include "rpiCam/ImageTransform.hpp"
+#include "rpiCam/Logging.hpp"
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace rpiCam;
+
+// the straightforward loop, walks the source in order and scatters to the destination
+void naiveTransform(PixelBuffer &src, PixelBuffer &dst, ImageTransform transform)
+{
+    PixelFormatDescriptor const descriptor = pixelFormatDescriptor(src.format());
+    for (std::size_t pi = 0; pi < descriptor.planeCount; ++pi)
+    {
+        std::size_t const bpp = descriptor.bytesPerPixel[pi];
+        std::uint8_t const *s = static_cast<std::uint8_t const*>(src.planeData(pi));
+        std::uint8_t *d = static_cast<std::uint8_t*>(dst.planeData(pi));
+        std::size_t const srcRowBytes = src.planeRowBytes(pi);
+        std::size_t const dstRowBytes = dst.planeRowBytes(pi);
+        std::uint32_t const w = src.planeSize(pi)(0);
+        std::uint32_t const h = src.planeSize(pi)(1);
+
+        for (std::uint32_t y = 0; y < h; ++y)
+        {
+            for (std::uint32_t x = 0; x < w; ++x)
+            {
+                std::uint32_t dx = x, dy = y;
+                switch(transform)
+                {
+                case ImageTransform::Rotate90:          dx = h - 1 - y; dy = x;         break;
+                case ImageTransform::Rotate180:         dx = w - 1 - x; dy = h - 1 - y; break;
+                case ImageTransform::Rotate270:         dx = y; dy = w - 1 - x;         break;
+                case ImageTransform::FlipHorizontal:    dx = w - 1 - x;                 break;
+                case ImageTransform::FlipVertical:      dy = h - 1 - y;                 break;
+                case ImageTransform::Transpose:         dx = y; dy = x;                 break;
+                default:                                                                break;
+                }
+                std::memcpy(d + dy * dstRowBytes + dx * bpp, s + y * srcRowBytes + x * bpp, bpp);
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    setLogLevel(LOG_SILENT);
+
+    Vec2ui const frameSize(1920, 1080);
+    std::size_t const numIterations = argc > 1 ? std::stoul(argv[1]) : 50;
+
+    std::vector<ePixelFormat> const formats = { kPixelFormatYUV420, kPixelFormatNV12, kPixelFormatRGB8 };
+    std::vector<ImageTransform> const transforms = {
+        ImageTransform::Rotate90,
+        ImageTransform::Rotate180,
+        ImageTransform::Rotate270,
+        ImageTransform::FlipHorizontal,
+        ImageTransform::FlipVertical,
+        ImageTransform::Transpose
+    };
+
+    for (auto format : formats)
+    {
+        MemoryPixelSampleBuffer src(format, frameSize);
+        std::uint8_t *data = static_cast<std::uint8_t*>(src.data());
+        for (std::size_t i = 0; i < src.size(); ++i)
+            data[i] = std::uint8_t(i * 31);
+
+        std::cout << "format " << format << ", " << frameSize(0) << "x" << frameSize(1) << std::endl;
+        for (auto transform : transforms)
+        {
+            MemoryPixelSampleBuffer dst(format, transformedImageSize(transform, frameSize));
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (std::size_t it = 0; it < numIterations; ++it)
+                naiveTransform(src, dst, transform);
+            auto end = std::chrono::high_resolution_clock::now();
+            double const naive = std::chrono::duration<double>(end - start).count() / numIterations;
+
+            start = std::chrono::high_resolution_clock::now();
+            for (std::size_t it = 0; it < numIterations; ++it)
+                transformPixelBuffer(src, dst, transform);
+            end = std::chrono::high_resolution_clock::now();
+            double const tiled = std::chrono::duration<double>(end - start).count() / numIterations;
+
+            std::cout << "  " << transform << ": naive " << 1.0e+6 * naive << "us/frame, "
+                << "tiled " << 1.0e+6 * tiled << "us/frame, "
+                << naive / tiled << "x" << std::endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include "rpiCam/ImageWarp.hpp"
+#include "rpiCam/MemoryPixelSampleBuffer.hpp"
+#include "rpiCam/Logging.hpp"
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+
+using namespace rpiCam;
+
+template <typename W>
+double benchmark(W warp, std::size_t iterations)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    for (std::size_t i = 0; i < iterations; ++i)
+        warp();
+    auto end = std::chrono::high_resolution_clock::now();
+    return 1.0e+3 * std::chrono::duration<double>(end - start).count() / iterations;
+}
+
+int main(int argc, char *argv[])
+{
+    setLogLevel(LOG_SILENT);
+
+    std::size_t const iterations = argc > 1 ? std::stoul(argv[1]) : 20;
+    Vec2ui const srcSize(1280, 720), dstSize(640, 480);
+
+    MemoryPixelSampleBuffer src(kPixelFormatYUV420, srcSize);
+    MemoryPixelSampleBuffer dst(kPixelFormatYUV420, dstSize);
+    std::mt19937 random(11);
+    std::uint8_t *data = static_cast<std::uint8_t*>(src.data());
+    for (std::size_t i = 0; i < src.size(); ++i)
+        data[i] = std::uint8_t(random());
+
+    // a rotated crop, and a whiteboard seen at an angle rectified
+    Eigen::Matrix3f affine;
+    affine << 1.2f * std::cos(0.3f), -1.2f * std::sin(0.3f), 400.0f,
+              1.2f * std::sin(0.3f), 1.2f * std::cos(0.3f), 20.0f,
+              0.0f, 0.0f, 1.0f;
+
+    std::array<Vec2f, 4> const corners = {{ Vec2f(0.0f, 0.0f), Vec2f(639.0f, 0.0f), Vec2f(0.0f, 479.0f), Vec2f(639.0f, 479.0f) }};
+    std::array<Vec2f, 4> const quad = {{ Vec2f(250.0f, 90.0f), Vec2f(1100.0f, 20.0f), Vec2f(180.0f, 650.0f), Vec2f(1200.0f, 700.0f) }};
+    Eigen::Matrix3f homography;
+    if (fitHomography(corners, quad, homography))
+    {
+        std::cout << "fitHomography() failed!" << std::endl;
+        return 1;
+    }
+
+    for (bool bSimd : { false, true })
+    {
+        ImageWarper warper;
+        warper.setSimdEnabled(bSimd);
+        std::cout << srcSize(0) << "x" << srcSize(1) << " to " << dstSize(0) << "x" << dstSize(1) << (bSimd ? " simd" : " scalar")
+            << ": affine " << benchmark([&]() { warper.warpAffine(src, dst, affine); }, iterations)
+            << "ms/frame, perspective " << benchmark([&]() { warper.warpPerspective(src, dst, homography); }, iterations)
+            << "ms/frame" << std::endl;
+    }
+    return 0;
+}
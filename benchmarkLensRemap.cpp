@@ -0,0 +1,79 @@
+#include "rpiCam/LensRemap.hpp"
+#include "rpiCam/MemoryPixelSampleBuffer.hpp"
+#include "rpiCam/Logging.hpp"
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace rpiCam;
+
+double benchmark(LensRemapper &remapper, PixelSampleBuffer &frame, std::size_t iterations)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    for (std::size_t i = 0; i < iterations; ++i)
+        remapper.remap(frame);
+    auto end = std::chrono::high_resolution_clock::now();
+    return 1.0e+3 * std::chrono::duration<double>(end - start).count() / iterations;
+}
+
+int main(int argc, char *argv[])
+{
+    setLogLevel(LOG_SILENT);
+
+    std::size_t const iterations = argc > 1 ? std::stoul(argv[1]) : 20;
+    Vec2ui const size(1280, 720);
+
+    MemoryPixelSampleBuffer frame(kPixelFormatYUV420, size);
+    std::mt19937 random(7);
+    std::uint8_t *data = static_cast<std::uint8_t*>(frame.data());
+    for (std::size_t i = 0; i < frame.size(); ++i)
+        data[i] = std::uint8_t(random());
+
+    CameraIntrinsics intrinsics;
+    intrinsics.imageSize = size;
+
+    struct Setup
+    {
+        char const *name;
+        LensModel model;
+        float focalLength;
+    };
+
+    for (Setup const &setup : { Setup{ "brown-conrady undistort", LensModel::BrownConrady, 900.0f }, Setup{ "fisheye 3 views", LensModel::Fisheye, 400.0f } })
+    {
+        intrinsics.focalLength = Vec2f(setup.focalLength, setup.focalLength);
+        intrinsics.principalPoint = Vec2f(639.5f, 359.5f);
+
+        LensDistortion distortion;
+        distortion.model = setup.model;
+        std::vector<RemapView> views;
+        if (setup.model == LensModel::BrownConrady)
+        {
+            distortion.k1 = -0.3f;
+            distortion.k2 = 0.1f;
+            views.push_back(RemapView::undistorted(intrinsics));
+        }
+        else
+        {
+            distortion.k1 = 0.02f;
+            for (float yaw : { -0.9f, 0.0f, 0.9f })
+                views.push_back(RemapView::perspective(Vec2ui(640, 480), 1.4f, yaw));
+        }
+
+        for (bool bSimd : { false, true })
+        {
+            LensRemapper remapper;
+            remapper.setSimdEnabled(bSimd);
+            auto start = std::chrono::high_resolution_clock::now();
+            remapper.configure(frame.format(), intrinsics, distortion, views);
+            auto end = std::chrono::high_resolution_clock::now();
+
+            std::cout << setup.name << " " << size(0) << "x" << size(1) << (bSimd ? " simd: " : " scalar: ")
+                << benchmark(remapper, frame, iterations) << "ms/frame, configure "
+                << 1.0e+3 * std::chrono::duration<double>(end - start).count() << "ms" << std::endl;
+        }
+    }
+    return 0;
+}
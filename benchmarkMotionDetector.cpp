@@ -0,0 +1,79 @@
+#include "rpiCam/MotionDetector.hpp"
+#include "rpiCam/MemoryPixelSampleBuffer.hpp"
+#include "rpiCam/Logging.hpp"
+#include <cstring>
+#include <iostream>
+#include <random>
+
+using namespace rpiCam;
+
+// a textured static scene with sensor noise and a bright square crossing it
+void renderFrame(MemoryPixelSampleBuffer &frame, std::uint32_t index, std::mt19937 &random)
+{
+    std::uint8_t *data = static_cast<std::uint8_t*>(frame.data());
+    std::memset(data, 128, frame.size());
+
+    std::uint8_t *y = static_cast<std::uint8_t*>(frame.planeData(0));
+    std::size_t const rowBytes = frame.planeRowBytes(0);
+    Vec2ui const size = frame.planeSize(0);
+    std::uniform_int_distribution<int> noise(-3, 3);
+    std::uint32_t const squareX = (index * 8) % size(0);
+    for (std::uint32_t py = 0; py < size(1); ++py)
+    {
+        for (std::uint32_t px = 0; px < size(0); ++px)
+        {
+            int v = int((px * 7 + py * 3) & 0x7f) + 64 + noise(random);
+            if (px >= squareX && px < squareX + 48 && py >= 200 && py < 248)
+                v = 240;
+            y[py * rowBytes + px] = std::uint8_t(std::min(255, std::max(0, v)));
+        }
+    }
+    frame.sequence = index;
+}
+
+double measure(MotionDetectorOptions const &options, bool bSimd, std::size_t numFrames, MotionResult &last)
+{
+    MotionDetector detector(options);
+    detector.setSimdEnabled(bSimd);
+
+    std::mt19937 random(42);
+    double total = 0.0;
+    for (std::uint32_t i = 0; i < numFrames; ++i)
+    {
+        // every frame is new so its pyramid has to be computed, as for camera frames
+        MemoryPixelSampleBuffer frame(kPixelFormatYUV420, Vec2ui(640, 480));
+        renderFrame(frame, i, random);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        detector.process(frame, last);
+        auto end = std::chrono::high_resolution_clock::now();
+        total += std::chrono::duration<double>(end - start).count();
+    }
+    return total / numFrames;
+}
+
+int main(int argc, char *argv[])
+{
+    setLogLevel(LOG_SILENT);
+
+    std::size_t const numFrames = argc > 1 ? std::stoul(argv[1]) : 200;
+
+    for (std::uint32_t level = 0; level <= 2; ++level)
+    {
+        MotionDetectorOptions options;
+        options.level = level;
+
+        MotionResult result;
+        double const scalar = measure(options, false, numFrames, result);
+        double const simd = measure(options, true, numFrames, result);
+
+        std::cout << "640x480, level " << level << ": scalar " << 1.0e+6 * scalar << "us/frame, "
+            << "simd " << 1.0e+6 * simd << "us/frame, "
+            << scalar / simd << "x" << std::endl;
+        std::cout << "  last frame: score " << result.score << ", noise " << result.noise
+            << ", motion " << result.bMotion
+            << ", box " << result.boundingBox.origin(0) << "," << result.boundingBox.origin(1)
+            << " " << result.boundingBox.size(0) << "x" << result.boundingBox.size(1) << std::endl;
+    }
+    return 0;
+}
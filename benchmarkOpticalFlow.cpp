@@ -0,0 +1,117 @@
+#include "rpiCam/OpticalFlow.hpp"
+#include "rpiCam/FeatureDetector.hpp"
+#include "rpiCam/MemoryPixelSampleBuffer.hpp"
+#include "rpiCam/Logging.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace rpiCam;
+
+// smooth texture sampled at an offset, so frames can move by fractions of a pixel
+void renderFrame(MemoryPixelSampleBuffer &frame, std::mt19937 &random, Vec2f const &shift)
+{
+    std::uint8_t *data = static_cast<std::uint8_t*>(frame.planeData(0));
+    std::size_t const rowBytes = frame.planeRowBytes(0);
+    Vec2ui const size = frame.planeSize(0);
+
+    for (std::uint32_t y = 0; y < size(1); ++y)
+    {
+        for (std::uint32_t x = 0; x < size(0); ++x)
+        {
+            float const sx = float(x) - shift(0), sy = float(y) - shift(1);
+            float const v = 128.0f +
+                40.0f * std::sin(0.11f * sx + 3.0f * std::cos(0.07f * sy)) +
+                30.0f * std::cos(0.13f * sy - 0.05f * sx) +
+                25.0f * std::sin(0.21f * (sx + sy)) * std::cos(0.17f * (sx - sy));
+            data[y * rowBytes + x] = std::uint8_t(std::max(0.0f, std::min(255.0f, v + float(random() % 3))));
+        }
+    }
+}
+
+// a copy without the pyramid of the source, so every pass builds its own
+std::unique_ptr<MemoryPixelSampleBuffer> copyFrame(MemoryPixelSampleBuffer &source)
+{
+    Vec2ui const size = source.planeSize(0);
+    std::unique_ptr<MemoryPixelSampleBuffer> frame(new MemoryPixelSampleBuffer(kPixelFormatGRAY8, size));
+    for (std::uint32_t y = 0; y < size(1); ++y)
+    {
+        std::memcpy(static_cast<std::uint8_t*>(frame->planeData(0)) + y * frame->planeRowBytes(0),
+            static_cast<std::uint8_t const*>(source.planeData(0)) + y * source.planeRowBytes(0), size(0));
+    }
+    return frame;
+}
+
+int main(int argc, char *argv[])
+{
+    setLogLevel(LOG_SILENT);
+
+    std::size_t const numFrames = argc > 1 ? std::stoul(argv[1]) : 30;
+    Vec2ui const size(640, 480);
+    Vec2f const motion(1.7f, -0.8f);
+    std::mt19937 random(5);
+
+    std::vector<std::unique_ptr<MemoryPixelSampleBuffer>> frames;
+    for (std::size_t fi = 0; fi <= numFrames; ++fi)
+    {
+        frames.emplace_back(new MemoryPixelSampleBuffer(kPixelFormatGRAY8, size));
+        renderFrame(*frames.back(), random, motion * float(fi));
+    }
+
+    FeatureOptions featureOptions;
+    featureOptions.maxFeatures = 400;
+    featureOptions.threshold = 6;
+    featureOptions.bDescriptors = false;
+    FeatureDetector detector(featureOptions);
+    FeatureSet features(featureOptions);
+    detector.detect(*frames[0], 0, 1.0f, features);
+
+    struct Variant
+    {
+        char const *name;
+        bool bSimd;
+        std::shared_ptr<ThreadPool> pool;
+    };
+
+    // pyramids and gradients are part of the time, as for frames off a camera
+    for (auto const &variant : { Variant{"scalar", false, nullptr}, Variant{"simd", true, nullptr}, Variant{"simd+pool", true, ThreadPool::shared()} })
+    {
+        std::vector<std::unique_ptr<MemoryPixelSampleBuffer>> pass;
+        for (auto const &frame : frames)
+            pass.push_back(copyFrame(*frame));
+
+        OpticalFlowTracker tracker(OpticalFlowOptions(), variant.pool);
+        tracker.setSimdEnabled(variant.bSimd);
+
+        std::vector<TrackedPoint> points;
+        for (auto const &keypoint : features.keypoints)
+            points.emplace_back(keypoint.position);
+        tracker.process(*pass[0], points);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (std::size_t fi = 1; fi <= numFrames; ++fi)
+            tracker.process(*pass[fi], points);
+        auto end = std::chrono::high_resolution_clock::now();
+        double const seconds = std::chrono::duration<double>(end - start).count() / numFrames;
+
+        std::size_t numTracked = 0;
+        double drift = 0.0;
+        for (std::size_t ip = 0; ip < points.size(); ++ip)
+        {
+            if (!points[ip].bTracked)
+                continue;
+            ++numTracked;
+            drift += (points[ip].position - features.keypoints[ip].position - motion * float(numFrames)).norm();
+        }
+
+        std::cout << size(0) << "x" << size(1) << " " << variant.name << ": "
+            << 1.0e+3 * seconds << "ms/frame, " << numTracked << "/" << points.size() << " points tracked over "
+            << numFrames << " frames, mean drift " << (numTracked ? drift / numTracked : 0.0) << "px" << std::endl;
+    }
+    return 0;
+}
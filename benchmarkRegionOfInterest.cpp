@@ -0,0 +1,90 @@
+#include "rpiCam/CroppedPixelSampleBuffer.hpp"
+#include "rpiCam/MemoryPixelSampleBuffer.hpp"
+#include "rpiCam/ImageView.hpp"
+#include "rpiCam/Logging.hpp"
+#include <iostream>
+#include <vector>
+
+using namespace rpiCam;
+
+// touches every luma and chroma byte of the buffer once, like a typical per-pixel kernel
+std::uint64_t sumPlanes(PixelBuffer &buffer)
+{
+    std::uint64_t sum = 0;
+    for (std::size_t pi = 0; pi < buffer.planeCount(); ++pi)
+    {
+        std::uint8_t const *data = static_cast<std::uint8_t const*>(buffer.planeData(pi));
+        std::size_t const rowBytes = buffer.planeRowBytes(pi);
+        Vec2ui const size = buffer.planeSize(pi);
+        for (std::uint32_t y = 0; y < size(1); ++y, data += rowBytes)
+        {
+            std::uint32_t rowSum = 0;
+            for (std::uint32_t x = 0; x < size(0); ++x)
+                rowSum += data[x];
+            sum += rowSum;
+        }
+    }
+    return sum;
+}
+
+std::size_t touchedBytes(PixelBuffer &buffer)
+{
+    std::size_t bytes = 0;
+    for (std::size_t pi = 0; pi < buffer.planeCount(); ++pi)
+        bytes += buffer.planeSize(pi).prod();
+    return bytes;
+}
+
+int main(int argc, char *argv[])
+{
+    setLogLevel(LOG_SILENT);
+
+    Vec2ui const frameSize(1920, 1080);
+    std::size_t const numIterations = argc > 1 ? std::stoul(argv[1]) : 200;
+
+    // more frames than fit in cache so every pass streams from memory
+    std::vector< std::shared_ptr<PixelSampleBuffer> > frames;
+    for (std::size_t ifr = 0; ifr < 8; ++ifr)
+    {
+        frames.push_back(std::make_shared<MemoryPixelSampleBuffer>(kPixelFormatYUV420, frameSize));
+        std::fill_n(static_cast<std::uint8_t*>(frames.back()->data()), frames.back()->size(), std::uint8_t(ifr));
+    }
+
+    std::vector< std::pair<char const*, Rect> > regions =
+    {
+        { "full frame", Rect(0, 0, frameSize(0), frameSize(1)) },
+        { "doorway 480x1080", Rect(720, 0, 480, 1080) },
+        { "lane 1920x240", Rect(0, 420, 1920, 240) },
+        { "spot 321x181", Rect(801, 451, 321, 181) }
+    };
+
+    double fullFrameTime = 0.0;
+    for (auto const &region : regions)
+    {
+        std::uint64_t checksum = 0;
+        std::size_t bytes = 0;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (std::size_t it = 0; it < numIterations; ++it)
+        {
+            std::shared_ptr<PixelSampleBuffer> cropped = cropPixelSampleBuffer(frames[it % frames.size()], region.second);
+            cropped->lock();
+            checksum += sumPlanes(*cropped);
+            bytes = touchedBytes(*cropped);
+            cropped->unlock();
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+
+        double const seconds = std::chrono::duration<double>(end - start).count();
+        if (fullFrameTime == 0.0)
+            fullFrameTime = seconds;
+
+        std::cout << region.first << ": "
+            << 1.0e+6 * seconds / numIterations << "us/frame, "
+            << bytes / 1024 << "KiB/frame, "
+            << double(bytes) * numIterations / seconds / 1.0e+9 << "GB/s, "
+            << fullFrameTime / seconds << "x vs full frame"
+            << " (checksum " << checksum << ")" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include "rpiCam/VideoStabilizer.hpp"
+#include "rpiCam/MemoryPixelSampleBuffer.hpp"
+#include "rpiCam/Logging.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace rpiCam;
+
+// smooth texture panning slowly with hand shake on top, the chroma planes are flat
+std::shared_ptr<MemoryPixelSampleBuffer> renderFrame(Vec2ui const &size, Vec2f const &shift, float angle)
+{
+    std::shared_ptr<MemoryPixelSampleBuffer> frame = std::make_shared<MemoryPixelSampleBuffer>(kPixelFormatYUV420, size);
+    std::uint8_t *data = static_cast<std::uint8_t*>(frame->planeData(0));
+    std::size_t const rowBytes = frame->planeRowBytes(0);
+    Vec2f const center = 0.5f * (size.cast<float>() - Vec2f(1.0f, 1.0f));
+    float const c = std::cos(angle), s = std::sin(angle);
+
+    for (std::uint32_t y = 0; y < size(1); ++y)
+    {
+        for (std::uint32_t x = 0; x < size(0); ++x)
+        {
+            Vec2f const p = Vec2f(float(x), float(y)) - center - shift;
+            float const sx = c * p(0) + s * p(1), sy = c * p(1) - s * p(0);
+            float const v = 128.0f +
+                40.0f * std::sin(0.11f * sx + 3.0f * std::cos(0.07f * sy)) +
+                30.0f * std::cos(0.13f * sy - 0.05f * sx) +
+                25.0f * std::sin(0.21f * (sx + sy)) * std::cos(0.17f * (sx - sy));
+            data[y * rowBytes + x] = std::uint8_t(std::max(0.0f, std::min(255.0f, v)));
+        }
+    }
+
+    for (std::size_t pi = 1; pi < frame->planeCount(); ++pi)
+        std::fill_n(static_cast<std::uint8_t*>(frame->planeData(pi)), frame->planeRowBytes(pi) * frame->planeSize(pi)(1), 128);
+    return frame;
+}
+
+int main(int argc, char *argv[])
+{
+    setLogLevel(LOG_SILENT);
+
+    std::size_t const numFrames = argc > 1 ? std::stoul(argv[1]) : 60;
+    Vec2ui const size(640, 480);
+    std::mt19937 random(5);
+    std::normal_distribution<float> shake(0.0f, 2.0f), roll(0.0f, 0.005f);
+
+    std::vector<std::shared_ptr<PixelSampleBuffer>> frames;
+    for (std::size_t fi = 0; fi < numFrames; ++fi)
+        frames.push_back(renderFrame(size, Vec2f(0.5f * fi + shake(random), shake(random)), roll(random)));
+
+    for (std::uint32_t lookAhead : { 0, 15 })
+    {
+        VideoStabilizerOptions options;
+        options.lookAhead = lookAhead;
+        options.featureThreshold = 8;
+        VideoStabilizer stabilizer(options);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (auto const &frame : frames)
+            stabilizer.process(frame);
+        stabilizer.finish();
+        auto end = std::chrono::high_resolution_clock::now();
+
+        VideoStabilizerStats const stats = stabilizer.stats();
+        std::cout << size(0) << "x" << size(1) << " look-ahead " << lookAhead << ": "
+            << 1.0e+3 * std::chrono::duration<double>(end - start).count() / numFrames << "ms/frame, cost mean "
+            << 1.0e+3 * std::chrono::duration<double>(stats.meanProcessingTime).count() << "ms max "
+            << 1.0e+3 * std::chrono::duration<double>(stats.maxProcessingTime).count() << "ms, latency mean "
+            << 1.0e+3 * std::chrono::duration<double>(stats.meanLatency).count() << "ms max "
+            << 1.0e+3 * std::chrono::duration<double>(stats.maxLatency).count() << "ms, "
+            << stats.processed << " frames" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,247 @@
+#include "rpiCam/PixelConversion.hpp"
+#include "rpiCam/MemoryPixelSampleBuffer.hpp"
+#include "rpiCam/Logging.hpp"
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+using namespace rpiCam;
+
+namespace
+{
+    Vec2ui const kSize(64, 32);
+    std::size_t failures = 0;
+
+    // chroma is constant over 2x2 blocks so every layout holds the reference exactly
+    std::uint8_t refY(std::uint32_t x, std::uint32_t y) { return std::uint8_t(16 + x * 3 + y * 2); }
+    std::uint8_t refU(std::uint32_t x, std::uint32_t y) { return std::uint8_t(40 + (x >> 1) * 5 + (y >> 1)); }
+    std::uint8_t refV(std::uint32_t x, std::uint32_t y) { return std::uint8_t(220 - (x >> 1) * 3 - (y >> 1) * 2); }
+
+    std::uint8_t at(PixelBuffer &buffer, std::size_t pi, std::uint32_t x, std::uint32_t y, std::size_t bytesPerPixel, std::size_t offset)
+    {
+        return static_cast<std::uint8_t*>(buffer.planeData(pi))[y * buffer.planeRowBytes(pi) + x * bytesPerPixel + offset];
+    }
+
+    void check(bool bOk, ePixelFormat format, char const *what, std::uint32_t x, std::uint32_t y)
+    {
+        if (bOk)
+            return;
+
+        if (failures++ < 16)
+            std::cout << format << ": " << what << " mismatch at " << x << "," << y << std::endl;
+    }
+
+    // the sample of each component where the layout of format puts it
+    void checkYUVLayout(PixelBuffer &buffer)
+    {
+        ePixelFormat const format = buffer.format();
+        for (std::uint32_t y = 0; y < kSize(1); ++y)
+        {
+            for (std::uint32_t x = 0; x < kSize(0); ++x)
+            {
+                std::uint8_t Y = 0, U = 128, V = 128;
+                switch(format)
+                {
+                case kPixelFormatGRAY8:
+                    Y = at(buffer, 0, x, y, 1, 0);
+                    U = refU(x, y); V = refV(x, y);
+                    break;
+                case kPixelFormatYUV420:
+                    Y = at(buffer, 0, x, y, 1, 0); U = at(buffer, 1, x >> 1, y >> 1, 1, 0); V = at(buffer, 2, x >> 1, y >> 1, 1, 0);
+                    break;
+                case kPixelFormatYUV422:
+                    Y = at(buffer, 0, x, y, 1, 0); U = at(buffer, 1, x >> 1, y, 1, 0); V = at(buffer, 2, x >> 1, y, 1, 0);
+                    break;
+                case kPixelFormatNV12:
+                    Y = at(buffer, 0, x, y, 1, 0); U = at(buffer, 1, x >> 1, y >> 1, 2, 0); V = at(buffer, 1, x >> 1, y >> 1, 2, 1);
+                    break;
+                case kPixelFormatNV21:
+                    Y = at(buffer, 0, x, y, 1, 0); V = at(buffer, 1, x >> 1, y >> 1, 2, 0); U = at(buffer, 1, x >> 1, y >> 1, 2, 1);
+                    break;
+                case kPixelFormatYUYV:
+                    Y = at(buffer, 0, x, y, 2, 0); U = at(buffer, 0, x >> 1, y, 4, 1); V = at(buffer, 0, x >> 1, y, 4, 3);
+                    break;
+                case kPixelFormatUYVY:
+                    Y = at(buffer, 0, x, y, 2, 1); U = at(buffer, 0, x >> 1, y, 4, 0); V = at(buffer, 0, x >> 1, y, 4, 2);
+                    break;
+                default:
+                    check(false, format, "layout", x, y);
+                    return;
+                }
+                check(Y == refY(x, y), format, "Y", x, y);
+                check(U == refU(x, y), format, "U", x, y);
+                check(V == refV(x, y), format, "V", x, y);
+            }
+        }
+    }
+
+    std::uint8_t refRGB(std::uint32_t x, std::uint32_t y, std::size_t ic) { return std::uint8_t(x * 4 + y * (ic + 1) + ic * 60); }
+
+    void checkRGBLayout(PixelBuffer &buffer)
+    {
+        ePixelFormat const format = buffer.format();
+        for (std::uint32_t y = 0; y < kSize(1); ++y)
+        {
+            for (std::uint32_t x = 0; x < kSize(0); ++x)
+            {
+                std::uint8_t rgba[4] = { 0, 0, 0, 0 };
+                switch(format)
+                {
+                case kPixelFormatRGB8:
+                    for (std::size_t ic = 0; ic < 3; ++ic) rgba[ic] = at(buffer, 0, x, y, 3, ic);
+                    rgba[3] = 255;
+                    break;
+                case kPixelFormatRGBA8:
+                    for (std::size_t ic = 0; ic < 4; ++ic) rgba[ic] = at(buffer, 0, x, y, 4, ic);
+                    break;
+                case kPixelFormatBGRA8:
+                    for (std::size_t ic = 0; ic < 3; ++ic) rgba[ic] = at(buffer, 0, x, y, 4, 2 - ic);
+                    rgba[3] = at(buffer, 0, x, y, 4, 3);
+                    break;
+                default:
+                    check(false, format, "layout", x, y);
+                    return;
+                }
+                check(rgba[0] == refRGB(x, y, 0), format, "R", x, y);
+                check(rgba[1] == refRGB(x, y, 1), format, "G", x, y);
+                check(rgba[2] == refRGB(x, y, 2), format, "B", x, y);
+                check(rgba[3] == 255, format, "A", x, y);
+            }
+        }
+    }
+
+    // full range BT.601 of a few saturated colours, both ways
+    void checkColours()
+    {
+        struct Colour { std::uint8_t rgb[3]; std::uint8_t yuv[3]; };
+        Colour const colours[] = {
+            { {   0,   0,   0 }, {   0, 128, 128 } },
+            { { 255, 255, 255 }, { 255, 128, 128 } },
+            { { 128, 128, 128 }, { 128, 128, 128 } },
+            { { 255,   0,   0 }, {  76,  85, 255 } },
+            { {   0, 255,   0 }, { 150,  44,  21 } },
+            { {   0,   0, 255 }, {  29, 255, 107 } }
+        };
+
+        for (Colour const &colour : colours)
+        {
+            MemoryPixelSampleBuffer rgb(kPixelFormatRGB8, Vec2ui(2, 2));
+            rgb.lock();
+            for (std::uint32_t y = 0; y < 2; ++y)
+                for (std::uint32_t x = 0; x < 2; ++x)
+                    for (std::size_t ic = 0; ic < 3; ++ic)
+                        static_cast<std::uint8_t*>(rgb.planeData())[y * rgb.planeRowBytes() + x * 3 + ic] = colour.rgb[ic];
+
+            std::shared_ptr<MemoryPixelSampleBuffer> yuv = convertPixelBuffer(rgb, kPixelFormatYUV420);
+            if (!yuv)
+            {
+                check(false, kPixelFormatYUV420, "conversion", 0, 0);
+                continue;
+            }
+            yuv->lock();
+            check(at(*yuv, 0, 1, 1, 1, 0) == colour.yuv[0], kPixelFormatYUV420, "colour Y", colour.rgb[0], colour.rgb[1]);
+            check(at(*yuv, 1, 0, 0, 1, 0) == colour.yuv[1], kPixelFormatYUV420, "colour U", colour.rgb[0], colour.rgb[1]);
+            check(at(*yuv, 2, 0, 0, 1, 0) == colour.yuv[2], kPixelFormatYUV420, "colour V", colour.rgb[0], colour.rgb[1]);
+
+            // back within a step of rounding
+            std::shared_ptr<MemoryPixelSampleBuffer> back = convertPixelBuffer(*yuv, kPixelFormatRGB8);
+            back->lock();
+            for (std::size_t ic = 0; ic < 3; ++ic)
+                check(std::abs(int(at(*back, 0, 1, 1, 3, ic)) - int(colour.rgb[ic])) <= 2, kPixelFormatRGB8, "colour round trip", colour.rgb[0], colour.rgb[1]);
+            back->unlock();
+            yuv->unlock();
+            rgb.unlock();
+        }
+    }
+}
+
+int main()
+{
+    setLogLevel(LOG_SILENT);
+
+    // every YUV layout from planar 4:2:2 and back
+    MemoryPixelSampleBuffer yuv(kPixelFormatYUV422, kSize);
+    yuv.lock();
+    for (std::uint32_t y = 0; y < kSize(1); ++y)
+    {
+        for (std::uint32_t x = 0; x < kSize(0); ++x)
+        {
+            static_cast<std::uint8_t*>(yuv.planeData(0))[y * yuv.planeRowBytes(0) + x] = refY(x, y);
+            static_cast<std::uint8_t*>(yuv.planeData(1))[y * yuv.planeRowBytes(1) + (x >> 1)] = refU(x, y);
+            static_cast<std::uint8_t*>(yuv.planeData(2))[y * yuv.planeRowBytes(2) + (x >> 1)] = refV(x, y);
+        }
+    }
+    checkYUVLayout(yuv);
+
+    for (ePixelFormat format : { kPixelFormatYUV420, kPixelFormatNV12, kPixelFormatNV21, kPixelFormatYUYV, kPixelFormatUYVY, kPixelFormatYUV422 })
+    {
+        std::shared_ptr<MemoryPixelSampleBuffer> converted = convertPixelBuffer(yuv, format);
+        if (!converted)
+        {
+            check(false, format, "conversion", 0, 0);
+            continue;
+        }
+
+        converted->lock();
+        checkYUVLayout(*converted);
+        std::shared_ptr<MemoryPixelSampleBuffer> back = convertPixelBuffer(*converted, kPixelFormatYUV422);
+        back->lock();
+        checkYUVLayout(*back);
+        back->unlock();
+        converted->unlock();
+    }
+
+    // gray keeps luma, and comes back with neutral chroma
+    std::shared_ptr<MemoryPixelSampleBuffer> gray = convertPixelBuffer(yuv, kPixelFormatGRAY8);
+    gray->lock();
+    checkYUVLayout(*gray);
+    std::shared_ptr<MemoryPixelSampleBuffer> grayBack = convertPixelBuffer(*gray, kPixelFormatNV12);
+    grayBack->lock();
+    for (std::uint32_t y = 0; y < kSize(1); ++y)
+    {
+        for (std::uint32_t x = 0; x < kSize(0); ++x)
+        {
+            check(at(*grayBack, 0, x, y, 1, 0) == refY(x, y), kPixelFormatGRAY8, "Y", x, y);
+            check(at(*grayBack, 1, x >> 1, y >> 1, 2, 0) == 128 && at(*grayBack, 1, x >> 1, y >> 1, 2, 1) == 128, kPixelFormatGRAY8, "chroma", x, y);
+        }
+    }
+    grayBack->unlock();
+    gray->unlock();
+    yuv.unlock();
+
+    // every RGB layout from RGB and back
+    MemoryPixelSampleBuffer rgb(kPixelFormatRGB8, kSize);
+    rgb.lock();
+    for (std::uint32_t y = 0; y < kSize(1); ++y)
+        for (std::uint32_t x = 0; x < kSize(0); ++x)
+            for (std::size_t ic = 0; ic < 3; ++ic)
+                static_cast<std::uint8_t*>(rgb.planeData())[y * rgb.planeRowBytes() + x * 3 + ic] = refRGB(x, y, ic);
+
+    for (ePixelFormat format : { kPixelFormatRGBA8, kPixelFormatBGRA8 })
+    {
+        std::shared_ptr<MemoryPixelSampleBuffer> converted = convertPixelBuffer(rgb, format);
+        if (!converted)
+        {
+            check(false, format, "conversion", 0, 0);
+            continue;
+        }
+
+        converted->lock();
+        checkRGBLayout(*converted);
+        std::shared_ptr<MemoryPixelSampleBuffer> swapped = convertPixelBuffer(*converted, format == kPixelFormatRGBA8 ? kPixelFormatBGRA8 : kPixelFormatRGBA8);
+        swapped->lock();
+        checkRGBLayout(*swapped);
+        std::shared_ptr<MemoryPixelSampleBuffer> back = convertPixelBuffer(*swapped, kPixelFormatRGB8);
+        back->lock();
+        checkRGBLayout(*back);
+        back->unlock();
+        swapped->unlock();
+        converted->unlock();
+    }
+    rgb.unlock();
+
+    checkColours();
+
+    std::cout << (failures ? "FAILED" : "OK") << ", " << failures << " mismatches" << std::endl;
+    return failures ? 1 : 0;
+}
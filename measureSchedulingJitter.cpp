@@ -0,0 +1,111 @@
+#include "rpiCam/Camera.hpp"
+#include "rpiCam/ThreadPool.hpp"
+#include "rpiCam/Logging.hpp"
+#include <iostream>
+#include <sstream>
+
+using namespace rpiCam;
+
+// usage: measureSchedulingJitter [cpus=2,3] [priority=50] [seconds=10]
+// runs every measurement twice, first with the default schedule and then
+// pinned to the given cpus with SCHED_FIFO at the given priority
+
+class PoolLoad
+    : public Camera::Events
+{
+public:
+    PoolLoad(ThreadPool &pool)
+        : m_Pool(pool)
+    {
+    }
+
+    void onCameraVideoFrame(std::shared_ptr<PixelSampleBuffer> const &buffer) override
+    {
+        // one short task per frame so the pool latency follows the frame cadence
+        m_Pool.post([]() {});
+    }
+
+private:
+    ThreadPool &m_Pool;
+};
+
+std::vector<int> parseCpus(std::string const &value)
+{
+    std::vector<int> cpus;
+    std::istringstream ss(value);
+    std::string cpu;
+    while (std::getline(ss, cpu, ','))
+        cpus.push_back(std::stoi(cpu));
+    return cpus;
+}
+
+void printLatency(char const *name, SchedulingLatencyStats const &stats)
+{
+    using us = std::chrono::microseconds;
+    std::cout << "\t" << name << ": " << stats.count << " samples";
+    if (stats.count)
+    {
+        std::cout << ", mean " << std::chrono::duration_cast<us>(stats.mean).count() << "us"
+            << ", min " << std::chrono::duration_cast<us>(stats.min).count() << "us"
+            << ", max " << std::chrono::duration_cast<us>(stats.max).count() << "us"
+            << ", jitter " << std::chrono::duration_cast<us>(stats.jitter).count() << "us";
+    }
+    std::cout << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    setLogLevel(LOG_SILENT);
+
+    ThreadSchedule realtime(
+        parseCpus(argc > 1 ? argv[1] : "2,3"),
+        ThreadSchedule::Policy::Fifo,
+        argc > 2 ? std::stoi(argv[2]) : 50
+    );
+    std::chrono::seconds const duration(argc > 3 ? std::stoi(argv[3]) : 10);
+
+    ThreadPool pool(2);
+    PoolLoad poolLoad(pool);
+
+    auto cameras = Device::list<Camera>();
+
+    for(auto cam : cameras)
+    {
+        if(cam->open())
+            continue;
+
+        std::cout << "camera: " << cam->name() << std::endl;
+        cam->setVideoFormat(kPixelFormatYUV420);
+        cam->setVideoSize(Vec2ui(1280, 720));
+        cam->setVideoFrameRate(Rational(30, 1));
+        cam->cameraEvents() += &poolLoad;
+
+        for (bool bRealtime : {false, true})
+        {
+            ThreadSchedule const schedule = bRealtime ? realtime : ThreadSchedule();
+            cam->setDeliveryThreadSchedule(Camera::DeliveryThread::Video, schedule);
+            if (pool.setSchedule(schedule))
+                std::cout << "\tcould not apply schedule to pool (missing CAP_SYS_NICE?)" << std::endl;
+
+            std::cout << (bRealtime ? "realtime" : "default") << " schedule:" << std::endl;
+
+            pool.resetSchedulingLatency();
+            if(!cam->startVideo())
+            {
+                std::this_thread::sleep_for(duration);
+                cam->stopVideo();
+
+                printLatency("video delivery", cam->getDeliveryThreadLatency(Camera::DeliveryThread::Video));
+                printLatency("pool workers", pool.schedulingLatency());
+            }
+            else
+            {
+                std::cout << "\tNA" << std::endl;
+            }
+        }
+
+        cam->cameraEvents() -= &poolLoad;
+        cam->close();
+    }
+    return 0;
+}
@@ -0,0 +1,505 @@
+#include "BackgroundModel.hpp"
+#include "ImagePyramid.hpp"
+#include "Simd.hpp"
+#include "Logging.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace rpiCam
+{
+    namespace
+    {
+        static constexpr std::uint32_t kMeanBits = 7;
+        static constexpr std::uint32_t kVarianceBits = 2;
+        static constexpr std::uint32_t kRateBits = 15;
+        static constexpr std::uint32_t kThresholdBits = 4;
+
+        static constexpr char kFileMagic[4] = { 'R', 'P', 'B', 'M' };
+        static constexpr std::uint32_t kFileVersion = 1;
+        static constexpr std::uint32_t kMaxFileSize = 4096;    // per side, above the largest sensor
+
+        struct UpdateParams
+        {
+            std::int16_t alpha;         // Q15 rate of background pixels
+            std::int16_t foregroundAlpha;
+            std::int16_t minVariance;   // Q2
+            std::int16_t threshold2;    // Q4 square of the threshold
+        };
+
+        inline std::int16_t rateQ15(float rate)
+        {
+            return std::int16_t(std::max(1.0f, std::min(32767.0f, std::round(rate * (1 << kRateBits)))));
+        }
+
+        // x * a / 2^15 rounded, as vqrdmulh does
+        inline std::int32_t mulRate(std::int32_t x, std::int32_t a)
+        {
+            return (x * a + (1 << (kRateBits - 1))) >> kRateBits;
+        }
+
+#if defined(RPI_CAM_SIMD_SSE2)
+        inline __m128i mulRate(__m128i x, __m128i a)
+        {
+            __m128i const round = _mm_set1_epi32(1 << (kRateBits - 1));
+            __m128i const lo = _mm_mullo_epi16(x, a);
+            __m128i const hi = _mm_mulhi_epi16(x, a);
+            return _mm_packs_epi32(
+                _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(lo, hi), round), kRateBits),
+                _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(lo, hi), round), kRateBits));
+        }
+
+        // 0xffff where the pixel is foreground
+        inline __m128i updatePixels(__m128i pixels, std::int16_t *mean, std::int16_t *variance, UpdateParams const &params)
+        {
+            __m128i const zero = _mm_setzero_si128();
+            __m128i m = _mm_loadu_si128(reinterpret_cast<__m128i*>(mean));
+            __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i*>(variance));
+
+            __m128i const d = _mm_sub_epi16(_mm_slli_epi16(pixels, kMeanBits), m);
+            __m128i const sqLo = _mm_mullo_epi16(d, d);
+            __m128i const sqHi = _mm_mulhi_epi16(d, d);
+            __m128i const d2 = _mm_packs_epi32(
+                _mm_srai_epi32(_mm_unpacklo_epi16(sqLo, sqHi), 2 * kMeanBits - kVarianceBits),
+                _mm_srai_epi32(_mm_unpackhi_epi16(sqLo, sqHi), 2 * kMeanBits - kVarianceBits));
+
+            __m128i const floor = _mm_max_epi16(v, _mm_set1_epi16(params.minVariance));
+            __m128i const k2 = _mm_set1_epi16(params.threshold2);
+            __m128i const tLo = _mm_mullo_epi16(floor, k2);
+            __m128i const tHi = _mm_mulhi_epi16(floor, k2);
+            __m128i const foreground = _mm_packs_epi32(
+                _mm_cmpgt_epi32(_mm_slli_epi32(_mm_unpacklo_epi16(d2, zero), kThresholdBits), _mm_unpacklo_epi16(tLo, tHi)),
+                _mm_cmpgt_epi32(_mm_slli_epi32(_mm_unpackhi_epi16(d2, zero), kThresholdBits), _mm_unpackhi_epi16(tLo, tHi)));
+
+            __m128i const a = _mm_or_si128(
+                _mm_and_si128(foreground, _mm_set1_epi16(params.foregroundAlpha)),
+                _mm_andnot_si128(foreground, _mm_set1_epi16(params.alpha)));
+
+            m = _mm_add_epi16(m, mulRate(d, a));
+            v = _mm_add_epi16(v, mulRate(_mm_sub_epi16(d2, v), a));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(mean), m);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(variance), v);
+            return foreground;
+        }
+#elif defined(RPI_CAM_SIMD_NEON)
+        // all ones where the pixel is foreground
+        inline uint16x8_t updatePixels(uint8x8_t pixels, std::int16_t *mean, std::int16_t *variance, UpdateParams const &params)
+        {
+            int16x8_t m = vld1q_s16(mean);
+            int16x8_t v = vld1q_s16(variance);
+
+            int16x8_t const d = vsubq_s16(vreinterpretq_s16_u16(vshll_n_u8(pixels, kMeanBits)), m);
+            int16x8_t const d2 = vcombine_s16(
+                vqshrn_n_s32(vmull_s16(vget_low_s16(d), vget_low_s16(d)), 2 * kMeanBits - kVarianceBits),
+                vqshrn_n_s32(vmull_s16(vget_high_s16(d), vget_high_s16(d)), 2 * kMeanBits - kVarianceBits));
+
+            int16x8_t const floor = vmaxq_s16(v, vdupq_n_s16(params.minVariance));
+            int16x4_t const k2 = vdup_n_s16(params.threshold2);
+            uint16x8_t const foreground = vcombine_u16(
+                vmovn_u32(vcgtq_s32(vshll_n_s16(vget_low_s16(d2), kThresholdBits), vmull_s16(vget_low_s16(floor), k2))),
+                vmovn_u32(vcgtq_s32(vshll_n_s16(vget_high_s16(d2), kThresholdBits), vmull_s16(vget_high_s16(floor), k2))));
+
+            int16x8_t const a = vbslq_s16(foreground, vdupq_n_s16(params.foregroundAlpha), vdupq_n_s16(params.alpha));
+
+            m = vaddq_s16(m, vqrdmulhq_s16(d, a));
+            v = vaddq_s16(v, vqrdmulhq_s16(vsubq_s16(d2, v), a));
+            vst1q_s16(mean, m);
+            vst1q_s16(variance, v);
+            return foreground;
+        }
+#endif
+
+        void updateRow(std::uint8_t const *src, std::int16_t *mean, std::int16_t *variance, std::uint8_t *mask,
+            BinaryMask::Format format, std::uint32_t width, UpdateParams const &params, bool bSimd)
+        {
+            bool const bBits = format == BinaryMask::Format::Bits;
+            std::uint32_t x = 0;
+#if defined(RPI_CAM_SIMD_SSE2)
+            if (bSimd)
+            {
+                __m128i const zero = _mm_setzero_si128();
+                for (; x + 16 <= width; x += 16)
+                {
+                    __m128i const pixels = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + x));
+                    __m128i const foreground = _mm_packs_epi16(
+                        updatePixels(_mm_unpacklo_epi8(pixels, zero), mean + x, variance + x, params),
+                        updatePixels(_mm_unpackhi_epi8(pixels, zero), mean + x + 8, variance + x + 8, params));
+                    if (bBits)
+                    {
+                        std::uint16_t const bits = std::uint16_t(_mm_movemask_epi8(foreground));
+                        mask[x / 8] = std::uint8_t(bits);
+                        mask[x / 8 + 1] = std::uint8_t(bits >> 8);
+                    }
+                    else
+                        _mm_storeu_si128(reinterpret_cast<__m128i*>(mask + x), foreground);
+                }
+            }
+#elif defined(RPI_CAM_SIMD_NEON)
+            if (bSimd)
+            {
+                static const std::uint8_t kBitWeights[8] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+                uint8x8_t const weights = vld1_u8(kBitWeights);
+                for (; x + 16 <= width; x += 16)
+                {
+                    uint8x16_t const pixels = vld1q_u8(src + x);
+                    uint8x16_t const foreground = vcombine_u8(
+                        vmovn_u16(updatePixels(vget_low_u8(pixels), mean + x, variance + x, params)),
+                        vmovn_u16(updatePixels(vget_high_u8(pixels), mean + x + 8, variance + x + 8, params)));
+                    if (bBits)
+                    {
+                        uint8x8_t bits = vpadd_u8(
+                            vand_u8(vget_low_u8(foreground), weights),
+                            vand_u8(vget_high_u8(foreground), weights));
+                        bits = vpadd_u8(bits, bits);
+                        bits = vpadd_u8(bits, bits);
+                        mask[x / 8] = vget_lane_u8(bits, 0);
+                        mask[x / 8 + 1] = vget_lane_u8(bits, 1);
+                    }
+                    else
+                        vst1q_u8(mask + x, foreground);
+                }
+            }
+#endif
+            if (bBits && x < width)
+                std::memset(mask + x / 8, 0, (width - x + 7) / 8);
+
+            for (; x < width; ++x)
+            {
+                std::int32_t const m = mean[x];
+                std::int32_t const v = variance[x];
+                std::int32_t const d = (std::int32_t(src[x]) << kMeanBits) - m;
+                std::int32_t const d2 = std::min<std::int32_t>(32767, (d * d) >> (2 * kMeanBits - kVarianceBits));
+                bool const bForeground = (d2 << kThresholdBits) > std::max<std::int32_t>(v, params.minVariance) * params.threshold2;
+                std::int32_t const a = bForeground ? params.foregroundAlpha : params.alpha;
+
+                mean[x] = std::int16_t(m + mulRate(d, a));
+                variance[x] = std::int16_t(v + mulRate(d2 - v, a));
+                if (bBits)
+                    mask[x >> 3] |= std::uint8_t(bForeground ? 1 << (x & 7) : 0);
+                else
+                    mask[x] = bForeground ? 255 : 0;
+            }
+        }
+
+        template <typename T>
+        inline void writeValue(std::ostream &s, T value)
+        {
+            std::uint8_t bytes[sizeof(T)];
+            for (std::size_t i = 0; i < sizeof(T); ++i)
+                bytes[i] = std::uint8_t(std::uint64_t(value) >> (8 * i));
+            s.write(reinterpret_cast<char const*>(bytes), sizeof(T));
+        }
+
+        template <typename T>
+        inline bool readValue(std::istream &s, T &value)
+        {
+            std::uint8_t bytes[sizeof(T)];
+            if (!s.read(reinterpret_cast<char*>(bytes), sizeof(T)))
+                return false;
+            std::uint64_t v = 0;
+            for (std::size_t i = 0; i < sizeof(T); ++i)
+                v |= std::uint64_t(bytes[i]) << (8 * i);
+            value = T(v);
+            return true;
+        }
+    }
+
+    BackgroundModelOptions::BackgroundModelOptions()
+        : level(0)
+        , learningRate(0.02f)
+        , foregroundLearningRate(0.002f)
+        , threshold(2.5f)
+        , minStdDev(3.0f)
+        , maskFormat(BinaryMask::Format::Bytes)
+        , stripHeight(32)
+    {
+    }
+
+    BackgroundModel::BackgroundModel(BackgroundModelOptions const &options, std::shared_ptr<ThreadPool> pool)
+        : m_Mutex()
+        , m_Options(isValid(options) ? options : BackgroundModelOptions())
+        , m_Pool(pool)
+        , m_bSimd(true)
+        , m_bReset(true)
+        , m_Size(0, 0)
+        , m_NumFrames(0)
+        , m_Mean()
+        , m_Variance()
+    {
+        if (!isValid(options))
+            RPI_LOG(WARNING, "BackgroundModel::BackgroundModel(): invalid options, using defaults!");
+    }
+
+    BackgroundModel::~BackgroundModel()
+    {
+    }
+
+    BackgroundModelOptions BackgroundModel::options() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_Options;
+    }
+
+    std::error_code BackgroundModel::setOptions(BackgroundModelOptions const &options)
+    {
+        if (!isValid(options))
+        {
+            RPI_LOG(ERROR, "BackgroundModel::setOptions(): invalid options!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        // rates and thresholds apply to the existing model, another level needs a new one
+        if (options.level != m_Options.level)
+            m_bReset = true;
+        m_Options = options;
+        return std::error_code();
+    }
+
+    void BackgroundModel::reset()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bReset = true;
+    }
+
+    bool BackgroundModel::isSimdEnabled() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_bSimd;
+    }
+
+    void BackgroundModel::setSimdEnabled(bool bEnabled)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bSimd = bEnabled;
+    }
+
+    Vec2ui BackgroundModel::size() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_Size;
+    }
+
+    std::uint64_t BackgroundModel::numFrames() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_NumFrames;
+    }
+
+    float BackgroundModel::mean(std::uint32_t x, std::uint32_t y) const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (x >= m_Size(0) || y >= m_Size(1))
+            return 0.0f;
+        return float(m_Mean[y * m_Size(0) + x]) / (1 << kMeanBits);
+    }
+
+    float BackgroundModel::variance(std::uint32_t x, std::uint32_t y) const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (x >= m_Size(0) || y >= m_Size(1))
+            return 0.0f;
+        return float(m_Variance[y * m_Size(0) + x]) / (1 << kVarianceBits);
+    }
+
+    std::error_code BackgroundModel::process(PixelSampleBuffer &frame, BinaryMask &foreground)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        std::size_t const li = m_Options.level;
+        PixelBuffer *luma = nullptr;
+        if (li > 0)
+        {
+            luma = frame.pyramid().level(li);
+            if (!luma)
+            {
+                RPI_LOG(ERROR, "BackgroundModel::process(): no luma level %d for this frame!", int(li));
+                return std::make_error_code(std::errc::invalid_argument);
+            }
+        }
+        else if (pixelFormatDescriptor(frame.format()).bytesPerPixel[0] != 1)
+        {
+            RPI_LOG(ERROR, "BackgroundModel::process(): no separate luma plane in this format!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+        else if (frame.lock())
+        {
+            RPI_LOG(ERROR, "BackgroundModel::process(): failed to lock the frame!");
+            return std::make_error_code(std::errc::io_error);
+        }
+        else
+            luma = &frame;
+
+        Vec2ui const size = luma->planeSize(0);
+        std::uint8_t const *data = static_cast<std::uint8_t const*>(luma->planeData(0));
+        std::size_t const rowBytes = luma->planeRowBytes(0);
+
+        if (data)
+        {
+            foreground.reset(m_Options.maskFormat, size);
+            if (m_bReset || size != m_Size)
+            {
+                if (!m_bReset)
+                    RPI_LOG(WARNING, "BackgroundModel::process(): frame size changed, starting a new model!");
+                restart(size, data, rowBytes);
+                foreground.clear();
+            }
+            else
+                update(data, rowBytes, foreground);
+            m_NumFrames++;
+        }
+
+        if (!li)
+            frame.unlock();
+
+        if (!data)
+        {
+            RPI_LOG(ERROR, "BackgroundModel::process(): frame has no luma data!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+        return std::error_code();
+    }
+
+    std::error_code BackgroundModel::save(std::ostream &s) const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_bReset)
+        {
+            RPI_LOG(ERROR, "BackgroundModel::save(): no model to save!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        s.write(kFileMagic, sizeof(kFileMagic));
+        writeValue<std::uint32_t>(s, kFileVersion);
+        writeValue<std::uint32_t>(s, m_Size(0));
+        writeValue<std::uint32_t>(s, m_Size(1));
+        writeValue<std::uint64_t>(s, m_NumFrames);
+        for (auto m : m_Mean)
+            writeValue<std::uint16_t>(s, std::uint16_t(m));
+        for (auto v : m_Variance)
+            writeValue<std::uint16_t>(s, std::uint16_t(v));
+
+        if (!s)
+        {
+            RPI_LOG(ERROR, "BackgroundModel::save(): failed to write the model!");
+            return std::make_error_code(std::errc::io_error);
+        }
+        return std::error_code();
+    }
+
+    std::error_code BackgroundModel::load(std::istream &s)
+    {
+        char magic[sizeof(kFileMagic)];
+        std::uint32_t version = 0, width = 0, height = 0;
+        std::uint64_t numFrames = 0;
+        if (!s.read(magic, sizeof(magic)) ||
+            !readValue(s, version) || !readValue(s, width) || !readValue(s, height) || !readValue(s, numFrames))
+        {
+            RPI_LOG(ERROR, "BackgroundModel::load(): failed to read the header!");
+            return std::make_error_code(std::errc::io_error);
+        }
+
+        if (std::memcmp(magic, kFileMagic, sizeof(kFileMagic)) || version != kFileVersion || !width || !height)
+        {
+            RPI_LOG(ERROR, "BackgroundModel::load(): not a background model!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        if (width > kMaxFileSize || height > kMaxFileSize)
+        {
+            RPI_LOG(ERROR, "BackgroundModel::load(): model size %dx%d out of range!", int(width), int(height));
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        // a mean never leaves the pixel range, a variance the positive int16 range
+        std::size_t const count = std::size_t(width) * height;
+        std::vector<std::int16_t> mean(count), variance(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            std::uint16_t m = 0;
+            if (!readValue(s, m))
+                return std::make_error_code(std::errc::io_error);
+            if (m > (255 << kMeanBits))
+            {
+                RPI_LOG(ERROR, "BackgroundModel::load(): mean out of range!");
+                return std::make_error_code(std::errc::invalid_argument);
+            }
+            mean[i] = std::int16_t(m);
+        }
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            std::uint16_t v = 0;
+            if (!readValue(s, v))
+                return std::make_error_code(std::errc::io_error);
+            if (v > 32767)
+            {
+                RPI_LOG(ERROR, "BackgroundModel::load(): variance out of range!");
+                return std::make_error_code(std::errc::invalid_argument);
+            }
+            variance[i] = std::int16_t(v);
+        }
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Size = Vec2ui(width, height);
+        m_NumFrames = numFrames;
+        m_Mean = std::move(mean);
+        m_Variance = std::move(variance);
+        m_bReset = false;
+        return std::error_code();
+    }
+
+    bool BackgroundModel::isValid(BackgroundModelOptions const &options)
+    {
+        return options.level <= ImagePyramid::kNumLevels &&
+            options.learningRate > 0.0f && options.learningRate < 1.0f &&
+            options.foregroundLearningRate > 0.0f && options.foregroundLearningRate < 1.0f &&
+            options.threshold >= 0.0f && options.threshold * options.threshold * (1 << kThresholdBits) < 32768.0f &&
+            options.minStdDev >= 0.0f && options.minStdDev * options.minStdDev * (1 << kVarianceBits) < 32768.0f &&
+            options.stripHeight > 0;
+    }
+
+    void BackgroundModel::restart(Vec2ui const &size, std::uint8_t const *data, std::size_t rowBytes)
+    {
+        std::int16_t const minVariance = std::int16_t(m_Options.minStdDev * m_Options.minStdDev * (1 << kVarianceBits));
+
+        m_bReset = false;
+        m_Size = size;
+        m_NumFrames = 0;
+        m_Mean.resize(size.prod());
+        m_Variance.assign(size.prod(), minVariance);
+        for (std::uint32_t y = 0; y < size(1); ++y)
+        {
+            for (std::uint32_t x = 0; x < size(0); ++x)
+                m_Mean[y * size(0) + x] = std::int16_t(data[y * rowBytes + x] << kMeanBits);
+        }
+    }
+
+    void BackgroundModel::update(std::uint8_t const *data, std::size_t rowBytes, BinaryMask &foreground)
+    {
+        // cumulative average while the model is young
+        float const warmUp = 1.0f / float(m_NumFrames + 1);
+
+        UpdateParams params;
+        params.alpha = rateQ15(std::max(m_Options.learningRate, warmUp));
+        params.foregroundAlpha = rateQ15(std::max(m_Options.foregroundLearningRate, warmUp));
+        params.minVariance = std::int16_t(m_Options.minStdDev * m_Options.minStdDev * (1 << kVarianceBits));
+        params.threshold2 = std::int16_t(m_Options.threshold * m_Options.threshold * (1 << kThresholdBits));
+
+        std::uint32_t const width = m_Size(0);
+        bool const bSimd = m_bSimd;
+        auto updateRows = [&](std::size_t begin, std::size_t end)
+        {
+            for (std::size_t y = begin; y < end; ++y)
+            {
+                updateRow(data + y * rowBytes, m_Mean.data() + y * width, m_Variance.data() + y * width,
+                    foreground.row(std::uint32_t(y)), foreground.format(), width, params, bSimd);
+            }
+        };
+
+        if (m_Pool && m_Pool->size() > 0 && m_Size(1) > m_Options.stripHeight)
+            m_Pool->parallelFor(0, m_Size(1), m_Options.stripHeight, updateRows);
+        else
+            updateRows(0, m_Size(1));
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Config.hpp"
+#include "PixelSampleBuffer.hpp"
+#include "BinaryMask.hpp"
+#include "ThreadPool.hpp"
+#include <vector>
+
+namespace rpiCam
+{
+    class BackgroundModelOptions
+    {
+    public:
+        BackgroundModelOptions();
+
+        std::uint32_t level;            // pyramid level of the modelled image, 0 is the full Y plane
+        float learningRate;             // weight of one frame in mean and variance of background pixels
+        float foregroundLearningRate;   // and of foreground pixels, lower keeps stopped objects out of the background longer
+        float threshold;                // foreground when |pixel - mean| > threshold * standard deviation
+        float minStdDev;                // floor of the standard deviation, in grey levels
+        BinaryMask::Format maskFormat;
+        std::uint32_t stripHeight;      // rows per task when a thread pool is used
+    };
+
+    // Per-pixel exponential running average and variance of the luma plane.
+    // Mean is kept in Q7 and variance in Q2 grey levels squared, both int16,
+    // so one pass updates 8 pixels per vector with rounding Q15 multiplies.
+    // The first frames are averaged with weight 1/n until that drops below
+    // the learning rate, and a saved model skips that warm-up altogether.
+    class BackgroundModel
+    {
+    public:
+        BackgroundModel(BackgroundModelOptions const &options = BackgroundModelOptions(), std::shared_ptr<ThreadPool> pool = nullptr);
+        ~BackgroundModel();
+
+        BackgroundModelOptions options() const;
+        std::error_code setOptions(BackgroundModelOptions const &options);
+
+        // forgets the model, the next frame starts a new one
+        void reset();
+
+        bool isSimdEnabled() const;
+        void setSimdEnabled(bool bEnabled);
+
+        Vec2ui size() const;
+        std::uint64_t numFrames() const;
+
+        float mean(std::uint32_t x, std::uint32_t y) const;
+        float variance(std::uint32_t x, std::uint32_t y) const;
+
+        // Classifies every pixel of frame against the model into foreground,
+        // then updates the model. The frame needs a separate Y plane, the
+        // mask gets the size of the modelled image.
+        std::error_code process(PixelSampleBuffer &frame, BinaryMask &foreground);
+
+        std::error_code save(std::ostream &s) const;
+        std::error_code load(std::istream &s);
+
+    private:
+        static bool isValid(BackgroundModelOptions const &options);
+
+        void restart(Vec2ui const &size, std::uint8_t const *data, std::size_t rowBytes);
+        void update(std::uint8_t const *data, std::size_t rowBytes, BinaryMask &foreground);
+
+    private:
+        mutable std::mutex m_Mutex;
+        BackgroundModelOptions m_Options;
+        std::shared_ptr<ThreadPool> m_Pool;
+        bool m_bSimd;
+        bool m_bReset;
+        Vec2ui m_Size;
+        std::uint64_t m_NumFrames;
+        std::vector<std::int16_t> m_Mean;
+        std::vector<std::int16_t> m_Variance;
+    };
+}
@@ -0,0 +1,188 @@
+#include "BestFrameSelector.hpp"
+#include "Logging.hpp"
+
+namespace rpiCam
+{
+    BestFrameSelectorOptions::BestFrameSelectorOptions()
+        : metric(SharpnessMetric::LaplacianVariance)
+        , roi()
+        , burstSize(0)
+        , bSnapshots(true)
+        , bVideoFrames(false)
+    {
+    }
+
+    BestFrameSelector::BestFrameSelector(BestFrameSelectorOptions const &options)
+        : Camera::Events()
+        , m_Mutex()
+        , m_Options(options)
+        , m_bSimd(true)
+        , m_Best()
+        , m_BestSharpness()
+        , m_NumFrames(0)
+        , m_BestFrameSelectorEvents()
+    {
+    }
+
+    BestFrameSelector::~BestFrameSelector()
+    {
+    }
+
+    BestFrameSelectorOptions BestFrameSelector::options() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_Options;
+    }
+
+    void BestFrameSelector::setOptions(BestFrameSelectorOptions const &options)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Options = options;
+    }
+
+    bool BestFrameSelector::isSimdEnabled() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_bSimd;
+    }
+
+    void BestFrameSelector::setSimdEnabled(bool bEnabled)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bSimd = bEnabled;
+    }
+
+    std::error_code BestFrameSelector::process(std::shared_ptr<PixelSampleBuffer> const &frame, Sharpness &sharpness)
+    {
+        if (!frame)
+        {
+            RPI_LOG(ERROR, "BestFrameSelector::process(): no frame!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        if (pixelFormatDescriptor(frame->format()).bytesPerPixel[0] != 1)
+        {
+            RPI_LOG(ERROR, "BestFrameSelector::process(): no separate luma plane in this format!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        BestFrameSelectorOptions const options = this->options();
+        if (frame->lock())
+        {
+            RPI_LOG(ERROR, "BestFrameSelector::process(): failed to lock the frame!");
+            return std::make_error_code(std::errc::io_error);
+        }
+        std::error_code const cse = computeSharpness(*frame, 0, options.roi, sharpness, isSimdEnabled());
+        frame->unlock();
+        if (cse)
+            return cse;
+
+        std::shared_ptr<PixelSampleBuffer> best;
+        Sharpness bestSharpness;
+        std::size_t numFrames = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            // the previous best is released here, so at most one frame is held
+            if (!m_Best || sharpness.value(m_Options.metric) > m_BestSharpness.value(m_Options.metric))
+            {
+                m_Best = frame;
+                m_BestSharpness = sharpness;
+            }
+            m_NumFrames++;
+
+            if (m_Options.burstSize && m_NumFrames >= m_Options.burstSize)
+                numFrames = takeBest(best, bestSharpness);
+        }
+
+        if (best)
+            m_BestFrameSelectorEvents.dispatch(&Events::onBestFrameSelected, best, bestSharpness, numFrames);
+        return std::error_code();
+    }
+
+    void BestFrameSelector::finish()
+    {
+        std::shared_ptr<PixelSampleBuffer> best;
+        Sharpness bestSharpness;
+        std::size_t numFrames = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            numFrames = takeBest(best, bestSharpness);
+        }
+
+        if (best)
+            m_BestFrameSelectorEvents.dispatch(&Events::onBestFrameSelected, best, bestSharpness, numFrames);
+    }
+
+    void BestFrameSelector::reset()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Best.reset();
+        m_BestSharpness = Sharpness();
+        m_NumFrames = 0;
+    }
+
+    std::shared_ptr<PixelSampleBuffer> BestFrameSelector::best() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_Best;
+    }
+
+    Sharpness BestFrameSelector::bestSharpness() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_BestSharpness;
+    }
+
+    std::size_t BestFrameSelector::numFrames() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_NumFrames;
+    }
+
+    void BestFrameSelector::onCameraTakingSnapshotsStarted()
+    {
+        if (options().bSnapshots)
+            reset();
+    }
+
+    void BestFrameSelector::onCameraTakingSnapshotsStopped()
+    {
+        if (options().bSnapshots)
+            finish();
+    }
+
+    void BestFrameSelector::onCameraSnapshotTaken(std::shared_ptr<PixelSampleBuffer> const &buffer)
+    {
+        if (!options().bSnapshots)
+            return;
+
+        Sharpness sharpness;
+        process(buffer, sharpness);
+    }
+
+    void BestFrameSelector::onCameraVideoFrame(std::shared_ptr<PixelSampleBuffer> const &buffer)
+    {
+        if (!options().bVideoFrames)
+            return;
+
+        Sharpness sharpness;
+        process(buffer, sharpness);
+    }
+
+    void BestFrameSelector::onCameraVideoStopped()
+    {
+        if (options().bVideoFrames)
+            finish();
+    }
+
+    std::size_t BestFrameSelector::takeBest(std::shared_ptr<PixelSampleBuffer> &best, Sharpness &sharpness)
+    {
+        std::size_t const numFrames = m_NumFrames;
+        best = std::move(m_Best);
+        sharpness = m_BestSharpness;
+        m_Best.reset();
+        m_BestSharpness = Sharpness();
+        m_NumFrames = 0;
+        return numFrames;
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Config.hpp"
+#include "Camera.hpp"
+#include "Sharpness.hpp"
+#include "Rect.hpp"
+
+namespace rpiCam
+{
+    class BestFrameSelectorOptions
+    {
+    public:
+        BestFrameSelectorOptions();
+
+        SharpnessMetric metric;
+        Rect roi;                   // measured region in frame pixels, empty is the whole frame
+        std::uint32_t burstSize;    // frames per selection, 0 selects once the snapshots or the video stop
+        bool bSnapshots;            // select among onCameraSnapshotTaken buffers
+        bool bVideoFrames;          // and among onCameraVideoFrame buffers
+    };
+
+    // Keeps the sharpest of a burst of frames by the Y plane of each. Only
+    // the current best buffer is retained, every other one is released as
+    // soon as it is measured, so a burst of any length costs one frame of
+    // memory and the others never need encoding. The winner is dispatched
+    // with onBestFrameSelected. Subscribe it to Camera::cameraEvents() or
+    // feed frames to process().
+    class BestFrameSelector
+        : public Camera::Events
+    {
+    public:
+        class Events
+        {
+        public:
+            virtual void onBestFrameSelected(std::shared_ptr<PixelSampleBuffer> const &buffer, Sharpness const &sharpness, std::size_t numFrames) {}
+        };
+
+        using BestFrameSelectorEvents = EventsDispatcher<Events>;
+
+        BestFrameSelector(BestFrameSelectorOptions const &options = BestFrameSelectorOptions());
+        ~BestFrameSelector();
+
+        inline BestFrameSelectorEvents const& bestFrameSelectorEvents() const { return m_BestFrameSelectorEvents; }
+
+        BestFrameSelectorOptions options() const;
+        void setOptions(BestFrameSelectorOptions const &options);
+
+        bool isSimdEnabled() const;
+        void setSimdEnabled(bool bEnabled);
+
+        // Measures frame and keeps it when it is the sharpest so far,
+        // selecting once burstSize frames are in. The frame needs a separate
+        // Y plane.
+        std::error_code process(std::shared_ptr<PixelSampleBuffer> const &frame, Sharpness &sharpness);
+
+        // selects the best of the frames so far, if any, and starts a new burst
+        void finish();
+
+        // drops the frames so far without selecting
+        void reset();
+
+        std::shared_ptr<PixelSampleBuffer> best() const;
+        Sharpness bestSharpness() const;
+        std::size_t numFrames() const;
+
+        // Camera::Events overrides
+        void onCameraTakingSnapshotsStarted() override;
+        void onCameraTakingSnapshotsStopped() override;
+        void onCameraSnapshotTaken(std::shared_ptr<PixelSampleBuffer> const &buffer) override;
+        void onCameraVideoFrame(std::shared_ptr<PixelSampleBuffer> const &buffer) override;
+        void onCameraVideoStopped() override;
+
+    private:
+        // moves the best frame out and starts a new burst, with m_Mutex held
+        std::size_t takeBest(std::shared_ptr<PixelSampleBuffer> &best, Sharpness &sharpness);
+
+    private:
+        mutable std::mutex m_Mutex;
+        BestFrameSelectorOptions m_Options;
+        bool m_bSimd;
+        std::shared_ptr<PixelSampleBuffer> m_Best;
+        Sharpness m_BestSharpness;
+        std::size_t m_NumFrames;
+        BestFrameSelectorEvents m_BestFrameSelectorEvents;
+    };
+}
@@ -0,0 +1,162 @@
+#include "BinaryMask.hpp"
+#include "Simd.hpp"
+#include "Logging.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace rpiCam
+{
+    BinaryMask::BinaryMask()
+        : m_Format(Format::Bytes)
+        , m_Size(0, 0)
+        , m_RowBytes(0)
+        , m_Data()
+    {
+    }
+
+    BinaryMask::BinaryMask(Format format, Vec2ui const &size)
+        : BinaryMask()
+    {
+        reset(format, size);
+        clear();
+    }
+
+    BinaryMask::~BinaryMask()
+    {
+    }
+
+    void BinaryMask::reset(Format format, Vec2ui const &size)
+    {
+        std::size_t const bytes = format == Format::Bits ? (size(0) + 7) / 8 : size(0);
+        m_Format = format;
+        m_Size = size;
+        m_RowBytes = (bytes + kRowAlignment - 1) & ~(kRowAlignment - 1);
+        m_Data.resize(m_RowBytes * size(1));
+    }
+
+    void BinaryMask::clear()
+    {
+        std::fill(m_Data.begin(), m_Data.end(), 0);
+    }
+
+    std::size_t BinaryMask::count() const
+    {
+        std::size_t n = 0;
+        for (std::uint32_t y = 0; y < m_Size(1); ++y)
+        {
+            std::uint8_t const *r = row(y);
+            if (m_Format == Format::Bytes)
+            {
+                n += std::size_t(std::count_if(r, r + m_Size(0), [](std::uint8_t v) { return v != 0; }));
+                continue;
+            }
+
+            std::uint32_t const fullBytes = m_Size(0) / 8;
+            for (std::uint32_t i = 0; i < fullBytes; ++i)
+                n += std::size_t(__builtin_popcount(r[i]));
+            if (m_Size(0) & 7)
+                n += std::size_t(__builtin_popcount(r[fullBytes] & ((1 << (m_Size(0) & 7)) - 1)));
+        }
+        return n;
+    }
+
+    std::error_code thresholdPixelBuffer(PixelBuffer &buffer, std::size_t pi, std::uint8_t threshold, BinaryMask::Format format, BinaryMask &mask)
+    {
+        if (pi >= buffer.planeCount() || pixelFormatDescriptor(buffer.format()).bytesPerPixel[pi] != 1)
+        {
+            RPI_LOG(ERROR, "thresholdPixelBuffer(): plane is not one byte per pixel!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        std::uint8_t const *data = static_cast<std::uint8_t const*>(buffer.planeData(pi));
+        if (!data)
+        {
+            RPI_LOG(ERROR, "thresholdPixelBuffer(): buffer not locked!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        Vec2ui const size = buffer.planeSize(pi);
+        std::size_t const rowBytes = buffer.planeRowBytes(pi);
+        bool const bBits = format == BinaryMask::Format::Bits;
+        mask.reset(format, size);
+
+        for (std::uint32_t y = 0; y < size(1); ++y)
+        {
+            std::uint8_t const *src = data + y * rowBytes;
+            std::uint8_t *dst = mask.row(y);
+            std::uint32_t x = 0;
+#if defined(RPI_CAM_SIMD_NEON)
+            static const std::uint8_t kBitWeights[8] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+            uint8x8_t const weights = vld1_u8(kBitWeights);
+            uint8x16_t const t = vdupq_n_u8(threshold);
+            for (; x + 16 <= size(0); x += 16)
+            {
+                uint8x16_t const set = vcgtq_u8(vld1q_u8(src + x), t);
+                if (bBits)
+                {
+                    uint8x8_t bits = vpadd_u8(vand_u8(vget_low_u8(set), weights), vand_u8(vget_high_u8(set), weights));
+                    bits = vpadd_u8(bits, bits);
+                    bits = vpadd_u8(bits, bits);
+                    dst[x / 8] = vget_lane_u8(bits, 0);
+                    dst[x / 8 + 1] = vget_lane_u8(bits, 1);
+                }
+                else
+                    vst1q_u8(dst + x, set);
+            }
+#elif defined(RPI_CAM_SIMD_SSE2)
+            // unsigned compare as signed after flipping the sign bits
+            __m128i const sign = _mm_set1_epi8(char(0x80));
+            __m128i const t = _mm_set1_epi8(char(threshold ^ 0x80));
+            for (; x + 16 <= size(0); x += 16)
+            {
+                __m128i const set = _mm_cmpgt_epi8(_mm_xor_si128(_mm_loadu_si128(reinterpret_cast<__m128i const*>(src + x)), sign), t);
+                if (bBits)
+                {
+                    std::uint16_t const bits = std::uint16_t(_mm_movemask_epi8(set));
+                    dst[x / 8] = std::uint8_t(bits);
+                    dst[x / 8 + 1] = std::uint8_t(bits >> 8);
+                }
+                else
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), set);
+            }
+#endif
+            if (bBits && x < size(0))
+                std::memset(dst + x / 8, 0, (size(0) - x + 7) / 8);
+
+            for (; x < size(0); ++x)
+            {
+                if (bBits)
+                    dst[x >> 3] |= std::uint8_t(src[x] > threshold ? 1 << (x & 7) : 0);
+                else
+                    dst[x] = src[x] > threshold ? 255 : 0;
+            }
+        }
+        return std::error_code();
+    }
+
+    std::istream& operator>>(std::istream &s, BinaryMask::Format &v)
+    {
+        std::string sv;
+        s >> sv;
+        if (sv == "Bytes")
+            v = BinaryMask::Format::Bytes;
+        else if (sv == "Bits")
+            v = BinaryMask::Format::Bits;
+        else
+            throw std::invalid_argument("Invalid value for BinaryMask::Format: " + sv);
+        return s;
+    }
+
+    std::ostream& operator<<(std::ostream &s, BinaryMask::Format v)
+    {
+        switch(v)
+        {
+        case BinaryMask::Format::Bytes:     s << "Bytes";   break;
+        case BinaryMask::Format::Bits:      s << "Bits";    break;
+        }
+        return s;
+    }
+}
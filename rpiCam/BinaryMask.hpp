@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Config.hpp"
+#include "PixelBuffer.hpp"
+#include <vector>
+
+namespace rpiCam
+{
+    // A foreground or threshold mask, one byte (0 or 255) or one bit per
+    // pixel. Bits are packed least significant first, pixel x of a row is bit
+    // x % 8 of byte x / 8. Rows are padded to 16 bytes so kernels can store
+    // whole vectors.
+    class BinaryMask
+    {
+    public:
+        enum class Format : int
+        {
+            Bytes,
+            Bits
+        };
+
+        static constexpr std::size_t kRowAlignment = 16;
+
+        BinaryMask();
+        BinaryMask(Format format, Vec2ui const &size);
+        ~BinaryMask();
+
+        // keeps the allocation when it is large enough, the contents are undefined
+        void reset(Format format, Vec2ui const &size);
+        void clear();
+
+        inline Format format() const { return m_Format; }
+        inline Vec2ui const& size() const { return m_Size; }
+        inline std::size_t rowBytes() const { return m_RowBytes; }
+        inline bool isEmpty() const { return m_Size(0) == 0 || m_Size(1) == 0; }
+
+        inline std::uint8_t* data() { return m_Data.data(); }
+        inline std::uint8_t const* data() const { return m_Data.data(); }
+        inline std::uint8_t* row(std::uint32_t y) { return m_Data.data() + y * m_RowBytes; }
+        inline std::uint8_t const* row(std::uint32_t y) const { return m_Data.data() + y * m_RowBytes; }
+
+        inline bool test(std::uint32_t x, std::uint32_t y) const
+        {
+            return m_Format == Format::Bits ?
+                (row(y)[x >> 3] >> (x & 7)) & 1 :
+                row(y)[x] != 0;
+        }
+
+        inline void set(std::uint32_t x, std::uint32_t y, bool bValue)
+        {
+            if (m_Format == Format::Bits)
+            {
+                std::uint8_t const bit = std::uint8_t(1 << (x & 7));
+                row(y)[x >> 3] = bValue ? (row(y)[x >> 3] | bit) : (row(y)[x >> 3] & ~bit);
+            }
+            else
+                row(y)[x] = bValue ? 255 : 0;
+        }
+
+        // number of set pixels
+        std::size_t count() const;
+
+    private:
+        Format m_Format;
+        Vec2ui m_Size;
+        std::size_t m_RowBytes;
+        std::vector<std::uint8_t> m_Data;
+    };
+
+    // Sets the mask where a one byte per pixel plane of the locked buffer is
+    // above threshold, e.g. the Y plane or a GRAY8 difference image.
+    std::error_code thresholdPixelBuffer(PixelBuffer &buffer, std::size_t pi, std::uint8_t threshold, BinaryMask::Format format, BinaryMask &mask);
+
+    extern std::istream& operator>>(std::istream &s, BinaryMask::Format &v);
+    extern std::ostream& operator<<(std::ostream &s, BinaryMask::Format v);
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "Config.hpp"
+#include <deque>
+#include <condition_variable>
+
+namespace rpiCam
+{
+    template <typename T>
+    class BoundedQueue
+    {
+    public:
+        explicit BoundedQueue(std::size_t capacity)
+            : m_Mutex()
+            , m_NotEmpty()
+            , m_NotFull()
+            , m_Items()
+            , m_Capacity(std::max<std::size_t>(capacity, 1))
+            , m_bClosed(false)
+        {
+        }
+
+        inline std::size_t capacity() const { return m_Capacity; }
+
+        std::size_t size() const
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            return m_Items.size();
+        }
+
+        // blocks while the queue is full, fails once closed
+        bool push(T &&item)
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_NotFull.wait(lock, [this]() { return m_bClosed || m_Items.size() < m_Capacity; });
+            if (m_bClosed)
+                return false;
+
+            m_Items.push_back(std::move(item));
+            m_NotEmpty.notify_one();
+            return true;
+        }
+
+        // never blocks, fails when the queue is full or closed
+        bool tryPush(T &&item)
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (m_bClosed || m_Items.size() >= m_Capacity)
+                return false;
+
+            m_Items.push_back(std::move(item));
+            m_NotEmpty.notify_one();
+            return true;
+        }
+
+        // never blocks, evicts the oldest item into evicted when the queue is full
+        bool pushEvictingOldest(T &&item, T &evicted)
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (m_bClosed)
+                return false;
+
+            bool bEvicted = false;
+            if (m_Items.size() >= m_Capacity)
+            {
+                evicted = std::move(m_Items.front());
+                m_Items.pop_front();
+                bEvicted = true;
+            }
+
+            m_Items.push_back(std::move(item));
+            m_NotEmpty.notify_one();
+            return bEvicted;
+        }
+
+        // blocks until an item is available, fails once closed and drained
+        bool pop(T &item)
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_NotEmpty.wait(lock, [this]() { return m_bClosed || !m_Items.empty(); });
+            if (m_Items.empty())
+                return false;
+
+            item = std::move(m_Items.front());
+            m_Items.pop_front();
+            m_NotFull.notify_one();
+            return true;
+        }
+
+        void close()
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_bClosed = true;
+            m_NotEmpty.notify_all();
+            m_NotFull.notify_all();
+        }
+
+        void reopen()
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Items.clear();
+            m_bClosed = false;
+        }
+
+    private:
+        mutable std::mutex m_Mutex;
+        std::condition_variable m_NotEmpty;
+        std::condition_variable m_NotFull;
+        std::deque<T> m_Items;
+        std::size_t const m_Capacity;
+        bool m_bClosed;
+    };
+}
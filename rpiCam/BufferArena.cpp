@@ -0,0 +1,106 @@
+#include "BufferArena.hpp"
+
+namespace rpiCam
+{
+    namespace
+    {
+        inline std::uint8_t* alignedData(std::uint8_t *memory)
+        {
+            return reinterpret_cast<std::uint8_t*>(
+                (reinterpret_cast<std::uintptr_t>(memory) + BufferArena::kAlignment - 1) & ~std::uintptr_t(BufferArena::kAlignment - 1)
+            );
+        }
+    }
+
+    BufferArena::Recycler::Recycler(std::weak_ptr<BufferArena> const &arena, std::uint8_t *memory, std::size_t size)
+        : m_Arena(arena)
+        , m_Memory(memory)
+        , m_Size(size)
+    {
+    }
+
+    void BufferArena::Recycler::operator()(std::uint8_t *)
+    {
+        if (std::shared_ptr<BufferArena> arena = m_Arena.lock())
+            arena->recycle(m_Memory, m_Size);
+        else
+            delete [] m_Memory;
+    }
+
+    BufferArena::BufferArena(std::size_t maxCachedBytes)
+        : m_MaxCachedBytes(maxCachedBytes)
+        , m_Mutex()
+        , m_Free()
+        , m_CachedBytes(0)
+        , m_NumHeapAllocations(0)
+    {
+    }
+
+    BufferArena::~BufferArena()
+    {
+        trim();
+    }
+
+    std::shared_ptr<BufferArena> const& BufferArena::shared()
+    {
+        static std::shared_ptr<BufferArena> arena = std::make_shared<BufferArena>();
+        return arena;
+    }
+
+    std::shared_ptr<std::uint8_t> BufferArena::allocate(std::size_t size)
+    {
+        std::uint8_t *memory = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            auto it = m_Free.find(size);
+            if (it != m_Free.end())
+            {
+                memory = it->second;
+                m_Free.erase(it);
+                m_CachedBytes -= size;
+            }
+            else
+                m_NumHeapAllocations++;
+        }
+
+        if (!memory)
+            memory = new std::uint8_t[size + kAlignment - 1];
+
+        return std::shared_ptr<std::uint8_t>(alignedData(memory), Recycler(shared_from_this(), memory, size));
+    }
+
+    void BufferArena::trim()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        for (auto &block : m_Free)
+            delete [] block.second;
+        m_Free.clear();
+        m_CachedBytes = 0;
+    }
+
+    std::size_t BufferArena::cachedBytes() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_CachedBytes;
+    }
+
+    std::size_t BufferArena::numHeapAllocations() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_NumHeapAllocations;
+    }
+
+    void BufferArena::recycle(std::uint8_t *memory, std::size_t size)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (m_CachedBytes + size <= m_MaxCachedBytes)
+            {
+                m_Free.emplace(size, memory);
+                m_CachedBytes += size;
+                return;
+            }
+        }
+        delete [] memory;
+    }
+}
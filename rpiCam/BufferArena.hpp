@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Config.hpp"
+#include <map>
+#include <mutex>
+
+namespace rpiCam
+{
+    // Pool of aligned memory blocks recycled by exact size. Per-frame scratch
+    // memory is requested at the same few sizes every frame, so after the
+    // first frames every allocation is a free list lookup. Blocks keep a weak
+    // reference to the arena and are simply freed if it is gone.
+    class BufferArena
+        : public std::enable_shared_from_this<BufferArena>
+    {
+    public:
+        static constexpr std::size_t kAlignment = 32;
+        static constexpr std::size_t kDefaultMaxCachedBytes = 32 << 20;
+
+        BufferArena(std::size_t maxCachedBytes = kDefaultMaxCachedBytes);
+        ~BufferArena();
+
+        static std::shared_ptr<BufferArena> const& shared();
+
+        // the block returns to the arena when the last reference goes away
+        std::shared_ptr<std::uint8_t> allocate(std::size_t size);
+
+        // frees every cached block
+        void trim();
+
+        std::size_t cachedBytes() const;
+
+        // number of allocations that could not be served from the cache
+        std::size_t numHeapAllocations() const;
+
+    private:
+        class Recycler
+        {
+        public:
+            Recycler(std::weak_ptr<BufferArena> const &arena, std::uint8_t *memory, std::size_t size);
+
+            void operator()(std::uint8_t *data);
+
+        private:
+            std::weak_ptr<BufferArena> m_Arena;
+            std::uint8_t *m_Memory;
+            std::size_t m_Size;
+        };
+
+        void recycle(std::uint8_t *memory, std::size_t size);
+
+    private:
+        std::size_t m_MaxCachedBytes;
+        mutable std::mutex m_Mutex;
+        std::multimap<std::size_t, std::uint8_t*> m_Free;
+        std::size_t m_CachedBytes;
+        std::size_t m_NumHeapAllocations;
+    };
+}
@@ -1,10 +1,20 @@
 #include "Camera.hpp"
+#include "Logging.hpp"
 
 namespace rpiCam
 {
     Camera::Camera()
         : m_CameraEvents()
+        , m_CameraTypedEvents()
+        , m_DeliveryThreads()
+        , m_DeliveryTransform(ImageTransform::Identity)
+        , m_DeliveryTransformArena(std::make_shared<BufferArena>())
+        , m_bDeliveryTransformFailed(false)
     {
+        m_CameraEvents.setOverrunHandler([this](DispatchOverrun const &overrun)
+        {
+            dispatchOnCameraDispatchDeadlineMissed(overrun);
+        });
 
     }
 
@@ -13,6 +23,65 @@ namespace rpiCam
     {
 
     }
+
+    void Camera::setDeliveryThreadSchedule(DeliveryThread thread, ThreadSchedule const &schedule)
+    {
+        deliveryThreadMonitor(thread).setSchedule(schedule);
+    }
+
+    ThreadSchedule Camera::getDeliveryThreadSchedule(DeliveryThread thread) const
+    {
+        return m_DeliveryThreads[static_cast<std::size_t>(thread)].schedule();
+    }
+
+    SchedulingLatencyStats Camera::getDeliveryThreadLatency(DeliveryThread thread) const
+    {
+        return m_DeliveryThreads[static_cast<std::size_t>(thread)].latency();
+    }
+
+    std::error_code Camera::setDeliveryTransform(ImageTransform transform)
+    {
+        if (!isImageTransformSupported(getVideoFormat(), transform))
+        {
+            RPI_LOG(WARNING, "Camera::setDeliveryTransform(): transform not supported for the video format!");
+            return std::make_error_code(std::errc::not_supported);
+        }
+
+        m_DeliveryTransform.store(transform, std::memory_order_relaxed);
+        m_bDeliveryTransformFailed.store(false, std::memory_order_relaxed);
+        return std::error_code();
+    }
+
+    ImageTransform Camera::getDeliveryTransform() const
+    {
+        return m_DeliveryTransform.load(std::memory_order_relaxed);
+    }
+
+    std::shared_ptr<PixelSampleBuffer> Camera::applyDeliveryTransform(std::shared_ptr<PixelSampleBuffer> const &buffer)
+    {
+        ImageTransform const transform = m_DeliveryTransform.load(std::memory_order_relaxed);
+        if (transform == ImageTransform::Identity || !buffer)
+            return buffer;
+
+        std::shared_ptr<MemoryPixelSampleBuffer> transformed;
+        if (isImageTransformSupported(buffer->format(), transform) && !buffer->lock())
+        {
+            transformed = transformPixelBuffer(*buffer, transform, m_DeliveryTransformArena);
+            buffer->unlock();
+        }
+
+        if (!transformed)
+        {
+            // once per setDeliveryTransform(), this runs for every frame
+            if (!m_bDeliveryTransformFailed.exchange(true, std::memory_order_relaxed))
+                RPI_LOG(WARNING, "Camera::applyDeliveryTransform(): transform not possible for the buffer, delivering it untransformed!");
+            return buffer;
+        }
+
+        transformed->time = buffer->time;
+        transformed->sequence = buffer->sequence;
+        return transformed;
+    }
     
     std::istream& operator>>(std::istream &s, Camera::AWBMode &v)
     {
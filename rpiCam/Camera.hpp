@@ -4,8 +4,12 @@
 #include "Device.hpp"
 #include "PixelFormat.hpp"
 #include "PixelSampleBuffer.hpp"
+#include "CroppedPixelSampleBuffer.hpp"
+#include "ImageTransform.hpp"
 #include "EventsDispatcher.hpp"
+#include "TypedEventsDispatcher.hpp"
 #include "Rational.hpp"
+#include "ThreadScheduling.hpp"
 
 namespace rpiCam
 {
@@ -26,6 +30,24 @@ namespace rpiCam
             virtual void onCameraVideoFrame(std::shared_ptr<PixelSampleBuffer> const &buffer) {}
             virtual void onCameraSnapshotTaken(std::shared_ptr<PixelSampleBuffer> const &buffer) {}
             virtual void onCameraRecordingBuffer(std::shared_ptr<SampleBuffer> const &buffer, std::uint32_t flags) {}
+            virtual void onCameraDispatchDeadlineMissed(DispatchOverrun const &overrun) {}
+        };
+
+        struct Event
+        {
+            struct ConfigurationChanged { using Signature = void(); };
+            struct VideoStarted { using Signature = void(); };
+            struct VideoStopped { using Signature = void(); };
+            struct TakingSnapshotsStarted { using Signature = void(); };
+            struct TakingSnapshotsStopped { using Signature = void(); };
+            struct RecordingStarted { using Signature = void(); };
+            struct RecordingStopped { using Signature = void(); };
+            struct VideoFrame { using Signature = void(std::shared_ptr<PixelSampleBuffer> const &buffer); };
+            // subscribed through subscribeVideoFrameRegion(), each subscriber receives its own crop
+            struct VideoFrameRegion { using Signature = void(std::shared_ptr<PixelSampleBuffer> const &buffer); };
+            struct SnapshotTaken { using Signature = void(std::shared_ptr<PixelSampleBuffer> const &buffer); };
+            struct RecordingBuffer { using Signature = void(std::shared_ptr<SampleBuffer> const &buffer, std::uint32_t flags); };
+            struct DispatchDeadlineMissed { using Signature = void(rpiCam::DispatchOverrun const &overrun); };
         };
 
         enum class RecordingBufferFlags : std::uint32_t
@@ -90,7 +112,29 @@ namespace rpiCam
             At60Hz
         };
 
+        enum class DeliveryThread : int
+        {
+            Video,
+            Snapshot,
+            Encoder,
+            Count
+        };
+
         using CameraEvents = EventsDispatcher<Events>;
+        using CameraTypedEvents = TypedEventsDispatcher<
+            Event::ConfigurationChanged,
+            Event::VideoStarted,
+            Event::VideoStopped,
+            Event::TakingSnapshotsStarted,
+            Event::TakingSnapshotsStopped,
+            Event::RecordingStarted,
+            Event::RecordingStopped,
+            Event::VideoFrame,
+            Event::VideoFrameRegion,
+            Event::SnapshotTaken,
+            Event::RecordingBuffer,
+            Event::DispatchDeadlineMissed
+        >;
 
         Camera();
         virtual ~Camera();
@@ -108,6 +152,7 @@ namespace rpiCam
         virtual std::error_code setVideoSize(Vec2ui const &sz) = 0;
         virtual Rational getVideoFrameRate() const = 0;
         virtual std::error_code setVideoFrameRate(Rational const &rate) = 0;
+        virtual std::size_t getVideoBufferCount() const = 0;
 
         virtual std::error_code startVideo() = 0;
         virtual bool isVideoStarted() const = 0;
@@ -176,61 +221,123 @@ namespace rpiCam
         virtual std::error_code disableRecording() = 0;
 
 
+        void setDeliveryThreadSchedule(DeliveryThread thread, ThreadSchedule const &schedule);
+        ThreadSchedule getDeliveryThreadSchedule(DeliveryThread thread) const;
+        SchedulingLatencyStats getDeliveryThreadLatency(DeliveryThread thread) const;
+
+        // Applied in software to video frames and snapshots before they are
+        // dispatched. Fails when the video format does not support transform;
+        // frames it cannot be applied to later on, after a format change or
+        // of another format, are delivered untransformed with a warning.
+        std::error_code setDeliveryTransform(ImageTransform transform);
+        ImageTransform getDeliveryTransform() const;
+
+        // handler receives zero-copy crops of every video frame to region
+        template <typename Handler>
+        EventSubscription subscribeVideoFrameRegion(Rect const &region, Handler &&handler) const
+        {
+            return m_CameraTypedEvents.subscribe<Event::VideoFrameRegion>(
+                [region, handler = std::forward<Handler>(handler)](std::shared_ptr<PixelSampleBuffer> const &buffer) mutable
+                {
+                    if (std::shared_ptr<PixelSampleBuffer> cropped = cropPixelSampleBuffer(buffer, region))
+                        handler(cropped);
+                }
+            );
+        }
+
+        inline bool unsubscribeVideoFrameRegion(EventSubscription subscription) const
+        {
+            return m_CameraTypedEvents.unsubscribe<Event::VideoFrameRegion>(subscription);
+        }
+
         inline CameraEvents const& cameraEvents() const { return m_CameraEvents; }
+        inline CameraTypedEvents const& cameraTypedEvents() const { return m_CameraTypedEvents; }
 
     protected:
+        // the buffer itself when no transform is set or it fails
+        std::shared_ptr<PixelSampleBuffer> applyDeliveryTransform(std::shared_ptr<PixelSampleBuffer> const &buffer);
+
+        inline ScheduledThreadMonitor& deliveryThreadMonitor(DeliveryThread thread)
+        {
+            return m_DeliveryThreads[static_cast<std::size_t>(thread)];
+        }
+
         inline void dispatchOnCameraConfigurationChanged()
         {
             m_CameraEvents.dispatch(&Events::onCameraConfigurationChanged);
+            m_CameraTypedEvents.dispatch<Event::ConfigurationChanged>();
         }
 
         inline void dispatchOnCameraVideoStarted()
         {
             m_CameraEvents.dispatch(&Events::onCameraVideoStarted);
+            m_CameraTypedEvents.dispatch<Event::VideoStarted>();
         }
 
         inline void dispatchOnCameraVideoStopped()
         {
             m_CameraEvents.dispatch(&Events::onCameraVideoStopped);
+            m_CameraTypedEvents.dispatch<Event::VideoStopped>();
         }
 
         inline void dispatchOnCameraTakingSnapshotsStarted()
         {
             m_CameraEvents.dispatch(&Events::onCameraTakingSnapshotsStarted);
+            m_CameraTypedEvents.dispatch<Event::TakingSnapshotsStarted>();
         }
 
         inline void dispatchOnCameraTakingSnapshotsStopped()
         {
             m_CameraEvents.dispatch(&Events::onCameraTakingSnapshotsStopped);
+            m_CameraTypedEvents.dispatch<Event::TakingSnapshotsStopped>();
         }
 
         inline void dispatchOnCameraRecordingStarted()
         {
             m_CameraEvents.dispatch(&Events::onCameraRecordingStarted);
+            m_CameraTypedEvents.dispatch<Event::RecordingStarted>();
         }
 
         inline void dispatchOnCameraRecordingStopped()
         {
             m_CameraEvents.dispatch(&Events::onCameraRecordingStopped);
+            m_CameraTypedEvents.dispatch<Event::RecordingStopped>();
         }
 
         inline void dispatchOnCameraVideoFrame(std::shared_ptr<PixelSampleBuffer> const &buffer)
         {
-            m_CameraEvents.dispatch(&Events::onCameraVideoFrame, buffer);
+            std::shared_ptr<PixelSampleBuffer> const delivered = applyDeliveryTransform(buffer);
+            m_CameraEvents.dispatch(&Events::onCameraVideoFrame, delivered);
+            m_CameraTypedEvents.dispatch<Event::VideoFrame>(delivered);
+            m_CameraTypedEvents.dispatch<Event::VideoFrameRegion>(delivered);
         }
 
         inline void dispatchOnCameraSnapshotTaken(std::shared_ptr<PixelSampleBuffer> const &buffer)
         {
-            m_CameraEvents.dispatch(&Events::onCameraSnapshotTaken, buffer);
+            std::shared_ptr<PixelSampleBuffer> const delivered = applyDeliveryTransform(buffer);
+            m_CameraEvents.dispatch(&Events::onCameraSnapshotTaken, delivered);
+            m_CameraTypedEvents.dispatch<Event::SnapshotTaken>(delivered);
         }
 
         inline void dispatchOnCameraRecordingBuffer(std::shared_ptr<SampleBuffer> const &buffer, std::uint32_t flags)
         {
             m_CameraEvents.dispatch(&Events::onCameraRecordingBuffer, buffer, flags);
+            m_CameraTypedEvents.dispatch<Event::RecordingBuffer>(buffer, flags);
+        }
+
+        inline void dispatchOnCameraDispatchDeadlineMissed(DispatchOverrun const &overrun)
+        {
+            m_CameraEvents.dispatch(&Events::onCameraDispatchDeadlineMissed, overrun);
+            m_CameraTypedEvents.dispatch<Event::DispatchDeadlineMissed>(overrun);
         }
 
     protected:
         CameraEvents m_CameraEvents;
+        CameraTypedEvents m_CameraTypedEvents;
+        ScheduledThreadMonitor m_DeliveryThreads[static_cast<std::size_t>(DeliveryThread::Count)];
+        std::atomic<ImageTransform> m_DeliveryTransform;
+        std::shared_ptr<BufferArena> m_DeliveryTransformArena;
+        std::atomic<bool> m_bDeliveryTransformFailed;
     };
     
     extern std::istream& operator>>(std::istream &s, Camera::AWBMode &v);
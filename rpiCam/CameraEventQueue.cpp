@@ -0,0 +1,288 @@
+#include "CameraEventQueue.hpp"
+#include "Logging.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <iostream>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace rpiCam
+{
+    namespace
+    {
+        std::size_t roundUpToPowerOfTwo(std::size_t value)
+        {
+            std::size_t result = 2;
+            while (result < value)
+                result <<= 1;
+            return result;
+        }
+    }
+
+    CameraEventRecord::CameraEventRecord()
+        : camera(nullptr)
+        , type(Type::ConfigurationChanged)
+        , flags(0)
+        , buffer()
+    {
+    }
+
+    CameraEventQueue::Source::Source(CameraEventQueue &queue, Camera const &cam)
+        : Camera::Events()
+        , camera(cam)
+        , m_Queue(queue)
+        , m_VideoFrame(std::make_shared<FrameSlot>())
+        , m_Snapshot(std::make_shared<FrameSlot>())
+    {
+    }
+
+    void CameraEventQueue::Source::onCameraConfigurationChanged()
+    {
+        push(CameraEventRecord::Type::ConfigurationChanged);
+    }
+
+    void CameraEventQueue::Source::onCameraVideoStarted()
+    {
+        push(CameraEventRecord::Type::VideoStarted);
+    }
+
+    void CameraEventQueue::Source::onCameraVideoStopped()
+    {
+        push(CameraEventRecord::Type::VideoStopped);
+    }
+
+    void CameraEventQueue::Source::onCameraTakingSnapshotsStarted()
+    {
+        push(CameraEventRecord::Type::TakingSnapshotsStarted);
+    }
+
+    void CameraEventQueue::Source::onCameraTakingSnapshotsStopped()
+    {
+        push(CameraEventRecord::Type::TakingSnapshotsStopped);
+    }
+
+    void CameraEventQueue::Source::onCameraRecordingStarted()
+    {
+        push(CameraEventRecord::Type::RecordingStarted);
+    }
+
+    void CameraEventQueue::Source::onCameraRecordingStopped()
+    {
+        push(CameraEventRecord::Type::RecordingStopped);
+    }
+
+    void CameraEventQueue::Source::onCameraVideoFrame(std::shared_ptr<PixelSampleBuffer> const &buffer)
+    {
+        pushFrame(CameraEventRecord::Type::VideoFrame, m_VideoFrame, buffer);
+    }
+
+    void CameraEventQueue::Source::onCameraSnapshotTaken(std::shared_ptr<PixelSampleBuffer> const &buffer)
+    {
+        pushFrame(CameraEventRecord::Type::SnapshotTaken, m_Snapshot, buffer);
+    }
+
+    void CameraEventQueue::Source::onCameraRecordingBuffer(std::shared_ptr<SampleBuffer> const &buffer, std::uint32_t flags)
+    {
+        push(CameraEventRecord::Type::RecordingBuffer, buffer, flags);
+    }
+
+    void CameraEventQueue::Source::push(CameraEventRecord::Type type, std::shared_ptr<SampleBuffer> const &buffer, std::uint32_t flags)
+    {
+        CameraEventRecord record;
+        record.camera = &camera;
+        record.type = type;
+        record.flags = flags;
+        record.buffer = buffer;
+        m_Queue.push(std::move(record));
+    }
+
+    void CameraEventQueue::Source::pushFrame(CameraEventRecord::Type type, std::shared_ptr<FrameSlot> const &slot, std::shared_ptr<SampleBuffer> const &buffer)
+    {
+        // a record already waits for the slot, it delivers this frame instead
+        if (std::atomic_exchange(&slot->buffer, buffer))
+        {
+            m_Queue.m_NumDropped++;
+            return;
+        }
+
+        CameraEventRecord record;
+        record.camera = &camera;
+        record.type = type;
+        if (!m_Queue.push(std::move(record), slot))
+            std::atomic_store(&slot->buffer, std::shared_ptr<SampleBuffer>());
+    }
+
+    CameraEventQueue::CameraEventQueue(std::size_t capacity)
+        : m_EventFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+        , m_Cells(roundUpToPowerOfTwo(capacity))
+        , m_Mask(m_Cells.size() - 1)
+        , m_EnqueuePos(0)
+        , m_DequeuePos(0)
+        , m_bNotified(false)
+        , m_NumDropped(0)
+        , m_SourcesMutex()
+        , m_Sources()
+    {
+        if (m_EventFd < 0)
+        {
+            RPI_LOG(ERROR, "CameraEventQueue::CameraEventQueue(): eventfd() failed!");
+        }
+
+        for (std::size_t ic = 0; ic < m_Cells.size(); ++ic)
+            m_Cells[ic].sequence.store(ic, std::memory_order_relaxed);
+    }
+
+    CameraEventQueue::~CameraEventQueue()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_SourcesMutex);
+            for (auto &source : m_Sources)
+                source->camera.cameraEvents() -= source.get();
+            m_Sources.clear();
+        }
+
+        if (m_EventFd >= 0)
+            ::close(m_EventFd);
+    }
+
+    std::error_code CameraEventQueue::attach(Camera const &camera)
+    {
+        std::lock_guard<std::mutex> lock(m_SourcesMutex);
+        auto it = std::find_if(m_Sources.begin(), m_Sources.end(), [&camera](std::unique_ptr<Source> const &s) { return &s->camera == &camera; });
+        if (it != m_Sources.end())
+        {
+            RPI_LOG(WARNING, "CameraEventQueue::attach(): camera already attached!");
+            return std::make_error_code(std::errc::device_or_resource_busy);
+        }
+
+        m_Sources.emplace_back(new Source(*this, camera));
+        camera.cameraEvents() += m_Sources.back().get();
+        return std::error_code();
+    }
+
+    std::error_code CameraEventQueue::detach(Camera const &camera)
+    {
+        std::lock_guard<std::mutex> lock(m_SourcesMutex);
+        auto it = std::find_if(m_Sources.begin(), m_Sources.end(), [&camera](std::unique_ptr<Source> const &s) { return &s->camera == &camera; });
+        if (it == m_Sources.end())
+        {
+            RPI_LOG(WARNING, "CameraEventQueue::detach(): camera not attached!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        camera.cameraEvents() -= it->get();
+        m_Sources.erase(it);
+        return std::error_code();
+    }
+
+    bool CameraEventQueue::push(CameraEventRecord &&record)
+    {
+        return push(std::move(record), std::shared_ptr<FrameSlot>());
+    }
+
+    bool CameraEventQueue::push(CameraEventRecord &&record, std::shared_ptr<FrameSlot> const &slot)
+    {
+        std::size_t pos = m_EnqueuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true)
+        {
+            cell = &m_Cells[pos & m_Mask];
+            std::size_t const sequence = cell->sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t const diff = std::ptrdiff_t(sequence) - std::ptrdiff_t(pos);
+            if (diff == 0)
+            {
+                if (m_EnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                m_NumDropped++;
+                return false;
+            }
+            else
+                pos = m_EnqueuePos.load(std::memory_order_relaxed);
+        }
+
+        cell->record = std::move(record);
+        cell->slot = slot;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+
+        notify();
+        return true;
+    }
+
+    bool CameraEventQueue::pop(CameraEventRecord &record)
+    {
+        std::size_t pos = m_DequeuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true)
+        {
+            cell = &m_Cells[pos & m_Mask];
+            std::size_t const sequence = cell->sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t const diff = std::ptrdiff_t(sequence) - std::ptrdiff_t(pos + 1);
+            if (diff == 0)
+            {
+                if (m_DequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false;
+            else
+                pos = m_DequeuePos.load(std::memory_order_relaxed);
+        }
+
+        record = std::move(cell->record);
+        if (cell->slot)
+        {
+            record.buffer = std::atomic_exchange(&cell->slot->buffer, std::shared_ptr<SampleBuffer>());
+            cell->slot.reset();
+        }
+        cell->sequence.store(pos + m_Mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    void CameraEventQueue::notify()
+    {
+        // One write per wake-up, the consumer re-arms in acknowledge() before
+        // draining. Both sides swap the flag sequentially consistent after
+        // publishing, so either the consumer sees the record or this sees
+        // the flag cleared and writes.
+        if (m_bNotified.exchange(true, std::memory_order_seq_cst))
+            return;
+
+        std::uint64_t const one = 1;
+        if (::write(m_EventFd, &one, sizeof(one)) != sizeof(one))
+        {
+            RPI_LOG(WARNING, "CameraEventQueue::notify(): write() failed!");
+        }
+    }
+
+    void CameraEventQueue::acknowledge()
+    {
+        std::uint64_t value;
+        if (::read(m_EventFd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+        {
+            RPI_LOG(WARNING, "CameraEventQueue::acknowledge(): read() failed!");
+        }
+        // an exchange, a plain store could be ordered after the loads in pop()
+        m_bNotified.exchange(false, std::memory_order_seq_cst);
+    }
+
+    std::ostream& operator<<(std::ostream &s, CameraEventRecord::Type v)
+    {
+        switch(v)
+        {
+        case CameraEventRecord::Type::ConfigurationChanged:    s << "ConfigurationChanged";    break;
+        case CameraEventRecord::Type::VideoStarted:            s << "VideoStarted";            break;
+        case CameraEventRecord::Type::VideoStopped:            s << "VideoStopped";            break;
+        case CameraEventRecord::Type::TakingSnapshotsStarted:  s << "TakingSnapshotsStarted";  break;
+        case CameraEventRecord::Type::TakingSnapshotsStopped:  s << "TakingSnapshotsStopped";  break;
+        case CameraEventRecord::Type::RecordingStarted:        s << "RecordingStarted";        break;
+        case CameraEventRecord::Type::RecordingStopped:        s << "RecordingStopped";        break;
+        case CameraEventRecord::Type::VideoFrame:              s << "VideoFrame";              break;
+        case CameraEventRecord::Type::SnapshotTaken:           s << "SnapshotTaken";           break;
+        case CameraEventRecord::Type::RecordingBuffer:         s << "RecordingBuffer";         break;
+        }
+        return s;
+    }
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "Config.hpp"
+#include "Camera.hpp"
+#include <vector>
+#include <system_error>
+
+namespace rpiCam
+{
+    class CameraEventRecord
+    {
+    public:
+        enum class Type : std::uint8_t
+        {
+            ConfigurationChanged,
+            VideoStarted,
+            VideoStopped,
+            TakingSnapshotsStarted,
+            TakingSnapshotsStopped,
+            RecordingStarted,
+            RecordingStopped,
+            VideoFrame,
+            SnapshotTaken,
+            RecordingBuffer
+        };
+
+        CameraEventRecord();
+
+        // valid for VideoFrame and SnapshotTaken records
+        inline std::shared_ptr<PixelSampleBuffer> pixelSampleBuffer() const
+        {
+            return std::static_pointer_cast<PixelSampleBuffer>(buffer);
+        }
+
+        Camera const *camera;
+        Type type;
+        std::uint32_t flags;
+        std::shared_ptr<SampleBuffer> buffer;
+    };
+
+    // Collects the events of any number of cameras into a bounded lock-free
+    // queue and signals an eventfd, so an application can poll() the fd from
+    // its own loop and drain() everything on that one thread. The camera
+    // threads never block: records arriving while the queue is full are
+    // dropped and counted. Frames pin buffers of the camera's small port
+    // pools, so at most one video frame and one snapshot of each camera
+    // wait: a newer one takes the place of the one not drained yet, which
+    // counts as dropped, and is delivered at its position in the queue.
+    class CameraEventQueue
+    {
+    public:
+        static constexpr std::size_t kDefaultCapacity = 64;
+
+        explicit CameraEventQueue(std::size_t capacity = kDefaultCapacity);
+        ~CameraEventQueue();
+
+        inline int fd() const { return m_EventFd; }
+        inline std::size_t capacity() const { return m_Cells.size(); }
+        inline std::uint64_t numDropped() const { return m_NumDropped; }
+
+        std::error_code attach(Camera const &camera);
+        std::error_code detach(Camera const &camera);
+
+        bool push(CameraEventRecord &&record);
+        bool pop(CameraEventRecord &record);
+
+        // call when fd() is readable, returns the number of records handled
+        template <typename Handler>
+        std::size_t drain(Handler &&handler, std::size_t maxRecords = std::size_t(-1))
+        {
+            acknowledge();
+
+            std::size_t numRecords = 0;
+            CameraEventRecord record;
+            while (numRecords < maxRecords && pop(record))
+            {
+                handler(record);
+                record.buffer.reset();
+                numRecords++;
+            }
+
+            // stopped early, make sure the loop comes back for the rest
+            if (numRecords == maxRecords)
+                notify();
+
+            return numRecords;
+        }
+
+    private:
+        // the frame of a camera not drained yet, null while none waits;
+        // frames of one camera are pushed from one delivery thread
+        struct FrameSlot
+        {
+            std::shared_ptr<SampleBuffer> buffer;
+        };
+
+        class Source
+            : public Camera::Events
+        {
+        public:
+            Source(CameraEventQueue &queue, Camera const &camera);
+
+            void onCameraConfigurationChanged() override;
+            void onCameraVideoStarted() override;
+            void onCameraVideoStopped() override;
+            void onCameraTakingSnapshotsStarted() override;
+            void onCameraTakingSnapshotsStopped() override;
+            void onCameraRecordingStarted() override;
+            void onCameraRecordingStopped() override;
+            void onCameraVideoFrame(std::shared_ptr<PixelSampleBuffer> const &buffer) override;
+            void onCameraSnapshotTaken(std::shared_ptr<PixelSampleBuffer> const &buffer) override;
+            void onCameraRecordingBuffer(std::shared_ptr<SampleBuffer> const &buffer, std::uint32_t flags) override;
+
+            Camera const &camera;
+
+        private:
+            void push(CameraEventRecord::Type type, std::shared_ptr<SampleBuffer> const &buffer = std::shared_ptr<SampleBuffer>(), std::uint32_t flags = 0);
+            void pushFrame(CameraEventRecord::Type type, std::shared_ptr<FrameSlot> const &slot, std::shared_ptr<SampleBuffer> const &buffer);
+
+        private:
+            CameraEventQueue &m_Queue;
+            std::shared_ptr<FrameSlot> m_VideoFrame;
+            std::shared_ptr<FrameSlot> m_Snapshot;
+        };
+
+        struct Cell
+        {
+            std::atomic<std::size_t> sequence;
+            CameraEventRecord record;
+            std::shared_ptr<FrameSlot> slot;    // where the buffer of a frame record waits
+        };
+
+        bool push(CameraEventRecord &&record, std::shared_ptr<FrameSlot> const &slot);
+
+        void notify();
+        void acknowledge();
+
+    private:
+        int m_EventFd;
+        std::vector<Cell> m_Cells;
+        std::size_t const m_Mask;
+        std::atomic<std::size_t> m_EnqueuePos;
+        std::atomic<std::size_t> m_DequeuePos;
+        std::atomic<bool> m_bNotified;
+        std::atomic<std::uint64_t> m_NumDropped;
+        std::mutex m_SourcesMutex;
+        std::vector< std::unique_ptr<Source> > m_Sources;
+    };
+
+    extern std::ostream& operator<<(std::ostream &s, CameraEventRecord::Type v);
+}
@@ -21,5 +21,6 @@ namespace rpiCam
 
     using Vec2i = Eigen::Matrix<std::int32_t, 2, 1>;
     using Vec2ui = Eigen::Matrix<std::uint32_t, 2, 1>;
+    using Vec2f = Eigen::Matrix<float, 2, 1>;
 }
 
@@ -0,0 +1,261 @@
+#include "ConnectedComponents.hpp"
+#include "Logging.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace rpiCam
+{
+    namespace
+    {
+        inline std::uint64_t load64(std::uint8_t const *p)
+        {
+            std::uint64_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        // first x >= from of a set (or clear) pixel in a row of bits, width when there is none
+        inline std::uint32_t findBit(std::uint8_t const *row, std::uint32_t from, std::uint32_t width, bool bSet)
+        {
+            std::uint32_t x = from;
+            while (x < width)
+            {
+                std::uint64_t v = load64(row + (x >> 6) * 8);
+                if (!bSet)
+                    v = ~v;
+                v >>= (x & 63);
+                if (v)
+                    return std::min(width, x + std::uint32_t(__builtin_ctzll(v)));
+                x = (x | 63) + 1;
+            }
+            return width;
+        }
+    }
+
+    ConnectedComponentsOptions::ConnectedComponentsOptions()
+        : connectivity(Connectivity::Eight)
+        , minArea(16)
+        , maxBlobs(64)
+    {
+    }
+
+    Blob::Blob()
+        : boundingBox()
+        , area(0)
+        , centroid(0.0f, 0.0f)
+    {
+    }
+
+    BlobList::BlobList()
+        : blobs()
+        , numComponents(0)
+        , bTruncated(false)
+    {
+    }
+
+    ConnectedComponents::ConnectedComponents(ConnectedComponentsOptions const &options)
+        : m_Options(options)
+        , m_Runs()
+        , m_RootComponent()
+        , m_Components()
+    {
+        if (!m_Options.maxBlobs)
+        {
+            RPI_LOG(WARNING, "ConnectedComponents::ConnectedComponents(): maxBlobs is 0, using defaults!");
+            m_Options = ConnectedComponentsOptions();
+        }
+    }
+
+    ConnectedComponents::~ConnectedComponents()
+    {
+    }
+
+    std::error_code ConnectedComponents::setOptions(ConnectedComponentsOptions const &options)
+    {
+        if (!options.maxBlobs)
+        {
+            RPI_LOG(ERROR, "ConnectedComponents::setOptions(): maxBlobs is 0!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+        m_Options = options;
+        return std::error_code();
+    }
+
+    std::error_code ConnectedComponents::label(BinaryMask const &mask, BlobList &result)
+    {
+        result.blobs.clear();
+        result.blobs.reserve(m_Options.maxBlobs);
+        result.numComponents = 0;
+        result.bTruncated = false;
+
+        if (mask.isEmpty())
+        {
+            RPI_LOG(ERROR, "ConnectedComponents::label(): empty mask!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        // with eight connectivity runs touching diagonally are joined as well
+        std::uint32_t const reach = m_Options.connectivity == ConnectedComponentsOptions::Connectivity::Eight ? 1 : 0;
+
+        m_Runs.clear();
+        std::size_t prevBegin = 0, prevEnd = 0;
+        for (std::uint32_t y = 0; y < mask.size()(1); ++y)
+        {
+            std::size_t const curBegin = m_Runs.size();
+            extractRuns(mask, y);
+            std::size_t const curEnd = m_Runs.size();
+
+            std::size_t p = prevBegin;
+            for (std::size_t c = curBegin; c < curEnd; ++c)
+            {
+                while (p < prevEnd && m_Runs[p].x1 + reach <= m_Runs[c].x0)
+                    ++p;
+                for (std::size_t q = p; q < prevEnd && m_Runs[q].x0 < m_Runs[c].x1 + reach; ++q)
+                    join(std::uint32_t(c), std::uint32_t(q));
+            }
+
+            prevBegin = curBegin;
+            prevEnd = curEnd;
+        }
+
+        // roots are the first run of their component, so they are met before the rest
+        m_RootComponent.resize(m_Runs.size());
+        m_Components.clear();
+        for (std::uint32_t ri = 0; ri < m_Runs.size(); ++ri)
+        {
+            Run const &run = m_Runs[ri];
+            std::uint32_t const root = find(ri);
+            std::uint32_t const length = run.x1 - run.x0;
+            if (root == ri)
+            {
+                m_RootComponent[ri] = std::uint32_t(m_Components.size());
+                m_Components.push_back(Component{0, run.x0, run.y, run.x1, run.y + 1, 0, 0});
+            }
+
+            Component &component = m_Components[m_RootComponent[root]];
+            component.area += length;
+            component.x0 = std::min(component.x0, run.x0);
+            component.x1 = std::max(component.x1, run.x1);
+            component.y1 = run.y + 1;
+            component.sumX2 += std::uint64_t(run.x0 + run.x1 - 1) * length;
+            component.sumY += std::uint64_t(run.y) * length;
+        }
+
+        result.numComponents = m_Components.size();
+
+        auto itEnd = std::remove_if(m_Components.begin(), m_Components.end(),
+            [this](Component const &component) { return component.area < m_Options.minArea; });
+        std::size_t numKept = std::size_t(itEnd - m_Components.begin());
+
+        auto byArea = [](Component const &a, Component const &b) { return a.area > b.area; };
+        if (numKept > m_Options.maxBlobs)
+        {
+            std::nth_element(m_Components.begin(), m_Components.begin() + m_Options.maxBlobs, itEnd, byArea);
+            numKept = m_Options.maxBlobs;
+            result.bTruncated = true;
+        }
+        std::sort(m_Components.begin(), m_Components.begin() + numKept, byArea);
+
+        for (std::size_t ic = 0; ic < numKept; ++ic)
+        {
+            Component const &component = m_Components[ic];
+            Blob blob;
+            blob.boundingBox = Rect(component.x0, component.y0, component.x1 - component.x0, component.y1 - component.y0);
+            blob.area = component.area;
+            blob.centroid = Vec2f(
+                float(double(component.sumX2) / (2.0 * component.area)),
+                float(double(component.sumY) / component.area)
+            );
+            result.blobs.push_back(blob);
+        }
+        return std::error_code();
+    }
+
+    void ConnectedComponents::extractRuns(BinaryMask const &mask, std::uint32_t y)
+    {
+        std::uint8_t const *row = mask.row(y);
+        std::uint32_t const width = mask.size()(0);
+
+        if (mask.format() == BinaryMask::Format::Bits)
+        {
+            std::uint32_t x = findBit(row, 0, width, true);
+            while (x < width)
+            {
+                std::uint32_t const end = findBit(row, x, width, false);
+                std::uint32_t const ri = std::uint32_t(m_Runs.size());
+                m_Runs.push_back(Run{x, end, y, ri});
+                x = findBit(row, end, width, true);
+            }
+            return;
+        }
+
+        std::uint32_t x = 0;
+        while (x < width)
+        {
+            // background is skipped eight bytes at a time
+            while (x + 8 <= width && !load64(row + x))
+                x += 8;
+            while (x < width && !row[x])
+                ++x;
+            if (x >= width)
+                break;
+
+            // and the inside of runs too when it is all 255 as thresholdPixelBuffer writes it
+            std::uint32_t const begin = x;
+            while (x + 8 <= width && load64(row + x) == ~std::uint64_t(0))
+                x += 8;
+            while (x < width && row[x])
+                ++x;
+
+            std::uint32_t const ri = std::uint32_t(m_Runs.size());
+            m_Runs.push_back(Run{begin, x, y, ri});
+        }
+    }
+
+    std::uint32_t ConnectedComponents::find(std::uint32_t ri)
+    {
+        while (m_Runs[ri].parent != ri)
+        {
+            m_Runs[ri].parent = m_Runs[m_Runs[ri].parent].parent;
+            ri = m_Runs[ri].parent;
+        }
+        return ri;
+    }
+
+    void ConnectedComponents::join(std::uint32_t ra, std::uint32_t rb)
+    {
+        ra = find(ra);
+        rb = find(rb);
+        // the smaller index stays the root
+        if (ra < rb)
+            m_Runs[rb].parent = ra;
+        else if (rb < ra)
+            m_Runs[ra].parent = rb;
+    }
+
+    std::istream& operator>>(std::istream &s, ConnectedComponentsOptions::Connectivity &v)
+    {
+        std::string sv;
+        s >> sv;
+        if (sv == "Four")
+            v = ConnectedComponentsOptions::Connectivity::Four;
+        else if (sv == "Eight")
+            v = ConnectedComponentsOptions::Connectivity::Eight;
+        else
+            throw std::invalid_argument("Invalid value for ConnectedComponentsOptions::Connectivity: " + sv);
+        return s;
+    }
+
+    std::ostream& operator<<(std::ostream &s, ConnectedComponentsOptions::Connectivity v)
+    {
+        switch(v)
+        {
+        case ConnectedComponentsOptions::Connectivity::Four:    s << "Four";    break;
+        case ConnectedComponentsOptions::Connectivity::Eight:   s << "Eight";   break;
+        }
+        return s;
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "Config.hpp"
+#include "BinaryMask.hpp"
+#include "Rect.hpp"
+#include <vector>
+
+namespace rpiCam
+{
+    class ConnectedComponentsOptions
+    {
+    public:
+        enum class Connectivity : int
+        {
+            Four,
+            Eight
+        };
+
+        ConnectedComponentsOptions();
+
+        Connectivity connectivity;
+        std::uint32_t minArea;      // smaller components are dropped
+        std::size_t maxBlobs;       // the largest ones are kept when there are more
+    };
+
+    class Blob
+    {
+    public:
+        Blob();
+
+        Rect boundingBox;
+        std::uint32_t area;
+        Vec2f centroid;
+    };
+
+    class BlobList
+    {
+    public:
+        BlobList();
+
+        std::vector<Blob> blobs;        // by decreasing area, never more than maxBlobs
+        std::size_t numComponents;      // found in the mask, before the area filter and the cap
+        bool bTruncated;                // components at or above minArea were dropped by the cap
+    };
+
+    // Two pass labelling on runs: every row is turned into runs of set pixels,
+    // runs overlapping runs of the previous row are joined in a union-find
+    // forest, then the statistics of every run are added to its root. Work and
+    // memory follow the number of runs rather than the number of pixels, and
+    // the run buffers are kept between calls.
+    class ConnectedComponents
+    {
+    public:
+        ConnectedComponents(ConnectedComponentsOptions const &options = ConnectedComponentsOptions());
+        ~ConnectedComponents();
+
+        inline ConnectedComponentsOptions const& options() const { return m_Options; }
+        std::error_code setOptions(ConnectedComponentsOptions const &options);
+
+        std::error_code label(BinaryMask const &mask, BlobList &result);
+
+    private:
+        struct Run
+        {
+            std::uint32_t x0;
+            std::uint32_t x1;   // one past the last pixel
+            std::uint32_t y;
+            std::uint32_t parent;
+        };
+
+        struct Component
+        {
+            std::uint32_t area;
+            std::uint32_t x0, y0, x1, y1;
+            std::uint64_t sumX2;    // twice the sum of x, run sums are (x0 + x1 - 1) * length / 2
+            std::uint64_t sumY;
+        };
+
+        void extractRuns(BinaryMask const &mask, std::uint32_t y);
+        std::uint32_t find(std::uint32_t ri);
+        void join(std::uint32_t ra, std::uint32_t rb);
+
+    private:
+        ConnectedComponentsOptions m_Options;
+        std::vector<Run> m_Runs;
+        std::vector<std::uint32_t> m_RootComponent;
+        std::vector<Component> m_Components;
+    };
+
+    extern std::istream& operator>>(std::istream &s, ConnectedComponentsOptions::Connectivity &v);
+    extern std::ostream& operator<<(std::ostream &s, ConnectedComponentsOptions::Connectivity v);
+}
@@ -0,0 +1,108 @@
+#include "CroppedPixelSampleBuffer.hpp"
+
+namespace rpiCam
+{
+    CroppedPixelSampleBuffer::CroppedPixelSampleBuffer(std::shared_ptr<PixelSampleBuffer> const &parent, Rect const &region)
+        : PixelSampleBuffer()
+        , m_Parent(parent)
+        , m_Region()
+        , m_Descriptor(pixelFormatDescriptor(parent ? parent->format() : kPixelFormatInvalid))
+    {
+        if (!m_Parent)
+            return;
+
+        time = m_Parent->time;
+        sequence = m_Parent->sequence;
+        m_Region = region.aligned(Vec2ui(m_Descriptor.blockWidth, m_Descriptor.blockHeight), m_Parent->planeSize(0));
+    }
+
+    CroppedPixelSampleBuffer::~CroppedPixelSampleBuffer()
+    {
+    }
+
+    bool CroppedPixelSampleBuffer::isValid() const
+    {
+        return m_Parent && m_Parent->isValid() && !m_Region.isEmpty();
+    }
+
+    void* CroppedPixelSampleBuffer::data()
+    {
+        return isValid() ? m_Parent->data() : nullptr;
+    }
+
+    std::size_t CroppedPixelSampleBuffer::size() const
+    {
+        return isValid() ? m_Parent->size() : 0;
+    }
+
+    ePixelFormat CroppedPixelSampleBuffer::format() const
+    {
+        return isValid() ? m_Parent->format() : kPixelFormatInvalid;
+    }
+
+    std::size_t CroppedPixelSampleBuffer::planeCount() const
+    {
+        return isValid() ? m_Descriptor.planeCount : 0;
+    }
+
+    Vec2ui CroppedPixelSampleBuffer::planeSize(std::size_t pi) const
+    {
+        if (!isValid() || pi >= m_Descriptor.planeCount)
+            return Vec2ui(0,0);
+
+        return Vec2ui(
+            m_Region.size(0) >> m_Descriptor.widthShift[pi],
+            m_Region.size(1) >> m_Descriptor.heightShift[pi]
+        );
+    }
+
+    void* CroppedPixelSampleBuffer::planeData(std::size_t pi)
+    {
+        if (!isValid() || pi >= m_Descriptor.planeCount)
+            return nullptr;
+
+        std::uint8_t *data = static_cast<std::uint8_t*>(m_Parent->planeData(pi));
+        if (!data)
+            return nullptr;
+
+        return data +
+            (m_Region.origin(1) >> m_Descriptor.heightShift[pi]) * m_Parent->planeRowBytes(pi) +
+            (m_Region.origin(0) >> m_Descriptor.widthShift[pi]) * m_Descriptor.bytesPerPixel[pi];
+    }
+
+    std::size_t CroppedPixelSampleBuffer::planeRowBytes(std::size_t pi) const
+    {
+        if (!isValid() || pi >= m_Descriptor.planeCount)
+            return 0;
+
+        return m_Parent->planeRowBytes(pi);
+    }
+
+    std::error_code CroppedPixelSampleBuffer::lock()
+    {
+        if (!isValid())
+            return std::make_error_code(std::errc::no_lock_available);
+
+        return m_Parent->lock();
+    }
+
+    std::error_code CroppedPixelSampleBuffer::unlock()
+    {
+        if (!isValid())
+            return std::make_error_code(std::errc::no_lock_available);
+
+        return m_Parent->unlock();
+    }
+
+    std::shared_ptr<CroppedPixelSampleBuffer> cropPixelSampleBuffer(std::shared_ptr<PixelSampleBuffer> const &buffer, Rect const &region)
+    {
+        if (!buffer)
+            return std::shared_ptr<CroppedPixelSampleBuffer>();
+
+        std::shared_ptr<CroppedPixelSampleBuffer> cropped = std::make_shared<CroppedPixelSampleBuffer>(buffer, region);
+        if (!cropped->isValid())
+            return std::shared_ptr<CroppedPixelSampleBuffer>();
+
+        return cropped;
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Config.hpp"
+#include "PixelSampleBuffer.hpp"
+#include "Rect.hpp"
+
+namespace rpiCam
+{
+    // Zero-copy view of a region of another PixelSampleBuffer. It keeps the
+    // parent alive, locks it on lock() and only offsets its plane pointers, so
+    // kernels running on the view never touch the rest of the frame.
+    class CroppedPixelSampleBuffer
+        : public PixelSampleBuffer
+    {
+    public:
+        CroppedPixelSampleBuffer(std::shared_ptr<PixelSampleBuffer> const &parent, Rect const &region);
+        ~CroppedPixelSampleBuffer();
+
+        inline std::shared_ptr<PixelSampleBuffer> const& parent() const { return m_Parent; }
+
+        // region in parent coordinates, after rounding to whole chroma samples
+        inline Rect const& region() const { return m_Region; }
+
+        // Buffer overrides
+        bool isValid() const override;
+        void* data() override;
+        std::size_t size() const override;
+
+        // PixelBuffer overrides
+        ePixelFormat format() const override;
+        std::size_t planeCount() const override;
+        Vec2ui planeSize(std::size_t pi = 0) const override;
+        void* planeData(std::size_t pi = 0) override;
+        std::size_t planeRowBytes(std::size_t pi = 0) const override;
+
+        // SampleBuffer overrides
+        std::error_code lock() override;
+        std::error_code unlock() override;
+
+    private:
+        std::shared_ptr<PixelSampleBuffer> m_Parent;
+        Rect m_Region;
+        PixelFormatDescriptor m_Descriptor;
+    };
+
+    // Returns nullptr when the region does not overlap the buffer. The region
+    // grows outwards to the format's block size (2x2 for I420 and NV12, 2x1 for
+    // 4:2:2) so every plane starts on a whole sample.
+    std::shared_ptr<CroppedPixelSampleBuffer> cropPixelSampleBuffer(std::shared_ptr<PixelSampleBuffer> const &buffer, Rect const &region);
+}
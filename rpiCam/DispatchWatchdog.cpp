@@ -0,0 +1,146 @@
+#include "DispatchWatchdog.hpp"
+#include <algorithm>
+#include <cxxabi.h>
+#include <cstdlib>
+
+namespace rpiCam
+{
+    DispatchHistogram::DispatchHistogram()
+        : buckets()
+        , count(0)
+        , total(0)
+        , max(0)
+        , dropped(0)
+    {
+        buckets.fill(0);
+    }
+
+    void DispatchHistogram::add(Duration elapsed)
+    {
+        std::uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() >> 6;
+        std::size_t bucket = 0;
+        while (us && bucket < kBucketCount - 1)
+        {
+            us >>= 1;
+            bucket++;
+        }
+        buckets[bucket]++;
+        count++;
+        total += elapsed;
+        max = std::max(max, elapsed);
+    }
+
+    Duration DispatchHistogram::bucketUpperBound(std::size_t bucket)
+    {
+        if (bucket >= kBucketCount - 1)
+            return Duration::max();
+
+        return std::chrono::microseconds(64ull << bucket);
+    }
+
+    DispatchOverrun::DispatchOverrun()
+        : subscriber(nullptr)
+        , subscriberType()
+        , event()
+        , elapsed(0)
+        , deadline(0)
+        , histogram()
+        , demoted(false)
+    {
+    }
+
+    AsyncDispatchQueue::AsyncDispatchQueue()
+        : m_Mutex()
+        , m_Condition()
+        , m_Tasks()
+        , m_RunningOwner(nullptr)
+        , m_Thread()
+        , m_bStopping(false)
+        , m_DroppedTasks(0)
+    {
+    }
+
+    AsyncDispatchQueue::~AsyncDispatchQueue()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_bStopping = true;
+        }
+        m_Condition.notify_all();
+
+        if (m_Thread.joinable())
+            m_Thread.join();
+    }
+
+    bool AsyncDispatchQueue::post(void const *owner, EventKey const &event, Task &&task)
+    {
+        bool bQueued = true;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (m_bStopping)
+                return true;
+
+            if (!m_Thread.joinable())
+                m_Thread = std::thread(&AsyncDispatchQueue::run, this);
+
+            auto isSame = [owner, &event](Pending const &pending) { return pending.owner == owner && pending.event == event; };
+            if (std::size_t(std::count_if(m_Tasks.begin(), m_Tasks.end(), isSame)) >= kMaxPendingTasks)
+            {
+                m_Tasks.erase(std::find_if(m_Tasks.begin(), m_Tasks.end(), isSame));
+                m_DroppedTasks++;
+                bQueued = false;
+            }
+            m_Tasks.push_back(Pending{owner, event, std::move(task)});
+        }
+        m_Condition.notify_all();
+        return bQueued;
+    }
+
+    void AsyncDispatchQueue::purge(void const *owner)
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Tasks.erase(
+            std::remove_if(m_Tasks.begin(), m_Tasks.end(), [owner](Pending const &pending) { return pending.owner == owner; }),
+            m_Tasks.end()
+        );
+
+        if (std::this_thread::get_id() == m_Thread.get_id())
+            return;
+
+        m_Condition.wait(lock, [this, owner]() { return m_RunningOwner != owner; });
+    }
+
+    void AsyncDispatchQueue::run()
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        while (true)
+        {
+            m_Condition.wait(lock, [this]() { return m_bStopping || !m_Tasks.empty(); });
+            if (m_bStopping)
+                break;
+
+            Pending pending = std::move(m_Tasks.front());
+            m_Tasks.pop_front();
+            m_RunningOwner = pending.owner;
+
+            lock.unlock();
+            pending.task();
+            lock.lock();
+
+            m_RunningOwner = nullptr;
+            m_Condition.notify_all();
+        }
+    }
+
+    std::string demangledTypeName(std::type_info const &type)
+    {
+        int status = 0;
+        char *demangled = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+        if (!demangled)
+            return type.name();
+
+        std::string name(demangled);
+        std::free(demangled);
+        return name;
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "Config.hpp"
+#include <array>
+#include <deque>
+#include <functional>
+#include <string>
+#include <condition_variable>
+#include <typeinfo>
+
+namespace rpiCam
+{
+    // subscriber execution times in power-of-two buckets, the first one ending at 64us
+    class DispatchHistogram
+    {
+    public:
+        static constexpr std::size_t kBucketCount = 16;
+
+        DispatchHistogram();
+
+        void add(Duration elapsed);
+        static Duration bucketUpperBound(std::size_t bucket);
+
+        std::array<std::uint32_t, kBucketCount> buckets;
+        std::uint64_t count;
+        Duration total;
+        Duration max;
+        std::uint64_t dropped;      // deliveries dropped from a full asynchronous queue
+    };
+
+    class DispatchOverrun
+    {
+    public:
+        DispatchOverrun();
+
+        void const *subscriber;
+        std::string subscriberType;
+        std::string event;
+        Duration elapsed;
+        Duration deadline;
+        DispatchHistogram histogram;
+        bool demoted;
+    };
+
+    // Single worker thread delivering events to subscribers demoted from
+    // synchronous dispatch. Each subscriber keeps at most
+    // kMaxPendingTasks of one event, a newer one drops the oldest: queued
+    // frame buffers would otherwise pin the camera's buffer pool.
+    class AsyncDispatchQueue
+    {
+    public:
+        using Task = std::function<void()>;
+
+        // an event, the bytes of its member function pointer
+        using EventKey = std::array<unsigned char, sizeof(void (AsyncDispatchQueue::*)())>;
+
+        static constexpr std::size_t kMaxPendingTasks = 2;
+
+        AsyncDispatchQueue();
+        ~AsyncDispatchQueue();
+
+        // false when a pending task of owner and event was dropped to make room
+        bool post(void const *owner, EventKey const &event, Task &&task);
+        void purge(void const *owner);
+
+        inline std::uint64_t droppedTasks() const { return m_DroppedTasks; }
+
+    private:
+        struct Pending
+        {
+            void const *owner;
+            EventKey event;
+            Task task;
+        };
+
+        void run();
+
+    private:
+        std::mutex m_Mutex;
+        std::condition_variable m_Condition;
+        std::deque<Pending> m_Tasks;
+        void const *m_RunningOwner;
+        std::thread m_Thread;
+        bool m_bStopping;
+        std::atomic<std::uint64_t> m_DroppedTasks;
+    };
+
+    std::string demangledTypeName(std::type_info const &type);
+}
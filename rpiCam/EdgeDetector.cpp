@@ -0,0 +1,590 @@
+#include "EdgeDetector.hpp"
+#include "Simd.hpp"
+#include "Logging.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace rpiCam
+{
+    namespace
+    {
+        // tan(22.5 degrees) in Q15, tan(67.5 degrees) is that plus two
+        static constexpr std::int32_t kTan22Q15 = 13573;
+
+        // atan(t) for t in [0, 1] as t * (c0 + c1 * (1 - t)), in 1/256 turns
+        static constexpr float kAtanC0 = 32.0f;
+        static constexpr float kAtanC1 = 11.12f;
+
+        enum : std::uint8_t
+        {
+            kSuppressed = 0,
+            kWeak = 1,
+            kEdge = 2,
+            kStrong = 3     // weak and strong both have the low bit set, tracing turns them into edges
+        };
+
+        // smoothing weights across the derivative, sides and center
+        struct Kernel
+        {
+            std::int16_t side;
+            std::int16_t center;
+        };
+
+        inline Kernel kernelOf(EdgeDetectorOptions::Operator op)
+        {
+            return op == EdgeDetectorOptions::Operator::Scharr ? Kernel{3, 10} : Kernel{1, 2};
+        }
+
+        // vertical smoothing and derivative of three rows into s and d, which have one pixel of padding on both sides
+        void verticalRow(std::uint8_t const *r0, std::uint8_t const *r1, std::uint8_t const *r2,
+            std::int16_t *s, std::int16_t *d, std::uint32_t width, Kernel kernel, bool bSimd)
+        {
+            std::uint32_t x = 0;
+#if defined(RPI_CAM_SIMD_NEON)
+            if (bSimd)
+            {
+                for (; x + 8 <= width; x += 8)
+                {
+                    uint16x8_t const a = vmovl_u8(vld1_u8(r0 + x));
+                    uint16x8_t const b = vmovl_u8(vld1_u8(r1 + x));
+                    uint16x8_t const c = vmovl_u8(vld1_u8(r2 + x));
+                    uint16x8_t const sv = vmlaq_n_u16(vmulq_n_u16(vaddq_u16(a, c), std::uint16_t(kernel.side)), b, std::uint16_t(kernel.center));
+                    vst1q_s16(s + 1 + x, vreinterpretq_s16_u16(sv));
+                    vst1q_s16(d + 1 + x, vreinterpretq_s16_u16(vsubq_u16(c, a)));
+                }
+            }
+#elif defined(RPI_CAM_SIMD_SSE2)
+            if (bSimd)
+            {
+                __m128i const zero = _mm_setzero_si128();
+                __m128i const side = _mm_set1_epi16(kernel.side);
+                __m128i const center = _mm_set1_epi16(kernel.center);
+                for (; x + 8 <= width; x += 8)
+                {
+                    __m128i const a = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(r0 + x)), zero);
+                    __m128i const b = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(r1 + x)), zero);
+                    __m128i const c = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(r2 + x)), zero);
+                    __m128i const sv = _mm_add_epi16(_mm_mullo_epi16(_mm_add_epi16(a, c), side), _mm_mullo_epi16(b, center));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(s + 1 + x), sv);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 1 + x), _mm_sub_epi16(c, a));
+                }
+            }
+#endif
+            for (; x < width; ++x)
+            {
+                s[1 + x] = std::int16_t((r0[x] + r2[x]) * kernel.side + r1[x] * kernel.center);
+                d[1 + x] = std::int16_t(r2[x] - r0[x]);
+            }
+
+            s[0] = s[1];
+            s[width + 1] = s[width];
+            d[0] = d[1];
+            d[width + 1] = d[width];
+        }
+
+        // horizontal derivative of s and smoothing of d, then |gx| + |gy|
+        void horizontalRow(std::int16_t const *s, std::int16_t const *d, std::int16_t *gx, std::int16_t *gy, std::uint16_t *magnitude,
+            std::uint32_t width, Kernel kernel, bool bSimd)
+        {
+            std::uint32_t x = 0;
+#if defined(RPI_CAM_SIMD_NEON)
+            if (bSimd)
+            {
+                for (; x + 8 <= width; x += 8)
+                {
+                    int16x8_t const gxv = vsubq_s16(vld1q_s16(s + x + 2), vld1q_s16(s + x));
+                    int16x8_t const gyv = vmlaq_n_s16(vmulq_n_s16(vaddq_s16(vld1q_s16(d + x), vld1q_s16(d + x + 2)), kernel.side), vld1q_s16(d + x + 1), kernel.center);
+                    vst1q_s16(gx + x, gxv);
+                    vst1q_s16(gy + x, gyv);
+                    vst1q_u16(magnitude + x, vreinterpretq_u16_s16(vaddq_s16(vabsq_s16(gxv), vabsq_s16(gyv))));
+                }
+            }
+#elif defined(RPI_CAM_SIMD_SSE2)
+            if (bSimd)
+            {
+                __m128i const zero = _mm_setzero_si128();
+                __m128i const side = _mm_set1_epi16(kernel.side);
+                __m128i const center = _mm_set1_epi16(kernel.center);
+                for (; x + 8 <= width; x += 8)
+                {
+                    __m128i const gxv = _mm_sub_epi16(
+                        _mm_loadu_si128(reinterpret_cast<__m128i const*>(s + x + 2)),
+                        _mm_loadu_si128(reinterpret_cast<__m128i const*>(s + x)));
+                    __m128i const gyv = _mm_add_epi16(
+                        _mm_mullo_epi16(_mm_add_epi16(
+                            _mm_loadu_si128(reinterpret_cast<__m128i const*>(d + x)),
+                            _mm_loadu_si128(reinterpret_cast<__m128i const*>(d + x + 2))), side),
+                        _mm_mullo_epi16(_mm_loadu_si128(reinterpret_cast<__m128i const*>(d + x + 1)), center));
+                    __m128i const ax = _mm_max_epi16(gxv, _mm_sub_epi16(zero, gxv));
+                    __m128i const ay = _mm_max_epi16(gyv, _mm_sub_epi16(zero, gyv));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(gx + x), gxv);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(gy + x), gyv);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(magnitude + x), _mm_add_epi16(ax, ay));
+                }
+            }
+#endif
+            for (; x < width; ++x)
+            {
+                gx[x] = std::int16_t(s[x + 2] - s[x]);
+                gy[x] = std::int16_t((d[x] + d[x + 2]) * kernel.side + d[x + 1] * kernel.center);
+                magnitude[x] = std::uint16_t(std::abs(gx[x]) + std::abs(gy[x]));
+            }
+        }
+
+        // first octant from the ratio of the smaller to the larger component, then mirrored into place
+        void orientationRow(std::int16_t const *gx, std::int16_t const *gy, std::uint8_t *orientation, std::uint32_t width, bool bSimd)
+        {
+            std::uint32_t x = 0;
+#if defined(RPI_CAM_SIMD_NEON)
+            if (bSimd)
+            {
+                float32x4_t const zero = vdupq_n_f32(0.0f);
+                float32x4_t const one = vdupq_n_f32(1.0f);
+                auto angles = [&](int16x4_t vx, int16x4_t vy)
+                {
+                    float32x4_t const fx = vcvtq_f32_s32(vmovl_s16(vx));
+                    float32x4_t const fy = vcvtq_f32_s32(vmovl_s16(vy));
+                    float32x4_t const ax = vabsq_f32(fx), ay = vabsq_f32(fy);
+                    float32x4_t const mx = vmaxq_f32(vmaxq_f32(ax, ay), one);
+                    // no divide on ARMv7, the refined reciprocal estimate is good to a few ulp
+                    float32x4_t r = vrecpeq_f32(mx);
+                    r = vmulq_f32(vrecpsq_f32(mx, r), r);
+                    r = vmulq_f32(vrecpsq_f32(mx, r), r);
+                    float32x4_t const t = vmulq_f32(vminq_f32(ax, ay), r);
+                    float32x4_t a = vmulq_f32(t, vmlaq_f32(vdupq_n_f32(kAtanC0), vdupq_n_f32(kAtanC1), vsubq_f32(one, t)));
+                    a = vbslq_f32(vcgtq_f32(ay, ax), vsubq_f32(vdupq_n_f32(64.0f), a), a);
+                    a = vbslq_f32(vcltq_f32(fx, zero), vsubq_f32(vdupq_n_f32(128.0f), a), a);
+                    a = vbslq_f32(vcltq_f32(fy, zero), vsubq_f32(vdupq_n_f32(256.0f), a), a);
+                    return vmovn_s32(vcvtq_s32_f32(vaddq_f32(a, vdupq_n_f32(0.5f))));
+                };
+                for (; x + 8 <= width; x += 8)
+                {
+                    int16x8_t const vx = vld1q_s16(gx + x), vy = vld1q_s16(gy + x);
+                    int16x8_t const a = vcombine_s16(angles(vget_low_s16(vx), vget_low_s16(vy)), angles(vget_high_s16(vx), vget_high_s16(vy)));
+                    // 256 is a full turn and wraps to 0
+                    vst1_u8(orientation + x, vmovn_u16(vandq_u16(vreinterpretq_u16_s16(a), vdupq_n_u16(255))));
+                }
+            }
+#elif defined(RPI_CAM_SIMD_SSE2)
+            if (bSimd)
+            {
+                __m128 const zero = _mm_setzero_ps();
+                __m128 const one = _mm_set1_ps(1.0f);
+                __m128 const absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+                auto select = [](__m128 mask, __m128 a, __m128 b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); };
+                auto angles = [&](__m128i vx, __m128i vy)
+                {
+                    __m128 const fx = _mm_cvtepi32_ps(vx);
+                    __m128 const fy = _mm_cvtepi32_ps(vy);
+                    __m128 const ax = _mm_and_ps(fx, absMask), ay = _mm_and_ps(fy, absMask);
+                    __m128 const t = _mm_div_ps(_mm_min_ps(ax, ay), _mm_max_ps(_mm_max_ps(ax, ay), one));
+                    __m128 a = _mm_mul_ps(t, _mm_add_ps(_mm_set1_ps(kAtanC0), _mm_mul_ps(_mm_set1_ps(kAtanC1), _mm_sub_ps(one, t))));
+                    a = select(_mm_cmpgt_ps(ay, ax), _mm_sub_ps(_mm_set1_ps(64.0f), a), a);
+                    a = select(_mm_cmplt_ps(fx, zero), _mm_sub_ps(_mm_set1_ps(128.0f), a), a);
+                    a = select(_mm_cmplt_ps(fy, zero), _mm_sub_ps(_mm_set1_ps(256.0f), a), a);
+                    return _mm_cvttps_epi32(_mm_add_ps(a, _mm_set1_ps(0.5f)));
+                };
+                for (; x + 8 <= width; x += 8)
+                {
+                    __m128i const vx = _mm_loadu_si128(reinterpret_cast<__m128i const*>(gx + x));
+                    __m128i const vy = _mm_loadu_si128(reinterpret_cast<__m128i const*>(gy + x));
+                    // sign extended halves
+                    __m128i const lo = angles(_mm_srai_epi32(_mm_unpacklo_epi16(vx, vx), 16), _mm_srai_epi32(_mm_unpacklo_epi16(vy, vy), 16));
+                    __m128i const hi = angles(_mm_srai_epi32(_mm_unpackhi_epi16(vx, vx), 16), _mm_srai_epi32(_mm_unpackhi_epi16(vy, vy), 16));
+                    __m128i const a = _mm_and_si128(_mm_packs_epi32(lo, hi), _mm_set1_epi16(255));
+                    _mm_storel_epi64(reinterpret_cast<__m128i*>(orientation + x), _mm_packus_epi16(a, a));
+                }
+            }
+#endif
+            for (; x < width; ++x)
+            {
+                float const fx = float(gx[x]), fy = float(gy[x]);
+                float const ax = std::fabs(fx), ay = std::fabs(fy);
+                float const t = std::min(ax, ay) / std::max(std::max(ax, ay), 1.0f);
+                float a = t * (kAtanC0 + kAtanC1 * (1.0f - t));
+                if (ay > ax)
+                    a = 64.0f - a;
+                if (fx < 0.0f)
+                    a = 128.0f - a;
+                if (fy < 0.0f)
+                    a = 256.0f - a;
+                orientation[x] = std::uint8_t(std::int32_t(a + 0.5f) & 255);
+            }
+        }
+
+        // index of the first of count pixels from x above low, count when there is none
+        inline std::uint32_t skipBelow(std::uint16_t const *magnitude, std::uint32_t x, std::uint32_t count, std::uint16_t low, bool bSimd)
+        {
+#if defined(RPI_CAM_SIMD_NEON)
+            if (bSimd)
+            {
+                uint16x8_t const lowv = vdupq_n_u16(low);
+                for (; x + 8 <= count; x += 8)
+                {
+                    uint16x8_t const above = vcgtq_u16(vld1q_u16(magnitude + x), lowv);
+                    uint32x2_t const any = vreinterpret_u32_u16(vorr_u16(vget_low_u16(above), vget_high_u16(above)));
+                    if (vget_lane_u32(vorr_u32(any, vrev64_u32(any)), 0))
+                        break;
+                }
+            }
+#elif defined(RPI_CAM_SIMD_SSE2)
+            if (bSimd)
+            {
+                // magnitudes stay below 32768, so a low threshold there only skips nothing
+                __m128i const lowv = _mm_set1_epi16(std::int16_t(low));
+                for (; x + 8 <= count; x += 8)
+                {
+                    if (_mm_movemask_epi8(_mm_cmpgt_epi16(_mm_loadu_si128(reinterpret_cast<__m128i const*>(magnitude + x)), lowv)))
+                        break;
+                }
+            }
+#else
+            (void)bSimd;
+#endif
+            while (x < count && magnitude[x] <= low)
+                ++x;
+            return x;
+        }
+
+        // promotes weak and strong pixels connected to the stacked ones, only between lo and hi
+        void trace(std::uint8_t *classes, std::ptrdiff_t stride, std::vector<std::uint32_t> &stack, std::size_t lo, std::size_t hi)
+        {
+            std::ptrdiff_t const neighbours[8] = { -stride - 1, -stride, -stride + 1, -1, 1, stride - 1, stride, stride + 1 };
+            while (!stack.empty())
+            {
+                std::uint32_t const i = stack.back();
+                stack.pop_back();
+                for (std::ptrdiff_t offset : neighbours)
+                {
+                    std::size_t const n = std::size_t(std::ptrdiff_t(i) + offset);
+                    if (n >= lo && n < hi && (classes[n] & kWeak))
+                    {
+                        classes[n] = kEdge;
+                        stack.push_back(std::uint32_t(n));
+                    }
+                }
+            }
+        }
+    }
+
+    EdgeDetectorOptions::EdgeDetectorOptions()
+        : gradientOperator(Operator::Sobel)
+        , lowThreshold(50)
+        , highThreshold(150)
+        , bOrientation(false)
+        , maskFormat(BinaryMask::Format::Bytes)
+        , stripHeight(32)
+    {
+    }
+
+    EdgeDetector::EdgeDetector(EdgeDetectorOptions const &options, std::shared_ptr<ThreadPool> pool)
+        : m_Options(isValid(options) ? options : EdgeDetectorOptions())
+        , m_Pool(pool)
+        , m_bSimdEnabled(true)
+        , m_Size(0, 0)
+        , m_GradientX()
+        , m_GradientY()
+        , m_Magnitude()
+        , m_Orientation()
+        , m_Classes()
+        , m_Stack()
+    {
+        if (!isValid(options))
+            RPI_LOG(WARNING, "EdgeDetector::EdgeDetector(): invalid options, using defaults!");
+    }
+
+    EdgeDetector::~EdgeDetector()
+    {
+    }
+
+    std::error_code EdgeDetector::setOptions(EdgeDetectorOptions const &options)
+    {
+        if (!isValid(options))
+        {
+            RPI_LOG(ERROR, "EdgeDetector::setOptions(): invalid options!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+        m_Options = options;
+        return std::error_code();
+    }
+
+    std::error_code EdgeDetector::computeGradients(PixelBuffer &buffer, std::size_t pi)
+    {
+        if (pi >= buffer.planeCount() || pixelFormatDescriptor(buffer.format()).bytesPerPixel[pi] != 1)
+        {
+            RPI_LOG(ERROR, "EdgeDetector::computeGradients(): plane is not one byte per pixel!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        std::uint8_t const *data = static_cast<std::uint8_t const*>(buffer.planeData(pi));
+        if (!data)
+        {
+            RPI_LOG(ERROR, "EdgeDetector::computeGradients(): buffer not locked!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        Vec2ui const size = buffer.planeSize(pi);
+        if (size(0) == 0 || size(1) == 0)
+        {
+            RPI_LOG(ERROR, "EdgeDetector::computeGradients(): empty plane!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        if (size != m_Size)
+        {
+            m_Size = size;
+            m_GradientX.resize(size.prod());
+            m_GradientY.resize(size.prod());
+            // the border of zeros is never written after this
+            m_Magnitude.assign((size(0) + 2) * (size(1) + 2), 0);
+            m_Classes.assign((size(0) + 2) * (size(1) + 2), kSuppressed);
+        }
+        m_Orientation.resize(m_Options.bOrientation ? size.prod() : 0);
+
+        std::size_t const rowBytes = buffer.planeRowBytes(pi);
+        forEachStrip([this, data, rowBytes](std::size_t begin, std::size_t end)
+        {
+            gradientRows(data, rowBytes, std::uint32_t(begin), std::uint32_t(end));
+        });
+        return std::error_code();
+    }
+
+    std::error_code EdgeDetector::detect(PixelBuffer &buffer, BinaryMask &edges, std::size_t pi)
+    {
+        if (std::error_code cge = computeGradients(buffer, pi))
+            return cge;
+
+        forEachStrip([this](std::size_t begin, std::size_t end)
+        {
+            suppressRows(std::uint32_t(begin), std::uint32_t(end));
+            traceRows(std::uint32_t(begin), std::uint32_t(end));
+        });
+        traceAcrossStrips();
+
+        edges.reset(m_Options.maskFormat, m_Size);
+        forEachStrip([this, &edges](std::size_t begin, std::size_t end)
+        {
+            writeRows(edges, std::uint32_t(begin), std::uint32_t(end));
+        });
+        return std::error_code();
+    }
+
+    bool EdgeDetector::isValid(EdgeDetectorOptions const &options)
+    {
+        return options.lowThreshold <= options.highThreshold &&
+            options.stripHeight > 0;
+    }
+
+    void EdgeDetector::forEachStrip(ThreadPool::RangeTask const &task)
+    {
+        std::size_t const stripHeight = m_Options.stripHeight;
+        std::size_t const numStrips = (m_Size(1) + stripHeight - 1) / stripHeight;
+
+        // always the same strips, traceAcrossStrips() relies on their boundaries
+        auto runStrips = [&](std::size_t begin, std::size_t end)
+        {
+            for (std::size_t is = begin; is < end; ++is)
+                task(is * stripHeight, std::min<std::size_t>(m_Size(1), (is + 1) * stripHeight));
+        };
+
+        if (m_Pool && m_Pool->size() > 0 && numStrips > 1)
+            m_Pool->parallelFor(0, numStrips, 1, runStrips);
+        else
+            runStrips(0, numStrips);
+    }
+
+    void EdgeDetector::gradientRows(std::uint8_t const *data, std::size_t rowBytes, std::uint32_t begin, std::uint32_t end)
+    {
+        std::uint32_t const width = m_Size(0);
+        std::uint32_t const height = m_Size(1);
+        std::size_t const stride = width + 2;
+        Kernel const kernel = kernelOf(m_Options.gradientOperator);
+        bool const bSimd = m_bSimdEnabled;
+
+        // per strip, so tasks share nothing they write
+        std::vector<std::int16_t> smoothed(stride), derivative(stride);
+        for (std::uint32_t y = begin; y < end; ++y)
+        {
+            std::uint8_t const *r0 = data + (y > 0 ? y - 1 : 0) * rowBytes;
+            std::uint8_t const *r1 = data + y * rowBytes;
+            std::uint8_t const *r2 = data + (y + 1 < height ? y + 1 : y) * rowBytes;
+            verticalRow(r0, r1, r2, smoothed.data(), derivative.data(), width, kernel, bSimd);
+
+            std::int16_t *gx = m_GradientX.data() + y * width;
+            std::int16_t *gy = m_GradientY.data() + y * width;
+            horizontalRow(smoothed.data(), derivative.data(), gx, gy, m_Magnitude.data() + (y + 1) * stride + 1, width, kernel, bSimd);
+
+            if (m_Options.bOrientation)
+                orientationRow(gx, gy, m_Orientation.data() + y * width, width, bSimd);
+        }
+    }
+
+    void EdgeDetector::suppressRows(std::uint32_t begin, std::uint32_t end)
+    {
+        std::uint32_t const width = m_Size(0);
+        std::ptrdiff_t const stride = std::ptrdiff_t(width) + 2;
+        std::uint16_t const low = m_Options.lowThreshold;
+        std::uint16_t const high = m_Options.highThreshold;
+        bool const bSimd = m_bSimdEnabled;
+
+        for (std::uint32_t y = begin; y < end; ++y)
+        {
+            std::int16_t const *gx = m_GradientX.data() + y * width;
+            std::int16_t const *gy = m_GradientY.data() + y * width;
+            std::uint16_t const *magnitude = m_Magnitude.data() + (y + 1) * stride + 1;
+            std::uint8_t *classes = m_Classes.data() + (y + 1) * stride + 1;
+
+            std::uint32_t x = 0;
+            while (x < width)
+            {
+                // most of a frame is flat, those pixels are cleared in bulk
+                std::uint32_t const next = skipBelow(magnitude, x, width, low, bSimd);
+                std::fill(classes + x, classes + next, kSuppressed);
+                if ((x = next) >= width)
+                    break;
+
+                // neighbours across the edge, one of four directions
+                std::int32_t const ax = std::abs(gx[x]), ay = std::abs(gy[x]);
+                std::int32_t const tg22x = ax * kTan22Q15;
+                std::int32_t const yq = ay << 15;
+                std::ptrdiff_t offset;
+                if (yq < tg22x)
+                    offset = 1;
+                else if (yq > tg22x + (ax << 16))
+                    offset = stride;
+                else
+                    offset = (gx[x] ^ gy[x]) < 0 ? stride - 1 : stride + 1;
+
+                std::uint16_t const m = magnitude[x];
+                if (m > magnitude[std::ptrdiff_t(x) - offset] && m >= magnitude[std::ptrdiff_t(x) + offset])
+                    classes[x] = m > high ? kStrong : kWeak;
+                else
+                    classes[x] = kSuppressed;
+                ++x;
+            }
+        }
+    }
+
+    void EdgeDetector::traceRows(std::uint32_t begin, std::uint32_t end)
+    {
+        std::size_t const stride = m_Size(0) + 2;
+        std::size_t const lo = (begin + 1) * stride, hi = (end + 1) * stride;
+        std::uint8_t *classes = m_Classes.data();
+
+        std::vector<std::uint32_t> stack;
+        for (std::size_t i = lo; i < hi; ++i)
+        {
+            if (classes[i] != kStrong)
+                continue;
+            classes[i] = kEdge;
+            stack.push_back(std::uint32_t(i));
+            trace(classes, std::ptrdiff_t(stride), stack, lo, hi);
+        }
+    }
+
+    void EdgeDetector::traceAcrossStrips()
+    {
+        std::uint32_t const width = m_Size(0);
+        std::size_t const stride = width + 2;
+        std::uint8_t *classes = m_Classes.data();
+
+        // every strip is traced, so weak pixels left next to an edge are on the other side of a boundary
+        m_Stack.clear();
+        for (std::uint32_t boundary = m_Options.stripHeight; boundary < m_Size(1); boundary += m_Options.stripHeight)
+        {
+            std::uint8_t *above = classes + boundary * stride + 1;
+            std::uint8_t *below = above + stride;
+            for (std::uint32_t x = 0; x < width; ++x)
+            {
+                for (std::ptrdiff_t dx = -1; dx <= 1; ++dx)
+                {
+                    if (above[x] == kEdge && below[x + dx] == kWeak)
+                    {
+                        below[x + dx] = kEdge;
+                        m_Stack.push_back(std::uint32_t(&below[x + dx] - classes));
+                    }
+                    if (below[x] == kEdge && above[x + dx] == kWeak)
+                    {
+                        above[x + dx] = kEdge;
+                        m_Stack.push_back(std::uint32_t(&above[x + dx] - classes));
+                    }
+                }
+            }
+        }
+        trace(classes, std::ptrdiff_t(stride), m_Stack, stride, (m_Size(1) + 1) * stride);
+    }
+
+    void EdgeDetector::writeRows(BinaryMask &edges, std::uint32_t begin, std::uint32_t end)
+    {
+        std::uint32_t const width = m_Size(0);
+        std::size_t const stride = width + 2;
+        bool const bSimd = m_bSimdEnabled;
+
+        for (std::uint32_t y = begin; y < end; ++y)
+        {
+            std::uint8_t const *classes = m_Classes.data() + (y + 1) * stride + 1;
+            std::uint8_t *out = edges.row(y);
+
+            if (edges.format() == BinaryMask::Format::Bits)
+            {
+                for (std::uint32_t xb = 0; xb < width; xb += 8)
+                {
+                    std::uint8_t bits = 0;
+                    for (std::uint32_t b = 0; b < 8 && xb + b < width; ++b)
+                        bits |= std::uint8_t((classes[xb + b] == kEdge) << b);
+                    out[xb >> 3] = bits;
+                }
+                continue;
+            }
+
+            std::uint32_t x = 0;
+#if defined(RPI_CAM_SIMD_NEON)
+            if (bSimd)
+            {
+                for (; x + 16 <= width; x += 16)
+                    vst1q_u8(out + x, vceqq_u8(vld1q_u8(classes + x), vdupq_n_u8(kEdge)));
+            }
+#elif defined(RPI_CAM_SIMD_SSE2)
+            if (bSimd)
+            {
+                for (; x + 16 <= width; x += 16)
+                {
+                    __m128i const c = _mm_loadu_si128(reinterpret_cast<__m128i const*>(classes + x));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_cmpeq_epi8(c, _mm_set1_epi8(kEdge)));
+                }
+            }
+#else
+            (void)bSimd;
+#endif
+            for (; x < width; ++x)
+                out[x] = classes[x] == kEdge ? 255 : 0;
+        }
+    }
+
+    std::istream& operator>>(std::istream &s, EdgeDetectorOptions::Operator &v)
+    {
+        std::string sv;
+        s >> sv;
+        if (sv == "Sobel")
+            v = EdgeDetectorOptions::Operator::Sobel;
+        else if (sv == "Scharr")
+            v = EdgeDetectorOptions::Operator::Scharr;
+        else
+            throw std::invalid_argument("Invalid value for EdgeDetectorOptions::Operator: " + sv);
+        return s;
+    }
+
+    std::ostream& operator<<(std::ostream &s, EdgeDetectorOptions::Operator v)
+    {
+        switch(v)
+        {
+        case EdgeDetectorOptions::Operator::Sobel:  s << "Sobel";   break;
+        case EdgeDetectorOptions::Operator::Scharr: s << "Scharr";  break;
+        }
+        return s;
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Config.hpp"
+#include "PixelBuffer.hpp"
+#include "BinaryMask.hpp"
+#include "ThreadPool.hpp"
+#include <vector>
+#include <system_error>
+
+namespace rpiCam
+{
+    class EdgeDetectorOptions
+    {
+    public:
+        enum class Operator : int
+        {
+            Sobel,
+            Scharr
+        };
+
+        EdgeDetectorOptions();
+
+        Operator gradientOperator;
+        std::uint16_t lowThreshold;     // on |gx| + |gy|, Scharr gradients are four times the Sobel ones
+        std::uint16_t highThreshold;    // edges start above it and are extended through pixels above lowThreshold
+        bool bOrientation;              // fill orientation() as well
+        BinaryMask::Format maskFormat;
+        std::uint32_t stripHeight;      // rows per task when a thread pool is used
+    };
+
+    // Sobel or Scharr gradients of a one byte per pixel plane and Canny edges
+    // on top of them. Gradients are integer and exact in 16 bits, the
+    // magnitude is |gx| + |gy|. Every pass runs over strips of rows, in
+    // parallel when there is a thread pool: gradients, non-maximum
+    // suppression, hysteresis inside each strip, then a short serial pass
+    // that carries edges across strip boundaries. Edges are replicated.
+    class EdgeDetector
+    {
+    public:
+        EdgeDetector(EdgeDetectorOptions const &options = EdgeDetectorOptions(), std::shared_ptr<ThreadPool> pool = nullptr);
+        ~EdgeDetector();
+
+        inline EdgeDetectorOptions const& options() const { return m_Options; }
+        std::error_code setOptions(EdgeDetectorOptions const &options);
+
+        inline bool isSimdEnabled() const { return m_bSimdEnabled; }
+        inline void setSimdEnabled(bool bEnabled) { m_bSimdEnabled = bEnabled; }
+
+        // plane pi of a locked buffer, usually the Y plane
+        std::error_code computeGradients(PixelBuffer &buffer, std::size_t pi = 0);
+
+        // computeGradients() followed by Canny, edges gets the size of the plane
+        std::error_code detect(PixelBuffer &buffer, BinaryMask &edges, std::size_t pi = 0);
+
+        // rows of the last computed gradients, x grows to the right and y down
+        inline Vec2ui const& size() const { return m_Size; }
+        inline std::int16_t const* gradientX(std::uint32_t y) const { return m_GradientX.data() + y * m_Size(0); }
+        inline std::int16_t const* gradientY(std::uint32_t y) const { return m_GradientY.data() + y * m_Size(0); }
+        inline std::uint16_t const* magnitude(std::uint32_t y) const { return m_Magnitude.data() + (y + 1) * (m_Size(0) + 2) + 1; }
+
+        // 256 steps per turn, 0 along +x and 64 along +y, within one step of
+        // the exact angle, only with options().bOrientation
+        inline std::uint8_t const* orientation(std::uint32_t y) const { return m_Orientation.data() + y * m_Size(0); }
+
+    private:
+        static bool isValid(EdgeDetectorOptions const &options);
+
+        void forEachStrip(ThreadPool::RangeTask const &task);
+
+        void gradientRows(std::uint8_t const *data, std::size_t rowBytes, std::uint32_t begin, std::uint32_t end);
+        void suppressRows(std::uint32_t begin, std::uint32_t end);
+        void traceRows(std::uint32_t begin, std::uint32_t end);
+        void traceAcrossStrips();
+        void writeRows(BinaryMask &edges, std::uint32_t begin, std::uint32_t end);
+
+    private:
+        EdgeDetectorOptions m_Options;
+        std::shared_ptr<ThreadPool> m_Pool;
+        bool m_bSimdEnabled;
+        Vec2ui m_Size;
+        std::vector<std::int16_t> m_GradientX;
+        std::vector<std::int16_t> m_GradientY;
+        std::vector<std::uint16_t> m_Magnitude;     // with a border of zeros
+        std::vector<std::uint8_t> m_Orientation;
+        std::vector<std::uint8_t> m_Classes;        // suppressed, weak and strong pixels, with a border of zeros
+        std::vector<std::uint32_t> m_Stack;
+    };
+
+    extern std::istream& operator>>(std::istream &s, EdgeDetectorOptions::Operator &v);
+    extern std::ostream& operator<<(std::ostream &s, EdgeDetectorOptions::Operator v);
+}
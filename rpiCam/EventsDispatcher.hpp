@@ -1,6 +1,11 @@
 #pragma once
 
 #include "Config.hpp"
+#include "Logging.hpp"
+#include "DispatchWatchdog.hpp"
+#include <cstring>
+#include <map>
+#include <vector>
 
 namespace rpiCam
 {
@@ -11,11 +16,27 @@ namespace rpiCam
         using ThisType = EventsDispatcher<Events>;
         using Subscriber = Events*;
         using SubscriberList = std::list<Subscriber>;
+        using EventKey = AsyncDispatchQueue::EventKey;
+
+        struct Deadline
+        {
+            EventKey event;
+            std::string name;
+            Duration deadline;
+            bool demoteToAsync;
+        };
 
     public:
+        using OverrunHandler = std::function<void(DispatchOverrun const &overrun)>;
+
         EventsDispatcher()
           : m_Mutex()
           , m_Subscribers()
+          , m_Deadlines()
+          , m_Histograms()
+          , m_AsyncSubscribers()
+          , m_OverrunHandler()
+          , m_AsyncQueue()
         {
 
         }
@@ -34,22 +55,187 @@ namespace rpiCam
           const_cast<ThisType*>(this)->remove(subscriber);
         }
 
+        // time every subscriber of event and report the ones running longer than deadline
+        template <typename Event>
+        void setDeadline(Event event, Duration deadline, bool demoteToAsync = false, std::string const &name = std::string()) const
+        {
+          std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+          EventKey key = eventKey(event);
+          auto itDeadline = findDeadline(key);
+          if (itDeadline != m_Deadlines.end())
+          {
+            itDeadline->deadline = deadline;
+            itDeadline->demoteToAsync = demoteToAsync;
+            itDeadline->name = name;
+          }
+          else
+            m_Deadlines.push_back(Deadline{key, name, deadline, demoteToAsync});
+        }
+
+        template <typename Event>
+        void clearDeadline(Event event) const
+        {
+          std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+          auto itDeadline = findDeadline(eventKey(event));
+          if (itDeadline != m_Deadlines.end())
+            m_Deadlines.erase(itDeadline);
+        }
+
+        template <typename Event>
+        DispatchHistogram histogram(Subscriber subscriber, Event event) const
+        {
+          std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+          auto itHistogram = m_Histograms.find(std::make_pair(subscriber, eventKey(event)));
+          if (itHistogram == m_Histograms.end())
+            return DispatchHistogram();
+          return itHistogram->second;
+        }
+
+        bool isDemoted(Subscriber subscriber) const
+        {
+          std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+          return std::find(m_AsyncSubscribers.begin(), m_AsyncSubscribers.end(), subscriber) != m_AsyncSubscribers.end();
+        }
+
+        // move a demoted subscriber back to synchronous delivery
+        void promote(Subscriber subscriber) const
+        {
+          {
+            std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+            m_AsyncSubscribers.remove(subscriber);
+          }
+          m_AsyncQueue.purge(subscriber);
+        }
+
+        void setOverrunHandler(OverrunHandler handler) const
+        {
+          std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+          m_OverrunHandler = handler;
+        }
+
         template <typename Event, typename ...Args>
         void dispatch(Event event, Args &&... args)
         {
           SubscriberList subscribers;
+          SubscriberList asyncSubscribers;
+          Deadline deadline;
+          bool hasDeadline = false;
           {
             std::lock_guard<std::recursive_mutex> lock(m_Mutex);
             subscribers = m_Subscribers;
+
+            if (!m_Deadlines.empty())
+            {
+              auto itDeadline = findDeadline(eventKey(event));
+              if (itDeadline != m_Deadlines.end())
+              {
+                deadline = *itDeadline;
+                hasDeadline = true;
+              }
+            }
+            asyncSubscribers = m_AsyncSubscribers;
+          }
+
+          if (!hasDeadline && asyncSubscribers.empty())
+          {
+            for(auto subscriber : subscribers)
+            {
+              (subscriber->*event)(args...);
+            };
+            return;
           }
 
+          std::vector<DispatchOverrun> overruns;
           for(auto subscriber : subscribers)
           {
+            if (std::find(asyncSubscribers.begin(), asyncSubscribers.end(), subscriber) != asyncSubscribers.end())
+            {
+              EventKey const key = eventKey(event);
+              if (!m_AsyncQueue.post(subscriber, key,
+                [subscriber, event, args...]() { (subscriber->*event)(args...); }))
+              {
+                std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+                m_Histograms[std::make_pair(subscriber, key)].dropped++;
+              }
+              continue;
+            }
+
+            if (!hasDeadline)
+            {
+              (subscriber->*event)(args...);
+              continue;
+            }
+
+            TimePoint start = TimeClock::now();
             (subscriber->*event)(args...);
-          };
+            Duration elapsed = TimeClock::now() - start;
+
+            std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+            DispatchHistogram &histogram = m_Histograms[std::make_pair(subscriber, deadline.event)];
+            histogram.add(elapsed);
+
+            if (elapsed <= deadline.deadline)
+              continue;
+
+            DispatchOverrun overrun;
+            overrun.subscriber = subscriber;
+            overrun.subscriberType = demangledTypeName(typeid(*subscriber));
+            overrun.event = deadline.name;
+            overrun.elapsed = elapsed;
+            overrun.deadline = deadline.deadline;
+            overrun.histogram = histogram;
+            overrun.demoted = deadline.demoteToAsync;
+
+            if (overrun.demoted &&
+              std::find(m_Subscribers.begin(), m_Subscribers.end(), subscriber) != m_Subscribers.end() &&
+              std::find(m_AsyncSubscribers.begin(), m_AsyncSubscribers.end(), subscriber) == m_AsyncSubscribers.end())
+            {
+              m_AsyncSubscribers.push_back(subscriber);
+            }
+
+            overruns.push_back(overrun);
+          }
+
+          if (overruns.empty())
+            return;
+
+          OverrunHandler handler;
+          {
+            std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+            handler = m_OverrunHandler;
+          }
+
+          for (auto const &overrun : overruns)
+          {
+            RPI_LOG(WARNING, "EventsDispatcher::dispatch(): subscriber %s (%p) overran %s deadline: %lldus > %lldus%s",
+              overrun.subscriberType.c_str(),
+              overrun.subscriber,
+              overrun.event.empty() ? "event" : overrun.event.c_str(),
+              static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(overrun.elapsed).count()),
+              static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(overrun.deadline).count()),
+              overrun.demoted ? ", demoted to asynchronous delivery" : ""
+            );
+
+            if (handler)
+              handler(overrun);
+          }
         }
 
     private:
+        template <typename Event>
+        static EventKey eventKey(Event event)
+        {
+          static_assert(sizeof(Event) == sizeof(EventKey), "unexpected member function pointer size");
+          EventKey key;
+          std::memcpy(key.data(), &event, key.size());
+          return key;
+        }
+
+        typename std::vector<Deadline>::iterator findDeadline(EventKey const &key) const
+        {
+          return std::find_if(m_Deadlines.begin(), m_Deadlines.end(), [&key](Deadline const &deadline) { return deadline.event == key; });
+        }
+
         void add(Subscriber subscriber)
         {
           std::lock_guard<std::recursive_mutex> lock(m_Mutex);
@@ -58,19 +244,37 @@ namespace rpiCam
 
         void remove(Subscriber subscriber)
         {
-          std::lock_guard<std::recursive_mutex> lock(m_Mutex);
-          typename SubscriberList::iterator itSubscriber = std::find(
-            m_Subscribers.begin(),
-            m_Subscribers.end(),
-            subscriber
-          );
-
-          if(itSubscriber != m_Subscribers.end())
-            m_Subscribers.erase(itSubscriber);
+          {
+            std::lock_guard<std::recursive_mutex> lock(m_Mutex);
+            typename SubscriberList::iterator itSubscriber = std::find(
+              m_Subscribers.begin(),
+              m_Subscribers.end(),
+              subscriber
+            );
+
+            if(itSubscriber != m_Subscribers.end())
+              m_Subscribers.erase(itSubscriber);
+
+            for (auto itHistogram = m_Histograms.begin(); itHistogram != m_Histograms.end();)
+            {
+              if (itHistogram->first.first == subscriber)
+                itHistogram = m_Histograms.erase(itHistogram);
+              else
+                ++itHistogram;
+            }
+
+            m_AsyncSubscribers.remove(subscriber);
+          }
+          m_AsyncQueue.purge(subscriber);
         }
 
     private:
         mutable std::recursive_mutex m_Mutex;
         mutable SubscriberList m_Subscribers;
+        mutable std::vector<Deadline> m_Deadlines;
+        mutable std::map<std::pair<Subscriber, EventKey>, DispatchHistogram> m_Histograms;
+        mutable SubscriberList m_AsyncSubscribers;
+        mutable OverrunHandler m_OverrunHandler;
+        mutable AsyncDispatchQueue m_AsyncQueue;
     };
 }
@@ -0,0 +1,581 @@
+#include "FeatureDetector.hpp"
+#include "ImagePyramid.hpp"
+#include "Simd.hpp"
+#include "Logging.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+
+namespace rpiCam
+{
+    namespace
+    {
+        static constexpr std::uint32_t kNumPairs = 256;
+        static constexpr std::int32_t kPatternRadius = 13;     // plus the box radius stays inside the patch
+        static constexpr std::int32_t kBoxRadius = 2;
+        static constexpr std::uint32_t kFastBorder = 3;
+        static constexpr float kTwoPi = 6.283185307f;
+
+        // Bresenham circle of radius 3, clockwise from the top
+        static constexpr std::int32_t kCircle[16][2] = {
+            { 0, -3}, { 1, -3}, { 2, -2}, { 3, -1}, { 3,  0}, { 3,  1}, { 2,  2}, { 1,  3},
+            { 0,  3}, {-1,  3}, {-2,  2}, {-3,  1}, {-3,  0}, {-3, -1}, {-2, -2}, {-1, -3}
+        };
+
+        // the largest t for which nine contiguous circle pixels are all brighter or all darker than the center by more than t
+        inline std::uint16_t cornerScore(std::uint8_t const *p, std::ptrdiff_t const *offsets)
+        {
+            std::int32_t const c = *p;
+            std::int32_t d[16 + 8];
+            for (int i = 0; i < 16; ++i)
+                d[i] = p[offsets[i]] - c;
+            for (int i = 0; i < 8; ++i)
+                d[16 + i] = d[i];
+
+            std::int32_t best = 0;
+            for (int start = 0; start < 16; ++start)
+            {
+                std::int32_t lo = d[start], hi = d[start];
+                for (int k = 1; k < 9; ++k)
+                {
+                    lo = std::min(lo, d[start + k]);
+                    hi = std::max(hi, d[start + k]);
+                }
+                best = std::max(best, std::max(lo, -hi));
+            }
+            return std::uint16_t(best);
+        }
+
+        // any nine contiguous pixels cover two neighbouring compass points
+        inline bool passesCompass(std::uint8_t const *p, std::ptrdiff_t const *offsets, std::int32_t threshold)
+        {
+            std::int32_t const c = *p;
+            bool b[4], d[4];
+            for (int i = 0; i < 4; ++i)
+            {
+                std::int32_t const v = p[offsets[4 * i]];
+                b[i] = v > c + threshold;
+                d[i] = v < c - threshold;
+            }
+            return (b[0] && b[1]) || (b[1] && b[2]) || (b[2] && b[3]) || (b[3] && b[0]) ||
+                (d[0] && d[1]) || (d[1] && d[2]) || (d[2] && d[3]) || (d[3] && d[0]);
+        }
+
+        // sum of the 5x5 box around (x, y) from a summed area table with a leading zero row and column
+        inline std::int32_t boxSum(std::uint32_t const *sums, std::size_t stride, std::int32_t x, std::int32_t y)
+        {
+            std::uint32_t const *top = sums + (y - kBoxRadius) * stride;
+            std::uint32_t const *bottom = sums + (y + kBoxRadius + 1) * stride;
+            return std::int32_t(bottom[x + kBoxRadius + 1] - bottom[x - kBoxRadius] - top[x + kBoxRadius + 1] + top[x - kBoxRadius]);
+        }
+    }
+
+    // Sets go back here when the last frame holding them is released, and
+    // are simply deleted once the detector is gone.
+    class FeatureDetector::SetPool
+        : public std::enable_shared_from_this<FeatureDetector::SetPool>
+    {
+    public:
+        static constexpr std::size_t kMaxFreeSets = 8;
+
+        SetPool()
+            : m_Mutex()
+            , m_Free()
+        {
+        }
+
+        ~SetPool()
+        {
+            for (FeatureSet *set : m_Free)
+                delete set;
+        }
+
+        std::shared_ptr<FeatureSet> acquire(FeatureOptions const &options)
+        {
+            FeatureSet *set = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                if (!m_Free.empty())
+                {
+                    set = m_Free.back();
+                    m_Free.pop_back();
+                }
+            }
+
+            if (!set)
+                set = new FeatureSet(options);
+            else if (set->options != options)
+                *set = FeatureSet(options);
+
+            std::weak_ptr<SetPool> pool = shared_from_this();
+            return std::shared_ptr<FeatureSet>(set, [pool](FeatureSet *released)
+            {
+                if (std::shared_ptr<SetPool> locked = pool.lock())
+                    locked->recycle(released);
+                else
+                    delete released;
+            });
+        }
+
+    private:
+        void recycle(FeatureSet *set)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                if (m_Free.size() < kMaxFreeSets)
+                {
+                    m_Free.push_back(set);
+                    return;
+                }
+            }
+            delete set;
+        }
+
+    private:
+        std::mutex m_Mutex;
+        std::vector<FeatureSet*> m_Free;
+    };
+
+    FeatureDetector::FeatureDetector(FeatureOptions const &options)
+        : m_Mutex()
+        , m_Options(isValid(options) ? options : FeatureOptions())
+        , m_bSimd(true)
+        , m_Size(0, 0)
+        , m_Border(0)
+        , m_Scores()
+        , m_Candidates()
+        , m_Selected()
+        , m_Integral()
+        , m_Patterns(kNumAngles * kNumPairs * 4)
+        , m_SetPool(std::make_shared<SetPool>())
+    {
+        if (!isValid(options))
+            RPI_LOG(WARNING, "FeatureDetector::FeatureDetector(): invalid options, using defaults!");
+
+        // a fixed pattern so descriptors compare across detectors and runs, the
+        // sum of two uniform draws concentrates the points towards the center
+        std::mt19937 random(0x42524946);
+        auto coordinate = [&random]() { return std::int32_t(random() % 14) + std::int32_t(random() % 14) - kPatternRadius; };
+        auto point = [&]()
+        {
+            for (;;)
+            {
+                std::int32_t const x = coordinate(), y = coordinate();
+                if (x * x + y * y <= kPatternRadius * kPatternRadius)
+                    return Vec2f(float(x), float(y));
+            }
+        };
+
+        for (std::uint32_t ip = 0; ip < kNumPairs; ++ip)
+        {
+            Vec2f const p0 = point();
+            Vec2f p1 = point();
+            while (p1 == p0)
+                p1 = point();
+
+            for (std::uint32_t ia = 0; ia < kNumAngles; ++ia)
+            {
+                float const angle = kTwoPi * float(ia) / float(kNumAngles);
+                float const c = std::cos(angle), s = std::sin(angle);
+                std::int8_t *pair = m_Patterns.data() + (ia * kNumPairs + ip) * 4;
+                pair[0] = std::int8_t(std::lround(c * p0(0) - s * p0(1)));
+                pair[1] = std::int8_t(std::lround(s * p0(0) + c * p0(1)));
+                pair[2] = std::int8_t(std::lround(c * p1(0) - s * p1(1)));
+                pair[3] = std::int8_t(std::lround(s * p1(0) + c * p1(1)));
+            }
+        }
+    }
+
+    FeatureDetector::~FeatureDetector()
+    {
+    }
+
+    FeatureOptions FeatureDetector::options() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_Options;
+    }
+
+    std::error_code FeatureDetector::setOptions(FeatureOptions const &options)
+    {
+        if (!isValid(options))
+        {
+            RPI_LOG(ERROR, "FeatureDetector::setOptions(): invalid options!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Options = options;
+        return std::error_code();
+    }
+
+    bool FeatureDetector::isSimdEnabled() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_bSimd;
+    }
+
+    void FeatureDetector::setSimdEnabled(bool bEnabled)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bSimd = bEnabled;
+    }
+
+    std::shared_ptr<FeatureSet const> FeatureDetector::detect(PixelSampleBuffer &frame)
+    {
+        FeatureOptions const options = this->options();
+        if (std::shared_ptr<FeatureSet const> attached = frame.features(options))
+            return attached;
+
+        std::size_t const li = options.level;
+        PixelBuffer *luma = nullptr;
+        if (li > 0)
+        {
+            luma = frame.pyramid().level(li);
+            if (!luma)
+            {
+                RPI_LOG(ERROR, "FeatureDetector::detect(): no luma level %d for this frame!", int(li));
+                return nullptr;
+            }
+        }
+        else if (pixelFormatDescriptor(frame.format()).bytesPerPixel[0] != 1)
+        {
+            RPI_LOG(ERROR, "FeatureDetector::detect(): no separate luma plane in this format!");
+            return nullptr;
+        }
+        else if (frame.lock())
+        {
+            RPI_LOG(ERROR, "FeatureDetector::detect(): failed to lock the frame!");
+            return nullptr;
+        }
+        else
+            luma = &frame;
+
+        std::shared_ptr<FeatureSet> features = m_SetPool->acquire(options);
+        std::error_code const de = detect(*luma, 0, float(1 << li), *features);
+
+        if (!li)
+            frame.unlock();
+
+        if (de)
+            return nullptr;
+        return frame.attachFeatures(features);
+    }
+
+    std::error_code FeatureDetector::detect(PixelBuffer &buffer, std::size_t pi, float scale, FeatureSet &features)
+    {
+        if (pi >= buffer.planeCount() || pixelFormatDescriptor(buffer.format()).bytesPerPixel[pi] != 1)
+        {
+            RPI_LOG(ERROR, "FeatureDetector::detect(): plane is not one byte per pixel!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        std::uint8_t const *data = static_cast<std::uint8_t const*>(buffer.planeData(pi));
+        if (!data)
+        {
+            RPI_LOG(ERROR, "FeatureDetector::detect(): buffer not locked!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        // rows only clear their scores inside the border, the rest of the
+        // plane is cleared whenever the border moves
+        Vec2ui const size = buffer.planeSize(pi);
+        std::uint32_t const border = m_Options.bDescriptors ? kPatchRadius + 1 : kFastBorder;
+        if (size != m_Size || border != m_Border)
+        {
+            m_Size = size;
+            m_Border = border;
+            m_Scores.assign(size.prod(), 0);
+        }
+
+        features.options = m_Options;
+        features.imageSize = size;
+        features.keypoints.clear();
+        features.descriptors.clear();
+
+        if (size(0) <= 2 * border || size(1) <= 2 * border)
+            return std::error_code();
+
+        if (m_Options.bDescriptors)
+        {
+            if (std::error_code ce = m_Integral.compute(buffer, pi))
+                return ce;
+        }
+
+        std::size_t const rowBytes = buffer.planeRowBytes(pi);
+        findCorners(data, rowBytes, border);
+        selectCorners();
+        describe(data, rowBytes, scale, features);
+        return std::error_code();
+    }
+
+    bool FeatureDetector::isValid(FeatureOptions const &options)
+    {
+        return options.level <= ImagePyramid::kNumLevels &&
+            options.maxFeatures > 0 &&
+            options.gridSize(0) > 0 && options.gridSize(1) > 0;
+    }
+
+    void FeatureDetector::findCorners(std::uint8_t const *data, std::size_t rowBytes, std::uint32_t border)
+    {
+        std::uint32_t const width = m_Size(0);
+        std::uint32_t const height = m_Size(1);
+        std::int32_t const threshold = m_Options.threshold;
+        bool const bSimd = m_bSimd;
+
+        std::ptrdiff_t offsets[16];
+        for (int i = 0; i < 16; ++i)
+            offsets[i] = kCircle[i][1] * std::ptrdiff_t(rowBytes) + kCircle[i][0];
+
+        m_Candidates.clear();
+        for (std::uint32_t y = border; y < height - border; ++y)
+        {
+            std::uint8_t const *row = data + y * rowBytes;
+            std::uint8_t *scores = m_Scores.data() + y * width;
+            std::fill(scores + border, scores + width - border, 0);
+
+            std::uint32_t const cy = y * m_Options.gridSize(1) / height;
+            auto candidate = [&](std::uint32_t x)
+            {
+                std::uint16_t const score = cornerScore(row + x, offsets);
+                if (score <= threshold)
+                    return;
+                scores[x] = std::uint8_t(score);
+                std::uint32_t const cx = x * m_Options.gridSize(0) / width;
+                m_Candidates.push_back(Candidate{x, y, cy * m_Options.gridSize(0) + cx, score});
+            };
+
+            std::uint32_t x = border;
+            std::uint32_t const end = width - border;
+#if defined(RPI_CAM_SIMD_NEON)
+            if (bSimd)
+            {
+                uint8x16_t const t = vdupq_n_u8(std::uint8_t(threshold));
+                uint8x16_t const one = vdupq_n_u8(1);
+                uint8x16_t const nine = vdupq_n_u8(9);
+                for (; x + 16 <= end; x += 16)
+                {
+                    std::uint8_t const *p = row + x;
+                    uint8x16_t const c = vld1q_u8(p);
+                    uint8x16_t const cb = vqaddq_u8(c, t), cd = vqsubq_u8(c, t);
+
+                    uint8x16_t bright[16], dark[16];
+                    for (int i = 0; i < 16; i += 4)
+                    {
+                        uint8x16_t const v = vld1q_u8(p + offsets[i]);
+                        bright[i] = vcgtq_u8(v, cb);
+                        dark[i] = vcltq_u8(v, cd);
+                    }
+                    uint8x16_t const any = vorrq_u8(
+                        vorrq_u8(vorrq_u8(vandq_u8(bright[0], bright[4]), vandq_u8(bright[4], bright[8])),
+                            vorrq_u8(vandq_u8(bright[8], bright[12]), vandq_u8(bright[12], bright[0]))),
+                        vorrq_u8(vorrq_u8(vandq_u8(dark[0], dark[4]), vandq_u8(dark[4], dark[8])),
+                            vorrq_u8(vandq_u8(dark[8], dark[12]), vandq_u8(dark[12], dark[0]))));
+                    uint64x2_t const any64 = vreinterpretq_u64_u8(any);
+                    if (!(vgetq_lane_u64(any64, 0) | vgetq_lane_u64(any64, 1)))
+                        continue;
+
+                    for (int i = 0; i < 16; ++i)
+                    {
+                        if (i % 4 == 0)
+                            continue;
+                        uint8x16_t const v = vld1q_u8(p + offsets[i]);
+                        bright[i] = vcgtq_u8(v, cb);
+                        dark[i] = vcltq_u8(v, cd);
+                    }
+
+                    // longest run around the circle, counted per lane and wrapped by eight
+                    uint8x16_t runBright = vdupq_n_u8(0), runDark = runBright, maxBright = runBright, maxDark = runBright;
+                    for (int k = 0; k < 16 + 8; ++k)
+                    {
+                        runBright = vandq_u8(vaddq_u8(runBright, one), bright[k & 15]);
+                        runDark = vandq_u8(vaddq_u8(runDark, one), dark[k & 15]);
+                        maxBright = vmaxq_u8(maxBright, runBright);
+                        maxDark = vmaxq_u8(maxDark, runDark);
+                    }
+
+                    std::uint8_t corners[16];
+                    vst1q_u8(corners, vcgeq_u8(vmaxq_u8(maxBright, maxDark), nine));
+                    for (std::uint32_t lane = 0; lane < 16; ++lane)
+                    {
+                        if (corners[lane])
+                            candidate(x + lane);
+                    }
+                }
+            }
+#elif defined(RPI_CAM_SIMD_SSE2)
+            if (bSimd)
+            {
+                __m128i const t = _mm_set1_epi8(char(threshold));
+                __m128i const zero = _mm_setzero_si128();
+                __m128i const ones = _mm_set1_epi8(-1);
+                __m128i const one = _mm_set1_epi8(1);
+                __m128i const eight = _mm_set1_epi8(8);
+                // unsigned a > b is a - b saturating to non-zero
+                auto greater = [&](__m128i a, __m128i b) { return _mm_xor_si128(_mm_cmpeq_epi8(_mm_subs_epu8(a, b), zero), ones); };
+                for (; x + 16 <= end; x += 16)
+                {
+                    std::uint8_t const *p = row + x;
+                    __m128i const c = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p));
+                    __m128i const cb = _mm_adds_epu8(c, t), cd = _mm_subs_epu8(c, t);
+
+                    __m128i bright[16], dark[16];
+                    for (int i = 0; i < 16; i += 4)
+                    {
+                        __m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p + offsets[i]));
+                        bright[i] = greater(v, cb);
+                        dark[i] = greater(cd, v);
+                    }
+                    __m128i const any = _mm_or_si128(
+                        _mm_or_si128(_mm_or_si128(_mm_and_si128(bright[0], bright[4]), _mm_and_si128(bright[4], bright[8])),
+                            _mm_or_si128(_mm_and_si128(bright[8], bright[12]), _mm_and_si128(bright[12], bright[0]))),
+                        _mm_or_si128(_mm_or_si128(_mm_and_si128(dark[0], dark[4]), _mm_and_si128(dark[4], dark[8])),
+                            _mm_or_si128(_mm_and_si128(dark[8], dark[12]), _mm_and_si128(dark[12], dark[0]))));
+                    if (!_mm_movemask_epi8(any))
+                        continue;
+
+                    for (int i = 0; i < 16; ++i)
+                    {
+                        if (i % 4 == 0)
+                            continue;
+                        __m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p + offsets[i]));
+                        bright[i] = greater(v, cb);
+                        dark[i] = greater(cd, v);
+                    }
+
+                    // longest run around the circle, counted per lane and wrapped by eight
+                    __m128i runBright = zero, runDark = zero, maxRun = zero;
+                    for (int k = 0; k < 16 + 8; ++k)
+                    {
+                        runBright = _mm_and_si128(_mm_add_epi8(runBright, one), bright[k & 15]);
+                        runDark = _mm_and_si128(_mm_add_epi8(runDark, one), dark[k & 15]);
+                        maxRun = _mm_max_epu8(maxRun, _mm_max_epu8(runBright, runDark));
+                    }
+
+                    int corners = _mm_movemask_epi8(greater(maxRun, eight));
+                    while (corners)
+                    {
+                        candidate(x + std::uint32_t(__builtin_ctz(corners)));
+                        corners &= corners - 1;
+                    }
+                }
+            }
+#else
+            (void)bSimd;
+#endif
+            for (; x < end; ++x)
+            {
+                if (passesCompass(row + x, offsets, threshold))
+                    candidate(x);
+            }
+        }
+    }
+
+    void FeatureDetector::selectCorners()
+    {
+        std::uint32_t const width = m_Size(0);
+
+        // 3x3 non-maximum suppression, ties go to the earlier pixel in raster order
+        m_Selected.clear();
+        for (Candidate const &candidate : m_Candidates)
+        {
+            std::uint8_t const *s = m_Scores.data() + candidate.y * width + candidate.x;
+            std::uint8_t const score = s[0];
+            if (score > s[-std::ptrdiff_t(width) - 1] && score > s[-std::ptrdiff_t(width)] && score > s[-std::ptrdiff_t(width) + 1] &&
+                score > s[-1] && score >= s[1] &&
+                score >= s[width - 1] && score >= s[width] && score >= s[width + 1])
+            {
+                m_Selected.push_back(candidate);
+            }
+        }
+
+        auto stronger = [](Candidate const &a, Candidate const &b)
+        {
+            if (a.score != b.score)
+                return a.score > b.score;
+            return a.y != b.y ? a.y < b.y : a.x < b.x;
+        };
+
+        // the strongest of every cell up to its share of the budget
+        std::uint32_t const numCells = m_Options.gridSize.prod();
+        std::uint32_t const cellBudget = (m_Options.maxFeatures + numCells - 1) / numCells;
+        std::sort(m_Selected.begin(), m_Selected.end(), [&stronger](Candidate const &a, Candidate const &b)
+        {
+            return a.cell != b.cell ? a.cell < b.cell : stronger(a, b);
+        });
+
+        // compacted in place, so the count restarts at each cell instead of looking back
+        std::size_t numKept = 0;
+        std::uint32_t cell = 0, numInCell = 0;
+        for (std::size_t i = 0; i < m_Selected.size(); ++i)
+        {
+            if (i == 0 || m_Selected[i].cell != cell)
+            {
+                cell = m_Selected[i].cell;
+                numInCell = 0;
+            }
+            if (numInCell++ >= cellBudget)
+                continue;
+            m_Selected[numKept++] = m_Selected[i];
+        }
+        m_Selected.resize(numKept);
+
+        std::sort(m_Selected.begin(), m_Selected.end(), stronger);
+        if (m_Selected.size() > m_Options.maxFeatures)
+            m_Selected.resize(m_Options.maxFeatures);
+    }
+
+    void FeatureDetector::describe(std::uint8_t const *data, std::size_t rowBytes, float scale, FeatureSet &features)
+    {
+        bool const bDescriptors = m_Options.bDescriptors;
+        std::size_t const stride = m_Size(0) + 1;
+        std::uint32_t const *sums = m_Integral.sums();
+
+        // half widths of the circular orientation patch
+        std::int32_t const r = std::int32_t(kPatchRadius);
+        std::int32_t halfWidths[kPatchRadius + 1];
+        for (std::int32_t v = 0; v <= r; ++v)
+            halfWidths[v] = std::int32_t(std::sqrt(float(r * r - v * v)));
+
+        for (Candidate const &candidate : m_Selected)
+        {
+            Keypoint keypoint;
+            keypoint.position = Vec2f((candidate.x + 0.5f) * scale - 0.5f, (candidate.y + 0.5f) * scale - 0.5f);
+            keypoint.score = candidate.score;
+
+            if (bDescriptors)
+            {
+                std::int32_t m10 = 0, m01 = 0;
+                for (std::int32_t v = -r; v <= r; ++v)
+                {
+                    std::uint8_t const *row = data + (std::int32_t(candidate.y) + v) * std::ptrdiff_t(rowBytes) + candidate.x;
+                    std::int32_t const hw = halfWidths[std::abs(v)];
+                    std::int32_t rowSum = 0;
+                    for (std::int32_t u = -hw; u <= hw; ++u)
+                    {
+                        m10 += u * row[u];
+                        rowSum += row[u];
+                    }
+                    m01 += v * rowSum;
+                }
+                keypoint.angle = std::atan2(float(m01), float(m10));
+
+                std::int32_t const bin = std::int32_t(std::floor(keypoint.angle * kNumAngles / kTwoPi + 0.5f));
+                std::int8_t const *pattern = m_Patterns.data() + ((bin % std::int32_t(kNumAngles) + kNumAngles) % kNumAngles) * kNumPairs * 4;
+
+                Descriptor descriptor = {{0, 0, 0, 0}};
+                std::int32_t const x = std::int32_t(candidate.x), y = std::int32_t(candidate.y);
+                for (std::uint32_t ip = 0; ip < kNumPairs; ++ip, pattern += 4)
+                {
+                    if (boxSum(sums, stride, x + pattern[0], y + pattern[1]) < boxSum(sums, stride, x + pattern[2], y + pattern[3]))
+                        descriptor[ip >> 6] |= std::uint64_t(1) << (ip & 63);
+                }
+                features.descriptors.push_back(descriptor);
+            }
+            features.keypoints.push_back(keypoint);
+        }
+    }
+}
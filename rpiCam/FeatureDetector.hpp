@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Config.hpp"
+#include "PixelSampleBuffer.hpp"
+#include "Features.hpp"
+#include "IntegralImage.hpp"
+#include <mutex>
+#include <vector>
+
+namespace rpiCam
+{
+    // FAST-9 corners with 3x3 non-maximum suppression and a per grid cell
+    // budget, optionally with an intensity centroid orientation and a
+    // rotated BRIEF descriptor comparing 5x5 box sums. Sixteen pixels are
+    // tested against the circle at once and only the corners get the exact
+    // scalar score. Sets handed out by detect(frame) are recycled through a
+    // small pool and attached to the frame for every other subscriber.
+    class FeatureDetector
+    {
+    public:
+        static constexpr std::uint32_t kPatchRadius = 15;
+        static constexpr std::uint32_t kNumAngles = 32;
+
+        FeatureDetector(FeatureOptions const &options = FeatureOptions());
+        ~FeatureDetector();
+
+        FeatureOptions options() const;
+        std::error_code setOptions(FeatureOptions const &options);
+
+        bool isSimdEnabled() const;
+        void setSimdEnabled(bool bEnabled);
+
+        // Features of the frame at options().level, the ones already attached
+        // to it when there are any, else detected into a recycled set and
+        // attached. nullptr on failure. The frame needs a separate Y plane.
+        std::shared_ptr<FeatureSet const> detect(PixelSampleBuffer &frame);
+
+        // into features, a locked one byte per pixel plane, positions are
+        // multiplied by scale
+        std::error_code detect(PixelBuffer &buffer, std::size_t pi, float scale, FeatureSet &features);
+
+    private:
+        class SetPool;
+
+        struct Candidate
+        {
+            std::uint32_t x;
+            std::uint32_t y;
+            std::uint32_t cell;
+            std::uint16_t score;
+        };
+
+        static bool isValid(FeatureOptions const &options);
+
+        void findCorners(std::uint8_t const *data, std::size_t rowBytes, std::uint32_t border);
+        void selectCorners();
+        void describe(std::uint8_t const *data, std::size_t rowBytes, float scale, FeatureSet &features);
+
+    private:
+        mutable std::mutex m_Mutex;
+        FeatureOptions m_Options;
+        bool m_bSimd;
+        Vec2ui m_Size;
+        std::uint32_t m_Border;                 // m_Scores is zero outside of it
+        std::vector<std::uint8_t> m_Scores;
+        std::vector<Candidate> m_Candidates;
+        std::vector<Candidate> m_Selected;
+        IntegralImage m_Integral;
+        std::vector<std::int8_t> m_Patterns;    // kNumAngles rotations of 256 point pairs, x0 y0 x1 y1
+        std::shared_ptr<SetPool> m_SetPool;
+    };
+}
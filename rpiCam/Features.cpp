@@ -0,0 +1,110 @@
+#include "Features.hpp"
+#include "Simd.hpp"
+#include <limits>
+
+namespace rpiCam
+{
+    namespace
+    {
+        inline std::uint32_t vectorHammingDistance(Descriptor const &a, Descriptor const &b)
+        {
+            std::uint8_t const *pa = reinterpret_cast<std::uint8_t const*>(a.data());
+            std::uint8_t const *pb = reinterpret_cast<std::uint8_t const*>(b.data());
+#if defined(RPI_CAM_SIMD_NEON)
+            uint8x16_t const counts = vaddq_u8(
+                vcntq_u8(veorq_u8(vld1q_u8(pa), vld1q_u8(pb))),
+                vcntq_u8(veorq_u8(vld1q_u8(pa + 16), vld1q_u8(pb + 16))));
+            uint64x2_t const sums = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(counts)));
+            return std::uint32_t(vgetq_lane_u64(sums, 0) + vgetq_lane_u64(sums, 1));
+#else
+            // SSE2 has no byte popcount, the scalar 64 bit one is faster
+            (void)pa;
+            (void)pb;
+            return hammingDistance(a, b);
+#endif
+        }
+    }
+
+    FeatureOptions::FeatureOptions()
+        : level(0)
+        , threshold(20)
+        , maxFeatures(500)
+        , gridSize(8, 6)
+        , bDescriptors(true)
+    {
+    }
+
+    bool FeatureOptions::operator==(FeatureOptions const &rhs) const
+    {
+        return level == rhs.level &&
+            threshold == rhs.threshold &&
+            maxFeatures == rhs.maxFeatures &&
+            gridSize == rhs.gridSize &&
+            bDescriptors == rhs.bDescriptors;
+    }
+
+    Keypoint::Keypoint()
+        : position(0.0f, 0.0f)
+        , angle(0.0f)
+        , score(0)
+    {
+    }
+
+    FeatureSet::FeatureSet(FeatureOptions const &options)
+        : options(options)
+        , imageSize(0, 0)
+        , keypoints()
+        , descriptors()
+    {
+        keypoints.reserve(options.maxFeatures);
+        if (options.bDescriptors)
+            descriptors.reserve(options.maxFeatures);
+    }
+
+    FeatureMatchOptions::FeatureMatchOptions()
+        : maxDistance(64)
+        , maxOffset(0.0f)
+        , ratio(0.8f)
+    {
+    }
+
+    void matchFeatures(FeatureSet const &query, FeatureSet const &train, FeatureMatchOptions const &options,
+        std::vector<FeatureMatch> &matches, bool bSimd)
+    {
+        matches.clear();
+        if (query.descriptors.size() != query.keypoints.size() || train.descriptors.size() != train.keypoints.size())
+            return;
+
+        float const maxOffset2 = options.maxOffset * options.maxOffset;
+        for (std::uint32_t qi = 0; qi < query.keypoints.size(); ++qi)
+        {
+            Vec2f const position = query.keypoints[qi].position;
+            Descriptor const &descriptor = query.descriptors[qi];
+
+            std::uint32_t best = std::numeric_limits<std::uint32_t>::max(), second = best, bestIndex = 0;
+            for (std::uint32_t ti = 0; ti < train.keypoints.size(); ++ti)
+            {
+                if (maxOffset2 > 0.0f && (train.keypoints[ti].position - position).squaredNorm() > maxOffset2)
+                    continue;
+
+                std::uint32_t const distance = bSimd ?
+                    vectorHammingDistance(descriptor, train.descriptors[ti]) :
+                    hammingDistance(descriptor, train.descriptors[ti]);
+                if (distance < best)
+                {
+                    second = best;
+                    best = distance;
+                    bestIndex = ti;
+                }
+                else if (distance < second)
+                    second = distance;
+            }
+
+            if (best > options.maxDistance)
+                continue;
+            if (options.ratio < 1.0f && second != std::numeric_limits<std::uint32_t>::max() && float(best) >= options.ratio * float(second))
+                continue;
+            matches.push_back(FeatureMatch{qi, bestIndex, best});
+        }
+    }
+}
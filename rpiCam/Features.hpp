@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Config.hpp"
+#include <array>
+#include <vector>
+
+namespace rpiCam
+{
+    class FeatureOptions
+    {
+    public:
+        FeatureOptions();
+
+        bool operator==(FeatureOptions const &rhs) const;
+        inline bool operator!=(FeatureOptions const &rhs) const { return !(*this == rhs); }
+
+        std::uint32_t level;        // pyramid level searched, 0 is the full Y plane
+        std::uint8_t threshold;     // FAST: nine contiguous circle pixels differ from the center by more than this
+        std::uint32_t maxFeatures;  // keypoint budget, split evenly over the grid cells
+        Vec2ui gridSize;            // cells across and down
+        bool bDescriptors;          // orientation and rotated BRIEF descriptor of every keypoint
+    };
+
+    class Keypoint
+    {
+    public:
+        Keypoint();
+
+        Vec2f position;         // in frame pixels
+        float angle;            // of the intensity centroid, radians from +x towards +y
+        std::uint16_t score;    // largest threshold at which it is still a corner
+    };
+
+    // 256 intensity comparisons, bit i of word i / 64
+    using Descriptor = std::array<std::uint64_t, 4>;
+
+    // Keypoints of one frame, strongest first, with descriptors[i] belonging
+    // to keypoints[i]. Both arrays are reserved for options.maxFeatures when
+    // the set is created and never grow, so recycled sets do not allocate.
+    class FeatureSet
+    {
+    public:
+        FeatureSet(FeatureOptions const &options = FeatureOptions());
+
+        FeatureOptions options;
+        Vec2ui imageSize;                       // of the searched level
+        std::vector<Keypoint> keypoints;
+        std::vector<Descriptor> descriptors;    // empty without options.bDescriptors
+    };
+
+    inline std::uint32_t hammingDistance(Descriptor const &a, Descriptor const &b)
+    {
+        return std::uint32_t(
+            __builtin_popcountll(a[0] ^ b[0]) + __builtin_popcountll(a[1] ^ b[1]) +
+            __builtin_popcountll(a[2] ^ b[2]) + __builtin_popcountll(a[3] ^ b[3]));
+    }
+
+    class FeatureMatchOptions
+    {
+    public:
+        FeatureMatchOptions();
+
+        std::uint32_t maxDistance;  // in bits
+        float maxOffset;            // between matched positions in frame pixels, 0 is unlimited
+        float ratio;                // best distance must be below ratio * second best, 1 disables the test
+    };
+
+    class FeatureMatch
+    {
+    public:
+        std::uint32_t query;        // index into the query set
+        std::uint32_t train;        // and into the train set
+        std::uint32_t distance;
+    };
+
+    // Nearest train descriptor for every query descriptor by Hamming
+    // distance, counted with vector popcounts over whole descriptors on
+    // NEON and 64 bit popcounts elsewhere. Both sets need descriptors.
+    void matchFeatures(FeatureSet const &query, FeatureSet const &train, FeatureMatchOptions const &options,
+        std::vector<FeatureMatch> &matches, bool bSimd = true);
+}
@@ -0,0 +1,300 @@
+#include "FrameStatistics.hpp"
+#include "Simd.hpp"
+#include "Logging.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace rpiCam
+{
+    namespace
+    {
+        static constexpr std::size_t kHistogramCopies = 4;
+
+        using Histograms = std::uint32_t[kHistogramCopies][256];
+
+        // sample (x, y) of one component is at data + y * rowBytes + x * pixelStride
+        struct Channel
+        {
+            std::uint8_t const *data;
+            std::size_t rowBytes;
+            std::size_t pixelStride;
+            Vec2ui size;
+        };
+
+        Channel channel(PixelBuffer &buffer, std::size_t pi, std::size_t offset, std::size_t pixelStride, Vec2ui const &size)
+        {
+            return Channel{
+                static_cast<std::uint8_t const*>(buffer.planeData(pi)) + offset,
+                buffer.planeRowBytes(pi),
+                pixelStride,
+                size
+            };
+        }
+
+        std::size_t describe(PixelBuffer &buffer, Channel channels[FrameStatistics::kMaxChannels])
+        {
+            for (std::size_t pi = 0; pi < buffer.planeCount(); ++pi)
+            {
+                if (!buffer.planeData(pi))
+                    return 0;
+            }
+
+            Vec2ui const size = buffer.planeSize(0);
+            Vec2ui const packedChroma(size(0) / 2, size(1));
+
+            switch(buffer.format())
+            {
+            case kPixelFormatRGB8:
+                for (std::size_t c = 0; c < 3; ++c)
+                    channels[c] = channel(buffer, 0, c, 3, size);
+                return 3;
+            case kPixelFormatRGBA8:
+                for (std::size_t c = 0; c < 3; ++c)
+                    channels[c] = channel(buffer, 0, c, 4, size);
+                return 3;
+            case kPixelFormatBGRA8:
+                for (std::size_t c = 0; c < 3; ++c)
+                    channels[c] = channel(buffer, 0, 2 - c, 4, size);
+                return 3;
+            case kPixelFormatYUV420:
+            case kPixelFormatYUV422:
+                for (std::size_t c = 0; c < 3; ++c)
+                    channels[c] = channel(buffer, c, 0, 1, buffer.planeSize(c));
+                return 3;
+            case kPixelFormatNV12:
+            case kPixelFormatNV21:
+            {
+                std::size_t const u = buffer.format() == kPixelFormatNV12 ? 0 : 1;
+                channels[0] = channel(buffer, 0, 0, 1, size);
+                channels[1] = channel(buffer, 1, u, 2, buffer.planeSize(1));
+                channels[2] = channel(buffer, 1, 1 - u, 2, buffer.planeSize(1));
+                return 3;
+            }
+            case kPixelFormatYUYV:
+                channels[0] = channel(buffer, 0, 0, 2, size);
+                channels[1] = channel(buffer, 0, 1, 4, packedChroma);
+                channels[2] = channel(buffer, 0, 3, 4, packedChroma);
+                return 3;
+            case kPixelFormatUYVY:
+                channels[0] = channel(buffer, 0, 1, 2, size);
+                channels[1] = channel(buffer, 0, 0, 4, packedChroma);
+                channels[2] = channel(buffer, 0, 2, 4, packedChroma);
+                return 3;
+            case kPixelFormatGRAY8:
+                channels[0] = channel(buffer, 0, 0, 1, size);
+                return 1;
+            default:
+                return 0;
+            }
+        }
+
+        inline std::uint32_t sumBytes(std::uint8_t const *data, std::uint32_t count)
+        {
+            std::uint32_t sum = 0;
+            std::uint32_t i = 0;
+#if defined(RPI_CAM_SIMD_NEON)
+            uint32x4_t acc = vdupq_n_u32(0);
+            for (; i + 16 <= count; i += 16)
+                acc = vpadalq_u16(acc, vpaddlq_u8(vld1q_u8(data + i)));
+            uint64x2_t const acc64 = vpaddlq_u32(acc);
+            sum = std::uint32_t(vgetq_lane_u64(acc64, 0) + vgetq_lane_u64(acc64, 1));
+#elif defined(RPI_CAM_SIMD_SSE2)
+            __m128i const zero = _mm_setzero_si128();
+            __m128i acc = _mm_setzero_si128();
+            for (; i + 16 <= count; i += 16)
+                acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i)), zero));
+            sum = std::uint32_t(_mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(acc, acc)));
+#endif
+            for (; i < count; ++i)
+                sum += data[i];
+            return sum;
+        }
+
+        inline void histogramBytes(std::uint8_t const *data, std::uint32_t count, Histograms &histograms)
+        {
+            std::uint32_t i = 0;
+            for (; i + kHistogramCopies <= count; i += kHistogramCopies)
+            {
+                histograms[0][data[i + 0]]++;
+                histograms[1][data[i + 1]]++;
+                histograms[2][data[i + 2]]++;
+                histograms[3][data[i + 3]]++;
+            }
+            for (; i < count; ++i)
+                histograms[0][data[i]]++;
+        }
+
+        void accumulateChannel(Channel const &channel, FrameStatisticsOptions const &options, Histograms &histograms,
+            std::vector<std::uint64_t> &zoneSums, std::vector<std::uint32_t> &zoneCounts)
+        {
+            std::uint32_t const step = options.subsample;
+            std::uint32_t const gridWidth = options.gridSize(0);
+            std::uint32_t const gridHeight = options.gridSize(1);
+            std::uint32_t const width = channel.size(0);
+            std::uint32_t const height = channel.size(1);
+
+            // first sampled column of every zone, the last entry ends the row
+            std::vector<std::uint32_t> bounds(gridWidth + 1);
+            for (std::uint32_t zx = 0; zx <= gridWidth; ++zx)
+                bounds[zx] = (std::uint64_t(zx) * width / gridWidth + step - 1) / step * step;
+
+            bool const bContiguous = channel.pixelStride == 1 && step == 1;
+            for (std::uint32_t y = 0; y < height; y += step)
+            {
+                std::uint8_t const *row = channel.data + y * channel.rowBytes;
+                std::uint32_t const zoneRow = std::uint32_t(std::uint64_t(y) * gridHeight / height) * gridWidth;
+
+                for (std::uint32_t zx = 0; zx < gridWidth; ++zx)
+                {
+                    std::uint32_t const x0 = bounds[zx];
+                    std::uint32_t const x1 = std::min(bounds[zx + 1], width);
+                    if (x0 >= x1)
+                        continue;
+
+                    std::uint32_t sum = 0;
+                    std::uint32_t count = 0;
+                    if (bContiguous)
+                    {
+                        count = x1 - x0;
+                        histogramBytes(row + x0, count, histograms);
+                        sum = sumBytes(row + x0, count);
+                    }
+                    else
+                    {
+                        for (std::uint32_t x = x0; x < x1; x += step, ++count)
+                        {
+                            std::uint8_t const v = row[x * channel.pixelStride];
+                            histograms[count & (kHistogramCopies - 1)][v]++;
+                            sum += v;
+                        }
+                    }
+
+                    zoneSums[zoneRow + zx] += sum;
+                    zoneCounts[zoneRow + zx] += count;
+                }
+            }
+        }
+
+        void summarize(Histograms const &histograms, FrameStatisticsOptions const &options, ChannelStatistics &statistics)
+        {
+            std::uint64_t sum = 0;
+            std::uint64_t low = 0, high = 0;
+            statistics.count = 0;
+            for (std::uint32_t v = 0; v < 256; ++v)
+            {
+                std::uint32_t n = 0;
+                for (std::size_t ih = 0; ih < kHistogramCopies; ++ih)
+                    n += histograms[ih][v];
+
+                statistics.histogram[v] = n;
+                statistics.count += n;
+                sum += std::uint64_t(v) * n;
+                if (v <= options.lowClip)
+                    low += n;
+                if (v >= options.highClip)
+                    high += n;
+            }
+
+            if (!statistics.count)
+                return;
+
+            statistics.min = 0;
+            while (!statistics.histogram[statistics.min])
+                statistics.min++;
+            statistics.max = 255;
+            while (!statistics.histogram[statistics.max])
+                statistics.max--;
+
+            statistics.mean = float(double(sum) / statistics.count);
+            statistics.lowClipRatio = float(double(low) / statistics.count);
+            statistics.highClipRatio = float(double(high) / statistics.count);
+        }
+    }
+
+    FrameStatisticsOptions::FrameStatisticsOptions()
+        : gridSize(16, 12)
+        , subsample(1)
+        , lowClip(0)
+        , highClip(255)
+        , chroma(true)
+    {
+    }
+
+    bool FrameStatisticsOptions::operator==(FrameStatisticsOptions const &rhs) const
+    {
+        return gridSize == rhs.gridSize &&
+            subsample == rhs.subsample &&
+            lowClip == rhs.lowClip &&
+            highClip == rhs.highClip &&
+            chroma == rhs.chroma;
+    }
+
+    ChannelStatistics::ChannelStatistics()
+        : histogram()
+        , count(0)
+        , min(0)
+        , max(0)
+        , mean(0.0f)
+        , lowClipRatio(0.0f)
+        , highClipRatio(0.0f)
+    {
+        histogram.fill(0);
+    }
+
+    FrameStatistics::FrameStatistics()
+        : options()
+        , channelCount(0)
+        , channels()
+        , zoneMeans()
+    {
+    }
+
+    std::error_code computeFrameStatistics(PixelBuffer &buffer, FrameStatisticsOptions const &options, FrameStatistics &statistics)
+    {
+        if (!options.gridSize(0) || !options.gridSize(1) || !options.subsample)
+        {
+            RPI_LOG(ERROR, "computeFrameStatistics(): invalid options!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        Channel channels[FrameStatistics::kMaxChannels];
+        std::size_t channelCount = describe(buffer, channels);
+        if (!channelCount)
+        {
+            RPI_LOG(ERROR, "computeFrameStatistics(): buffer not locked or unsupported format!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        if (!options.chroma)
+            channelCount = 1;
+
+        std::size_t const numZones = options.gridSize.prod();
+        statistics.options = options;
+        statistics.channelCount = channelCount;
+        statistics.zoneMeans.assign(numZones * channelCount, 0.0f);
+
+        std::vector<std::uint64_t> zoneSums(numZones);
+        std::vector<std::uint32_t> zoneCounts(numZones);
+        Histograms histograms;
+
+        for (std::size_t c = 0; c < channelCount; ++c)
+        {
+            std::memset(histograms, 0, sizeof(histograms));
+            std::fill(zoneSums.begin(), zoneSums.end(), 0);
+            std::fill(zoneCounts.begin(), zoneCounts.end(), 0);
+
+            accumulateChannel(channels[c], options, histograms, zoneSums, zoneCounts);
+
+            statistics.channels[c] = ChannelStatistics();
+            summarize(histograms, options, statistics.channels[c]);
+
+            for (std::size_t iz = 0; iz < numZones; ++iz)
+            {
+                if (zoneCounts[iz])
+                    statistics.zoneMeans[iz * channelCount + c] = float(double(zoneSums[iz]) / zoneCounts[iz]);
+            }
+        }
+
+        return std::error_code();
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Config.hpp"
+#include "PixelBuffer.hpp"
+#include <array>
+#include <vector>
+#include <system_error>
+
+namespace rpiCam
+{
+    class FrameStatisticsOptions
+    {
+    public:
+        FrameStatisticsOptions();
+
+        bool operator==(FrameStatisticsOptions const &rhs) const;
+        inline bool operator!=(FrameStatisticsOptions const &rhs) const { return !(*this == rhs); }
+
+        Vec2ui gridSize;            // zones across and down
+        std::uint32_t subsample;    // every subsample-th pixel of every subsample-th row
+        std::uint8_t lowClip;       // values <= lowClip count as clipped shadows
+        std::uint8_t highClip;      // values >= highClip count as clipped highlights
+        bool chroma;                // also U and V, or G and B, not only Y or R
+    };
+
+    class ChannelStatistics
+    {
+    public:
+        ChannelStatistics();
+
+        std::array<std::uint32_t, 256> histogram;
+        std::uint64_t count;
+        std::uint8_t min;
+        std::uint8_t max;
+        float mean;
+        float lowClipRatio;
+        float highClipRatio;
+    };
+
+    // Statistics of Y, U, V for YUV formats and R, G, B for RGB formats.
+    class FrameStatistics
+    {
+    public:
+        static constexpr std::size_t kMaxChannels = 3;
+
+        FrameStatistics();
+
+        inline float zoneMean(std::uint32_t zx, std::uint32_t zy, std::size_t c = 0) const
+        {
+            return zoneMeans[(zy * options.gridSize(0) + zx) * channelCount + c];
+        }
+
+        FrameStatisticsOptions options;
+        std::size_t channelCount;
+        ChannelStatistics channels[kMaxChannels];
+        // gridSize(0) * gridSize(1) * channelCount means, row major, channels interleaved
+        std::vector<float> zoneMeans;
+    };
+
+    // One pass over the locked buffer per channel: histograms are kept in four
+    // interleaved copies so consecutive equal pixels do not serialize on the
+    // same counter, zone sums are vectorized when nothing is subsampled.
+    std::error_code computeFrameStatistics(PixelBuffer &buffer, FrameStatisticsOptions const &options, FrameStatistics &statistics);
+}
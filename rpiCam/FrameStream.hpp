@@ -0,0 +1,228 @@
+#pragma once
+
+#include "Config.hpp"
+#include "Camera.hpp"
+#include "ThreadPool.hpp"
+
+// the library itself builds as C++14, the coroutine interface is only
+// available to applications compiled with coroutine support
+#if defined(__has_include)
+#if __has_include(<coroutine>) && defined(__cpp_impl_coroutine)
+#define RPI_CAM_HAS_COROUTINES 1
+#endif
+#endif
+
+#if defined(RPI_CAM_HAS_COROUTINES)
+
+#include <coroutine>
+
+namespace rpiCam
+{
+    class FrameStreamExecutor
+    {
+    public:
+        virtual ~FrameStreamExecutor() {}
+
+        virtual void resume(std::coroutine_handle<> handle) = 0;
+    };
+
+    // resumes the awaiting coroutine directly on the camera delivery thread
+    class InlineFrameStreamExecutor
+        : public FrameStreamExecutor
+    {
+    public:
+        void resume(std::coroutine_handle<> handle) override
+        {
+            handle.resume();
+        }
+    };
+
+    class ThreadPoolFrameStreamExecutor
+        : public FrameStreamExecutor
+    {
+    public:
+        ThreadPoolFrameStreamExecutor(std::shared_ptr<ThreadPool> pool = ThreadPool::shared())
+            : FrameStreamExecutor()
+            , m_Pool(pool)
+        {
+        }
+
+        void resume(std::coroutine_handle<> handle) override
+        {
+            // a single handle fits the small buffer of std::function, posting does not allocate
+            m_Pool->post([handle]() { handle.resume(); });
+        }
+
+    private:
+        std::shared_ptr<ThreadPool> m_Pool;
+    };
+
+    // Awaitable stream of video frames:
+    //
+    //     VideoFrameStream frames(camera, executor);
+    //     while (auto frame = co_await frames.next())
+    //         ...
+    //
+    // Only the most recent frame is kept while nobody is awaiting, older ones
+    // are counted as dropped and released back to the camera. Stopping the
+    // video resumes a pending await with an empty buffer. The awaiter lives in
+    // the coroutine frame, so nothing is allocated per frame.
+    class VideoFrameStream
+        : public Camera::Events
+    {
+    public:
+        class Awaiter
+        {
+        public:
+            Awaiter(VideoFrameStream &stream)
+                : m_Stream(stream)
+                , m_Handle()
+                , m_Frame()
+            {
+            }
+
+            bool await_ready()
+            {
+                return m_Stream.take(m_Frame);
+            }
+
+            bool await_suspend(std::coroutine_handle<> handle)
+            {
+                m_Handle = handle;
+                return m_Stream.wait(this);
+            }
+
+            std::shared_ptr<PixelSampleBuffer> await_resume()
+            {
+                return std::move(m_Frame);
+            }
+
+        private:
+            friend class VideoFrameStream;
+
+            VideoFrameStream &m_Stream;
+            std::coroutine_handle<> m_Handle;
+            std::shared_ptr<PixelSampleBuffer> m_Frame;
+        };
+
+        VideoFrameStream(Camera const &camera, FrameStreamExecutor &executor)
+            : VideoFrameStream(camera.cameraEvents(), executor)
+        {
+        }
+
+        VideoFrameStream(Camera::CameraEvents const &events, FrameStreamExecutor &executor)
+            : Camera::Events()
+            , m_Events(events)
+            , m_Executor(executor)
+            , m_Mutex()
+            , m_Pending()
+            , m_Waiter(nullptr)
+            , m_bStopped(false)
+            , m_NumDropped(0)
+        {
+            m_Events += this;
+        }
+
+        ~VideoFrameStream()
+        {
+            m_Events -= this;
+            cancel();
+        }
+
+        inline Awaiter next() { return Awaiter(*this); }
+
+        // resumes a pending await with an empty buffer
+        void cancel()
+        {
+            resume(nullptr, true);
+        }
+
+        inline std::uint64_t numDropped() const { return m_NumDropped; }
+
+        // Camera::Events overrides
+        void onCameraVideoStarted() override
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_bStopped = false;
+        }
+
+        void onCameraVideoStopped() override
+        {
+            resume(nullptr, true);
+        }
+
+        void onCameraVideoFrame(std::shared_ptr<PixelSampleBuffer> const &buffer) override
+        {
+            resume(buffer, false);
+        }
+
+    private:
+        bool take(std::shared_ptr<PixelSampleBuffer> &frame)
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (m_Pending)
+            {
+                frame = std::move(m_Pending);
+                return true;
+            }
+            return m_bStopped;
+        }
+
+        // returns false when the frame arrived before the awaiter could be parked
+        bool wait(Awaiter *awaiter)
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (m_Pending)
+            {
+                awaiter->m_Frame = std::move(m_Pending);
+                return false;
+            }
+            if (m_bStopped)
+                return false;
+
+            m_Waiter = awaiter;
+            return true;
+        }
+
+        void resume(std::shared_ptr<PixelSampleBuffer> const &buffer, bool bStop)
+        {
+            Awaiter *waiter;
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                if (bStop)
+                {
+                    m_bStopped = true;
+                    m_Pending.reset();
+                }
+
+                waiter = m_Waiter;
+                m_Waiter = nullptr;
+
+                if (!waiter && !bStop)
+                {
+                    if (m_Pending)
+                        m_NumDropped++;
+                    m_Pending = buffer;
+                    return;
+                }
+            }
+
+            if (waiter)
+            {
+                waiter->m_Frame = buffer;
+                m_Executor.resume(waiter->m_Handle);
+            }
+        }
+
+    private:
+        Camera::CameraEvents const &m_Events;
+        FrameStreamExecutor &m_Executor;
+        std::mutex m_Mutex;
+        std::shared_ptr<PixelSampleBuffer> m_Pending;
+        Awaiter *m_Waiter;
+        bool m_bStopped;
+        std::atomic<std::uint64_t> m_NumDropped;
+    };
+}
+
+#endif //RPI_CAM_HAS_COROUTINES
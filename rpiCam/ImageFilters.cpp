@@ -0,0 +1,444 @@
+#include "ImageFilters.hpp"
+#include "Simd.hpp"
+#include "Logging.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+namespace rpiCam
+{
+    namespace
+    {
+        static constexpr std::uint32_t kWeightBits = 8;
+        static constexpr std::uint32_t kBoxReciprocalBits = 24;
+        static constexpr std::uint32_t kMaxGaussianRadius = 64;
+
+        struct Plane
+        {
+            std::uint8_t *data;
+            std::size_t rowBytes;
+            std::uint32_t width;    // in pixels
+            std::uint32_t height;
+            std::uint32_t bpp;
+        };
+
+        bool describePlanes(PixelBuffer &src, PixelBuffer &dst, std::size_t pi, Plane &s, Plane &d, char const *who)
+        {
+            ePixelFormat const format = src.format();
+            if (format != dst.format() || pi >= src.planeCount() || src.planeSize(pi) != dst.planeSize(pi))
+            {
+                RPI_LOG(ERROR, "%s: buffers differ in format or size!", who);
+                return false;
+            }
+
+            if (format == kPixelFormatYUYV || format == kPixelFormatUYVY)
+            {
+                RPI_LOG(ERROR, "%s: packed 4:2:2 formats are not supported!", who);
+                return false;
+            }
+
+            PixelFormatDescriptor const descriptor = pixelFormatDescriptor(format);
+            Vec2ui const size = src.planeSize(pi);
+            s = Plane{static_cast<std::uint8_t*>(src.planeData(pi)), src.planeRowBytes(pi), size(0), size(1), std::uint32_t(descriptor.bytesPerPixel[pi])};
+            d = Plane{static_cast<std::uint8_t*>(dst.planeData(pi)), dst.planeRowBytes(pi), size(0), size(1), std::uint32_t(descriptor.bytesPerPixel[pi])};
+            if (!s.data || !d.data)
+            {
+                RPI_LOG(ERROR, "%s: buffers not locked!", who);
+                return false;
+            }
+            return true;
+        }
+
+        // row with radius pixels replicated on both sides
+        void padRow(std::uint8_t const *row, Plane const &plane, std::uint32_t radius, std::uint8_t *padded)
+        {
+            std::uint32_t const bpp = plane.bpp;
+            std::memcpy(padded + radius * bpp, row, plane.width * bpp);
+            for (std::uint32_t k = 0; k < radius; ++k)
+            {
+                std::memcpy(padded + k * bpp, row, bpp);
+                std::memcpy(padded + (radius + plane.width + k) * bpp, row + (plane.width - 1) * bpp, bpp);
+            }
+        }
+
+        // out[i] = w0 * c[i] + sum wk * (c[i - k] + c[i + k]), c is the padded row shifted by radius
+        void gaussianRow(std::uint8_t const *center, std::uint16_t *out, std::uint32_t count, std::uint32_t bpp,
+            std::uint16_t const *weights, std::uint32_t radius, bool bSimd)
+        {
+            std::uint32_t i = 0;
+#if defined(RPI_CAM_SIMD_NEON)
+            if (bSimd)
+            {
+                for (; i + 8 <= count; i += 8)
+                {
+                    uint16x8_t acc = vmulq_n_u16(vmovl_u8(vld1_u8(center + i)), weights[0]);
+                    for (std::uint32_t k = 1; k <= radius; ++k)
+                        acc = vmlaq_n_u16(acc, vaddl_u8(vld1_u8(center + i - k * bpp), vld1_u8(center + i + k * bpp)), weights[k]);
+                    vst1q_u16(out + i, acc);
+                }
+            }
+#elif defined(RPI_CAM_SIMD_SSE2)
+            if (bSimd)
+            {
+                __m128i const zero = _mm_setzero_si128();
+                for (; i + 8 <= count; i += 8)
+                {
+                    __m128i const c = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(center + i)), zero);
+                    __m128i acc = _mm_mullo_epi16(c, _mm_set1_epi16(std::int16_t(weights[0])));
+                    for (std::uint32_t k = 1; k <= radius; ++k)
+                    {
+                        __m128i const l = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(center + i - k * bpp)), zero);
+                        __m128i const r = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(center + i + k * bpp)), zero);
+                        acc = _mm_add_epi16(acc, _mm_mullo_epi16(_mm_add_epi16(l, r), _mm_set1_epi16(std::int16_t(weights[k]))));
+                    }
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), acc);
+                }
+            }
+#endif
+            for (; i < count; ++i)
+            {
+                std::uint8_t const *c = center + i;
+                std::uint32_t acc = weights[0] * c[0];
+                for (std::uint32_t k = 1; k <= radius; ++k)
+                    acc += weights[k] * (*(c - k * bpp) + *(c + k * bpp));
+                out[i] = std::uint16_t(acc);
+            }
+        }
+
+        // out[i] = (sum wj * rows[j][i] + 2^15) >> 16 over the 2 * radius + 1 rows
+        void gaussianColumn(std::uint16_t const * const *rows, std::uint8_t *out, std::uint32_t count,
+            std::uint16_t const *weights, std::uint32_t radius, bool bSimd)
+        {
+            std::uint32_t const numRows = 2 * radius + 1;
+            std::uint32_t i = 0;
+#if defined(RPI_CAM_SIMD_NEON)
+            if (bSimd)
+            {
+                for (; i + 8 <= count; i += 8)
+                {
+                    uint32x4_t accLo = vdupq_n_u32(0);
+                    uint32x4_t accHi = vdupq_n_u32(0);
+                    for (std::uint32_t j = 0; j < numRows; ++j)
+                    {
+                        std::uint16_t const w = weights[j < radius ? radius - j : j - radius];
+                        uint16x8_t const v = vld1q_u16(rows[j] + i);
+                        accLo = vmlal_n_u16(accLo, vget_low_u16(v), w);
+                        accHi = vmlal_n_u16(accHi, vget_high_u16(v), w);
+                    }
+                    vst1_u8(out + i, vmovn_u16(vcombine_u16(vrshrn_n_u32(accLo, 2 * kWeightBits), vrshrn_n_u32(accHi, 2 * kWeightBits))));
+                }
+            }
+#elif defined(RPI_CAM_SIMD_SSE2)
+            if (bSimd)
+            {
+                __m128i const round = _mm_set1_epi32(1 << (2 * kWeightBits - 1));
+                for (; i + 8 <= count; i += 8)
+                {
+                    __m128i accLo = round;
+                    __m128i accHi = round;
+                    for (std::uint32_t j = 0; j < numRows; ++j)
+                    {
+                        __m128i const w = _mm_set1_epi16(std::int16_t(weights[j < radius ? radius - j : j - radius]));
+                        __m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(rows[j] + i));
+                        __m128i const lo = _mm_mullo_epi16(v, w);
+                        __m128i const hi = _mm_mulhi_epu16(v, w);
+                        accLo = _mm_add_epi32(accLo, _mm_unpacklo_epi16(lo, hi));
+                        accHi = _mm_add_epi32(accHi, _mm_unpackhi_epi16(lo, hi));
+                    }
+                    __m128i const packed = _mm_packs_epi32(_mm_srli_epi32(accLo, 2 * kWeightBits), _mm_srli_epi32(accHi, 2 * kWeightBits));
+                    _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(packed, packed));
+                }
+            }
+#endif
+            for (; i < count; ++i)
+            {
+                std::uint32_t acc = 1 << (2 * kWeightBits - 1);
+                for (std::uint32_t j = 0; j < numRows; ++j)
+                    acc += weights[j < radius ? radius - j : j - radius] * std::uint32_t(rows[j][i]);
+                out[i] = std::uint8_t(acc >> (2 * kWeightBits));
+            }
+        }
+
+        // running sum of 2 * radius + 1 pixels of the same channel
+        void boxRow(std::uint8_t const *padded, std::uint16_t *out, std::uint32_t count, std::uint32_t bpp, std::uint32_t radius)
+        {
+            std::uint32_t const span = 2 * radius * bpp;
+            for (std::uint32_t c = 0; c < bpp && c < count; ++c)
+            {
+                std::uint32_t sum = 0;
+                for (std::uint32_t k = 0; k <= span; k += bpp)
+                    sum += padded[c + k];
+                out[c] = std::uint16_t(sum);
+            }
+            for (std::uint32_t i = bpp; i < count; ++i)
+                out[i] = std::uint16_t(out[i - bpp] + padded[i + span] - padded[i - bpp]);
+        }
+
+        // writes the mean of every column sum, then moves the sums one row down
+        void boxColumn(std::uint32_t *sums, std::uint16_t const *entering, std::uint16_t const *leaving, std::uint8_t *out,
+            std::uint32_t count, std::uint32_t reciprocal, bool bSimd)
+        {
+            std::uint32_t i = 0;
+#if defined(RPI_CAM_SIMD_NEON)
+            if (bSimd)
+            {
+                for (; i + 8 <= count; i += 8)
+                {
+                    uint32x4_t lo = vld1q_u32(sums + i);
+                    uint32x4_t hi = vld1q_u32(sums + i + 4);
+                    uint16x4_t const meanLo = vqmovn_u32(vrshrq_n_u32(vmulq_n_u32(lo, reciprocal), kBoxReciprocalBits));
+                    uint16x4_t const meanHi = vqmovn_u32(vrshrq_n_u32(vmulq_n_u32(hi, reciprocal), kBoxReciprocalBits));
+                    vst1_u8(out + i, vqmovn_u16(vcombine_u16(meanLo, meanHi)));
+
+                    uint16x8_t const in = vld1q_u16(entering + i);
+                    uint16x8_t const off = vld1q_u16(leaving + i);
+                    lo = vsubw_u16(vaddw_u16(lo, vget_low_u16(in)), vget_low_u16(off));
+                    hi = vsubw_u16(vaddw_u16(hi, vget_high_u16(in)), vget_high_u16(off));
+                    vst1q_u32(sums + i, lo);
+                    vst1q_u32(sums + i + 4, hi);
+                }
+            }
+#elif defined(RPI_CAM_SIMD_SSE2)
+            if (bSimd)
+            {
+                __m128i const zero = _mm_setzero_si128();
+                __m128i const round = _mm_set1_epi32(1 << (kBoxReciprocalBits - 1));
+                __m128i const r = _mm_set1_epi32(int(reciprocal));
+                // low 32 bits of a 32x32 bit product, SSE2 only multiplies lanes 0 and 2
+                auto mul = [&r](__m128i v)
+                {
+                    __m128i const p02 = _mm_mul_epu32(v, r);
+                    __m128i const p13 = _mm_mul_epu32(_mm_srli_epi64(v, 32), r);
+                    return _mm_unpacklo_epi32(_mm_shuffle_epi32(p02, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(p13, _MM_SHUFFLE(0, 0, 2, 0)));
+                };
+                for (; i + 8 <= count; i += 8)
+                {
+                    __m128i lo = _mm_loadu_si128(reinterpret_cast<__m128i const*>(sums + i));
+                    __m128i hi = _mm_loadu_si128(reinterpret_cast<__m128i const*>(sums + i + 4));
+                    __m128i const means = _mm_packs_epi32(
+                        _mm_srli_epi32(_mm_add_epi32(mul(lo), round), kBoxReciprocalBits),
+                        _mm_srli_epi32(_mm_add_epi32(mul(hi), round), kBoxReciprocalBits));
+                    _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(means, means));
+
+                    __m128i const in = _mm_loadu_si128(reinterpret_cast<__m128i const*>(entering + i));
+                    __m128i const off = _mm_loadu_si128(reinterpret_cast<__m128i const*>(leaving + i));
+                    lo = _mm_sub_epi32(_mm_add_epi32(lo, _mm_unpacklo_epi16(in, zero)), _mm_unpacklo_epi16(off, zero));
+                    hi = _mm_sub_epi32(_mm_add_epi32(hi, _mm_unpackhi_epi16(in, zero)), _mm_unpackhi_epi16(off, zero));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(sums + i), lo);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(sums + i + 4), hi);
+                }
+            }
+#endif
+            for (; i < count; ++i)
+            {
+                std::uint32_t const mean = (sums[i] * reciprocal + (1u << (kBoxReciprocalBits - 1))) >> kBoxReciprocalBits;
+                out[i] = std::uint8_t(std::min<std::uint32_t>(mean, 255));
+                sums[i] = sums[i] + entering[i] - leaving[i];
+            }
+        }
+
+        std::shared_ptr<MemoryPixelSampleBuffer> makeDestination(PixelBuffer &src, std::shared_ptr<BufferArena> const &arena)
+        {
+            return arena ?
+                std::make_shared<MemoryPixelSampleBuffer>(src.format(), src.planeSize(0), arena) :
+                std::make_shared<MemoryPixelSampleBuffer>(src.format(), src.planeSize(0));
+        }
+
+        inline std::uint32_t clampRow(std::int64_t y, std::uint32_t height)
+        {
+            return std::uint32_t(std::max<std::int64_t>(0, std::min<std::int64_t>(height - 1, y)));
+        }
+    }
+
+    constexpr float GaussianFilter::kMinSigma;
+    constexpr float GaussianFilter::kMaxSigma;
+    constexpr std::uint32_t BoxFilter::kMaxRadius;
+
+    GaussianFilter::GaussianFilter(float sigma)
+        : m_Sigma(std::max(kMinSigma, std::min(kMaxSigma, sigma)))
+        , m_bSimdEnabled(true)
+        , m_Weights()
+        , m_PaddedRow()
+        , m_Rows()
+    {
+        prepareWeights();
+    }
+
+    GaussianFilter::~GaussianFilter()
+    {
+    }
+
+    std::error_code GaussianFilter::setSigma(float sigma)
+    {
+        if (!(sigma >= kMinSigma && sigma <= kMaxSigma))
+        {
+            RPI_LOG(ERROR, "GaussianFilter::setSigma(): sigma out of range!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+        m_Sigma = sigma;
+        prepareWeights();
+        return std::error_code();
+    }
+
+    std::error_code GaussianFilter::apply(PixelBuffer &src, PixelBuffer &dst)
+    {
+        for (std::size_t pi = 0; pi < src.planeCount(); ++pi)
+        {
+            if (std::error_code ec = applyPlane(src, dst, pi))
+                return ec;
+        }
+        return std::error_code();
+    }
+
+    std::error_code GaussianFilter::applyPlane(PixelBuffer &src, PixelBuffer &dst, std::size_t pi)
+    {
+        Plane s, d;
+        if (!describePlanes(src, dst, pi, s, d, "GaussianFilter::applyPlane()"))
+            return std::make_error_code(std::errc::invalid_argument);
+
+        std::uint32_t const radius = this->radius();
+        std::uint32_t const numRows = 2 * radius + 1;
+        std::uint32_t const count = s.width * s.bpp;
+        m_PaddedRow.resize((s.width + 2 * radius) * s.bpp);
+        m_Rows.resize(std::size_t(numRows) * count);
+
+        std::array<std::uint16_t const*, 2 * kMaxGaussianRadius + 1> rows;
+        std::uint32_t numFiltered = 0;
+        for (std::uint32_t y = 0; y < s.height; ++y)
+        {
+            // every source row is read before the output row it can overlap is written
+            for (; numFiltered < s.height && numFiltered <= y + radius; ++numFiltered)
+            {
+                padRow(s.data + numFiltered * s.rowBytes, s, radius, m_PaddedRow.data());
+                gaussianRow(m_PaddedRow.data() + radius * s.bpp, m_Rows.data() + (numFiltered % numRows) * count,
+                    count, s.bpp, m_Weights.data(), radius, m_bSimdEnabled);
+            }
+
+            for (std::uint32_t j = 0; j < numRows; ++j)
+                rows[j] = m_Rows.data() + (clampRow(std::int64_t(y) + j - radius, s.height) % numRows) * count;
+
+            gaussianColumn(rows.data(), d.data + y * d.rowBytes, count, m_Weights.data(), radius, m_bSimdEnabled);
+        }
+        return std::error_code();
+    }
+
+    std::shared_ptr<MemoryPixelSampleBuffer> GaussianFilter::apply(PixelBuffer &src, std::shared_ptr<BufferArena> const &arena)
+    {
+        std::shared_ptr<MemoryPixelSampleBuffer> dst = makeDestination(src, arena);
+        if (apply(src, *dst))
+            return std::shared_ptr<MemoryPixelSampleBuffer>();
+        return dst;
+    }
+
+    void GaussianFilter::prepareWeights()
+    {
+        std::uint32_t const radius = std::min(kMaxGaussianRadius, std::uint32_t(std::ceil(3.0f * m_Sigma)));
+        std::vector<float> gauss(radius + 1);
+        float total = 0.0f;
+        for (std::uint32_t k = 0; k <= radius; ++k)
+        {
+            gauss[k] = std::exp(-float(k * k) / (2.0f * m_Sigma * m_Sigma));
+            total += k ? 2.0f * gauss[k] : gauss[k];
+        }
+
+        // outer taps that round to 0 are dropped, the center takes the rounding error
+        m_Weights.assign(radius + 1, 0);
+        std::uint32_t sum = 0;
+        for (std::uint32_t k = 1; k <= radius; ++k)
+        {
+            m_Weights[k] = std::uint16_t(std::lround(gauss[k] / total * (1 << kWeightBits)));
+            sum += 2 * m_Weights[k];
+        }
+        m_Weights[0] = std::uint16_t((1 << kWeightBits) - sum);
+        while (m_Weights.size() > 1 && !m_Weights.back())
+            m_Weights.pop_back();
+    }
+
+    BoxFilter::BoxFilter(Vec2ui const &radius)
+        : m_Radius(radius.cwiseMin(Vec2ui(kMaxRadius, kMaxRadius)))
+        , m_bSimdEnabled(true)
+        , m_PaddedRow()
+        , m_Rows()
+        , m_ColumnSums()
+    {
+    }
+
+    BoxFilter::~BoxFilter()
+    {
+    }
+
+    std::error_code BoxFilter::setRadius(Vec2ui const &radius)
+    {
+        if (radius(0) > kMaxRadius || radius(1) > kMaxRadius)
+        {
+            RPI_LOG(ERROR, "BoxFilter::setRadius(): radius out of range!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+        m_Radius = radius;
+        return std::error_code();
+    }
+
+    std::error_code BoxFilter::apply(PixelBuffer &src, PixelBuffer &dst)
+    {
+        for (std::size_t pi = 0; pi < src.planeCount(); ++pi)
+        {
+            if (std::error_code ec = applyPlane(src, dst, pi))
+                return ec;
+        }
+        return std::error_code();
+    }
+
+    std::error_code BoxFilter::applyPlane(PixelBuffer &src, PixelBuffer &dst, std::size_t pi)
+    {
+        Plane s, d;
+        if (!describePlanes(src, dst, pi, s, d, "BoxFilter::applyPlane()"))
+            return std::make_error_code(std::errc::invalid_argument);
+
+        std::uint32_t const rx = m_Radius(0);
+        std::uint32_t const ry = m_Radius(1);
+        std::uint32_t const numRows = 2 * ry + 2;
+        std::uint32_t const count = s.width * s.bpp;
+        std::uint32_t const area = (2 * rx + 1) * (2 * ry + 1);
+        std::uint32_t const reciprocal = std::uint32_t(((std::uint64_t(1) << kBoxReciprocalBits) + area / 2) / area);
+        m_PaddedRow.resize((s.width + 2 * rx) * s.bpp);
+        m_Rows.resize(std::size_t(numRows) * count);
+        m_ColumnSums.assign(count, 0);
+
+        std::uint32_t numSummed = 0;
+        auto row = [&](std::int64_t y) -> std::uint16_t const*
+        {
+            std::uint32_t const yc = clampRow(y, s.height);
+            for (; numSummed <= yc; ++numSummed)
+            {
+                padRow(s.data + numSummed * s.rowBytes, s, rx, m_PaddedRow.data());
+                boxRow(m_PaddedRow.data(), m_Rows.data() + (numSummed % numRows) * count, count, s.bpp, rx);
+            }
+            return m_Rows.data() + (yc % numRows) * count;
+        };
+
+        for (std::int64_t j = -std::int64_t(ry); j <= std::int64_t(ry); ++j)
+        {
+            std::uint16_t const *sums = row(j);
+            for (std::uint32_t i = 0; i < count; ++i)
+                m_ColumnSums[i] += sums[i];
+        }
+
+        for (std::uint32_t y = 0; y < s.height; ++y)
+        {
+            // the entering row is summed before row y is written, which keeps dst == src valid
+            std::uint16_t const *entering = row(std::int64_t(y) + ry + 1);
+            std::uint16_t const *leaving = row(std::int64_t(y) - ry);
+            boxColumn(m_ColumnSums.data(), entering, leaving, d.data + y * d.rowBytes, count, reciprocal, m_bSimdEnabled);
+        }
+        return std::error_code();
+    }
+
+    std::shared_ptr<MemoryPixelSampleBuffer> BoxFilter::apply(PixelBuffer &src, std::shared_ptr<BufferArena> const &arena)
+    {
+        std::shared_ptr<MemoryPixelSampleBuffer> dst = makeDestination(src, arena);
+        if (apply(src, *dst))
+            return std::shared_ptr<MemoryPixelSampleBuffer>();
+        return dst;
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Config.hpp"
+#include "PixelBuffer.hpp"
+#include "MemoryPixelSampleBuffer.hpp"
+#include "BufferArena.hpp"
+#include <vector>
+#include <system_error>
+
+namespace rpiCam
+{
+    // Separable Gaussian blur with 8 bit weights summing to 256. The
+    // horizontal pass folds the symmetric taps and keeps exact 16 bit sums,
+    // the vertical pass accumulates in 32 bits and rounds once, so the vector
+    // and scalar kernels agree bit for bit. Rows go through a ring of 2r + 1
+    // horizontally filtered rows, which keeps the working set in cache and
+    // lets dst be src. Edges are replicated. Every plane is filtered, packed
+    // 4:2:2 formats are not supported.
+    class GaussianFilter
+    {
+    public:
+        static constexpr float kMinSigma = 0.5f;
+        static constexpr float kMaxSigma = 20.0f;
+
+        GaussianFilter(float sigma = 1.0f);
+        ~GaussianFilter();
+
+        inline float sigma() const { return m_Sigma; }
+        std::error_code setSigma(float sigma);
+
+        // taps on each side of the center
+        inline std::uint32_t radius() const { return std::uint32_t(m_Weights.size() - 1); }
+
+        inline bool isSimdEnabled() const { return m_bSimdEnabled; }
+        inline void setSimdEnabled(bool bEnabled) { m_bSimdEnabled = bEnabled; }
+
+        // both buffers must be locked with the same format and size, dst may be src
+        std::error_code apply(PixelBuffer &src, PixelBuffer &dst);
+        std::error_code applyPlane(PixelBuffer &src, PixelBuffer &dst, std::size_t pi);
+
+        // into a new buffer, taken from arena when there is one
+        std::shared_ptr<MemoryPixelSampleBuffer> apply(PixelBuffer &src, std::shared_ptr<BufferArena> const &arena = nullptr);
+
+    private:
+        void prepareWeights();
+
+    private:
+        float m_Sigma;
+        bool m_bSimdEnabled;
+        std::vector<std::uint16_t> m_Weights;   // center first
+        std::vector<std::uint8_t> m_PaddedRow;
+        std::vector<std::uint16_t> m_Rows;
+    };
+
+    // Mean over a (2 * radius + 1) window with sliding sums: a running sum
+    // along every row and per-column sums updated by one entering and one
+    // leaving row, so the cost per pixel does not depend on the radius. The
+    // division is a Q24 reciprocal multiply. Same ring buffer, in-place and
+    // edge handling as GaussianFilter.
+    class BoxFilter
+    {
+    public:
+        static constexpr std::uint32_t kMaxRadius = 127;
+
+        BoxFilter(Vec2ui const &radius = Vec2ui(1, 1));
+        ~BoxFilter();
+
+        inline Vec2ui const& radius() const { return m_Radius; }
+        std::error_code setRadius(Vec2ui const &radius);
+
+        inline bool isSimdEnabled() const { return m_bSimdEnabled; }
+        inline void setSimdEnabled(bool bEnabled) { m_bSimdEnabled = bEnabled; }
+
+        std::error_code apply(PixelBuffer &src, PixelBuffer &dst);
+        std::error_code applyPlane(PixelBuffer &src, PixelBuffer &dst, std::size_t pi);
+        std::shared_ptr<MemoryPixelSampleBuffer> apply(PixelBuffer &src, std::shared_ptr<BufferArena> const &arena = nullptr);
+
+    private:
+        Vec2ui m_Radius;
+        bool m_bSimdEnabled;
+        std::vector<std::uint8_t> m_PaddedRow;
+        std::vector<std::uint16_t> m_Rows;
+        std::vector<std::uint32_t> m_ColumnSums;
+    };
+}
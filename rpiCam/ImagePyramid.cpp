@@ -0,0 +1,248 @@
+#include "ImagePyramid.hpp"
+#include "PixelSampleBuffer.hpp"
+#include "Logging.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace rpiCam
+{
+    ImagePyramid::LevelBuffer::LevelBuffer()
+        : Buffer()
+        , PixelBuffer()
+        , m_Format(kPixelFormatInvalid)
+        , m_PlaneCount(0)
+    {
+        for (std::size_t pi = 0; pi < PixelFormatDescriptor::kMaxPlanes; ++pi)
+        {
+            m_PlaneSize[pi] = Vec2ui(0, 0);
+            m_PlaneData[pi] = nullptr;
+            m_PlaneRowBytes[pi] = 0;
+        }
+    }
+
+    ImagePyramid::LevelBuffer::~LevelBuffer()
+    {
+    }
+
+    bool ImagePyramid::LevelBuffer::isValid() const
+    {
+        return m_PlaneCount && m_PlaneData[0];
+    }
+
+    void* ImagePyramid::LevelBuffer::data()
+    {
+        return m_PlaneData[0];
+    }
+
+    std::size_t ImagePyramid::LevelBuffer::size() const
+    {
+        std::size_t bytes = 0;
+        for (std::size_t pi = 0; pi < m_PlaneCount; ++pi)
+            bytes += m_PlaneRowBytes[pi] * m_PlaneSize[pi](1);
+        return bytes;
+    }
+
+    ePixelFormat ImagePyramid::LevelBuffer::format() const
+    {
+        return m_Format;
+    }
+
+    std::size_t ImagePyramid::LevelBuffer::planeCount() const
+    {
+        return m_PlaneCount;
+    }
+
+    Vec2ui ImagePyramid::LevelBuffer::planeSize(std::size_t pi) const
+    {
+        if (pi >= m_PlaneCount)
+            return Vec2ui(0, 0);
+
+        return m_PlaneSize[pi];
+    }
+
+    void* ImagePyramid::LevelBuffer::planeData(std::size_t pi)
+    {
+        if (pi >= m_PlaneCount)
+            return nullptr;
+
+        return m_PlaneData[pi];
+    }
+
+    std::size_t ImagePyramid::LevelBuffer::planeRowBytes(std::size_t pi) const
+    {
+        if (pi >= m_PlaneCount)
+            return 0;
+
+        return m_PlaneRowBytes[pi];
+    }
+
+    ImagePyramid::ImagePyramid(PixelSampleBuffer &base)
+        : m_Base(base)
+        , m_Arena(BufferArena::shared())
+        , m_Format(base.format())
+        , m_Descriptor(pixelFormatDescriptor(m_Format))
+        , m_Size(base.planeSize(0))
+        , m_Levels()
+    {
+        for (std::size_t li = 1; li <= kNumLevels; ++li)
+        {
+            Level &level = m_Levels[li - 1];
+            Vec2ui const size = levelSize(li);
+
+            level.all.m_Format = m_Format;
+            level.all.m_PlaneCount = m_Descriptor.planeCount;
+            for (std::size_t pi = 0; pi < m_Descriptor.planeCount; ++pi)
+            {
+                level.bPlaneReady[pi].store(false, std::memory_order_relaxed);
+                level.all.m_PlaneSize[pi] = Vec2ui(size(0) >> m_Descriptor.widthShift[pi], size(1) >> m_Descriptor.heightShift[pi]);
+                level.all.m_PlaneRowBytes[pi] =
+                    (level.all.m_PlaneSize[pi](0) * m_Descriptor.bytesPerPixel[pi] + BufferArena::kAlignment - 1) & ~(BufferArena::kAlignment - 1);
+            }
+
+            // the Y plane of the full level seen as a GRAY8 buffer
+            if (m_Descriptor.bytesPerPixel[0] == 1)
+            {
+                level.luma.m_Format = kPixelFormatGRAY8;
+                level.luma.m_PlaneCount = 1;
+                level.luma.m_PlaneSize[0] = level.all.m_PlaneSize[0];
+                level.luma.m_PlaneRowBytes[0] = level.all.m_PlaneRowBytes[0];
+            }
+        }
+    }
+
+    ImagePyramid::~ImagePyramid()
+    {
+    }
+
+    void ImagePyramid::setArena(std::shared_ptr<BufferArena> const &arena)
+    {
+        m_Arena = arena ? arena : BufferArena::shared();
+    }
+
+    Vec2ui ImagePyramid::levelSize(std::size_t li) const
+    {
+        if (li > kNumLevels)
+            return Vec2ui(0, 0);
+
+        return Vec2ui(m_Size(0) >> li, m_Size(1) >> li);
+    }
+
+    PixelBuffer* ImagePyramid::level(std::size_t li, Planes planes)
+    {
+        if (li < 1 || li > kNumLevels)
+        {
+            RPI_LOG(ERROR, "ImagePyramid::level(): level out of range!");
+            return nullptr;
+        }
+
+        Level &level = m_Levels[li - 1];
+        if (planes == Planes::Luma)
+        {
+            if (!level.luma.m_PlaneCount)
+            {
+                RPI_LOG(ERROR, "ImagePyramid::level(): no separate luma plane in this format!");
+                return nullptr;
+            }
+            return ensurePlane(li, 0) ? &level.luma : nullptr;
+        }
+
+        for (std::size_t pi = 0; pi < m_Descriptor.planeCount; ++pi)
+        {
+            if (!ensurePlane(li, pi))
+                return nullptr;
+        }
+        return m_Descriptor.planeCount ? &level.all : nullptr;
+    }
+
+    bool ImagePyramid::isLevelReady(std::size_t li, Planes planes) const
+    {
+        if (li < 1 || li > kNumLevels || !m_Descriptor.planeCount)
+            return false;
+
+        Level const &level = m_Levels[li - 1];
+        std::size_t const count = planes == Planes::Luma ? 1 : m_Descriptor.planeCount;
+        for (std::size_t pi = 0; pi < count; ++pi)
+        {
+            if (!level.bPlaneReady[pi].load(std::memory_order_acquire))
+                return false;
+        }
+        return true;
+    }
+
+    bool ImagePyramid::ensurePlane(std::size_t li, std::size_t pi)
+    {
+        Level &level = m_Levels[li - 1];
+        if (level.bPlaneReady[pi].load(std::memory_order_acquire))
+            return true;
+
+        // levels are locked top down one at a time, the level above is complete before this one is locked
+        if (li > 1 && !ensurePlane(li - 1, pi))
+            return false;
+
+        std::lock_guard<std::mutex> lock(level.mutex);
+        if (level.bPlaneReady[pi].load(std::memory_order_relaxed))
+            return true;
+
+        if (!computePlane(li, pi))
+            return false;
+
+        level.bPlaneReady[pi].store(true, std::memory_order_release);
+        return true;
+    }
+
+    bool ImagePyramid::computePlane(std::size_t li, std::size_t pi)
+    {
+        Level &level = m_Levels[li - 1];
+        Vec2ui const &size = level.all.m_PlaneSize[pi];
+        if (!size(0) || !size(1))
+        {
+            RPI_LOG(ERROR, "ImagePyramid::computePlane(): frame too small for level %d!", int(li));
+            return false;
+        }
+
+        if (!level.planeMemory[pi])
+        {
+            level.planeMemory[pi] = m_Arena->allocate(level.all.m_PlaneRowBytes[pi] * size(1));
+            level.all.m_PlaneData[pi] = level.planeMemory[pi].get();
+            if (pi == 0)
+                level.luma.m_PlaneData[0] = level.all.m_PlaneData[0];
+        }
+
+        if (li > 1)
+            return !level.scaler.scalePlane(m_Levels[li - 2].all, level.all, pi);
+
+        if (m_Base.lock())
+        {
+            RPI_LOG(ERROR, "ImagePyramid::computePlane(): failed to lock the frame!");
+            return false;
+        }
+
+        bool const bScaled = !level.scaler.scalePlane(m_Base, level.all, pi);
+        m_Base.unlock();
+        return bScaled;
+    }
+
+    std::istream& operator>>(std::istream &s, ImagePyramid::Planes &v)
+    {
+        std::string sv;
+        s >> sv;
+        if (sv == "Luma")
+            v = ImagePyramid::Planes::Luma;
+        else if (sv == "All")
+            v = ImagePyramid::Planes::All;
+        else
+            throw std::invalid_argument("Invalid value for ImagePyramid::Planes: " + sv);
+        return s;
+    }
+
+    std::ostream& operator<<(std::ostream &s, ImagePyramid::Planes v)
+    {
+        switch(v)
+        {
+        case ImagePyramid::Planes::Luma:    s << "Luma";    break;
+        case ImagePyramid::Planes::All:     s << "All";     break;
+        }
+        return s;
+    }
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Config.hpp"
+#include "PixelBuffer.hpp"
+#include "ImageScaler.hpp"
+#include "BufferArena.hpp"
+
+namespace rpiCam
+{
+    class PixelSampleBuffer;
+
+    // Downscaled copies of one frame at 1/2, 1/4 and 1/8 of its size. A plane
+    // of a level is computed from the level above on first request and shared
+    // by every subscriber holding the frame. Level memory comes from a
+    // BufferArena and goes back to it when the frame is released.
+    class ImagePyramid
+    {
+    public:
+        static constexpr std::size_t kNumLevels = 3;
+
+        enum class Planes : int
+        {
+            Luma,   // GRAY8 levels of the Y plane
+            All     // levels in the format of the frame, chroma included
+        };
+
+        ImagePyramid(PixelSampleBuffer &base);
+        ~ImagePyramid();
+
+        // must be called before the first level is requested
+        void setArena(std::shared_ptr<BufferArena> const &arena);
+
+        // size of level li, 1 <= li <= kNumLevels, the base frame is level 0
+        Vec2ui levelSize(std::size_t li) const;
+
+        // Returns the level, computing whatever is missing, or nullptr on
+        // failure. Luma levels need a frame with a separate Y plane. The
+        // buffer stays valid as long as the frame and needs no locking.
+        PixelBuffer* level(std::size_t li, Planes planes = Planes::Luma);
+
+        bool isLevelReady(std::size_t li, Planes planes = Planes::Luma) const;
+
+    private:
+        class LevelBuffer
+            : public PixelBuffer
+        {
+        public:
+            LevelBuffer();
+            ~LevelBuffer();
+
+            // Buffer overrides
+            bool isValid() const override;
+            void* data() override;
+            std::size_t size() const override;
+
+            // PixelBuffer overrides
+            ePixelFormat format() const override;
+            std::size_t planeCount() const override;
+            Vec2ui planeSize(std::size_t pi = 0) const override;
+            void* planeData(std::size_t pi = 0) override;
+            std::size_t planeRowBytes(std::size_t pi = 0) const override;
+
+            ePixelFormat m_Format;
+            std::size_t m_PlaneCount;
+            Vec2ui m_PlaneSize[PixelFormatDescriptor::kMaxPlanes];
+            std::uint8_t *m_PlaneData[PixelFormatDescriptor::kMaxPlanes];
+            std::size_t m_PlaneRowBytes[PixelFormatDescriptor::kMaxPlanes];
+        };
+
+        struct Level
+        {
+            std::mutex mutex;
+            std::atomic<bool> bPlaneReady[PixelFormatDescriptor::kMaxPlanes];
+            std::shared_ptr<std::uint8_t> planeMemory[PixelFormatDescriptor::kMaxPlanes];
+            LevelBuffer all;
+            LevelBuffer luma;
+            ImageScaler scaler;
+        };
+
+        bool ensurePlane(std::size_t li, std::size_t pi);
+        bool computePlane(std::size_t li, std::size_t pi);
+
+    private:
+        PixelSampleBuffer &m_Base;
+        std::shared_ptr<BufferArena> m_Arena;
+        ePixelFormat m_Format;
+        PixelFormatDescriptor m_Descriptor;
+        Vec2ui m_Size;
+        Level m_Levels[kNumLevels];
+    };
+
+    extern std::istream& operator>>(std::istream &s, ImagePyramid::Planes &v);
+    extern std::ostream& operator<<(std::ostream &s, ImagePyramid::Planes v);
+}
@@ -0,0 +1,609 @@
+#include "ImageScaler.hpp"
+#include "Simd.hpp"
+#include "Logging.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace rpiCam
+{
+    namespace
+    {
+        // bilinear weights have 7 fractional bits, the horizontal pass keeps
+        // 15 bit intermediates and the vertical pass drops all 14 at once
+        static constexpr std::uint32_t kWeightBits = 7;
+        static constexpr std::uint32_t kWeightOne = 1 << kWeightBits;
+
+        // area reciprocals are Q32 rounded down, so a sum of area whites never
+        // rounds above 255; column sums stay 16 bit up to this many rows
+        static constexpr std::uint32_t kReciprocalBits = 32;
+        static constexpr std::uint32_t kMaxNarrowSumRows = 257;
+
+        void box2Row(std::uint8_t const *r0, std::uint8_t const *r1, std::uint8_t *dst, std::uint32_t width, bool bSimd)
+        {
+            std::uint32_t x = 0;
+#if defined(RPI_CAM_SIMD_NEON)
+            if (bSimd)
+            {
+                for (; x + 8 <= width; x += 8)
+                {
+                    uint16x8_t sum = vpaddlq_u8(vld1q_u8(r0 + 2 * x));
+                    sum = vpadalq_u8(sum, vld1q_u8(r1 + 2 * x));
+                    vst1_u8(dst + x, vrshrn_n_u16(sum, 2));
+                }
+            }
+#elif defined(RPI_CAM_SIMD_SSE2)
+            if (bSimd)
+            {
+                __m128i const mask = _mm_set1_epi16(0x00ff);
+                __m128i const round = _mm_set1_epi16(2);
+                for (; x + 16 <= width; x += 16)
+                {
+                    __m128i sum[2];
+                    for (int h = 0; h < 2; ++h)
+                    {
+                        __m128i const a = _mm_loadu_si128(reinterpret_cast<__m128i const*>(r0 + 2 * x + 16 * h));
+                        __m128i const b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(r1 + 2 * x + 16 * h));
+                        __m128i s = _mm_add_epi16(_mm_and_si128(a, mask), _mm_srli_epi16(a, 8));
+                        s = _mm_add_epi16(s, _mm_and_si128(b, mask));
+                        s = _mm_add_epi16(s, _mm_srli_epi16(b, 8));
+                        sum[h] = _mm_srli_epi16(_mm_add_epi16(s, round), 2);
+                    }
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(sum[0], sum[1]));
+                }
+            }
+#else
+            (void)bSimd;
+#endif
+            for (; x < width; ++x)
+                dst[x] = std::uint8_t((r0[2 * x] + r0[2 * x + 1] + r1[2 * x] + r1[2 * x + 1] + 2) >> 2);
+        }
+
+        void box4Row(std::uint8_t const * const r[4], std::uint8_t *dst, std::uint32_t width, bool bSimd)
+        {
+            std::uint32_t x = 0;
+#if defined(RPI_CAM_SIMD_NEON)
+            if (bSimd)
+            {
+                for (; x + 8 <= width; x += 8)
+                {
+                    uint16x4_t half[2];
+                    for (int h = 0; h < 2; ++h)
+                    {
+                        std::size_t const o = 4 * x + 16 * h;
+                        uint16x8_t sum = vpaddlq_u8(vld1q_u8(r[0] + o));
+                        sum = vpadalq_u8(sum, vld1q_u8(r[1] + o));
+                        sum = vpadalq_u8(sum, vld1q_u8(r[2] + o));
+                        sum = vpadalq_u8(sum, vld1q_u8(r[3] + o));
+                        half[h] = vpadd_u16(vget_low_u16(sum), vget_high_u16(sum));
+                    }
+                    vst1_u8(dst + x, vrshrn_n_u16(vcombine_u16(half[0], half[1]), 4));
+                }
+            }
+#elif defined(RPI_CAM_SIMD_SSE2)
+            if (bSimd)
+            {
+                __m128i const mask = _mm_set1_epi16(0x00ff);
+                __m128i const ones = _mm_set1_epi16(1);
+                __m128i const round = _mm_set1_epi32(8);
+                for (; x + 8 <= width; x += 8)
+                {
+                    __m128i quad[2];
+                    for (int h = 0; h < 2; ++h)
+                    {
+                        __m128i pairs = _mm_setzero_si128();
+                        for (int ir = 0; ir < 4; ++ir)
+                        {
+                            __m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(r[ir] + 4 * x + 16 * h));
+                            pairs = _mm_add_epi16(pairs, _mm_add_epi16(_mm_and_si128(v, mask), _mm_srli_epi16(v, 8)));
+                        }
+                        quad[h] = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(pairs, ones), round), 4);
+                    }
+                    __m128i const packed = _mm_packs_epi32(quad[0], quad[1]);
+                    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(packed, packed));
+                }
+            }
+#else
+            (void)bSimd;
+#endif
+            for (; x < width; ++x)
+            {
+                std::uint32_t sum = 8;
+                for (int ir = 0; ir < 4; ++ir)
+                    sum += r[ir][4 * x] + r[ir][4 * x + 1] + r[ir][4 * x + 2] + r[ir][4 * x + 3];
+                dst[x] = std::uint8_t(sum >> 4);
+            }
+        }
+
+        // dst = (r0 * (128 - w) + r1 * w) / 2^14 over count intermediates
+        void blendRows(std::uint16_t const *r0, std::uint16_t const *r1, std::uint32_t w, std::uint8_t *dst, std::size_t count, bool bSimd)
+        {
+            std::uint32_t const w0 = kWeightOne - w;
+            std::size_t i = 0;
+#if defined(RPI_CAM_SIMD_NEON)
+            if (bSimd)
+            {
+                uint16x4_t const vw0 = vdup_n_u16(std::uint16_t(w0));
+                uint16x4_t const vw1 = vdup_n_u16(std::uint16_t(w));
+                for (; i + 8 <= count; i += 8)
+                {
+                    uint16x8_t const a = vld1q_u16(r0 + i);
+                    uint16x8_t const b = vld1q_u16(r1 + i);
+                    uint32x4_t lo = vmull_u16(vget_low_u16(a), vw0);
+                    uint32x4_t hi = vmull_u16(vget_high_u16(a), vw0);
+                    lo = vmlal_u16(lo, vget_low_u16(b), vw1);
+                    hi = vmlal_u16(hi, vget_high_u16(b), vw1);
+                    uint16x8_t const v = vcombine_u16(vrshrn_n_u32(lo, 14), vrshrn_n_u32(hi, 14));
+                    vst1_u8(dst + i, vmovn_u16(v));
+                }
+            }
+#elif defined(RPI_CAM_SIMD_SSE2)
+            if (bSimd)
+            {
+                // intermediates are below 2^15 so the signed madd is exact
+                __m128i const weights = _mm_set1_epi32(int((w << 16) | w0));
+                __m128i const round = _mm_set1_epi32(1 << 13);
+                for (; i + 16 <= count; i += 16)
+                {
+                    __m128i words[2];
+                    for (int h = 0; h < 2; ++h)
+                    {
+                        __m128i const a = _mm_loadu_si128(reinterpret_cast<__m128i const*>(r0 + i + 8 * h));
+                        __m128i const b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(r1 + i + 8 * h));
+                        __m128i const lo = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(a, b), weights), round), 14);
+                        __m128i const hi = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(a, b), weights), round), 14);
+                        words[h] = _mm_packs_epi32(lo, hi);
+                    }
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(words[0], words[1]));
+                }
+            }
+#else
+            (void)bSimd;
+#endif
+            for (; i < count; ++i)
+                dst[i] = std::uint8_t((r0[i] * w0 + r1[i] * w + (1 << 13)) >> 14);
+        }
+
+        void accumulateRow(std::uint16_t *sum, std::uint8_t const *src, std::size_t count, bool bSimd)
+        {
+            std::size_t i = 0;
+#if defined(RPI_CAM_SIMD_NEON)
+            if (bSimd)
+            {
+                for (; i + 16 <= count; i += 16)
+                {
+                    uint8x16_t const v = vld1q_u8(src + i);
+                    vst1q_u16(sum + i, vaddw_u8(vld1q_u16(sum + i), vget_low_u8(v)));
+                    vst1q_u16(sum + i + 8, vaddw_u8(vld1q_u16(sum + i + 8), vget_high_u8(v)));
+                }
+            }
+#elif defined(RPI_CAM_SIMD_SSE2)
+            if (bSimd)
+            {
+                __m128i const zero = _mm_setzero_si128();
+                for (; i + 16 <= count; i += 16)
+                {
+                    __m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+                    __m128i *s = reinterpret_cast<__m128i*>(sum + i);
+                    _mm_storeu_si128(s, _mm_add_epi16(_mm_loadu_si128(s), _mm_unpacklo_epi8(v, zero)));
+                    _mm_storeu_si128(s + 1, _mm_add_epi16(_mm_loadu_si128(s + 1), _mm_unpackhi_epi8(v, zero)));
+                }
+            }
+#else
+            (void)bSimd;
+#endif
+            for (; i < count; ++i)
+                sum[i] += src[i];
+        }
+
+        void accumulateRow(std::uint32_t *sum, std::uint8_t const *src, std::size_t count, bool)
+        {
+            for (std::size_t i = 0; i < count; ++i)
+                sum[i] += src[i];
+        }
+
+        template <std::size_t C>
+        void nearestRow(std::uint8_t const *src, std::uint32_t const *index, std::uint8_t *dst, std::uint32_t width)
+        {
+            for (std::uint32_t x = 0; x < width; ++x, dst += C)
+            {
+                std::uint8_t const *s = src + index[x];
+                for (std::size_t c = 0; c < C; ++c)
+                    dst[c] = s[c];
+            }
+        }
+
+        template <std::size_t C>
+        void bilinearRow(std::uint8_t const *src, std::uint32_t const *index, std::uint16_t const *weight, std::uint16_t *dst, std::uint32_t width)
+        {
+            for (std::uint32_t x = 0; x < width; ++x, dst += C)
+            {
+                std::uint8_t const *s0 = src + index[2 * x];
+                std::uint8_t const *s1 = src + index[2 * x + 1];
+                std::uint32_t const w = weight[x];
+                for (std::size_t c = 0; c < C; ++c)
+                    dst[c] = std::uint16_t(s0[c] * (kWeightOne - w) + s1[c] * w);
+            }
+        }
+
+        template <std::size_t C, typename Sum>
+        void areaRow(Sum const *sum, std::uint32_t const *index, std::uint64_t const *reciprocal, std::uint8_t *dst, std::uint32_t width)
+        {
+            for (std::uint32_t x = 0; x < width; ++x, dst += C)
+            {
+                std::uint32_t acc[C] = {};
+                for (std::uint32_t sx = index[2 * x]; sx < index[2 * x + 1]; ++sx)
+                {
+                    for (std::size_t c = 0; c < C; ++c)
+                        acc[c] += sum[sx * C + c];
+                }
+                for (std::size_t c = 0; c < C; ++c)
+                    dst[c] = std::uint8_t((acc[c] * reciprocal[x] + (std::uint64_t(1) << (kReciprocalBits - 1))) >> kReciprocalBits);
+            }
+        }
+
+        template <typename Sum>
+        void areaRow(std::size_t channels, Sum const *sum, std::uint32_t const *index, std::uint64_t const *reciprocal, std::uint8_t *dst, std::uint32_t width)
+        {
+            switch(channels)
+            {
+            case 1: areaRow<1>(sum, index, reciprocal, dst, width); break;
+            case 2: areaRow<2>(sum, index, reciprocal, dst, width); break;
+            case 3: areaRow<3>(sum, index, reciprocal, dst, width); break;
+            default: areaRow<4>(sum, index, reciprocal, dst, width); break;
+            }
+        }
+
+        template <typename Sum>
+        void areaRows(std::size_t channels, std::uint8_t const *src, std::size_t srcRowBytes, std::uint32_t srcWidth,
+            std::uint32_t const *yIndex, std::uint32_t const *xIndex, std::uint64_t const *reciprocal,
+            std::uint8_t *dst, std::size_t dstRowBytes, Vec2ui const &dstSize, Sum *sum, bool bSimd)
+        {
+            std::size_t const count = srcWidth * channels;
+            std::uint32_t const minRows = yIndex[1] - yIndex[0];
+            for (std::uint32_t y = 0; y < dstSize(1); ++y)
+            {
+                std::fill(sum, sum + count, Sum(0));
+                for (std::uint32_t sy = yIndex[2 * y]; sy < yIndex[2 * y + 1]; ++sy)
+                    accumulateRow(sum, src + sy * srcRowBytes, count, bSimd);
+
+                std::uint32_t const rows = yIndex[2 * y + 1] - yIndex[2 * y];
+                std::uint64_t const *r = reciprocal + (rows > minRows ? dstSize(0) : 0);
+                areaRow(channels, sum, xIndex, r, dst + y * dstRowBytes, dstSize(0));
+            }
+        }
+    }
+
+    ImageScaler::ImageScaler(Mode mode)
+        : m_Mode(mode)
+        , m_bSimdEnabled(true)
+        , m_Tables()
+        , m_RowBuffer()
+        , m_SumBuffer()
+    {
+    }
+
+    ImageScaler::~ImageScaler()
+    {
+    }
+
+    void ImageScaler::setMode(Mode mode)
+    {
+        m_Mode = mode;
+    }
+
+    std::error_code ImageScaler::scale(PixelBuffer &src, PixelBuffer &dst)
+    {
+        if (!src.planeCount())
+        {
+            RPI_LOG(ERROR, "ImageScaler::scale(): invalid source buffer!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        for (std::size_t pi = 0; pi < src.planeCount(); ++pi)
+        {
+            if (std::error_code ec = scalePlane(src, dst, pi))
+                return ec;
+        }
+        return std::error_code();
+    }
+
+    std::error_code ImageScaler::scalePlane(PixelBuffer &src, PixelBuffer &dst, std::size_t pi)
+    {
+        ePixelFormat const format = src.format();
+        if (format == kPixelFormatInvalid || dst.format() != format)
+        {
+            RPI_LOG(ERROR, "ImageScaler::scalePlane(): invalid or mismatching pixel formats!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        PixelFormatDescriptor const descriptor = pixelFormatDescriptor(format);
+        if (src.planeCount() != descriptor.planeCount || dst.planeCount() != descriptor.planeCount || pi >= descriptor.planeCount)
+        {
+            RPI_LOG(ERROR, "ImageScaler::scalePlane(): unexpected plane count!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        // packed 4:2:2 is scaled as 4 byte Y U Y V macro pixels so chroma is never mixed with luma
+        std::uint32_t const packing = descriptor.planeCount == 1 ? descriptor.blockWidth : 1;
+
+        Plane planes[2];
+        PixelBuffer *buffers[2] = { &src, &dst };
+        for (int ib = 0; ib < 2; ++ib)
+        {
+            Plane &plane = planes[ib];
+            plane.data = static_cast<std::uint8_t*>(buffers[ib]->planeData(pi));
+            plane.rowBytes = buffers[ib]->planeRowBytes(pi);
+            plane.size = buffers[ib]->planeSize(pi);
+            plane.size(0) /= packing;
+            plane.channels = descriptor.bytesPerPixel[pi] * packing;
+
+            if (!plane.data || !plane.size(0) || !plane.size(1))
+            {
+                RPI_LOG(ERROR, "ImageScaler::scalePlane(): buffer not locked or empty!");
+                return std::make_error_code(std::errc::invalid_argument);
+            }
+        }
+
+        scalePlaneData(m_Tables[pi], planes[0], planes[1]);
+        return std::error_code();
+    }
+
+    void ImageScaler::scalePlaneData(Tables &tables, Plane const &src, Plane const &dst)
+    {
+        if (src.size == dst.size)
+        {
+            for (std::uint32_t y = 0; y < dst.size(1); ++y)
+                std::memcpy(dst.data + y * dst.rowBytes, src.data + y * src.rowBytes, dst.size(0) * dst.channels);
+            return;
+        }
+
+        // exact 2x bilinear samples the same 2x2 block as the box filter
+        if (m_Mode != Mode::Nearest && src.channels == 1)
+        {
+            if (src.size == dst.size * 2)
+            {
+                scaleBox(2, src, dst);
+                return;
+            }
+            if (m_Mode == Mode::Area && src.size == dst.size * 4)
+            {
+                scaleBox(4, src, dst);
+                return;
+            }
+        }
+
+        Mode mode = m_Mode;
+        if (mode == Mode::Area && (dst.size(0) > src.size(0) || dst.size(1) > src.size(1)))
+            mode = Mode::Bilinear;
+
+        if (tables.srcSize != src.size || tables.dstSize != dst.size || tables.channels != src.channels || tables.mode != mode)
+            prepareTables(tables, mode, src, dst);
+
+        switch(mode)
+        {
+        case Mode::Nearest:     scaleNearest(tables, src, dst);     break;
+        case Mode::Bilinear:    scaleBilinear(tables, src, dst);    break;
+        case Mode::Area:        scaleArea(tables, src, dst);        break;
+        }
+    }
+
+    void ImageScaler::prepareTables(Tables &tables, Mode mode, Plane const &src, Plane const &dst)
+    {
+        tables.srcSize = src.size;
+        tables.dstSize = dst.size;
+        tables.channels = src.channels;
+        tables.mode = mode;
+        tables.reciprocal.clear();
+
+        Axis *axes[2] = { &tables.x, &tables.y };
+        for (int ia = 0; ia < 2; ++ia)
+        {
+            Axis &axis = *axes[ia];
+            std::uint64_t const srcLength = src.size(ia);
+            std::uint64_t const dstLength = dst.size(ia);
+            // x indices are byte offsets within a row, y indices are rows
+            std::uint32_t const stride = ia == 0 ? std::uint32_t(src.channels) : 1;
+
+            axis.index.clear();
+            axis.weight.clear();
+
+            switch(mode)
+            {
+            case Mode::Nearest:
+                for (std::uint64_t d = 0; d < dstLength; ++d)
+                {
+                    std::uint64_t const s = std::min(((2 * d + 1) * srcLength) / (2 * dstLength), srcLength - 1);
+                    axis.index.push_back(std::uint32_t(s) * stride);
+                }
+                break;
+
+            case Mode::Bilinear:
+                for (std::uint64_t d = 0; d < dstLength; ++d)
+                {
+                    // source position of the destination sample center, 7 fractional bits
+                    std::int64_t const position = (std::int64_t((2 * d + 1) * srcLength) - std::int64_t(dstLength)) * kWeightOne / std::int64_t(2 * dstLength);
+                    std::uint64_t s0 = 0, weight = 0;
+                    if (position > 0)
+                    {
+                        s0 = std::uint64_t(position) >> kWeightBits;
+                        weight = std::uint64_t(position) & (kWeightOne - 1);
+                    }
+                    if (s0 + 1 >= srcLength)
+                    {
+                        s0 = srcLength - 1;
+                        weight = 0;
+                    }
+                    std::uint64_t const s1 = std::min(s0 + 1, srcLength - 1);
+                    axis.index.push_back(std::uint32_t(s0) * stride);
+                    axis.index.push_back(std::uint32_t(s1) * stride);
+                    axis.weight.push_back(std::uint16_t(weight));
+                }
+                break;
+
+            case Mode::Area:
+                for (std::uint64_t d = 0; d < dstLength; ++d)
+                {
+                    axis.index.push_back(std::uint32_t((d * srcLength) / dstLength));
+                    axis.index.push_back(std::uint32_t(((d + 1) * srcLength) / dstLength));
+                }
+                break;
+            }
+        }
+
+        if (mode == Mode::Area)
+        {
+            // a destination row covers either floor or ceil of the ratio source rows
+            std::uint32_t const minRows = tables.y.index[1] - tables.y.index[0];
+            tables.reciprocal.resize(2 * dst.size(0));
+            for (std::uint32_t rows = minRows; rows <= minRows + 1; ++rows)
+            {
+                std::uint64_t *reciprocal = &tables.reciprocal[(rows - minRows) * dst.size(0)];
+                for (std::uint32_t x = 0; x < dst.size(0); ++x)
+                {
+                    std::uint32_t const area = (tables.x.index[2 * x + 1] - tables.x.index[2 * x]) * rows;
+                    reciprocal[x] = (std::uint64_t(1) << kReciprocalBits) / area;
+                }
+            }
+        }
+    }
+
+    void ImageScaler::scaleNearest(Tables const &tables, Plane const &src, Plane const &dst)
+    {
+        std::uint32_t const *xIndex = tables.x.index.data();
+        for (std::uint32_t y = 0; y < dst.size(1); ++y)
+        {
+            std::uint8_t *d = dst.data + y * dst.rowBytes;
+            std::uint8_t const *s = src.data + tables.y.index[y] * src.rowBytes;
+
+            // repeated source rows are copied from the previous output row
+            if (y > 0 && tables.y.index[y] == tables.y.index[y - 1])
+            {
+                std::memcpy(d, d - dst.rowBytes, dst.size(0) * dst.channels);
+                continue;
+            }
+
+            switch(src.channels)
+            {
+            case 1: nearestRow<1>(s, xIndex, d, dst.size(0)); break;
+            case 2: nearestRow<2>(s, xIndex, d, dst.size(0)); break;
+            case 3: nearestRow<3>(s, xIndex, d, dst.size(0)); break;
+            default: nearestRow<4>(s, xIndex, d, dst.size(0)); break;
+            }
+        }
+    }
+
+    void ImageScaler::scaleBilinear(Tables const &tables, Plane const &src, Plane const &dst)
+    {
+        std::size_t const count = dst.size(0) * dst.channels;
+        m_RowBuffer.resize(2 * count);
+
+        // two horizontally filtered source rows, reused while consecutive output rows share them
+        std::uint16_t *rows[2] = { m_RowBuffer.data(), m_RowBuffer.data() + count };
+        std::int64_t rowIndex[2] = { -1, -1 };
+
+        auto filterRow = [&](std::uint16_t *row, std::uint32_t sy)
+        {
+            std::uint8_t const *s = src.data + sy * src.rowBytes;
+            std::uint32_t const *index = tables.x.index.data();
+            std::uint16_t const *weight = tables.x.weight.data();
+            switch(src.channels)
+            {
+            case 1: bilinearRow<1>(s, index, weight, row, dst.size(0)); break;
+            case 2: bilinearRow<2>(s, index, weight, row, dst.size(0)); break;
+            case 3: bilinearRow<3>(s, index, weight, row, dst.size(0)); break;
+            default: bilinearRow<4>(s, index, weight, row, dst.size(0)); break;
+            }
+        };
+
+        for (std::uint32_t y = 0; y < dst.size(1); ++y)
+        {
+            std::uint32_t const sy[2] = { tables.y.index[2 * y], tables.y.index[2 * y + 1] };
+
+            if (rowIndex[0] != sy[0])
+            {
+                if (rowIndex[1] == sy[0])
+                {
+                    std::swap(rows[0], rows[1]);
+                    std::swap(rowIndex[0], rowIndex[1]);
+                }
+                else
+                {
+                    filterRow(rows[0], sy[0]);
+                    rowIndex[0] = sy[0];
+                }
+            }
+
+            if (rowIndex[1] != sy[1])
+            {
+                filterRow(rows[1], sy[1]);
+                rowIndex[1] = sy[1];
+            }
+
+            blendRows(rows[0], rows[1], tables.y.weight[y], dst.data + y * dst.rowBytes, count, m_bSimdEnabled);
+        }
+    }
+
+    void ImageScaler::scaleArea(Tables const &tables, Plane const &src, Plane const &dst)
+    {
+        std::size_t const count = src.size(0) * src.channels;
+        std::uint32_t const maxRows = tables.y.index[1] - tables.y.index[0] + 1;
+
+        if (maxRows <= kMaxNarrowSumRows)
+        {
+            m_RowBuffer.resize(count);
+            areaRows(src.channels, src.data, src.rowBytes, src.size(0), tables.y.index.data(), tables.x.index.data(),
+                tables.reciprocal.data(), dst.data, dst.rowBytes, dst.size, m_RowBuffer.data(), m_bSimdEnabled);
+        }
+        else
+        {
+            m_SumBuffer.resize(count);
+            areaRows(src.channels, src.data, src.rowBytes, src.size(0), tables.y.index.data(), tables.x.index.data(),
+                tables.reciprocal.data(), dst.data, dst.rowBytes, dst.size, m_SumBuffer.data(), m_bSimdEnabled);
+        }
+    }
+
+    void ImageScaler::scaleBox(std::uint32_t factor, Plane const &src, Plane const &dst)
+    {
+        for (std::uint32_t y = 0; y < dst.size(1); ++y)
+        {
+            std::uint8_t const *s = src.data + y * factor * src.rowBytes;
+            std::uint8_t *d = dst.data + y * dst.rowBytes;
+            if (factor == 2)
+                box2Row(s, s + src.rowBytes, d, dst.size(0), m_bSimdEnabled);
+            else
+            {
+                std::uint8_t const * const rows[4] = { s, s + src.rowBytes, s + 2 * src.rowBytes, s + 3 * src.rowBytes };
+                box4Row(rows, d, dst.size(0), m_bSimdEnabled);
+            }
+        }
+    }
+
+    std::istream& operator>>(std::istream &s, ImageScaler::Mode &v)
+    {
+        std::string sv;
+        s >> sv;
+        if (sv == "Nearest")
+            v = ImageScaler::Mode::Nearest;
+        else if (sv == "Bilinear")
+            v = ImageScaler::Mode::Bilinear;
+        else if (sv == "Area")
+            v = ImageScaler::Mode::Area;
+        else
+            throw std::invalid_argument("Invalid value for ImageScaler::Mode: " + sv);
+        return s;
+    }
+
+    std::ostream& operator<<(std::ostream &s, ImageScaler::Mode v)
+    {
+        switch(v)
+        {
+        case ImageScaler::Mode::Nearest:    s << "Nearest";     break;
+        case ImageScaler::Mode::Bilinear:   s << "Bilinear";    break;
+        case ImageScaler::Mode::Area:       s << "Area";        break;
+        }
+        return s;
+    }
+}
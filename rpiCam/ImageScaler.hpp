@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Config.hpp"
+#include "PixelBuffer.hpp"
+#include <vector>
+#include <system_error>
+
+namespace rpiCam
+{
+    // Scales PixelBuffers of any format plane by plane. Coefficient tables are
+    // computed once per source/destination size and kept in the scaler, so one
+    // scaler per stream makes every further frame table-free. Exact 2x and 4x
+    // reductions of byte planes use box kernels, other ratios stream source
+    // rows through a small row cache so the working set stays in L1.
+    class ImageScaler
+    {
+    public:
+        enum class Mode : int
+        {
+            Nearest,
+            Bilinear,
+            Area
+        };
+
+        ImageScaler(Mode mode = Mode::Area);
+        ~ImageScaler();
+
+        inline Mode mode() const { return m_Mode; }
+        void setMode(Mode mode);
+
+        // scalar kernels only, for comparison
+        inline bool isSimdEnabled() const { return m_bSimdEnabled; }
+        inline void setSimdEnabled(bool bEnabled) { m_bSimdEnabled = bEnabled; }
+
+        // both buffers must be locked and have the same format, the size of dst selects the ratio
+        std::error_code scale(PixelBuffer &src, PixelBuffer &dst);
+
+        // scales plane pi only, the other planes of dst are left untouched
+        std::error_code scalePlane(PixelBuffer &src, PixelBuffer &dst, std::size_t pi);
+
+    private:
+        struct Plane
+        {
+            std::uint8_t *data;
+            std::size_t rowBytes;
+            Vec2ui size;        // in units of channels bytes
+            std::size_t channels;
+        };
+
+        // nearest: one source index per sample, bilinear: two indices and the
+        // 7 bit weight of the second, area: first and past-the-end index
+        struct Axis
+        {
+            std::vector<std::uint32_t> index;
+            std::vector<std::uint16_t> weight;
+        };
+
+        struct Tables
+        {
+            Vec2ui srcSize;
+            Vec2ui dstSize;
+            std::size_t channels;
+            Mode mode;
+            Axis x;
+            Axis y;
+            std::vector<std::uint64_t> reciprocal;
+        };
+
+        void scalePlaneData(Tables &tables, Plane const &src, Plane const &dst);
+        void prepareTables(Tables &tables, Mode mode, Plane const &src, Plane const &dst);
+        void scaleNearest(Tables const &tables, Plane const &src, Plane const &dst);
+        void scaleBilinear(Tables const &tables, Plane const &src, Plane const &dst);
+        void scaleArea(Tables const &tables, Plane const &src, Plane const &dst);
+        void scaleBox(std::uint32_t factor, Plane const &src, Plane const &dst);
+
+    private:
+        Mode m_Mode;
+        bool m_bSimdEnabled;
+        Tables m_Tables[PixelFormatDescriptor::kMaxPlanes];
+        std::vector<std::uint16_t> m_RowBuffer;
+        std::vector<std::uint32_t> m_SumBuffer;
+    };
+
+    extern std::istream& operator>>(std::istream &s, ImageScaler::Mode &v);
+    extern std::ostream& operator<<(std::ostream &s, ImageScaler::Mode v);
+}
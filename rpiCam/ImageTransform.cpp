@@ -0,0 +1,493 @@
+#include "ImageTransform.hpp"
+#include "Simd.hpp"
+#include "Logging.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace rpiCam
+{
+    namespace
+    {
+        // tiles are transposed in registers, blocks keep the 64 destination
+        // rows a block writes to resident in L1 while it is being filled
+        static constexpr std::uint32_t kTileSize = 8;
+        static constexpr std::uint32_t kBlockSize = 64;
+
+        struct Plane
+        {
+            std::uint8_t *data;
+            std::size_t rowBytes;
+            Vec2ui size;
+
+            inline std::uint8_t* row(std::uint32_t y) const { return data + y * rowBytes; }
+        };
+
+        // dst[j][i] = src[i][j] for one tile of E byte elements
+        template <std::size_t E>
+        inline void transposeTileScalar(std::uint8_t const * const src[kTileSize], std::uint8_t * const dst[kTileSize])
+        {
+            for (std::uint32_t j = 0; j < kTileSize; ++j)
+            {
+                for (std::uint32_t i = 0; i < kTileSize; ++i)
+                    std::memcpy(dst[j] + i * E, src[i] + j * E, E);
+            }
+        }
+
+#if defined(RPI_CAM_SIMD_NEON)
+        // rows in, columns out
+        inline void transpose8x8(uint8x8_t r[8])
+        {
+            uint8x8x2_t const t01 = vtrn_u8(r[0], r[1]);
+            uint8x8x2_t const t23 = vtrn_u8(r[2], r[3]);
+            uint8x8x2_t const t45 = vtrn_u8(r[4], r[5]);
+            uint8x8x2_t const t67 = vtrn_u8(r[6], r[7]);
+
+            uint16x4x2_t const u02 = vtrn_u16(vreinterpret_u16_u8(t01.val[0]), vreinterpret_u16_u8(t23.val[0]));
+            uint16x4x2_t const u13 = vtrn_u16(vreinterpret_u16_u8(t01.val[1]), vreinterpret_u16_u8(t23.val[1]));
+            uint16x4x2_t const u46 = vtrn_u16(vreinterpret_u16_u8(t45.val[0]), vreinterpret_u16_u8(t67.val[0]));
+            uint16x4x2_t const u57 = vtrn_u16(vreinterpret_u16_u8(t45.val[1]), vreinterpret_u16_u8(t67.val[1]));
+
+            uint32x2x2_t const v04 = vtrn_u32(vreinterpret_u32_u16(u02.val[0]), vreinterpret_u32_u16(u46.val[0]));
+            uint32x2x2_t const v26 = vtrn_u32(vreinterpret_u32_u16(u02.val[1]), vreinterpret_u32_u16(u46.val[1]));
+            uint32x2x2_t const v15 = vtrn_u32(vreinterpret_u32_u16(u13.val[0]), vreinterpret_u32_u16(u57.val[0]));
+            uint32x2x2_t const v37 = vtrn_u32(vreinterpret_u32_u16(u13.val[1]), vreinterpret_u32_u16(u57.val[1]));
+
+            r[0] = vreinterpret_u8_u32(v04.val[0]);
+            r[1] = vreinterpret_u8_u32(v15.val[0]);
+            r[2] = vreinterpret_u8_u32(v26.val[0]);
+            r[3] = vreinterpret_u8_u32(v37.val[0]);
+            r[4] = vreinterpret_u8_u32(v04.val[1]);
+            r[5] = vreinterpret_u8_u32(v15.val[1]);
+            r[6] = vreinterpret_u8_u32(v26.val[1]);
+            r[7] = vreinterpret_u8_u32(v37.val[1]);
+        }
+
+        // interleaved elements are split into byte channels by vldN and transposed channel by channel
+        template <std::size_t E>
+        inline void transposeTile(std::uint8_t const * const src[kTileSize], std::uint8_t * const dst[kTileSize])
+        {
+            uint8x8_t c[E][kTileSize];
+            for (std::uint32_t i = 0; i < kTileSize; ++i)
+            {
+                switch(E)
+                {
+                case 1: { c[0][i] = vld1_u8(src[i]); } break;
+                case 2: { uint8x8x2_t const v = vld2_u8(src[i]); for (std::size_t e = 0; e < E; ++e) c[e][i] = v.val[e]; } break;
+                case 3: { uint8x8x3_t const v = vld3_u8(src[i]); for (std::size_t e = 0; e < E; ++e) c[e][i] = v.val[e]; } break;
+                case 4: { uint8x8x4_t const v = vld4_u8(src[i]); for (std::size_t e = 0; e < E; ++e) c[e][i] = v.val[e]; } break;
+                }
+            }
+
+            for (std::size_t e = 0; e < E; ++e)
+                transpose8x8(c[e]);
+
+            for (std::uint32_t j = 0; j < kTileSize; ++j)
+            {
+                switch(E)
+                {
+                case 1: { vst1_u8(dst[j], c[0][j]); } break;
+                case 2: { uint8x8x2_t v; for (std::size_t e = 0; e < E; ++e) v.val[e] = c[e][j]; vst2_u8(dst[j], v); } break;
+                case 3: { uint8x8x3_t v; for (std::size_t e = 0; e < E; ++e) v.val[e] = c[e][j]; vst3_u8(dst[j], v); } break;
+                case 4: { uint8x8x4_t v; for (std::size_t e = 0; e < E; ++e) v.val[e] = c[e][j]; vst4_u8(dst[j], v); } break;
+                }
+            }
+        }
+#elif defined(RPI_CAM_SIMD_SSE2)
+        template <std::size_t E>
+        inline void transposeTile(std::uint8_t const * const src[kTileSize], std::uint8_t * const dst[kTileSize])
+        {
+            // no byte shuffles in SSE2 for 3 byte elements
+            transposeTileScalar<E>(src, dst);
+        }
+
+        template <>
+        inline void transposeTile<1>(std::uint8_t const * const src[kTileSize], std::uint8_t * const dst[kTileSize])
+        {
+            __m128i r[kTileSize];
+            for (std::uint32_t i = 0; i < kTileSize; ++i)
+                r[i] = _mm_loadl_epi64(reinterpret_cast<__m128i const*>(src[i]));
+
+            __m128i const a0 = _mm_unpacklo_epi8(r[0], r[1]);
+            __m128i const a1 = _mm_unpacklo_epi8(r[2], r[3]);
+            __m128i const a2 = _mm_unpacklo_epi8(r[4], r[5]);
+            __m128i const a3 = _mm_unpacklo_epi8(r[6], r[7]);
+
+            __m128i const b0 = _mm_unpacklo_epi16(a0, a1);
+            __m128i const b1 = _mm_unpackhi_epi16(a0, a1);
+            __m128i const b2 = _mm_unpacklo_epi16(a2, a3);
+            __m128i const b3 = _mm_unpackhi_epi16(a2, a3);
+
+            // two columns per register
+            __m128i const c[4] = {
+                _mm_unpacklo_epi32(b0, b2),
+                _mm_unpackhi_epi32(b0, b2),
+                _mm_unpacklo_epi32(b1, b3),
+                _mm_unpackhi_epi32(b1, b3)
+            };
+
+            for (std::uint32_t j = 0; j < 4; ++j)
+            {
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(dst[2 * j]), c[j]);
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(dst[2 * j + 1]), _mm_unpackhi_epi64(c[j], c[j]));
+            }
+        }
+
+        template <>
+        inline void transposeTile<2>(std::uint8_t const * const src[kTileSize], std::uint8_t * const dst[kTileSize])
+        {
+            __m128i r[kTileSize];
+            for (std::uint32_t i = 0; i < kTileSize; ++i)
+                r[i] = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src[i]));
+
+            __m128i a[kTileSize];
+            for (std::uint32_t i = 0; i < kTileSize; i += 2)
+            {
+                a[i] = _mm_unpacklo_epi16(r[i], r[i + 1]);
+                a[i + 1] = _mm_unpackhi_epi16(r[i], r[i + 1]);
+            }
+
+            // b[0..3] columns 0-1, 2-3, 4-5, 6-7 of rows 0-3, b[4..7] the same of rows 4-7
+            __m128i b[kTileSize];
+            for (std::uint32_t h = 0; h < 2; ++h)
+            {
+                __m128i const *ah = a + 4 * h;
+                b[4 * h + 0] = _mm_unpacklo_epi32(ah[0], ah[2]);
+                b[4 * h + 1] = _mm_unpackhi_epi32(ah[0], ah[2]);
+                b[4 * h + 2] = _mm_unpacklo_epi32(ah[1], ah[3]);
+                b[4 * h + 3] = _mm_unpackhi_epi32(ah[1], ah[3]);
+            }
+
+            for (std::uint32_t j = 0; j < 4; ++j)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst[2 * j]), _mm_unpacklo_epi64(b[j], b[4 + j]));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst[2 * j + 1]), _mm_unpackhi_epi64(b[j], b[4 + j]));
+            }
+        }
+
+        template <>
+        inline void transposeTile<4>(std::uint8_t const * const src[kTileSize], std::uint8_t * const dst[kTileSize])
+        {
+            // four 4x4 quadrants, quadrant (qx, qy) of src lands at (qy, qx) of dst
+            for (std::uint32_t qy = 0; qy < kTileSize; qy += 4)
+            {
+                for (std::uint32_t qx = 0; qx < kTileSize; qx += 4)
+                {
+                    __m128i r[4];
+                    for (std::uint32_t i = 0; i < 4; ++i)
+                        r[i] = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src[qy + i] + 4 * qx));
+
+                    __m128i const t0 = _mm_unpacklo_epi32(r[0], r[1]);
+                    __m128i const t1 = _mm_unpacklo_epi32(r[2], r[3]);
+                    __m128i const t2 = _mm_unpackhi_epi32(r[0], r[1]);
+                    __m128i const t3 = _mm_unpackhi_epi32(r[2], r[3]);
+
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst[qx + 0] + 4 * qy), _mm_unpacklo_epi64(t0, t1));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst[qx + 1] + 4 * qy), _mm_unpackhi_epi64(t0, t1));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst[qx + 2] + 4 * qy), _mm_unpacklo_epi64(t2, t3));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst[qx + 3] + 4 * qy), _mm_unpackhi_epi64(t2, t3));
+                }
+            }
+        }
+#else
+        template <std::size_t E>
+        inline void transposeTile(std::uint8_t const * const src[kTileSize], std::uint8_t * const dst[kTileSize])
+        {
+            transposeTileScalar<E>(src, dst);
+        }
+#endif
+
+        // dst[i] = src[count - 1 - i] for E byte elements
+        template <std::size_t E>
+        void reverseRow(std::uint8_t const *src, std::uint8_t *dst, std::uint32_t count)
+        {
+            std::uint32_t i = 0;
+#if defined(RPI_CAM_SIMD_NEON)
+            if (E == 3)
+            {
+                for (; i + 16 <= count; i += 16)
+                {
+                    uint8x16x3_t v = vld3q_u8(src + (count - i - 16) * E);
+                    for (std::size_t e = 0; e < 3; ++e)
+                    {
+                        uint8x16_t const r = vrev64q_u8(v.val[e]);
+                        v.val[e] = vcombine_u8(vget_high_u8(r), vget_low_u8(r));
+                    }
+                    vst3q_u8(dst + i * E, v);
+                }
+            }
+            else
+            {
+                std::uint32_t const n = 16 / E;
+                for (; i + n <= count; i += n)
+                {
+                    uint8x16_t r = vld1q_u8(src + (count - i - n) * E);
+                    switch(E)
+                    {
+                    case 1: r = vrev64q_u8(r); break;
+                    case 2: r = vreinterpretq_u8_u16(vrev64q_u16(vreinterpretq_u16_u8(r))); break;
+                    case 4: r = vreinterpretq_u8_u32(vrev64q_u32(vreinterpretq_u32_u8(r))); break;
+                    }
+                    vst1q_u8(dst + i * E, vcombine_u8(vget_high_u8(r), vget_low_u8(r)));
+                }
+            }
+#elif defined(RPI_CAM_SIMD_SSE2)
+            if (E != 3)
+            {
+                std::uint32_t const n = 16 / E;
+                for (; i + n <= count; i += n)
+                {
+                    __m128i r = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + (count - i - n) * E));
+                    r = _mm_shuffle_epi32(r, _MM_SHUFFLE(0, 1, 2, 3));
+                    if (E < 4)
+                    {
+                        r = _mm_shufflelo_epi16(r, _MM_SHUFFLE(2, 3, 0, 1));
+                        r = _mm_shufflehi_epi16(r, _MM_SHUFFLE(2, 3, 0, 1));
+                    }
+                    if (E < 2)
+                        r = _mm_or_si128(_mm_slli_epi16(r, 8), _mm_srli_epi16(r, 8));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * E), r);
+                }
+            }
+#endif
+            for (; i < count; ++i)
+                std::memcpy(dst + i * E, src + (count - 1 - i) * E, E);
+        }
+
+        template <std::size_t E>
+        void flipPlane(Plane const &src, Plane const &dst, bool bHorizontal, bool bVertical)
+        {
+            std::uint32_t const height = src.size(1);
+            for (std::uint32_t y = 0; y < height; ++y)
+            {
+                std::uint8_t const *s = src.row(bVertical ? height - 1 - y : y);
+                if (bHorizontal)
+                    reverseRow<E>(s, dst.row(y), src.size(0));
+                else
+                    std::memcpy(dst.row(y), s, src.size(0) * E);
+            }
+        }
+
+        template <std::size_t E>
+        void transposePlane(Plane const &src, Plane const &dst, ImageTransform transform)
+        {
+            std::uint32_t const width = src.size(0);
+            std::uint32_t const height = src.size(1);
+
+            // destination of source element (x, y)
+            auto target = [&](std::uint32_t x, std::uint32_t y) -> std::uint8_t*
+            {
+                switch(transform)
+                {
+                case ImageTransform::Rotate90:  return dst.row(x) + (height - 1 - y) * E;
+                case ImageTransform::Rotate270: return dst.row(width - 1 - x) + y * E;
+                default:                        return dst.row(x) + y * E;
+                }
+            };
+
+            auto copyScalar = [&](std::uint32_t x0, std::uint32_t x1, std::uint32_t y0, std::uint32_t y1)
+            {
+                for (std::uint32_t y = y0; y < y1; ++y)
+                {
+                    std::uint8_t const *s = src.row(y);
+                    for (std::uint32_t x = x0; x < x1; ++x)
+                        std::memcpy(target(x, y), s + x * E, E);
+                }
+            };
+
+            for (std::uint32_t by = 0; by < height; by += kBlockSize)
+            {
+                std::uint32_t const yEnd = std::min(by + kBlockSize, height);
+                std::uint32_t const yTiles = by + (yEnd - by) / kTileSize * kTileSize;
+
+                for (std::uint32_t bx = 0; bx < width; bx += kBlockSize)
+                {
+                    std::uint32_t const xEnd = std::min(bx + kBlockSize, width);
+                    std::uint32_t const xTiles = bx + (xEnd - bx) / kTileSize * kTileSize;
+
+                    for (std::uint32_t ty = by; ty < yTiles; ty += kTileSize)
+                    {
+                        for (std::uint32_t tx = bx; tx < xTiles; tx += kTileSize)
+                        {
+                            std::uint8_t const *s[kTileSize];
+                            std::uint8_t *d[kTileSize];
+                            for (std::uint32_t i = 0; i < kTileSize; ++i)
+                            {
+                                switch(transform)
+                                {
+                                case ImageTransform::Rotate90:
+                                    // bottom row first, so tile columns come out reversed
+                                    s[i] = src.row(ty + kTileSize - 1 - i) + tx * E;
+                                    d[i] = dst.row(tx + i) + (height - kTileSize - ty) * E;
+                                    break;
+                                case ImageTransform::Rotate270:
+                                    s[i] = src.row(ty + i) + tx * E;
+                                    d[i] = dst.row(width - 1 - tx - i) + ty * E;
+                                    break;
+                                default:
+                                    s[i] = src.row(ty + i) + tx * E;
+                                    d[i] = dst.row(tx + i) + ty * E;
+                                    break;
+                                }
+                            }
+                            transposeTile<E>(s, d);
+                        }
+                    }
+
+                    copyScalar(xTiles, xEnd, by, yTiles);
+                    copyScalar(bx, xEnd, yTiles, yEnd);
+                }
+            }
+        }
+
+        template <std::size_t E>
+        void transformPlane(Plane const &src, Plane const &dst, ImageTransform transform)
+        {
+            switch(transform)
+            {
+            case ImageTransform::Identity:          flipPlane<E>(src, dst, false, false);   break;
+            case ImageTransform::Rotate180:         flipPlane<E>(src, dst, true, true);     break;
+            case ImageTransform::FlipHorizontal:    flipPlane<E>(src, dst, true, false);    break;
+            case ImageTransform::FlipVertical:      flipPlane<E>(src, dst, false, true);    break;
+            case ImageTransform::Rotate90:
+            case ImageTransform::Rotate270:
+            case ImageTransform::Transpose:         transposePlane<E>(src, dst, transform); break;
+            }
+        }
+
+        bool isTransformSupported(PixelFormatDescriptor const &descriptor, ImageTransform transform)
+        {
+            if (!descriptor.planeCount)
+                return false;
+
+            if (transform == ImageTransform::Identity || transform == ImageTransform::FlipVertical)
+                return true;
+
+            // reversing a packed 4:2:2 row would also swap its chroma samples
+            bool const bPacked = descriptor.planeCount == 1 && descriptor.blockWidth > 1;
+            if (bPacked)
+                return false;
+
+            if (!imageTransformSwapsAxes(transform))
+                return true;
+
+            for (std::size_t pi = 0; pi < descriptor.planeCount; ++pi)
+            {
+                if (descriptor.widthShift[pi] != descriptor.heightShift[pi])
+                    return false;
+            }
+            return true;
+        }
+    }
+
+    bool imageTransformSwapsAxes(ImageTransform transform)
+    {
+        return transform == ImageTransform::Rotate90 || transform == ImageTransform::Rotate270 || transform == ImageTransform::Transpose;
+    }
+
+    Vec2ui transformedImageSize(ImageTransform transform, Vec2ui const &size)
+    {
+        return imageTransformSwapsAxes(transform) ? Vec2ui(size(1), size(0)) : size;
+    }
+
+    bool isImageTransformSupported(ePixelFormat format, ImageTransform transform)
+    {
+        return isTransformSupported(pixelFormatDescriptor(format), transform);
+    }
+
+    std::error_code transformPixelBuffer(PixelBuffer &src, PixelBuffer &dst, ImageTransform transform)
+    {
+        ePixelFormat const format = src.format();
+        PixelFormatDescriptor const descriptor = pixelFormatDescriptor(format);
+        if (dst.format() != format || !isTransformSupported(descriptor, transform))
+        {
+            RPI_LOG(ERROR, "transformPixelBuffer(): unsupported format or transform!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        Plane planes[2][PixelFormatDescriptor::kMaxPlanes];
+        for (std::size_t pi = 0; pi < descriptor.planeCount; ++pi)
+        {
+            planes[0][pi] = Plane{ static_cast<std::uint8_t*>(src.planeData(pi)), src.planeRowBytes(pi), src.planeSize(pi) };
+            planes[1][pi] = Plane{ static_cast<std::uint8_t*>(dst.planeData(pi)), dst.planeRowBytes(pi), dst.planeSize(pi) };
+
+            if (!planes[0][pi].data || !planes[1][pi].data)
+            {
+                RPI_LOG(ERROR, "transformPixelBuffer(): buffer not locked!");
+                return std::make_error_code(std::errc::invalid_argument);
+            }
+
+            if (planes[1][pi].size != transformedImageSize(transform, planes[0][pi].size))
+            {
+                RPI_LOG(ERROR, "transformPixelBuffer(): destination size mismatch!");
+                return std::make_error_code(std::errc::invalid_argument);
+            }
+        }
+
+        for (std::size_t pi = 0; pi < descriptor.planeCount; ++pi)
+        {
+            switch(descriptor.bytesPerPixel[pi])
+            {
+            case 1: transformPlane<1>(planes[0][pi], planes[1][pi], transform); break;
+            case 2: transformPlane<2>(planes[0][pi], planes[1][pi], transform); break;
+            case 3: transformPlane<3>(planes[0][pi], planes[1][pi], transform); break;
+            case 4: transformPlane<4>(planes[0][pi], planes[1][pi], transform); break;
+            }
+        }
+
+        return std::error_code();
+    }
+
+    std::shared_ptr<MemoryPixelSampleBuffer> transformPixelBuffer(PixelBuffer &src, ImageTransform transform, std::shared_ptr<BufferArena> const &arena)
+    {
+        Vec2ui const size = transformedImageSize(transform, src.planeSize(0));
+        std::shared_ptr<MemoryPixelSampleBuffer> dst = arena ?
+            std::make_shared<MemoryPixelSampleBuffer>(src.format(), size, arena) :
+            std::make_shared<MemoryPixelSampleBuffer>(src.format(), size);
+
+        if (transformPixelBuffer(src, *dst, transform))
+            return std::shared_ptr<MemoryPixelSampleBuffer>();
+
+        return dst;
+    }
+
+    std::istream& operator>>(std::istream &s, ImageTransform &v)
+    {
+        std::string sv;
+        s >> sv;
+        if (sv == "Identity")
+            v = ImageTransform::Identity;
+        else if (sv == "Rotate90")
+            v = ImageTransform::Rotate90;
+        else if (sv == "Rotate180")
+            v = ImageTransform::Rotate180;
+        else if (sv == "Rotate270")
+            v = ImageTransform::Rotate270;
+        else if (sv == "FlipHorizontal")
+            v = ImageTransform::FlipHorizontal;
+        else if (sv == "FlipVertical")
+            v = ImageTransform::FlipVertical;
+        else if (sv == "Transpose")
+            v = ImageTransform::Transpose;
+        else
+            throw std::invalid_argument("Invalid value for ImageTransform: " + sv);
+        return s;
+    }
+
+    std::ostream& operator<<(std::ostream &s, ImageTransform v)
+    {
+        switch(v)
+        {
+        case ImageTransform::Identity:          s << "Identity";        break;
+        case ImageTransform::Rotate90:          s << "Rotate90";        break;
+        case ImageTransform::Rotate180:         s << "Rotate180";       break;
+        case ImageTransform::Rotate270:         s << "Rotate270";       break;
+        case ImageTransform::FlipHorizontal:    s << "FlipHorizontal";  break;
+        case ImageTransform::FlipVertical:      s << "FlipVertical";    break;
+        case ImageTransform::Transpose:         s << "Transpose";       break;
+        }
+        return s;
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Config.hpp"
+#include "PixelBuffer.hpp"
+#include "MemoryPixelSampleBuffer.hpp"
+#include <system_error>
+
+namespace rpiCam
+{
+    // rotations are clockwise
+    enum class ImageTransform : int
+    {
+        Identity,
+        Rotate90,
+        Rotate180,
+        Rotate270,
+        FlipHorizontal,
+        FlipVertical,
+        Transpose
+    };
+
+    // true for the transforms that exchange width and height
+    bool imageTransformSwapsAxes(ImageTransform transform);
+
+    Vec2ui transformedImageSize(ImageTransform transform, Vec2ui const &size);
+
+    bool isImageTransformSupported(ePixelFormat format, ImageTransform transform);
+
+    // Planar and semi-planar YUV 4:2:0, GRAY8, RGB and RGBA buffers support
+    // every transform, planar 4:2:2 only those keeping the axes and packed
+    // 4:2:2 only vertical flips. Both buffers must be locked, have the same
+    // format and dst the transformed size. Axis swapping transforms work on
+    // 8x8 register transposed tiles inside 64x64 blocks so reads and writes
+    // both stay within a few cache lines.
+    std::error_code transformPixelBuffer(PixelBuffer &src, PixelBuffer &dst, ImageTransform transform);
+
+    // returns nullptr when the transform is not possible, arena may be null
+    std::shared_ptr<MemoryPixelSampleBuffer> transformPixelBuffer(PixelBuffer &src, ImageTransform transform, std::shared_ptr<BufferArena> const &arena = std::shared_ptr<BufferArena>());
+
+    extern std::istream& operator>>(std::istream &s, ImageTransform &v);
+    extern std::ostream& operator<<(std::ostream &s, ImageTransform v);
+}
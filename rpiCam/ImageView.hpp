@@ -0,0 +1,225 @@
+#pragma once
+
+#include "Config.hpp"
+#include "PixelBuffer.hpp"
+#include <array>
+
+namespace rpiCam
+{
+    template <std::size_t BytesPerPixel>
+    struct ImagePixel
+    {
+        using Type = std::array<std::uint8_t, BytesPerPixel>;
+    };
+
+    template <>
+    struct ImagePixel<1>
+    {
+        using Type = std::uint8_t;
+    };
+
+    // One plane of an ImageView: plain pointer, stride and sizes, no virtual
+    // calls and no bounds checks. paddedSize covers the whole allocation, so
+    // kernels may read and write up to it without handling a tail.
+    template <std::size_t BytesPerPixel>
+    class ImagePlane
+    {
+    public:
+        using Pixel = typename ImagePixel<BytesPerPixel>::Type;
+        using Map = Eigen::Map< Eigen::Matrix<std::uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>, Eigen::Unaligned, Eigen::OuterStride<> >;
+        using ChannelMap = Eigen::Map< Eigen::Matrix<std::uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>, Eigen::Unaligned, Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic> >;
+
+        static constexpr std::size_t kBytesPerPixel = BytesPerPixel;
+
+        class Row
+        {
+        public:
+            Row(Pixel *b, Pixel *e) : m_Begin(b), m_End(e) {}
+
+            inline Pixel* begin() const { return m_Begin; }
+            inline Pixel* end() const { return m_End; }
+
+        private:
+            Pixel *m_Begin;
+            Pixel *m_End;
+        };
+
+        class RowIterator
+        {
+        public:
+            RowIterator(std::uint8_t *row, std::size_t rowBytes, std::uint32_t width)
+                : m_Row(row)
+                , m_RowBytes(rowBytes)
+                , m_Width(width)
+            {
+            }
+
+            inline Row operator*() const
+            {
+                Pixel *begin = reinterpret_cast<Pixel*>(m_Row);
+                return Row(begin, begin + m_Width);
+            }
+
+            inline RowIterator& operator++() { m_Row += m_RowBytes; return *this; }
+            inline bool operator==(RowIterator const &rhs) const { return m_Row == rhs.m_Row; }
+            inline bool operator!=(RowIterator const &rhs) const { return m_Row != rhs.m_Row; }
+
+        private:
+            std::uint8_t *m_Row;
+            std::size_t m_RowBytes;
+            std::uint32_t m_Width;
+        };
+
+        class Rows
+        {
+        public:
+            Rows(RowIterator b, RowIterator e) : m_Begin(b), m_End(e) {}
+
+            inline RowIterator begin() const { return m_Begin; }
+            inline RowIterator end() const { return m_End; }
+
+        private:
+            RowIterator m_Begin;
+            RowIterator m_End;
+        };
+
+        ImagePlane()
+            : data(nullptr)
+            , rowBytes(0)
+            , size(0, 0)
+            , paddedSize(0, 0)
+        {
+        }
+
+        ImagePlane(std::uint8_t *d, std::size_t rb, Vec2ui const &sz, Vec2ui const &psz)
+            : data(d)
+            , rowBytes(rb)
+            , size(sz)
+            , paddedSize(psz)
+        {
+        }
+
+        inline std::uint8_t* rowData(std::uint32_t y) const { return data + y * rowBytes; }
+        inline Pixel* row(std::uint32_t y) const { return reinterpret_cast<Pixel*>(rowData(y)); }
+        inline Pixel& operator()(std::uint32_t x, std::uint32_t y) const { return row(y)[x]; }
+
+        inline Rows rows() const
+        {
+            return Rows(
+                RowIterator(data, rowBytes, size(0)),
+                RowIterator(data + size(1) * rowBytes, rowBytes, size(0))
+            );
+        }
+
+        // raw bytes, size(1) rows by size(0) * kBytesPerPixel columns
+        inline Map map() const
+        {
+            return Map(data, size(1), size(0) * kBytesPerPixel, Eigen::OuterStride<>(rowBytes));
+        }
+
+        inline Map paddedMap() const
+        {
+            return Map(data, paddedSize(1), paddedSize(0) * kBytesPerPixel, Eigen::OuterStride<>(rowBytes));
+        }
+
+        // one component of an interleaved plane
+        inline ChannelMap channelMap(std::size_t c) const
+        {
+            return ChannelMap(data + c, size(1), size(0), Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic>(rowBytes, kBytesPerPixel));
+        }
+
+        std::uint8_t *data;
+        std::size_t rowBytes;
+        Vec2ui size;
+        Vec2ui paddedSize;
+    };
+
+    // Plane layout of a locked PixelBuffer resolved once per frame. The format
+    // is a template parameter so plane count, pixel sizes and subsampling are
+    // compile time constants. A buffer of another format yields an invalid view.
+    template <ePixelFormat Format>
+    class ImageView
+    {
+    public:
+        static constexpr PixelFormatDescriptor kDescriptor = pixelFormatDescriptor(Format);
+        static constexpr std::size_t kPlaneCount = kDescriptor.planeCount;
+        static constexpr std::uint32_t kWidthAlignment = kPixelBufferWidthAlignment;
+        static constexpr std::uint32_t kHeightAlignment = kPixelBufferHeightAlignment;
+
+        template <std::size_t PI>
+        using Plane = ImagePlane<kDescriptor.bytesPerPixel[PI]>;
+
+        ImageView()
+            : m_Size(0, 0)
+            , m_PaddedSize(0, 0)
+            , m_Data()
+            , m_RowBytes()
+        {
+            m_Data.fill(nullptr);
+            m_RowBytes.fill(0);
+        }
+
+        explicit ImageView(PixelBuffer &buffer)
+            : ImageView()
+        {
+            if (buffer.format() != Format || buffer.planeCount() != kPlaneCount)
+                return;
+
+            for (std::size_t pi = 0; pi < kPlaneCount; ++pi)
+            {
+                m_Data[pi] = static_cast<std::uint8_t*>(buffer.planeData(pi));
+                m_RowBytes[pi] = buffer.planeRowBytes(pi);
+                if (!m_Data[pi])
+                {
+                    m_Data.fill(nullptr);
+                    return;
+                }
+            }
+
+            m_Size = buffer.planeSize(0);
+            m_PaddedSize = buffer.paddedSize();
+        }
+
+        inline bool isValid() const { return m_Data[0] != nullptr; }
+        inline Vec2ui const& size() const { return m_Size; }
+        inline Vec2ui const& paddedSize() const { return m_PaddedSize; }
+
+        // true when the allocation is padded to kWidthAlignment x kHeightAlignment
+        inline bool isPadded() const
+        {
+            return m_PaddedSize(0) % kWidthAlignment == 0 && m_PaddedSize(1) % kHeightAlignment == 0;
+        }
+
+        template <std::size_t PI>
+        inline Plane<PI> plane() const
+        {
+            static_assert(PI < kPlaneCount, "plane index out of range");
+            return Plane<PI>(
+                m_Data[PI],
+                m_RowBytes[PI],
+                Vec2ui(m_Size(0) >> kDescriptor.widthShift[PI], m_Size(1) >> kDescriptor.heightShift[PI]),
+                Vec2ui(m_PaddedSize(0) >> kDescriptor.widthShift[PI], m_PaddedSize(1) >> kDescriptor.heightShift[PI])
+            );
+        }
+
+    private:
+        Vec2ui m_Size;
+        Vec2ui m_PaddedSize;
+        std::array<std::uint8_t*, kPlaneCount> m_Data;
+        std::array<std::size_t, kPlaneCount> m_RowBytes;
+    };
+
+    template <ePixelFormat Format>
+    constexpr PixelFormatDescriptor ImageView<Format>::kDescriptor;
+
+    using I420View = ImageView<kPixelFormatYUV420>;
+    using RGB24View = ImageView<kPixelFormatRGB8>;
+    using NV12View = ImageView<kPixelFormatNV12>;
+    using NV21View = ImageView<kPixelFormatNV21>;
+    using YUYVView = ImageView<kPixelFormatYUYV>;
+    using UYVYView = ImageView<kPixelFormatUYVY>;
+    using RGBAView = ImageView<kPixelFormatRGBA8>;
+    using BGRAView = ImageView<kPixelFormatBGRA8>;
+    using Gray8View = ImageView<kPixelFormatGRAY8>;
+    using I422View = ImageView<kPixelFormatYUV422>;
+}
@@ -0,0 +1,411 @@
+#include "ImageWarp.hpp"
+#include "SimdBilinear.hpp"
+#include "Logging.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace rpiCam
+{
+    namespace
+    {
+        static constexpr std::uint32_t kTileWidth = 64;
+        static constexpr std::uint32_t kTileHeight = 16;
+        static constexpr std::int32_t kWeightBits = 7;
+        static constexpr std::int32_t kWeightOne = 1 << kWeightBits;
+        static constexpr std::uint32_t kBlockPixels = 8;
+
+        // one plane of a warp, mapping takes destination plane pixels to
+        // source plane pixels
+        struct PlaneWarp
+        {
+            std::uint8_t const *src;
+            std::size_t srcRowBytes;
+            std::int32_t width;
+            std::int32_t height;
+            std::uint8_t *dst;
+            std::size_t dstRowBytes;
+            Vec2ui dstSize;
+            std::size_t channels;
+            std::uint8_t fill;
+            bool bReplicate;
+            bool bPerspective;
+            Eigen::Matrix3d mapping;
+        };
+
+        // The bilinear taps of the pixels along a tile row, the offset of
+        // the top left tap and the weights of the right and bottom ones.
+        // Pixels outside have their bit set and sample the plane's first
+        // pixel until the fill overwrites them.
+        struct RowSamples
+        {
+            std::uint32_t offset[kTileWidth];
+            alignas(16) std::uint16_t wx[kTileWidth];
+            alignas(16) std::uint16_t wy[kTileWidth];
+            std::uint64_t outside;
+        };
+
+        // Q16 source position of pixel i of a row onto its taps, the right
+        // and bottom taps are always inside: the last column and row are
+        // reached with a full weight on them
+        inline void resolve(PlaneWarp const &plane, std::uint32_t i, std::int64_t sx, std::int64_t sy, RowSamples &samples)
+        {
+            std::int64_t const maxX = std::int64_t(plane.width - 1) << 16, maxY = std::int64_t(plane.height - 1) << 16;
+            if (sx < 0 || sy < 0 || sx > maxX || sy > maxY)
+            {
+                if (!plane.bReplicate)
+                {
+                    samples.offset[i] = 0;
+                    samples.wx[i] = samples.wy[i] = 0;
+                    samples.outside |= std::uint64_t(1) << i;
+                    return;
+                }
+                sx = std::max<std::int64_t>(0, std::min(sx, maxX));
+                sy = std::max<std::int64_t>(0, std::min(sy, maxY));
+            }
+
+            std::int32_t x = std::int32_t(sx >> 16), y = std::int32_t(sy >> 16);
+            std::int32_t fx = std::int32_t(sx >> (16 - kWeightBits)) & (kWeightOne - 1);
+            std::int32_t fy = std::int32_t(sy >> (16 - kWeightBits)) & (kWeightOne - 1);
+            if (x == plane.width - 1)
+            {
+                x = plane.width - 2;
+                fx = kWeightOne;
+            }
+            if (y == plane.height - 1)
+            {
+                y = plane.height - 2;
+                fy = kWeightOne;
+            }
+
+            samples.offset[i] = std::uint32_t(y * plane.srcRowBytes + x * plane.channels);
+            samples.wx[i] = std::uint16_t(fx);
+            samples.wy[i] = std::uint16_t(fy);
+        }
+
+        // source positions of count pixels from (x0, y) on
+        void prepareRow(PlaneWarp const &plane, std::uint32_t x0, std::uint32_t y, std::uint32_t count, RowSamples &samples)
+        {
+            Eigen::Matrix3d const &m = plane.mapping;
+            Eigen::Vector3d const start = m * Eigen::Vector3d(x0, y, 1.0);
+            samples.outside = 0;
+
+            if (!plane.bPerspective)
+            {
+                std::int64_t sx = std::llround(start(0) * 65536.0), sy = std::llround(start(1) * 65536.0);
+                std::int64_t const stepX = std::llround(m(0, 0) * 65536.0), stepY = std::llround(m(1, 0) * 65536.0);
+                for (std::uint32_t i = 0; i < count; ++i, sx += stepX, sy += stepY)
+                    resolve(plane, i, sx, sy, samples);
+                return;
+            }
+
+            // positions are clamped into a margin around the plane before
+            // the conversion, biased so it rounds down on both sides of 0
+            float const maxX = float(plane.width + 1), maxY = float(plane.height + 1);
+            float const stepX = float(m(0, 0)), stepY = float(m(1, 0)), stepW = float(m(2, 0));
+            float X = float(start(0)), Y = float(start(1)), W = float(start(2));
+            for (std::uint32_t i = 0; i < count; ++i, X += stepX, Y += stepY, W += stepW)
+            {
+                if (!(W > 0.0f))
+                {
+                    samples.offset[i] = 0;
+                    samples.wx[i] = samples.wy[i] = 0;
+                    samples.outside |= std::uint64_t(1) << i;
+                    continue;
+                }
+
+                float const r = 1.0f / W;
+                float const x = std::max(-2.0f, std::min(X * r, maxX)), y = std::max(-2.0f, std::min(Y * r, maxY));
+                resolve(plane, i,
+                    std::int64_t((x + 2.0f) * 65536.0f + 0.5f) - (2 << 16),
+                    std::int64_t((y + 2.0f) * 65536.0f + 0.5f) - (2 << 16),
+                    samples);
+            }
+        }
+
+        // Whole blocks of single channel pixels, the two taps of a source
+        // row come in one little endian 16 bit load. Returns the pixels done.
+        std::uint32_t sampleBlocks(RowSamples const &samples, std::uint32_t count, std::uint8_t const *src, std::size_t rowBytes, std::uint8_t *dst)
+        {
+            std::uint32_t i0 = 0;
+#if defined(RPI_CAM_SIMD)
+            alignas(16) std::uint16_t top[kBlockPixels], bottom[kBlockPixels];
+            for (; i0 + kBlockPixels <= count; i0 += kBlockPixels)
+            {
+                for (std::uint32_t i = 0; i < kBlockPixels; ++i)
+                {
+                    std::uint8_t const *p = src + samples.offset[i0 + i];
+                    std::memcpy(top + i, p, 2);
+                    std::memcpy(bottom + i, p + rowBytes, 2);
+                }
+
+#if defined(RPI_CAM_SIMD_NEON)
+                bilinearBlock<kWeightBits>(top, bottom, vld1q_u16(samples.wx + i0), vld1q_u16(samples.wy + i0), dst + i0);
+#else
+                bilinearBlock<kWeightBits>(top, bottom, _mm_load_si128(reinterpret_cast<__m128i const*>(samples.wx + i0)),
+                    _mm_load_si128(reinterpret_cast<__m128i const*>(samples.wy + i0)), dst + i0);
+#endif
+            }
+#else
+            (void)samples; (void)count; (void)src; (void)rowBytes; (void)dst;
+#endif
+            return i0;
+        }
+
+        // Pairs of pixels of 2 to 4 channels, a source row of a pixel in one
+        // load. Returns the pixels done.
+        template <std::size_t Channels>
+        std::uint32_t samplePairs(RowSamples const &samples, std::uint32_t count, std::uint8_t const *src, std::size_t rowBytes, std::uint8_t *dst)
+        {
+            std::uint32_t i0 = 0;
+#if defined(RPI_CAM_SIMD)
+            for (; i0 + 2 <= count; i0 += 2)
+            {
+                std::uint8_t const *p0 = src + samples.offset[i0], *p1 = src + samples.offset[i0 + 1];
+                storeBilinearPair<Channels>(bilinearPair<Channels, kWeightBits>(
+                    loadBilinearTaps<Channels>(p0), loadBilinearTaps<Channels>(p0 + rowBytes), samples.wx[i0], samples.wy[i0],
+                    loadBilinearTaps<Channels>(p1), loadBilinearTaps<Channels>(p1 + rowBytes), samples.wx[i0 + 1], samples.wy[i0 + 1]),
+                    dst + i0 * Channels);
+            }
+#else
+            (void)samples; (void)count; (void)src; (void)rowBytes; (void)dst;
+#endif
+            return i0;
+        }
+
+        void sampleRow(PlaneWarp const &plane, RowSamples const &samples, std::uint32_t count, std::uint8_t *dst, bool bSimd)
+        {
+            std::size_t const channels = plane.channels, rowBytes = plane.srcRowBytes;
+            std::uint32_t i = 0;
+            if (bSimd)
+            {
+                switch (channels)
+                {
+                case 1: i = sampleBlocks(samples, count, plane.src, rowBytes, dst); break;
+                case 2: i = samplePairs<2>(samples, count, plane.src, rowBytes, dst); break;
+                case 3: i = samplePairs<3>(samples, count, plane.src, rowBytes, dst); break;
+                case 4: i = samplePairs<4>(samples, count, plane.src, rowBytes, dst); break;
+                }
+            }
+
+            for (; i < count; ++i)
+            {
+                std::uint8_t const *p = plane.src + samples.offset[i];
+                std::uint32_t const fx = samples.wx[i], fy = samples.wy[i];
+                for (std::size_t c = 0; c < channels; ++c, ++p)
+                {
+                    std::uint32_t const top = p[0] * (kWeightOne - fx) + p[channels] * fx;
+                    std::uint32_t const bottom = p[rowBytes] * (kWeightOne - fx) + p[rowBytes + channels] * fx;
+                    dst[i * channels + c] = std::uint8_t((top * (kWeightOne - fy) + bottom * fy + (1 << (2 * kWeightBits - 1))) >> (2 * kWeightBits));
+                }
+            }
+
+            for (i = 0; i < count && samples.outside >> i; ++i)
+            {
+                if ((samples.outside >> i) & 1)
+                    std::fill_n(dst + i * channels, channels, plane.fill);
+            }
+        }
+
+        // the tiles of the band of rows from y0 on
+        void warpBand(PlaneWarp const &plane, std::uint32_t y0, bool bSimd)
+        {
+            RowSamples samples;
+            std::uint32_t const bandHeight = std::min(std::uint32_t(kTileHeight), plane.dstSize(1) - y0);
+            for (std::uint32_t x0 = 0; x0 < plane.dstSize(0); x0 += kTileWidth)
+            {
+                std::uint32_t const tileWidth = std::min(std::uint32_t(kTileWidth), plane.dstSize(0) - x0);
+                for (std::uint32_t y = y0; y < y0 + bandHeight; ++y)
+                {
+                    prepareRow(plane, x0, y, tileWidth, samples);
+                    sampleRow(plane, samples, tileWidth, plane.dst + y * plane.dstRowBytes + x0 * plane.channels, bSimd);
+                }
+            }
+        }
+    }
+
+    std::error_code fitHomography(std::array<Vec2f, 4> const &from, std::array<Vec2f, 4> const &to, Eigen::Matrix3f &homography)
+    {
+        // moves the centroid to the origin and the mean distance to sqrt(2)
+        auto normalization = [](std::array<Vec2f, 4> const &points, Eigen::Matrix3d &t) -> bool
+        {
+            Eigen::Vector2d centroid = Eigen::Vector2d::Zero();
+            for (Vec2f const &p : points)
+                centroid += p.cast<double>();
+            centroid /= 4.0;
+
+            double distance = 0.0;
+            for (Vec2f const &p : points)
+                distance += (p.cast<double>() - centroid).norm();
+            if (!(distance > 0.0))
+                return false;
+
+            double const s = 4.0 * std::sqrt(2.0) / distance;
+            t << s, 0.0, -s * centroid(0),
+                 0.0, s, -s * centroid(1),
+                 0.0, 0.0, 1.0;
+
+            // no three points on a line
+            for (std::size_t i = 0; i < 4; ++i)
+            {
+                Eigen::Vector2d const a = s * (points[(i + 1) % 4].cast<double>() - points[i].cast<double>());
+                Eigen::Vector2d const b = s * (points[(i + 2) % 4].cast<double>() - points[i].cast<double>());
+                if (std::abs(a(0) * b(1) - a(1) * b(0)) < 1.0e-6)
+                    return false;
+            }
+            return true;
+        };
+
+        Eigen::Matrix3d tFrom, tTo;
+        if (!normalization(from, tFrom) || !normalization(to, tTo))
+            return std::make_error_code(std::errc::invalid_argument);
+
+        // h22 = 1, two equations per pair
+        Eigen::Matrix<double, 8, 8> a;
+        Eigen::Matrix<double, 8, 1> b;
+        for (std::size_t i = 0; i < 4; ++i)
+        {
+            Eigen::Vector3d const p = tFrom * Eigen::Vector3d(from[i](0), from[i](1), 1.0);
+            Eigen::Vector3d const q = tTo * Eigen::Vector3d(to[i](0), to[i](1), 1.0);
+            a.row(2 * i) << p(0), p(1), 1.0, 0.0, 0.0, 0.0, -q(0) * p(0), -q(0) * p(1);
+            a.row(2 * i + 1) << 0.0, 0.0, 0.0, p(0), p(1), 1.0, -q(1) * p(0), -q(1) * p(1);
+            b(2 * i) = q(0);
+            b(2 * i + 1) = q(1);
+        }
+
+        Eigen::FullPivLU<Eigen::Matrix<double, 8, 8>> const lu(a);
+        if (!lu.isInvertible())
+            return std::make_error_code(std::errc::invalid_argument);
+
+        Eigen::Matrix<double, 8, 1> const h = lu.solve(b);
+        Eigen::Matrix3d normalized;
+        normalized << h(0), h(1), h(2),
+                      h(3), h(4), h(5),
+                      h(6), h(7), 1.0;
+
+        Eigen::Matrix3d const result = tTo.inverse() * normalized * tFrom;
+        homography = (result / result(2, 2)).cast<float>();
+        return std::error_code();
+    }
+
+    ImageWarper::ImageWarper(std::shared_ptr<ThreadPool> pool)
+        : m_Pool(pool)
+        , m_Border(Border::Constant)
+        , m_bSimdEnabled(true)
+    {
+    }
+
+    ImageWarper::~ImageWarper()
+    {
+    }
+
+    std::error_code ImageWarper::warpAffine(PixelBuffer &src, PixelBuffer &dst, Eigen::Matrix3f const &dstToSrc)
+    {
+        return warp(src, dst, dstToSrc, false, "ImageWarper::warpAffine()");
+    }
+
+    std::error_code ImageWarper::warpPerspective(PixelBuffer &src, PixelBuffer &dst, Eigen::Matrix3f const &dstToSrc)
+    {
+        return warp(src, dst, dstToSrc, true, "ImageWarper::warpPerspective()");
+    }
+
+    std::error_code ImageWarper::warp(PixelBuffer &src, PixelBuffer &dst, Eigen::Matrix3f const &dstToSrc, bool bPerspective, char const *who)
+    {
+        PixelFormatDescriptor const descriptor = pixelFormatDescriptor(src.format());
+        if (src.format() != dst.format())
+        {
+            RPI_LOG(ERROR, "%s: mismatching pixel formats!", who);
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        if (!descriptor.planeCount || src.format() == kPixelFormatYUYV || src.format() == kPixelFormatUYVY)
+        {
+            RPI_LOG(ERROR, "%s: unsupported pixel format!", who);
+            return std::make_error_code(std::errc::not_supported);
+        }
+
+        for (std::size_t pi = 0; pi < descriptor.planeCount; ++pi)
+        {
+            Vec2ui const srcSize = src.planeSize(pi);
+            if (srcSize(0) < 2 || srcSize(1) < 2 || srcSize(0) > kMaxSourceSize || srcSize(1) > kMaxSourceSize)
+            {
+                RPI_LOG(ERROR, "%s: unsupported source size!", who);
+                return std::make_error_code(std::errc::invalid_argument);
+            }
+
+            if (!src.planeData(pi) || !dst.planeData(pi))
+            {
+                RPI_LOG(ERROR, "%s: buffer not locked or empty!", who);
+                return std::make_error_code(std::errc::invalid_argument);
+            }
+        }
+
+        Eigen::Matrix3d transform = dstToSrc.cast<double>();
+        if (!bPerspective)
+            transform.row(2) << 0.0, 0.0, 1.0;
+
+        bool const bSimd = m_bSimdEnabled;
+        for (std::size_t pi = 0; pi < descriptor.planeCount; ++pi)
+        {
+            // plane pixel centers in frame pixels, (p + 0.5) * k - 0.5
+            double const kx = double(1 << descriptor.widthShift[pi]), ky = double(1 << descriptor.heightShift[pi]);
+            Eigen::Matrix3d toFrame;
+            toFrame << kx, 0.0, 0.5 * kx - 0.5,
+                       0.0, ky, 0.5 * ky - 0.5,
+                       0.0, 0.0, 1.0;
+
+            PlaneWarp plane;
+            plane.src = static_cast<std::uint8_t const*>(src.planeData(pi));
+            plane.srcRowBytes = src.planeRowBytes(pi);
+            plane.width = std::int32_t(src.planeSize(pi)(0));
+            plane.height = std::int32_t(src.planeSize(pi)(1));
+            plane.dst = static_cast<std::uint8_t*>(dst.planeData(pi));
+            plane.dstRowBytes = dst.planeRowBytes(pi);
+            plane.dstSize = dst.planeSize(pi);
+            plane.channels = descriptor.bytesPerPixel[pi];
+            plane.fill = pi ? 128 : 0;
+            plane.bReplicate = m_Border == Border::Replicate;
+            plane.bPerspective = bPerspective;
+            plane.mapping = toFrame.inverse() * transform * toFrame;
+
+            std::size_t const bands = (plane.dstSize(1) + kTileHeight - 1) / kTileHeight;
+            auto warpBands = [&](std::size_t begin, std::size_t end)
+            {
+                for (std::size_t band = begin; band < end; ++band)
+                    warpBand(plane, std::uint32_t(band) * kTileHeight, bSimd);
+            };
+
+            if (m_Pool && m_Pool->size() > 0 && bands > 1)
+                m_Pool->parallelFor(0, bands, 1, warpBands);
+            else
+                warpBands(0, bands);
+        }
+        return std::error_code();
+    }
+
+    std::istream& operator>>(std::istream &s, ImageWarper::Border &v)
+    {
+        std::string sv;
+        s >> sv;
+        if (sv == "Constant")
+            v = ImageWarper::Border::Constant;
+        else if (sv == "Replicate")
+            v = ImageWarper::Border::Replicate;
+        else
+            throw std::invalid_argument("Invalid value for ImageWarper::Border: " + sv);
+        return s;
+    }
+
+    std::ostream& operator<<(std::ostream &s, ImageWarper::Border v)
+    {
+        switch (v)
+        {
+        case ImageWarper::Border::Constant:     s << "Constant";    break;
+        case ImageWarper::Border::Replicate:    s << "Replicate";   break;
+        }
+        return s;
+    }
+}
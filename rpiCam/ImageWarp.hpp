@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Config.hpp"
+#include "PixelBuffer.hpp"
+#include "ThreadPool.hpp"
+#include <array>
+#include <system_error>
+
+namespace rpiCam
+{
+    // Homography taking from[i] onto to[i], solved exactly from the four
+    // pairs with the points normalised for conditioning. Fails with
+    // std::errc::invalid_argument when three points of either side are on
+    // a line. Fitting output corners onto a quadrilateral seen in a frame
+    // gives the dstToSrc of warpPerspective() rectifying it.
+    std::error_code fitHomography(std::array<Vec2f, 4> const &from, std::array<Vec2f, 4> const &to, Eigen::Matrix3f &homography);
+
+    // Affine and perspective warps of PixelBuffers of any format but packed
+    // 4:2:2, plane by plane. Transforms take destination pixels to source
+    // pixels in full resolution frame coordinates, subsampled planes follow
+    // along. Output is produced in 64x16 tiles, in parallel over bands of
+    // tiles when there is a thread pool, so the source footprint of a tile
+    // stays in cache whatever the rotation. Along a tile row the source
+    // position advances incrementally, by a constant Q16 step for affine
+    // transforms and by the homogeneous numerators and denominator for
+    // perspective ones, a division per pixel. Samples are Q7 fixed point
+    // bilinear.
+    class ImageWarper
+    {
+    public:
+        enum class Border : int
+        {
+            Constant,   // black, zero in the first plane and 128 in the others
+            Replicate   // the nearest edge pixel
+        };
+
+        static constexpr std::uint32_t kMaxSourceSize = 16383;
+
+        ImageWarper(std::shared_ptr<ThreadPool> pool = nullptr);
+        ~ImageWarper();
+
+        inline Border border() const { return m_Border; }
+        inline void setBorder(Border border) { m_Border = border; }
+
+        inline bool isSimdEnabled() const { return m_bSimdEnabled; }
+        inline void setSimdEnabled(bool bEnabled) { m_bSimdEnabled = bEnabled; }
+
+        // Destination pixel (x, y) takes the source at dstToSrc * (x, y, 1),
+        // the last row of dstToSrc is taken as (0, 0, 1). Both buffers must
+        // be locked and have the same format.
+        std::error_code warpAffine(PixelBuffer &src, PixelBuffer &dst, Eigen::Matrix3f const &dstToSrc);
+
+        // Destination pixel (x, y) takes the source at the dehomogenised
+        // dstToSrc * (x, y, 1), positions behind the source (a last
+        // coordinate not above zero) are outside whatever the border.
+        std::error_code warpPerspective(PixelBuffer &src, PixelBuffer &dst, Eigen::Matrix3f const &dstToSrc);
+
+    private:
+        std::error_code warp(PixelBuffer &src, PixelBuffer &dst, Eigen::Matrix3f const &dstToSrc, bool bPerspective, char const *who);
+
+    private:
+        std::shared_ptr<ThreadPool> m_Pool;
+        Border m_Border;
+        bool m_bSimdEnabled;
+    };
+
+    extern std::istream& operator>>(std::istream &s, ImageWarper::Border &v);
+    extern std::ostream& operator<<(std::ostream &s, ImageWarper::Border v);
+}
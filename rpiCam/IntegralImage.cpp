@@ -0,0 +1,117 @@
+#include "IntegralImage.hpp"
+#include "Logging.hpp"
+#include <algorithm>
+
+namespace rpiCam
+{
+    IntegralImage::IntegralImage()
+        : m_Size(0, 0)
+        , m_Sums()
+        , m_SquaredSums()
+    {
+    }
+
+    IntegralImage::~IntegralImage()
+    {
+    }
+
+    std::error_code IntegralImage::compute(PixelBuffer &buffer, std::size_t pi, bool bSquared)
+    {
+        if (pi >= buffer.planeCount() || pixelFormatDescriptor(buffer.format()).bytesPerPixel[pi] != 1)
+        {
+            RPI_LOG(ERROR, "IntegralImage::compute(): plane is not one byte per pixel!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        std::uint8_t const *data = static_cast<std::uint8_t const*>(buffer.planeData(pi));
+        if (!data)
+        {
+            RPI_LOG(ERROR, "IntegralImage::compute(): buffer not locked!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        m_Size = buffer.planeSize(pi);
+        std::size_t const rowBytes = buffer.planeRowBytes(pi);
+        std::size_t const stride = m_Size(0) + 1;
+        std::size_t const count = stride * (m_Size(1) + 1);
+
+        m_Sums.resize(count);
+        std::fill(m_Sums.begin(), m_Sums.begin() + stride, 0);
+        if (bSquared)
+        {
+            m_SquaredSums.resize(count);
+            std::fill(m_SquaredSums.begin(), m_SquaredSums.begin() + stride, 0);
+        }
+        else
+            m_SquaredSums.clear();
+
+        // row prefix sums plus the row above, the second half is a plain vectorizable add
+        for (std::uint32_t y = 0; y < m_Size(1); ++y)
+        {
+            std::uint8_t const *src = data + y * rowBytes;
+            std::uint32_t const *above = m_Sums.data() + y * stride;
+            std::uint32_t *out = m_Sums.data() + (y + 1) * stride;
+
+            out[0] = 0;
+            std::uint32_t rowSum = 0;
+            for (std::uint32_t x = 0; x < m_Size(0); ++x)
+            {
+                rowSum += src[x];
+                out[x + 1] = rowSum;
+            }
+            for (std::uint32_t x = 1; x <= m_Size(0); ++x)
+                out[x] += above[x];
+
+            if (!bSquared)
+                continue;
+
+            std::uint64_t const *squaredAbove = m_SquaredSums.data() + y * stride;
+            std::uint64_t *squaredOut = m_SquaredSums.data() + (y + 1) * stride;
+            squaredOut[0] = 0;
+            std::uint64_t squaredRowSum = 0;
+            for (std::uint32_t x = 0; x < m_Size(0); ++x)
+            {
+                squaredRowSum += std::uint32_t(src[x]) * src[x];
+                squaredOut[x + 1] = squaredRowSum + squaredAbove[x + 1];
+            }
+        }
+        return std::error_code();
+    }
+
+    std::uint32_t IntegralImage::sum(Rect const &rect) const
+    {
+        std::size_t const stride = m_Size(0) + 1;
+        Vec2ui const e = rect.end();
+        // unsigned wrap-around cancels out, the result fits 32 bits
+        return m_Sums[e(1) * stride + e(0)] - m_Sums[rect.origin(1) * stride + e(0)]
+            - m_Sums[e(1) * stride + rect.origin(0)] + m_Sums[rect.origin(1) * stride + rect.origin(0)];
+    }
+
+    std::uint64_t IntegralImage::squaredSum(Rect const &rect) const
+    {
+        if (m_SquaredSums.empty())
+            return 0;
+
+        std::size_t const stride = m_Size(0) + 1;
+        Vec2ui const e = rect.end();
+        return m_SquaredSums[e(1) * stride + e(0)] - m_SquaredSums[rect.origin(1) * stride + e(0)]
+            - m_SquaredSums[e(1) * stride + rect.origin(0)] + m_SquaredSums[rect.origin(1) * stride + rect.origin(0)];
+    }
+
+    float IntegralImage::mean(Rect const &rect) const
+    {
+        if (rect.isEmpty())
+            return 0.0f;
+        return float(double(sum(rect)) / (double(rect.size(0)) * rect.size(1)));
+    }
+
+    float IntegralImage::variance(Rect const &rect) const
+    {
+        if (rect.isEmpty() || m_SquaredSums.empty())
+            return 0.0f;
+
+        double const n = double(rect.size(0)) * rect.size(1);
+        double const m = double(sum(rect)) / n;
+        return float(std::max(0.0, double(squaredSum(rect)) / n - m * m));
+    }
+}
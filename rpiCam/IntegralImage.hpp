@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Config.hpp"
+#include "PixelBuffer.hpp"
+#include "Rect.hpp"
+#include <vector>
+#include <system_error>
+
+namespace rpiCam
+{
+    // Summed area table of a one byte per pixel plane, optionally with the
+    // table of squares, so the sum, mean and variance of any rectangle cost
+    // four lookups. Tables have a leading row and column of zeros and are
+    // reused by the next compute() of the same size.
+    class IntegralImage
+    {
+    public:
+        IntegralImage();
+        ~IntegralImage();
+
+        // plane pi of a locked buffer, usually the Y plane
+        std::error_code compute(PixelBuffer &buffer, std::size_t pi = 0, bool bSquared = false);
+
+        inline Vec2ui const& size() const { return m_Size; }
+        inline bool hasSquared() const { return !m_SquaredSums.empty(); }
+
+        // rect must lie inside size()
+        std::uint32_t sum(Rect const &rect) const;
+        std::uint64_t squaredSum(Rect const &rect) const;
+        float mean(Rect const &rect) const;
+        float variance(Rect const &rect) const;
+
+        // (size(0) + 1) x (size(1) + 1) tables, row major
+        inline std::uint32_t const* sums() const { return m_Sums.data(); }
+        inline std::uint64_t const* squaredSums() const { return m_SquaredSums.data(); }
+
+    private:
+        Vec2ui m_Size;
+        std::vector<std::uint32_t> m_Sums;
+        std::vector<std::uint64_t> m_SquaredSums;
+    };
+}
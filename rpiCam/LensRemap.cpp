@@ -0,0 +1,550 @@
+#include "LensRemap.hpp"
+#include "SimdBilinear.hpp"
+#include "Logging.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace rpiCam
+{
+    namespace
+    {
+        // source positions are Q4, x in the low and y in the high half of an entry
+        static constexpr std::int32_t kFractionBits = 4;
+        static constexpr std::int32_t kOne = 1 << kFractionBits;
+        static constexpr std::uint32_t kOutside = 0xffffffff;
+        static constexpr std::size_t kBlockPixels = 8;
+
+        class Projection
+        {
+        public:
+            Projection(CameraIntrinsics const &intrinsics, LensDistortion const &distortion)
+                : m_Intrinsics(intrinsics)
+                , m_Distortion(distortion)
+                , m_MaxRadius(std::numeric_limits<double>::max())
+            {
+                if (distortion.model != LensModel::BrownConrady)
+                    return;
+
+                // past the first turning point of r * (1 + k1 r^2 + k2 r^4 + k3 r^6) the
+                // polynomial folds far away rays back into the image
+                for (double r = 0.0; r < 10.0; r += 0.001)
+                {
+                    double const r2 = r * r;
+                    double const slope = 1.0 + 3.0 * distortion.k1 * r2 + 5.0 * distortion.k2 * r2 * r2 + 7.0 * distortion.k3 * r2 * r2 * r2;
+                    if (slope <= 0.0)
+                    {
+                        m_MaxRadius = r;
+                        break;
+                    }
+                }
+            }
+
+            // physical camera pixel of a ray, false when the lens does not see it
+            bool project(Eigen::Vector3d const &ray, Eigen::Vector2d &pixel) const
+            {
+                Eigen::Vector2d distorted;
+                if (m_Distortion.model == LensModel::BrownConrady)
+                {
+                    if (ray(2) <= 1.0e-9)
+                        return false;
+
+                    double const x = ray(0) / ray(2), y = ray(1) / ray(2);
+                    double const r2 = x * x + y * y;
+                    if (r2 > m_MaxRadius * m_MaxRadius)
+                        return false;
+
+                    double const radial = 1.0 + r2 * (m_Distortion.k1 + r2 * (m_Distortion.k2 + r2 * m_Distortion.k3));
+                    double const p1 = m_Distortion.p1, p2 = m_Distortion.p2;
+                    distorted(0) = x * radial + 2.0 * p1 * x * y + p2 * (r2 + 2.0 * x * x);
+                    distorted(1) = y * radial + p1 * (r2 + 2.0 * y * y) + 2.0 * p2 * x * y;
+                }
+                else
+                {
+                    double const r = std::sqrt(ray(0) * ray(0) + ray(1) * ray(1));
+                    if (r < 1.0e-12)
+                        distorted = Eigen::Vector2d::Zero();
+                    else
+                    {
+                        double const theta = std::atan2(r, ray(2)), theta2 = theta * theta;
+                        double const thetaDistorted = theta * (1.0 + theta2 * (m_Distortion.k1 + theta2 * (m_Distortion.k2 +
+                            theta2 * (m_Distortion.k3 + theta2 * m_Distortion.k4))));
+                        distorted = (thetaDistorted / r) * Eigen::Vector2d(ray(0), ray(1));
+                    }
+                }
+
+                pixel = distorted.cwiseProduct(m_Intrinsics.focalLength.cast<double>()) + m_Intrinsics.principalPoint.cast<double>();
+                return true;
+            }
+
+        private:
+            CameraIntrinsics const m_Intrinsics;
+            LensDistortion const m_Distortion;
+            double m_MaxRadius;
+        };
+
+        // Q4 coordinate along an axis of n samples, kept below n - 1 so the
+        // second tap is always inside
+        inline bool toFixed(double v, std::uint32_t n, std::uint32_t &fixed)
+        {
+            if (v < -0.5 || v > double(n) - 0.5)
+                return false;
+            std::int64_t const q = std::llround(v * kOne);
+            fixed = std::uint32_t(std::max<std::int64_t>(0, std::min<std::int64_t>(q, std::int64_t(n - 1) * kOne - 1)));
+            return true;
+        }
+
+        // Whole blocks of single channel pixels. The two taps of a source
+        // row are neighbours and come in one little endian 16 bit load, the
+        // left one in the low byte, the weights are taken from the entries
+        // in registers. Returns the pixels done.
+        std::uint32_t remapBlocks(std::uint32_t const *entries, std::uint32_t count, std::uint8_t const *src, std::size_t rowBytes,
+            std::uint8_t fill, std::uint8_t *dst)
+        {
+            std::uint32_t i0 = 0;
+#if defined(RPI_CAM_SIMD_NEON) || defined(RPI_CAM_SIMD_SSE2)
+            alignas(16) std::uint16_t top[kBlockPixels], bottom[kBlockPixels];
+            for (; i0 + kBlockPixels <= count; i0 += kBlockPixels)
+            {
+                std::uint32_t outside = 0;
+                for (std::uint32_t i = 0; i < kBlockPixels; ++i)
+                {
+                    std::uint32_t const e = entries[i0 + i];
+                    std::size_t offset = 0;
+                    if (e == kOutside)
+                        outside |= 1 << i;
+                    else
+                        offset = (e >> (16 + kFractionBits)) * rowBytes + ((e & 0xffff) >> kFractionBits);
+                    std::memcpy(top + i, src + offset, 2);
+                    std::memcpy(bottom + i, src + offset + rowBytes, 2);
+                }
+
+#if defined(RPI_CAM_SIMD_NEON)
+                uint32x4_t const mask = vdupq_n_u32(kOne - 1);
+                uint32x4_t const e0 = vld1q_u32(entries + i0), e1 = vld1q_u32(entries + i0 + 4);
+                uint16x8_t const fx = vcombine_u16(vmovn_u32(vandq_u32(e0, mask)), vmovn_u32(vandq_u32(e1, mask)));
+                uint16x8_t const fy = vcombine_u16(vmovn_u32(vandq_u32(vshrq_n_u32(e0, 16), mask)), vmovn_u32(vandq_u32(vshrq_n_u32(e1, 16), mask)));
+#else
+                __m128i const mask = _mm_set1_epi32(kOne - 1);
+                __m128i const e0 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(entries + i0));
+                __m128i const e1 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(entries + i0 + 4));
+                __m128i const fx = _mm_packs_epi32(_mm_and_si128(e0, mask), _mm_and_si128(e1, mask));
+                __m128i const fy = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(e0, 16), mask), _mm_and_si128(_mm_srli_epi32(e1, 16), mask));
+#endif
+                bilinearBlock<kFractionBits>(top, bottom, fx, fy, dst + i0);
+                for (std::uint32_t i = 0; outside; ++i, outside >>= 1)
+                {
+                    if (outside & 1)
+                        dst[i0 + i] = fill;
+                }
+            }
+#else
+            (void)entries; (void)count; (void)src; (void)rowBytes; (void)fill; (void)dst;
+#endif
+            return i0;
+        }
+
+        // Pairs of pixels of 2 to 4 channels, a source row of a pixel in one
+        // load. Returns the pixels done.
+        template <std::size_t Channels>
+        std::uint32_t remapPairs(std::uint32_t const *entries, std::uint32_t count, std::uint8_t const *src, std::size_t rowBytes,
+            std::uint8_t fill, std::uint8_t *dst)
+        {
+            std::uint32_t i0 = 0;
+#if defined(RPI_CAM_SIMD_NEON) || defined(RPI_CAM_SIMD_SSE2)
+            std::uint64_t const filled = fill * 0x0101010101010101ull;
+
+            // equal taps of an outside pixel blend to themselves
+            auto gather = [&](std::uint32_t e, std::uint64_t &top, std::uint64_t &bottom, std::uint32_t &fx, std::uint32_t &fy)
+            {
+                if (e == kOutside)
+                {
+                    top = bottom = filled;
+                    fx = fy = 0;
+                    return;
+                }
+
+                std::uint8_t const *p = src + (e >> (16 + kFractionBits)) * rowBytes + ((e & 0xffff) >> kFractionBits) * Channels;
+                top = loadBilinearTaps<Channels>(p);
+                bottom = loadBilinearTaps<Channels>(p + rowBytes);
+                fx = e & (kOne - 1);
+                fy = (e >> 16) & (kOne - 1);
+            };
+
+            for (; i0 + 2 <= count; i0 += 2)
+            {
+                std::uint64_t top0, bottom0, top1, bottom1;
+                std::uint32_t fx0, fy0, fx1, fy1;
+                gather(entries[i0], top0, bottom0, fx0, fy0);
+                gather(entries[i0 + 1], top1, bottom1, fx1, fy1);
+                storeBilinearPair<Channels>(bilinearPair<Channels, kFractionBits>(top0, bottom0, fx0, fy0, top1, bottom1, fx1, fy1), dst + i0 * Channels);
+            }
+#else
+            (void)entries; (void)count; (void)src; (void)rowBytes; (void)fill; (void)dst;
+#endif
+            return i0;
+        }
+
+        // count pixels of channels bytes along one tile row
+        void remapRow(std::uint32_t const *entries, std::uint32_t count, std::uint8_t const *src, std::size_t rowBytes,
+            std::size_t channels, std::uint8_t fill, std::uint8_t *dst, bool bSimd)
+        {
+            std::uint32_t i = 0;
+            if (bSimd)
+            {
+                switch (channels)
+                {
+                case 1: i = remapBlocks(entries, count, src, rowBytes, fill, dst); break;
+                case 2: i = remapPairs<2>(entries, count, src, rowBytes, fill, dst); break;
+                case 3: i = remapPairs<3>(entries, count, src, rowBytes, fill, dst); break;
+                case 4: i = remapPairs<4>(entries, count, src, rowBytes, fill, dst); break;
+                }
+            }
+
+            for (dst += i * channels; i < count; ++i, dst += channels)
+            {
+                std::uint32_t const e = entries[i];
+                if (e == kOutside)
+                {
+                    std::fill_n(dst, channels, fill);
+                    continue;
+                }
+
+                std::uint32_t const x = e & 0xffff, y = e >> 16;
+                std::uint32_t const fx = x & (kOne - 1), fy = y & (kOne - 1);
+                std::uint8_t const *p = src + (y >> kFractionBits) * rowBytes + (x >> kFractionBits) * channels;
+                for (std::size_t c = 0; c < channels; ++c, ++p)
+                {
+                    std::uint32_t const top = p[0] * (kOne - fx) + p[channels] * fx;
+                    std::uint32_t const bottom = p[rowBytes] * (kOne - fx) + p[rowBytes + channels] * fx;
+                    dst[c] = std::uint8_t((top * (kOne - fy) + bottom * fy + (1 << (2 * kFractionBits - 1))) >> (2 * kFractionBits));
+                }
+            }
+        }
+    }
+
+    CameraIntrinsics::CameraIntrinsics()
+        : imageSize(0, 0)
+        , focalLength(0.0f, 0.0f)
+        , principalPoint(0.0f, 0.0f)
+    {
+    }
+
+    LensDistortion::LensDistortion()
+        : model(LensModel::BrownConrady)
+        , k1(0.0f)
+        , k2(0.0f)
+        , k3(0.0f)
+        , k4(0.0f)
+        , p1(0.0f)
+        , p2(0.0f)
+    {
+    }
+
+    RemapView::RemapView()
+        : size(0, 0)
+        , focalLength(0.0f, 0.0f)
+        , principalPoint(0.0f, 0.0f)
+        , rotation(Eigen::Matrix3f::Identity())
+    {
+    }
+
+    RemapView RemapView::undistorted(CameraIntrinsics const &intrinsics)
+    {
+        RemapView view;
+        view.size = intrinsics.imageSize;
+        view.focalLength = intrinsics.focalLength;
+        view.principalPoint = intrinsics.principalPoint;
+        return view;
+    }
+
+    RemapView RemapView::perspective(Vec2ui const &size, float horizontalFov, float yaw, float pitch, float roll)
+    {
+        RemapView view;
+        view.size = size;
+        float const focal = 0.5f * float(size(0)) / std::tan(0.5f * horizontalFov);
+        view.focalLength = Vec2f(focal, focal);
+        view.principalPoint = 0.5f * (size.cast<float>() - Vec2f(1.0f, 1.0f));
+
+        // y points down, so a positive turn about it looks right and one about x looks up
+        view.rotation = (
+            Eigen::AngleAxisf(yaw, Eigen::Vector3f::UnitY()) *
+            Eigen::AngleAxisf(-pitch, Eigen::Vector3f::UnitX()) *
+            Eigen::AngleAxisf(roll, Eigen::Vector3f::UnitZ())
+        ).toRotationMatrix();
+        return view;
+    }
+
+    LensRemapper::LensRemapper(std::shared_ptr<ThreadPool> pool)
+        : m_Pool(pool)
+        , m_bSimdEnabled(true)
+        , m_Format(kPixelFormatInvalid)
+        , m_SourceSize(0, 0)
+        , m_Views()
+    {
+    }
+
+    LensRemapper::~LensRemapper()
+    {
+    }
+
+    std::error_code LensRemapper::configure(ePixelFormat format, CameraIntrinsics const &intrinsics, LensDistortion const &distortion,
+        std::vector<RemapView> const &views)
+    {
+        m_Format = kPixelFormatInvalid;
+        m_Views.clear();
+
+        PixelFormatDescriptor const descriptor = pixelFormatDescriptor(format);
+        if (!descriptor.planeCount || format == kPixelFormatYUYV || format == kPixelFormatUYVY)
+        {
+            RPI_LOG(ERROR, "LensRemapper::configure(): unsupported pixel format!");
+            return std::make_error_code(std::errc::not_supported);
+        }
+
+        Vec2ui const &sourceSize = intrinsics.imageSize;
+        if ((sourceSize(0) >> descriptor.widthShift[descriptor.planeCount - 1]) < 2 ||
+            (sourceSize(1) >> descriptor.heightShift[descriptor.planeCount - 1]) < 2 ||
+            sourceSize(0) > kMaxSourceSize || sourceSize(1) > kMaxSourceSize ||
+            intrinsics.focalLength(0) <= 0.0f || intrinsics.focalLength(1) <= 0.0f)
+        {
+            RPI_LOG(ERROR, "LensRemapper::configure(): invalid intrinsics!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        for (auto const &view : views)
+        {
+            if ((view.size(0) >> descriptor.widthShift[descriptor.planeCount - 1]) < 1 ||
+                (view.size(1) >> descriptor.heightShift[descriptor.planeCount - 1]) < 1 ||
+                view.focalLength(0) <= 0.0f || view.focalLength(1) <= 0.0f)
+            {
+                RPI_LOG(ERROR, "LensRemapper::configure(): invalid view!");
+                return std::make_error_code(std::errc::invalid_argument);
+            }
+        }
+
+        // the subsampling shared by every subsampled plane, if any
+        std::uint32_t widthShift = 0, heightShift = 0;
+        for (std::size_t pi = 0; pi < descriptor.planeCount; ++pi)
+        {
+            if (descriptor.widthShift[pi] || descriptor.heightShift[pi])
+            {
+                widthShift = descriptor.widthShift[pi];
+                heightShift = descriptor.heightShift[pi];
+            }
+        }
+
+        Projection const projection(intrinsics, distortion);
+        m_Views.resize(views.size());
+        for (std::size_t vi = 0; vi < views.size(); ++vi)
+        {
+            View &view = m_Views[vi];
+            view.view = views[vi];
+
+            Eigen::Matrix3d const rotation = view.view.rotation.cast<double>();
+            Eigen::Vector2d const focal = view.view.focalLength.cast<double>();
+            Eigen::Vector2d const center = view.view.principalPoint.cast<double>();
+
+            for (std::size_t mi = 0; mi < 2; ++mi)
+            {
+                std::uint32_t const ws = mi ? widthShift : 0, hs = mi ? heightShift : 0;
+                Map &map = view.maps[mi];
+                if (mi && !ws && !hs)
+                {
+                    map.size = Vec2ui(0, 0);
+                    map.entries.clear();
+                    continue;
+                }
+
+                // plane pixel centers in frame pixels, (p + 0.5) * k - 0.5
+                double const kx = double(1 << ws), ky = double(1 << hs);
+                Vec2ui const planeSize(sourceSize(0) >> ws, sourceSize(1) >> hs);
+                map.size = Vec2ui(view.view.size(0) >> ws, view.view.size(1) >> hs);
+                map.entries.resize(map.size.prod());
+
+                auto computeBands = [&](std::size_t begin, std::size_t end)
+                {
+                    for (std::size_t band = begin; band < end; ++band)
+                    {
+                        std::uint32_t const y0 = std::uint32_t(band) * kTileHeight;
+                        std::uint32_t const bandHeight = std::min(std::uint32_t(kTileHeight), map.size(1) - y0);
+                        for (std::uint32_t x0 = 0; x0 < map.size(0); x0 += kTileWidth)
+                        {
+                            std::uint32_t const tileWidth = std::min(std::uint32_t(kTileWidth), map.size(0) - x0);
+                            std::uint32_t *tile = map.entries.data() + std::size_t(y0) * map.size(0) + std::size_t(x0) * bandHeight;
+                            for (std::uint32_t r = 0; r < bandHeight; ++r)
+                            {
+                                for (std::uint32_t col = 0; col < tileWidth; ++col)
+                                {
+                                    Eigen::Vector2d const output((double(x0 + col) + 0.5) * kx - 0.5, (double(y0 + r) + 0.5) * ky - 0.5);
+                                    Eigen::Vector2d const normalized = (output - center).cwiseQuotient(focal);
+                                    Eigen::Vector2d pixel;
+                                    std::uint32_t x = 0, y = 0;
+                                    bool const bInside = projection.project(rotation * Eigen::Vector3d(normalized(0), normalized(1), 1.0), pixel) &&
+                                        toFixed((pixel(0) + 0.5) / kx - 0.5, planeSize(0), x) &&
+                                        toFixed((pixel(1) + 0.5) / ky - 0.5, planeSize(1), y);
+                                    tile[r * tileWidth + col] = bInside ? x | (y << 16) : kOutside;
+                                }
+                            }
+                        }
+                    }
+                };
+
+                std::size_t const bands = (map.size(1) + kTileHeight - 1) / kTileHeight;
+                if (m_Pool && m_Pool->size() > 0 && bands > 1)
+                    m_Pool->parallelFor(0, bands, 1, computeBands);
+                else
+                    computeBands(0, bands);
+            }
+        }
+
+        m_Format = format;
+        m_SourceSize = sourceSize;
+        return std::error_code();
+    }
+
+    std::error_code LensRemapper::remap(PixelBuffer &src, PixelBuffer &dst, std::size_t vi)
+    {
+        if (!checkBuffers(src, dst, vi))
+            return std::make_error_code(std::errc::invalid_argument);
+
+        std::size_t const bands = numBands(vi);
+        if (m_Pool && m_Pool->size() > 0 && bands > 1)
+        {
+            m_Pool->parallelFor(0, bands, 1, [this, &src, &dst, vi](std::size_t begin, std::size_t end)
+            {
+                remapBands(src, dst, vi, begin, end);
+            });
+        }
+        else
+            remapBands(src, dst, vi, 0, bands);
+        return std::error_code();
+    }
+
+    std::vector<std::shared_ptr<MemoryPixelSampleBuffer>> LensRemapper::remap(PixelSampleBuffer &frame, std::shared_ptr<BufferArena> const &arena)
+    {
+        std::vector<std::shared_ptr<MemoryPixelSampleBuffer>> outputs;
+        if (frame.lock())
+        {
+            RPI_LOG(ERROR, "LensRemapper::remap(): failed to lock the frame!");
+            return outputs;
+        }
+
+        for (std::size_t vi = 0; vi < m_Views.size(); ++vi)
+        {
+            std::shared_ptr<MemoryPixelSampleBuffer> output = arena ?
+                std::make_shared<MemoryPixelSampleBuffer>(m_Format, m_Views[vi].view.size, arena) :
+                std::make_shared<MemoryPixelSampleBuffer>(m_Format, m_Views[vi].view.size);
+            output->time = frame.time;
+            output->sequence = frame.sequence;
+
+            if (remap(frame, *output, vi))
+            {
+                outputs.clear();
+                break;
+            }
+            outputs.push_back(output);
+        }
+
+        frame.unlock();
+        return outputs;
+    }
+
+    bool LensRemapper::checkBuffers(PixelBuffer &src, PixelBuffer &dst, std::size_t vi) const
+    {
+        if (vi >= m_Views.size())
+        {
+            RPI_LOG(ERROR, "LensRemapper::remap(): no such view!");
+            return false;
+        }
+
+        if (src.format() != m_Format || dst.format() != m_Format)
+        {
+            RPI_LOG(ERROR, "LensRemapper::remap(): buffers not of the configured format!");
+            return false;
+        }
+
+        if (src.planeSize(0) != m_SourceSize || dst.planeSize(0) != m_Views[vi].view.size)
+        {
+            RPI_LOG(ERROR, "LensRemapper::remap(): buffer sizes differ from the configuration!");
+            return false;
+        }
+
+        for (std::size_t pi = 0; pi < src.planeCount(); ++pi)
+        {
+            if (!src.planeData(pi) || !dst.planeData(pi))
+            {
+                RPI_LOG(ERROR, "LensRemapper::remap(): buffers not locked!");
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void LensRemapper::remapBands(PixelBuffer &src, PixelBuffer &dst, std::size_t vi, std::size_t begin, std::size_t end)
+    {
+        PixelFormatDescriptor const descriptor = pixelFormatDescriptor(m_Format);
+        View const &view = m_Views[vi];
+        bool const bSimd = m_bSimdEnabled;
+
+        for (std::size_t pi = 0; pi < descriptor.planeCount; ++pi)
+        {
+            Map const &map = view.maps[descriptor.widthShift[pi] || descriptor.heightShift[pi] ? 1 : 0];
+            std::uint8_t const *srcData = static_cast<std::uint8_t const*>(src.planeData(pi));
+            std::uint8_t *dstData = static_cast<std::uint8_t*>(dst.planeData(pi));
+            std::size_t const srcRowBytes = src.planeRowBytes(pi), dstRowBytes = dst.planeRowBytes(pi);
+            std::size_t const channels = descriptor.bytesPerPixel[pi];
+
+            // black is zero in the first plane and 128 in the chroma planes
+            std::uint8_t const fill = pi ? 128 : 0;
+
+            std::size_t const bands = (map.size(1) + kTileHeight - 1) / kTileHeight;
+            for (std::size_t band = begin; band < std::min(end, bands); ++band)
+            {
+                std::uint32_t const y0 = std::uint32_t(band) * kTileHeight;
+                std::uint32_t const bandHeight = std::min(std::uint32_t(kTileHeight), map.size(1) - y0);
+                for (std::uint32_t x0 = 0; x0 < map.size(0); x0 += kTileWidth)
+                {
+                    std::uint32_t const tileWidth = std::min(std::uint32_t(kTileWidth), map.size(0) - x0);
+                    std::uint32_t const *tile = map.entries.data() + std::size_t(y0) * map.size(0) + std::size_t(x0) * bandHeight;
+                    for (std::uint32_t r = 0; r < bandHeight; ++r)
+                    {
+                        remapRow(tile + r * tileWidth, tileWidth, srcData, srcRowBytes, channels, fill,
+                            dstData + (y0 + r) * dstRowBytes + x0 * channels, bSimd);
+                    }
+                }
+            }
+        }
+    }
+
+    std::size_t LensRemapper::numBands(std::size_t vi) const
+    {
+        return (m_Views[vi].maps[0].size(1) + kTileHeight - 1) / kTileHeight;
+    }
+
+    std::istream& operator>>(std::istream &s, LensModel &v)
+    {
+        std::string sv;
+        s >> sv;
+        if (sv == "BrownConrady")
+            v = LensModel::BrownConrady;
+        else if (sv == "Fisheye")
+            v = LensModel::Fisheye;
+        else
+            throw std::invalid_argument("Invalid value for LensModel: " + sv);
+        return s;
+    }
+
+    std::ostream& operator<<(std::ostream &s, LensModel v)
+    {
+        switch (v)
+        {
+        case LensModel::BrownConrady:   s << "BrownConrady"; break;
+        case LensModel::Fisheye:        s << "Fisheye"; break;
+        }
+        return s;
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "Config.hpp"
+#include "PixelBuffer.hpp"
+#include "MemoryPixelSampleBuffer.hpp"
+#include "ThreadPool.hpp"
+#include <vector>
+#include <system_error>
+
+namespace rpiCam
+{
+    // pinhole projection of the physical camera at the resolution it was calibrated at
+    class CameraIntrinsics
+    {
+    public:
+        CameraIntrinsics();
+
+        Vec2ui imageSize;
+        Vec2f focalLength;      // in pixels
+        Vec2f principalPoint;   // in pixels, the top left pixel's center is (0, 0)
+    };
+
+    enum class LensModel : int
+    {
+        BrownConrady,   // radial k1 k2 k3 and tangential p1 p2 on the normalized image plane
+        Fisheye         // equidistant, theta * (1 + k1 theta^2 + k2 theta^4 + k3 theta^6 + k4 theta^8)
+    };
+
+    class LensDistortion
+    {
+    public:
+        LensDistortion();
+
+        LensModel model;
+        float k1;
+        float k2;
+        float k3;
+        float k4;       // fisheye only
+        float p1;       // Brown-Conrady only
+        float p2;
+    };
+
+    // An undistorted pinhole camera looking from the same center as the
+    // physical one, rotation takes its rays into the physical camera's
+    // frame (x right, y down, z forward).
+    class RemapView
+    {
+    public:
+        RemapView();
+
+        // the physical camera's own view without the distortion
+        static RemapView undistorted(CameraIntrinsics const &intrinsics);
+
+        // size pixels covering horizontalFov radians across, turned by yaw
+        // to the right, then pitch down, then roll clockwise
+        static RemapView perspective(Vec2ui const &size, float horizontalFov, float yaw = 0.0f, float pitch = 0.0f, float roll = 0.0f);
+
+        Vec2ui size;
+        Vec2f focalLength;
+        Vec2f principalPoint;
+        Eigen::Matrix3f rotation;
+    };
+
+    // Lens undistortion and fisheye dewarping through maps computed once per
+    // configuration. Every output pixel keeps its source position as two Q4
+    // fixed point coordinates packed in 32 bits, in 32x16 tile order so
+    // the map streams and each tile's source footprint stays in cache.
+    // Planes of a different subsampling get maps of their own. Frames are
+    // remapped tile by tile, in parallel when there is a thread pool: the
+    // source taps are gathered a row pair per pixel and blended in vector
+    // registers. Any number of views can be cut out of one source frame.
+    // Source pixels outside the frame come out black.
+    class LensRemapper
+    {
+    public:
+        static constexpr std::uint32_t kTileWidth = 32;
+        static constexpr std::uint32_t kTileHeight = 16;
+        static constexpr std::uint32_t kMaxSourceSize = 4095;
+
+        LensRemapper(std::shared_ptr<ThreadPool> pool = nullptr);
+        ~LensRemapper();
+
+        inline bool isSimdEnabled() const { return m_bSimdEnabled; }
+        inline void setSimdEnabled(bool bEnabled) { m_bSimdEnabled = bEnabled; }
+
+        // Computes the maps of every view for frames of format and
+        // intrinsics.imageSize. Packed 4:2:2 formats are not supported.
+        std::error_code configure(ePixelFormat format, CameraIntrinsics const &intrinsics, LensDistortion const &distortion,
+            std::vector<RemapView> const &views);
+
+        inline std::size_t numViews() const { return m_Views.size(); }
+        inline RemapView const& view(std::size_t vi) const { return m_Views[vi].view; }
+
+        // view vi of src into dst, both locked, of the configured format and
+        // src of the configured size, dst of the view's
+        std::error_code remap(PixelBuffer &src, PixelBuffer &dst, std::size_t vi);
+
+        // every view of frame into new buffers, one per view, empty on failure
+        std::vector<std::shared_ptr<MemoryPixelSampleBuffer>> remap(PixelSampleBuffer &frame,
+            std::shared_ptr<BufferArena> const &arena = BufferArena::shared());
+
+    private:
+        struct Map
+        {
+            Vec2ui size;
+            std::vector<std::uint32_t> entries;
+        };
+
+        struct View
+        {
+            RemapView view;
+            Map maps[2];        // full resolution planes, then subsampled ones
+        };
+
+        bool checkBuffers(PixelBuffer &src, PixelBuffer &dst, std::size_t vi) const;
+        void remapBands(PixelBuffer &src, PixelBuffer &dst, std::size_t vi, std::size_t begin, std::size_t end);
+        std::size_t numBands(std::size_t vi) const;
+
+    private:
+        std::shared_ptr<ThreadPool> m_Pool;
+        bool m_bSimdEnabled;
+        ePixelFormat m_Format;
+        Vec2ui m_SourceSize;
+        std::vector<View> m_Views;
+    };
+
+    extern std::istream& operator>>(std::istream &s, LensModel &v);
+    extern std::ostream& operator<<(std::ostream &s, LensModel v);
+}
@@ -0,0 +1,150 @@
+#include "MemoryPixelSampleBuffer.hpp"
+
+namespace rpiCam
+{
+    MemoryPixelSampleBuffer::MemoryPixelSampleBuffer(ePixelFormat format, Vec2ui const &size)
+        : PixelSampleBuffer()
+        , m_Format(format)
+        , m_Size(size)
+        , m_PaddedSize(
+            (size(0) + kPixelBufferWidthAlignment - 1) & ~(kPixelBufferWidthAlignment - 1),
+            (size(1) + kPixelBufferHeightAlignment - 1) & ~(kPixelBufferHeightAlignment - 1)
+        )
+        , m_Memory()
+        , m_Block()
+        , m_Data(nullptr)
+        , m_DataSize(0)
+        , m_PlaneCount(0)
+    {
+        allocate(nullptr);
+    }
+
+    MemoryPixelSampleBuffer::MemoryPixelSampleBuffer(ePixelFormat format, Vec2ui const &size, std::shared_ptr<BufferArena> const &arena)
+        : PixelSampleBuffer()
+        , m_Format(format)
+        , m_Size(size)
+        , m_PaddedSize(
+            (size(0) + kPixelBufferWidthAlignment - 1) & ~(kPixelBufferWidthAlignment - 1),
+            (size(1) + kPixelBufferHeightAlignment - 1) & ~(kPixelBufferHeightAlignment - 1)
+        )
+        , m_Memory()
+        , m_Block()
+        , m_Data(nullptr)
+        , m_DataSize(0)
+        , m_PlaneCount(0)
+    {
+        allocate(arena.get());
+    }
+
+    MemoryPixelSampleBuffer::~MemoryPixelSampleBuffer()
+    {
+    }
+
+    void MemoryPixelSampleBuffer::allocate(BufferArena *arena)
+    {
+        time = TimeClock::now();
+
+        PixelFormatDescriptor const descriptor = pixelFormatDescriptor(m_Format);
+
+        m_PlaneCount = descriptor.planeCount;
+        for (std::size_t pi = 0; pi < m_PlaneCount; ++pi)
+        {
+            m_PlaneSize[pi] = Vec2ui(
+                m_Size(0) >> descriptor.widthShift[pi],
+                m_Size(1) >> descriptor.heightShift[pi]
+            );
+            m_PlaneDataOffset[pi] = m_DataSize;
+            m_PlaneRowBytes[pi] = (m_PaddedSize(0) >> descriptor.widthShift[pi]) * descriptor.bytesPerPixel[pi];
+            m_DataSize += m_PlaneRowBytes[pi] * (m_PaddedSize(1) >> descriptor.heightShift[pi]);
+        }
+
+        if (!m_DataSize)
+            return;
+
+        static_assert(BufferArena::kAlignment % kDataAlignment == 0, "arena blocks must satisfy kDataAlignment");
+        if (arena)
+        {
+            m_Block = arena->allocate(m_DataSize);
+            m_Data = m_Block.get();
+            return;
+        }
+
+        m_Memory.resize(m_DataSize + kDataAlignment - 1);
+        m_Data = reinterpret_cast<std::uint8_t*>(
+            (reinterpret_cast<std::uintptr_t>(m_Memory.data()) + kDataAlignment - 1) & ~std::uintptr_t(kDataAlignment - 1)
+        );
+    }
+
+    bool MemoryPixelSampleBuffer::isValid() const
+    {
+        return m_Data;
+    }
+
+    void* MemoryPixelSampleBuffer::data()
+    {
+        return m_Data;
+    }
+
+    std::size_t MemoryPixelSampleBuffer::size() const
+    {
+        return m_DataSize;
+    }
+
+    ePixelFormat MemoryPixelSampleBuffer::format() const
+    {
+        return isValid() ? m_Format : kPixelFormatInvalid;
+    }
+
+    std::size_t MemoryPixelSampleBuffer::planeCount() const
+    {
+        return m_PlaneCount;
+    }
+
+    Vec2ui MemoryPixelSampleBuffer::planeSize(std::size_t pi) const
+    {
+        if (!isValid() || pi >= m_PlaneCount)
+            return Vec2ui(0,0);
+
+        return m_PlaneSize[pi];
+    }
+
+    void* MemoryPixelSampleBuffer::planeData(std::size_t pi)
+    {
+        if (!isValid() || pi >= m_PlaneCount)
+            return nullptr;
+
+        return m_Data + m_PlaneDataOffset[pi];
+    }
+
+    std::size_t MemoryPixelSampleBuffer::planeRowBytes(std::size_t pi) const
+    {
+        if (!isValid() || pi >= m_PlaneCount)
+            return 0;
+
+        return m_PlaneRowBytes[pi];
+    }
+
+    Vec2ui MemoryPixelSampleBuffer::paddedSize() const
+    {
+        if (!isValid())
+            return Vec2ui(0,0);
+
+        return m_PaddedSize;
+    }
+
+    std::error_code MemoryPixelSampleBuffer::lock()
+    {
+        if (!isValid())
+            return std::make_error_code(std::errc::no_lock_available);
+
+        return std::error_code();
+    }
+
+    std::error_code MemoryPixelSampleBuffer::unlock()
+    {
+        if (!isValid())
+            return std::make_error_code(std::errc::no_lock_available);
+
+        return std::error_code();
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Config.hpp"
+#include "PixelSampleBuffer.hpp"
+#include "BufferArena.hpp"
+#include <vector>
+
+namespace rpiCam
+{
+    // Heap backed PixelSampleBuffer with the same plane layout and 32x16
+    // padding as the camera buffers, used as destination of conversions.
+    class MemoryPixelSampleBuffer
+        : public PixelSampleBuffer
+    {
+    public:
+        static constexpr std::size_t kDataAlignment = 32;
+
+        MemoryPixelSampleBuffer(ePixelFormat format, Vec2ui const &size);
+
+        // takes the memory from arena and returns it there on destruction
+        MemoryPixelSampleBuffer(ePixelFormat format, Vec2ui const &size, std::shared_ptr<BufferArena> const &arena);
+        ~MemoryPixelSampleBuffer();
+
+        // Buffer overrides
+        bool isValid() const override;
+        void* data() override;
+        std::size_t size() const override;
+
+        // PixelBuffer overrides
+        ePixelFormat format() const override;
+        std::size_t planeCount() const override;
+        Vec2ui planeSize(std::size_t pi = 0) const override;
+        void* planeData(std::size_t pi = 0) override;
+        std::size_t planeRowBytes(std::size_t pi = 0) const override;
+        Vec2ui paddedSize() const override;
+
+        // SampleBuffer overrides
+        std::error_code lock() override;
+        std::error_code unlock() override;
+
+    private:
+        void allocate(BufferArena *arena);
+
+    private:
+        ePixelFormat m_Format;
+        Vec2ui m_Size;
+        Vec2ui m_PaddedSize;
+        std::vector<std::uint8_t> m_Memory;
+        std::shared_ptr<std::uint8_t> m_Block;
+        std::uint8_t *m_Data;
+        std::size_t m_DataSize;
+        std::size_t m_PlaneCount;
+        Vec2ui m_PlaneSize[PixelFormatDescriptor::kMaxPlanes];
+        std::size_t m_PlaneDataOffset[PixelFormatDescriptor::kMaxPlanes];
+        std::size_t m_PlaneRowBytes[PixelFormatDescriptor::kMaxPlanes];
+    };
+}
@@ -0,0 +1,411 @@
+#include "MotionDetector.hpp"
+#include "Simd.hpp"
+#include "ImagePyramid.hpp"
+#include "Logging.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace rpiCam
+{
+    namespace
+    {
+        // Sum of |cur - ref| over count bytes, moving ref towards cur by
+        // (cur - ref) / 2^shift rounded to nearest, or replacing it when shift is 0.
+        inline std::uint32_t sadAndUpdate(std::uint8_t const *cur, std::uint8_t *ref, std::uint32_t count, std::uint32_t shift, bool bSimd)
+        {
+            std::uint32_t sad = 0;
+            std::uint32_t i = 0;
+            std::int32_t const round = shift ? 1 << (shift - 1) : 0;
+#if defined(RPI_CAM_SIMD_NEON)
+            if (bSimd)
+            {
+                uint32x4_t acc = vdupq_n_u32(0);
+                int16x8_t const negShift = vdupq_n_s16(-std::int16_t(shift));
+                for (; i + 16 <= count; i += 16)
+                {
+                    uint8x16_t const c = vld1q_u8(cur + i);
+                    uint8x16_t const r = vld1q_u8(ref + i);
+                    acc = vpadalq_u16(acc, vpaddlq_u8(vabdq_u8(c, r)));
+                    if (!shift)
+                    {
+                        vst1q_u8(ref + i, c);
+                        continue;
+                    }
+                    int16x8_t const dLo = vreinterpretq_s16_u16(vsubl_u8(vget_low_u8(c), vget_low_u8(r)));
+                    int16x8_t const dHi = vreinterpretq_s16_u16(vsubl_u8(vget_high_u8(c), vget_high_u8(r)));
+                    int16x8_t const rLo = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(r)));
+                    int16x8_t const rHi = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(r)));
+                    vst1q_u8(ref + i, vcombine_u8(
+                        vqmovun_s16(vaddq_s16(rLo, vrshlq_s16(dLo, negShift))),
+                        vqmovun_s16(vaddq_s16(rHi, vrshlq_s16(dHi, negShift)))));
+                }
+                uint64x2_t const acc64 = vpaddlq_u32(acc);
+                sad = std::uint32_t(vgetq_lane_u64(acc64, 0) + vgetq_lane_u64(acc64, 1));
+            }
+#elif defined(RPI_CAM_SIMD_SSE2)
+            if (bSimd)
+            {
+                __m128i const zero = _mm_setzero_si128();
+                __m128i const roundV = _mm_set1_epi16(std::int16_t(round));
+                __m128i const shiftV = _mm_cvtsi32_si128(int(shift));
+                __m128i acc = _mm_setzero_si128();
+                for (; i + 16 <= count; i += 16)
+                {
+                    __m128i const c = _mm_loadu_si128(reinterpret_cast<__m128i const*>(cur + i));
+                    __m128i const r = _mm_loadu_si128(reinterpret_cast<__m128i*>(ref + i));
+                    acc = _mm_add_epi64(acc, _mm_sad_epu8(c, r));
+                    if (!shift)
+                    {
+                        _mm_storeu_si128(reinterpret_cast<__m128i*>(ref + i), c);
+                        continue;
+                    }
+                    __m128i const rLo = _mm_unpacklo_epi8(r, zero);
+                    __m128i const rHi = _mm_unpackhi_epi8(r, zero);
+                    __m128i const dLo = _mm_sra_epi16(_mm_add_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(c, zero), rLo), roundV), shiftV);
+                    __m128i const dHi = _mm_sra_epi16(_mm_add_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(c, zero), rHi), roundV), shiftV);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(ref + i),
+                        _mm_packus_epi16(_mm_add_epi16(rLo, dLo), _mm_add_epi16(rHi, dHi)));
+                }
+                sad = std::uint32_t(_mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(acc, acc)));
+            }
+#endif
+            for (; i < count; ++i)
+            {
+                std::int32_t const d = std::int32_t(cur[i]) - std::int32_t(ref[i]);
+                sad += std::uint32_t(d < 0 ? -d : d);
+                ref[i] = std::uint8_t(std::int32_t(ref[i]) + ((d + round) >> shift));
+            }
+            return sad;
+        }
+
+        inline Rect scaleRect(Rect const &rect, Vec2ui const &from, Vec2ui const &to)
+        {
+            std::uint32_t const x0 = std::uint32_t(std::uint64_t(rect.origin(0)) * to(0) / from(0));
+            std::uint32_t const y0 = std::uint32_t(std::uint64_t(rect.origin(1)) * to(1) / from(1));
+            std::uint32_t const x1 = std::min<std::uint32_t>(to(0), std::uint32_t((std::uint64_t(rect.end()(0)) * to(0) + from(0) - 1) / from(0)));
+            std::uint32_t const y1 = std::min<std::uint32_t>(to(1), std::uint32_t((std::uint64_t(rect.end()(1)) * to(1) + from(1) - 1) / from(1)));
+            return Rect(x0, y0, x1 - x0, y1 - y0);
+        }
+    }
+
+    MotionDetectorOptions::MotionDetectorOptions()
+        : level(1)
+        , tileSize(16, 16)
+        , referenceShift(3)
+        , noiseAdaptation(0.05f)
+        , noiseFactor(3.0f)
+        , minThreshold(4.0f)
+        , triggerScore(0.01f)
+        , triggerFrames(3)
+        , releaseScore(0.005f)
+        , releaseFrames(15)
+        , masks()
+    {
+    }
+
+    MotionResult::MotionResult()
+        : time()
+        , sequence(0)
+        , score(0.0f)
+        , boundingBox()
+        , bMotion(false)
+        , noise(0.0f)
+        , tileGrid(0, 0)
+        , tiles()
+    {
+    }
+
+    MotionDetector::MotionDetector(MotionDetectorOptions const &options)
+        : Camera::Events()
+        , m_Mutex()
+        , m_Options(isValid(options) ? options : MotionDetectorOptions())
+        , m_bSimd(true)
+        , m_bReset(true)
+        , m_FrameSize(0, 0)
+        , m_Size(0, 0)
+        , m_TileGrid(0, 0)
+        , m_Reference()
+        , m_TileSums()
+        , m_TileMasked()
+        , m_TileMeans()
+        , m_NumUnmasked(0)
+        , m_Noise(0.0f)
+        , m_bMotion(false)
+        , m_NumTransitionFrames(0)
+        , m_Result()
+        , m_MotionDetectorEvents()
+    {
+        if (!isValid(options))
+            RPI_LOG(WARNING, "MotionDetector::MotionDetector(): invalid options, using defaults!");
+    }
+
+    MotionDetector::~MotionDetector()
+    {
+    }
+
+    MotionDetectorOptions MotionDetector::options() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_Options;
+    }
+
+    std::error_code MotionDetector::setOptions(MotionDetectorOptions const &options)
+    {
+        if (!isValid(options))
+        {
+            RPI_LOG(ERROR, "MotionDetector::setOptions(): invalid options!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Options = options;
+        m_bReset = true;
+        return std::error_code();
+    }
+
+    void MotionDetector::reset()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bReset = true;
+    }
+
+    bool MotionDetector::isSimdEnabled() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_bSimd;
+    }
+
+    void MotionDetector::setSimdEnabled(bool bEnabled)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bSimd = bEnabled;
+    }
+
+    std::error_code MotionDetector::process(PixelSampleBuffer &frame, MotionResult &result)
+    {
+        bool bStarted = false, bStopped = false;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+
+            std::size_t const li = m_Options.level;
+            PixelBuffer *luma = nullptr;
+            if (li > 0)
+            {
+                luma = frame.pyramid().level(li);
+                if (!luma)
+                {
+                    RPI_LOG(ERROR, "MotionDetector::process(): no luma level %d for this frame!", int(li));
+                    return std::make_error_code(std::errc::invalid_argument);
+                }
+            }
+            else if (pixelFormatDescriptor(frame.format()).bytesPerPixel[0] != 1)
+            {
+                RPI_LOG(ERROR, "MotionDetector::process(): no separate luma plane in this format!");
+                return std::make_error_code(std::errc::invalid_argument);
+            }
+            else if (frame.lock())
+            {
+                RPI_LOG(ERROR, "MotionDetector::process(): failed to lock the frame!");
+                return std::make_error_code(std::errc::io_error);
+            }
+            else
+                luma = &frame;
+
+            Vec2ui const frameSize = frame.planeSize(0);
+            Vec2ui const size = luma->planeSize(0);
+            std::uint8_t const *data = static_cast<std::uint8_t const*>(luma->planeData(0));
+            std::size_t const rowBytes = luma->planeRowBytes(0);
+
+            bool const bRestart = m_bReset || frameSize != m_FrameSize || size != m_Size;
+            if (bRestart)
+                restart(frameSize, size);
+
+            if (bRestart || !data)
+            {
+                // the first frame only becomes the reference
+                for (std::uint32_t y = 0; data && y < size(1); ++y)
+                    std::memcpy(m_Reference.data() + y * size(0), data + y * rowBytes, size(0));
+                std::fill(m_Result.tiles.begin(), m_Result.tiles.end(), 0);
+                m_Result.score = 0.0f;
+                m_Result.boundingBox = Rect();
+            }
+            else
+                compare(data, rowBytes);
+
+            if (!li)
+                frame.unlock();
+
+            if (!data)
+            {
+                RPI_LOG(ERROR, "MotionDetector::process(): frame has no luma data!");
+                m_bReset = true;
+                return std::make_error_code(std::errc::invalid_argument);
+            }
+
+            // hysteresis, the state flips after enough consecutive frames on the other side
+            bool const bOtherSide = m_bMotion ?
+                m_Result.score < m_Options.releaseScore :
+                m_Result.score >= m_Options.triggerScore;
+
+            m_NumTransitionFrames = bOtherSide ? m_NumTransitionFrames + 1 : 0;
+            if (m_NumTransitionFrames >= (m_bMotion ? m_Options.releaseFrames : m_Options.triggerFrames))
+            {
+                m_bMotion = !m_bMotion;
+                m_NumTransitionFrames = 0;
+                bStarted = m_bMotion;
+                bStopped = !m_bMotion;
+            }
+
+            m_Result.time = frame.time;
+            m_Result.sequence = frame.sequence;
+            m_Result.bMotion = m_bMotion;
+            m_Result.noise = m_Noise;
+            result = m_Result;
+        }
+
+        m_MotionDetectorEvents.dispatch(&Events::onMotionDetectorFrame, result);
+        if (bStarted)
+            m_MotionDetectorEvents.dispatch(&Events::onMotionStarted, result);
+        if (bStopped)
+            m_MotionDetectorEvents.dispatch(&Events::onMotionStopped, result);
+        return std::error_code();
+    }
+
+    void MotionDetector::onCameraVideoFrame(std::shared_ptr<PixelSampleBuffer> const &buffer)
+    {
+        MotionResult result;
+        process(*buffer, result);
+    }
+
+    void MotionDetector::onCameraVideoStopped()
+    {
+        reset();
+    }
+
+    bool MotionDetector::isValid(MotionDetectorOptions const &options)
+    {
+        return options.level <= ImagePyramid::kNumLevels &&
+            options.tileSize(0) > 0 && options.tileSize(1) > 0 &&
+            options.referenceShift < 8 &&
+            options.noiseAdaptation >= 0.0f && options.noiseAdaptation <= 1.0f &&
+            options.noiseFactor >= 0.0f &&
+            options.minThreshold >= 0.0f &&
+            options.triggerFrames > 0 && options.releaseFrames > 0;
+    }
+
+    void MotionDetector::restart(Vec2ui const &frameSize, Vec2ui const &size)
+    {
+        m_bReset = false;
+        m_FrameSize = frameSize;
+        m_Size = size;
+        m_TileGrid = Vec2ui(
+            (size(0) + m_Options.tileSize(0) - 1) / m_Options.tileSize(0),
+            (size(1) + m_Options.tileSize(1) - 1) / m_Options.tileSize(1)
+        );
+
+        std::size_t const numTiles = m_TileGrid.prod();
+        m_Reference.assign(size.prod(), 0);
+        m_TileSums.assign(numTiles, 0);
+        m_TileMeans.reserve(numTiles);
+
+        // a tile is masked when masks cover at least half of it
+        m_TileMasked.assign(numTiles, 0);
+        m_NumUnmasked = numTiles;
+        for (std::uint32_t ty = 0; ty < m_TileGrid(1); ++ty)
+        {
+            for (std::uint32_t tx = 0; tx < m_TileGrid(0); ++tx)
+            {
+                Rect const tile = Rect(
+                    Vec2ui(tx * m_Options.tileSize(0), ty * m_Options.tileSize(1)),
+                    m_Options.tileSize
+                ).intersected(Rect(Vec2ui(0, 0), size));
+
+                std::uint64_t covered = 0;
+                for (auto const &mask : m_Options.masks)
+                {
+                    Rect const area = scaleRect(mask, frameSize, size).intersected(tile);
+                    covered += std::uint64_t(area.size(0)) * area.size(1);
+                }
+
+                if (2 * covered >= std::uint64_t(tile.size(0)) * tile.size(1))
+                {
+                    m_TileMasked[ty * m_TileGrid(0) + tx] = 1;
+                    m_NumUnmasked--;
+                }
+            }
+        }
+
+        m_Noise = 0.0f;
+        m_bMotion = false;
+        m_NumTransitionFrames = 0;
+        m_Result.tileGrid = m_TileGrid;
+        m_Result.tiles.assign(numTiles, 0);
+    }
+
+    void MotionDetector::compare(std::uint8_t const *data, std::size_t rowBytes)
+    {
+        std::uint32_t const tileWidth = m_Options.tileSize(0);
+        std::uint32_t const tileHeight = m_Options.tileSize(1);
+        std::uint32_t const width = m_Size(0);
+        std::uint32_t const height = m_Size(1);
+
+        // row by row through all tiles of a tile row, both images are read once in order
+        std::fill(m_TileSums.begin(), m_TileSums.end(), 0);
+        for (std::uint32_t y = 0; y < height; ++y)
+        {
+            std::uint8_t const *cur = data + y * rowBytes;
+            std::uint8_t *ref = m_Reference.data() + y * width;
+            std::uint32_t *sums = m_TileSums.data() + (y / tileHeight) * m_TileGrid(0);
+            for (std::uint32_t tx = 0, x = 0; tx < m_TileGrid(0); ++tx, x += tileWidth)
+                sums[tx] += sadAndUpdate(cur + x, ref + x, std::min(tileWidth, width - x), m_Options.referenceShift, m_bSimd);
+        }
+
+        // the median tile follows the noise as long as less than half of the frame moves
+        m_TileMeans.clear();
+        for (std::uint32_t ty = 0; ty < m_TileGrid(1); ++ty)
+        {
+            std::uint32_t const th = std::min(tileHeight, height - ty * tileHeight);
+            for (std::uint32_t tx = 0; tx < m_TileGrid(0); ++tx)
+            {
+                std::size_t const it = ty * m_TileGrid(0) + tx;
+                if (m_TileMasked[it])
+                    continue;
+                std::uint32_t const tw = std::min(tileWidth, width - tx * tileWidth);
+                m_TileMeans.push_back(float(m_TileSums[it]) / float(tw * th));
+            }
+        }
+
+        if (!m_TileMeans.empty())
+        {
+            auto itMedian = m_TileMeans.begin() + m_TileMeans.size() / 2;
+            std::nth_element(m_TileMeans.begin(), itMedian, m_TileMeans.end());
+            m_Noise += m_Options.noiseAdaptation * (*itMedian - m_Noise);
+        }
+
+        float const threshold = std::max(m_Options.minThreshold, m_Noise * m_Options.noiseFactor);
+        std::uint32_t x0 = width, y0 = height, x1 = 0, y1 = 0;
+        std::size_t numMoving = 0;
+        for (std::uint32_t ty = 0; ty < m_TileGrid(1); ++ty)
+        {
+            std::uint32_t const th = std::min(tileHeight, height - ty * tileHeight);
+            for (std::uint32_t tx = 0; tx < m_TileGrid(0); ++tx)
+            {
+                std::size_t const it = ty * m_TileGrid(0) + tx;
+                std::uint32_t const tw = std::min(tileWidth, width - tx * tileWidth);
+                bool const bMoving = !m_TileMasked[it] && float(m_TileSums[it]) > threshold * float(tw * th);
+                m_Result.tiles[it] = bMoving ? 1 : 0;
+                if (!bMoving)
+                    continue;
+
+                numMoving++;
+                x0 = std::min(x0, tx * tileWidth);
+                y0 = std::min(y0, ty * tileHeight);
+                x1 = std::max(x1, tx * tileWidth + tw);
+                y1 = std::max(y1, ty * tileHeight + th);
+            }
+        }
+
+        m_Result.score = m_NumUnmasked ? float(numMoving) / float(m_NumUnmasked) : 0.0f;
+        m_Result.boundingBox = numMoving ? scaleRect(Rect(x0, y0, x1 - x0, y1 - y0), m_Size, m_FrameSize) : Rect();
+    }
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "Config.hpp"
+#include "Camera.hpp"
+#include "Rect.hpp"
+#include <vector>
+
+namespace rpiCam
+{
+    class MotionDetectorOptions
+    {
+    public:
+        MotionDetectorOptions();
+
+        std::uint32_t level;            // pyramid level of the working image, 0 is the full Y plane
+        Vec2ui tileSize;                // in pixels of the working image
+        std::uint32_t referenceShift;   // the reference moves 1/2^shift of the way to every frame, 0 replaces it
+        float noiseAdaptation;          // weight of one frame in the noise estimate
+        float noiseFactor;              // a tile moves when its mean difference exceeds noise * noiseFactor
+        float minThreshold;             // and minThreshold, both in grey levels per pixel
+        float triggerScore;             // motion starts after triggerFrames frames scoring >= triggerScore
+        std::uint32_t triggerFrames;
+        float releaseScore;             // and stops after releaseFrames frames scoring < releaseScore
+        std::uint32_t releaseFrames;
+        std::vector<Rect> masks;        // ignored regions in frame pixels
+    };
+
+    class MotionResult
+    {
+    public:
+        MotionResult();
+
+        TimePoint time;
+        std::uint64_t sequence;
+        float score;                        // fraction of the unmasked tiles that moved
+        Rect boundingBox;                   // of the moving tiles in frame pixels, empty when none moved
+        bool bMotion;                       // hysteresis state after this frame
+        float noise;                        // current noise estimate in grey levels per pixel
+        Vec2ui tileGrid;                    // tiles across and down
+        std::vector<std::uint8_t> tiles;    // 1 for every moving tile, row major
+    };
+
+    // Compares the Y plane of every frame, or a level of its pyramid, against
+    // a slowly updated reference in tiles. The sum of absolute differences of
+    // a tile and the reference update are done in the same vectorized pass.
+    // Subscribe it to Camera::cameraEvents() or feed frames to process().
+    class MotionDetector
+        : public Camera::Events
+    {
+    public:
+        class Events
+        {
+        public:
+            virtual void onMotionDetectorFrame(MotionResult const &result) {}
+            virtual void onMotionStarted(MotionResult const &result) {}
+            virtual void onMotionStopped(MotionResult const &result) {}
+        };
+
+        using MotionDetectorEvents = EventsDispatcher<Events>;
+
+        MotionDetector(MotionDetectorOptions const &options = MotionDetectorOptions());
+        ~MotionDetector();
+
+        inline MotionDetectorEvents const& motionDetectorEvents() const { return m_MotionDetectorEvents; }
+
+        MotionDetectorOptions options() const;
+        std::error_code setOptions(MotionDetectorOptions const &options);
+
+        // drops the reference, the next frame starts a new one
+        void reset();
+
+        bool isSimdEnabled() const;
+        void setSimdEnabled(bool bEnabled);
+
+        // Compares frame against the reference, fills result and dispatches
+        // onMotionDetectorFrame, plus onMotionStarted or onMotionStopped when
+        // the hysteresis state changes. The frame needs a separate Y plane.
+        std::error_code process(PixelSampleBuffer &frame, MotionResult &result);
+
+        // Camera::Events overrides
+        void onCameraVideoFrame(std::shared_ptr<PixelSampleBuffer> const &buffer) override;
+        void onCameraVideoStopped() override;
+
+    private:
+        static bool isValid(MotionDetectorOptions const &options);
+
+        void restart(Vec2ui const &frameSize, Vec2ui const &size);
+        void compare(std::uint8_t const *data, std::size_t rowBytes);
+
+    private:
+        mutable std::mutex m_Mutex;
+        MotionDetectorOptions m_Options;
+        bool m_bSimd;
+        bool m_bReset;
+        Vec2ui m_FrameSize;
+        Vec2ui m_Size;
+        Vec2ui m_TileGrid;
+        std::vector<std::uint8_t> m_Reference;
+        std::vector<std::uint32_t> m_TileSums;
+        std::vector<std::uint8_t> m_TileMasked;
+        std::vector<float> m_TileMeans;
+        std::size_t m_NumUnmasked;
+        float m_Noise;
+        bool m_bMotion;
+        std::uint32_t m_NumTransitionFrames;
+        MotionResult m_Result;
+        MotionDetectorEvents m_MotionDetectorEvents;
+    };
+}
@@ -0,0 +1,195 @@
+#include "MotionEstimation.hpp"
+#include "Logging.hpp"
+#include <cmath>
+#include <random>
+
+namespace rpiCam
+{
+    namespace
+    {
+        // scale * R(angle) is [a -b; b a]
+        struct Model
+        {
+            float a;
+            float b;
+            Vec2f t;
+
+            inline Vec2f apply(Vec2f const &p) const
+            {
+                return Vec2f(a * p(0) - b * p(1), b * p(0) + a * p(1)) + t;
+            }
+        };
+
+        bool modelFromPairs(Vec2f const &p0, Vec2f const &p1, Vec2f const &q0, Vec2f const &q1, Model &model)
+        {
+            Vec2f const d = p1 - p0, e = q1 - q0;
+            float const n = d.squaredNorm();
+
+            // points this close give no usable angle or scale
+            if (n < 1.0f)
+                return false;
+
+            model.a = (e(0) * d(0) + e(1) * d(1)) / n;
+            model.b = (e(1) * d(0) - e(0) * d(1)) / n;
+            model.t = q0 - Vec2f(model.a * p0(0) - model.b * p0(1), model.b * p0(0) + model.a * p0(1));
+            return true;
+        }
+
+        std::size_t countInliers(std::vector<Vec2f> const &from, std::vector<Vec2f> const &to, Model const &model,
+            float threshold2, std::vector<std::uint8_t> &inliers)
+        {
+            std::size_t count = 0;
+            for (std::size_t i = 0; i < from.size(); ++i)
+            {
+                inliers[i] = (model.apply(from[i]) - to[i]).squaredNorm() <= threshold2;
+                count += inliers[i];
+            }
+            return count;
+        }
+
+        // normal equations of the pairs with inliers set, unknowns a, b, tx and ty
+        bool fitModel(std::vector<Vec2f> const &from, std::vector<Vec2f> const &to, std::vector<std::uint8_t> const &inliers, Model &model)
+        {
+            Eigen::Matrix4d normal = Eigen::Matrix4d::Zero();
+            Eigen::Vector4d rhs = Eigen::Vector4d::Zero();
+            for (std::size_t i = 0; i < from.size(); ++i)
+            {
+                if (!inliers[i])
+                    continue;
+
+                double const x = from[i](0), y = from[i](1);
+                Eigen::Vector4d const rx(x, -y, 1.0, 0.0), ry(y, x, 0.0, 1.0);
+                normal.noalias() += rx * rx.transpose() + ry * ry.transpose();
+                rhs.noalias() += rx * double(to[i](0)) + ry * double(to[i](1));
+            }
+
+            Eigen::LDLT<Eigen::Matrix4d> const ldlt(normal);
+            if (ldlt.info() != Eigen::Success || !ldlt.isPositive())
+                return false;
+
+            Eigen::Vector4d const solution = ldlt.solve(rhs);
+            if (!solution.allFinite())
+                return false;
+
+            model.a = float(solution(0));
+            model.b = float(solution(1));
+            model.t = Vec2f(float(solution(2)), float(solution(3)));
+            return true;
+        }
+    }
+
+    SimilarityTransform::SimilarityTransform()
+        : translation(0.0f, 0.0f)
+        , angle(0.0f)
+        , scale(1.0f)
+    {
+    }
+
+    bool SimilarityTransform::operator==(SimilarityTransform const &rhs) const
+    {
+        return translation == rhs.translation &&
+            angle == rhs.angle &&
+            scale == rhs.scale;
+    }
+
+    Vec2f SimilarityTransform::apply(Vec2f const &p) const
+    {
+        float const c = scale * std::cos(angle), s = scale * std::sin(angle);
+        return Vec2f(c * p(0) - s * p(1), s * p(0) + c * p(1)) + translation;
+    }
+
+    SimilarityTransform SimilarityTransform::inverse() const
+    {
+        SimilarityTransform inverse;
+        inverse.angle = -angle;
+        inverse.scale = 1.0f / scale;
+        inverse.translation = -inverse.apply(translation);
+        return inverse;
+    }
+
+    Eigen::Matrix3f SimilarityTransform::matrix() const
+    {
+        float const c = scale * std::cos(angle), s = scale * std::sin(angle);
+        Eigen::Matrix3f m;
+        m << c, -s, translation(0),
+             s,  c, translation(1),
+             0.0f, 0.0f, 1.0f;
+        return m;
+    }
+
+    MotionEstimationOptions::MotionEstimationOptions()
+        : numIterations(64)
+        , inlierThreshold(1.5f)
+        , minInliers(8)
+    {
+    }
+
+    std::size_t estimateSimilarity(std::vector<Vec2f> const &from, std::vector<Vec2f> const &to,
+        MotionEstimationOptions const &options, SimilarityTransform &motion, std::vector<std::uint8_t> *inliers)
+    {
+        motion = SimilarityTransform();
+
+        std::vector<std::uint8_t> scratch;
+        std::vector<std::uint8_t> &flags = inliers ? *inliers : scratch;
+        flags.assign(from.size(), 0);
+
+        if (from.size() != to.size())
+        {
+            RPI_LOG(ERROR, "estimateSimilarity(): point counts differ!");
+            return 0;
+        }
+
+        std::size_t const numPairs = from.size();
+        if (numPairs < 2 || numPairs < options.minInliers)
+            return 0;
+
+        float const threshold2 = options.inlierThreshold * options.inlierThreshold;
+        std::vector<std::uint8_t> candidate(from.size(), 0);
+        std::mt19937 random(0x52414e53);
+        std::uniform_int_distribution<std::size_t> pick(0, numPairs - 1);
+
+        std::size_t bestCount = 0;
+        Model model;
+        for (std::uint32_t it = 0; it < options.numIterations && bestCount < numPairs; ++it)
+        {
+            std::size_t const i0 = pick(random), i1 = pick(random);
+            if (i0 == i1 || !modelFromPairs(from[i0], from[i1], to[i0], to[i1], model))
+                continue;
+
+            std::size_t const count = countInliers(from, to, model, threshold2, candidate);
+            if (count > bestCount)
+            {
+                bestCount = count;
+                flags.swap(candidate);
+            }
+        }
+
+        if (bestCount < options.minInliers || bestCount < 2)
+        {
+            flags.assign(from.size(), 0);
+            return 0;
+        }
+
+        // refit on the inliers, then once more on the inliers of the refit
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            if (!fitModel(from, to, flags, model))
+            {
+                flags.assign(from.size(), 0);
+                return 0;
+            }
+            bestCount = countInliers(from, to, model, threshold2, flags);
+        }
+
+        if (bestCount < options.minInliers)
+        {
+            flags.assign(from.size(), 0);
+            return 0;
+        }
+
+        motion.translation = model.t;
+        motion.angle = std::atan2(model.b, model.a);
+        motion.scale = std::sqrt(model.a * model.a + model.b * model.b);
+        return bestCount;
+    }
+}
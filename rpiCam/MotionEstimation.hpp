@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Config.hpp"
+#include <vector>
+
+namespace rpiCam
+{
+    // p' = scale * R(angle) * p + translation
+    class SimilarityTransform
+    {
+    public:
+        SimilarityTransform();
+
+        bool operator==(SimilarityTransform const &rhs) const;
+        inline bool operator!=(SimilarityTransform const &rhs) const { return !(*this == rhs); }
+
+        Vec2f apply(Vec2f const &p) const;
+        SimilarityTransform inverse() const;
+
+        // homogeneous form acting on (x, y, 1)
+        Eigen::Matrix3f matrix() const;
+
+        Vec2f translation;
+        float angle;        // radians from +x towards +y
+        float scale;
+    };
+
+    class MotionEstimationOptions
+    {
+    public:
+        MotionEstimationOptions();
+
+        std::uint32_t numIterations;    // RANSAC samples of two point pairs
+        float inlierThreshold;          // largest distance of a pair from the model, in pixels
+        std::uint32_t minInliers;       // fewer inliers leave the estimate at identity
+    };
+
+    // Similarity taking from[i] onto to[i], fitted by RANSAC over two point
+    // samples and refined by linear least squares over the inliers of the
+    // best sample. Samples come from a fixed seed so the same tracks always
+    // give the same estimate. Returns the number of inliers, motion is
+    // identity and the result 0 when there are fewer than
+    // options.minInliers. inliers, when given, gets one flag per pair.
+    std::size_t estimateSimilarity(std::vector<Vec2f> const &from, std::vector<Vec2f> const &to,
+        MotionEstimationOptions const &options, SimilarityTransform &motion, std::vector<std::uint8_t> *inliers = nullptr);
+}
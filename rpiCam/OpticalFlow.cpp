@@ -0,0 +1,557 @@
+#include "OpticalFlow.hpp"
+#include "Simd.hpp"
+#include "Logging.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace rpiCam
+{
+    namespace
+    {
+        // bilinear weights are Q14 and sum to exactly one, sampled pixels are
+        // kept as Q5 like the Scharr gradients, which are 32 times the slope
+        static constexpr std::int32_t kWeightBits = 14;
+        static constexpr std::int32_t kPixelBits = 5;
+        static constexpr std::int32_t kPixelShift = kWeightBits - kPixelBits;
+        static constexpr float kMomentScale = 1.0f / float(1 << 20);
+        static constexpr std::size_t kPointGrain = 16;
+
+        inline std::int32_t descale(std::int32_t v, std::int32_t bits)
+        {
+            return (v + (1 << (bits - 1))) >> bits;
+        }
+
+        inline EdgeDetectorOptions scharrOptions()
+        {
+            EdgeDetectorOptions options;
+            options.gradientOperator = EdgeDetectorOptions::Operator::Scharr;
+            return options;
+        }
+
+        // weights of the top left, top right, bottom left and bottom right pixels
+        inline void bilinearWeights(float fx, float fy, std::int32_t w[4])
+        {
+            float const one = float(1 << kWeightBits);
+            w[0] = std::int32_t(std::lround((1.0f - fx) * (1.0f - fy) * one));
+            w[1] = std::int32_t(std::lround(fx * (1.0f - fy) * one));
+            w[2] = std::int32_t(std::lround((1.0f - fx) * fy * one));
+            w[3] = (1 << kWeightBits) - w[0] - w[1] - w[2];
+        }
+
+        // one row of the template at w from the window's top left pixel: the
+        // pixels as Q5, the gradients, and the sums of their products. The
+        // padding lanes come out zero.
+        void templateRow(std::uint8_t const *src, std::int16_t const *dx, std::int16_t const *dy, std::int32_t width,
+            std::int32_t window, std::int32_t stride, std::int32_t const w[4], bool bSimd,
+            std::int16_t *ival, std::int16_t *ixval, std::int16_t *iyval, std::int64_t &a11, std::int64_t &a12, std::int64_t &a22)
+        {
+            std::int32_t x = 0;
+#if defined(RPI_CAM_SIMD_NEON)
+            if (bSimd)
+            {
+                static int16_t const kLanes[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+                int16_t const w0 = int16_t(w[0]), w1 = int16_t(w[1]), w2 = int16_t(w[2]), w3 = int16_t(w[3]);
+                auto sample = [&](int16x8_t p00, int16x8_t p01, int16x8_t p10, int16x8_t p11, int32x4_t &lo, int32x4_t &hi)
+                {
+                    lo = vmull_n_s16(vget_low_s16(p00), w0);
+                    lo = vmlal_n_s16(lo, vget_low_s16(p01), w1);
+                    lo = vmlal_n_s16(lo, vget_low_s16(p10), w2);
+                    lo = vmlal_n_s16(lo, vget_low_s16(p11), w3);
+                    hi = vmull_n_s16(vget_high_s16(p00), w0);
+                    hi = vmlal_n_s16(hi, vget_high_s16(p01), w1);
+                    hi = vmlal_n_s16(hi, vget_high_s16(p10), w2);
+                    hi = vmlal_n_s16(hi, vget_high_s16(p11), w3);
+                };
+                auto pixels = [](std::uint8_t const *p) { return vreinterpretq_s16_u16(vmovl_u8(vld1_u8(p))); };
+
+                int32x4_t m11 = vdupq_n_s32(0), m12 = vdupq_n_s32(0), m22 = vdupq_n_s32(0);
+                for (; x < stride; x += 8)
+                {
+                    int16x8_t const inside = vreinterpretq_s16_u16(vcltq_s16(vaddq_s16(vdupq_n_s16(int16_t(x)), vld1q_s16(kLanes)), vdupq_n_s16(int16_t(window))));
+                    int32x4_t lo, hi;
+                    sample(pixels(src + x), pixels(src + x + 1), pixels(src + width + x), pixels(src + width + x + 1), lo, hi);
+                    vst1q_s16(ival + x, vandq_s16(vcombine_s16(vrshrn_n_s32(lo, kPixelShift), vrshrn_n_s32(hi, kPixelShift)), inside));
+                    sample(vld1q_s16(dx + x), vld1q_s16(dx + x + 1), vld1q_s16(dx + width + x), vld1q_s16(dx + width + x + 1), lo, hi);
+                    int16x8_t const gx = vandq_s16(vcombine_s16(vrshrn_n_s32(lo, kWeightBits), vrshrn_n_s32(hi, kWeightBits)), inside);
+                    sample(vld1q_s16(dy + x), vld1q_s16(dy + x + 1), vld1q_s16(dy + width + x), vld1q_s16(dy + width + x + 1), lo, hi);
+                    int16x8_t const gy = vandq_s16(vcombine_s16(vrshrn_n_s32(lo, kWeightBits), vrshrn_n_s32(hi, kWeightBits)), inside);
+                    vst1q_s16(ixval + x, gx);
+                    vst1q_s16(iyval + x, gy);
+
+                    m11 = vmlal_s16(vmlal_s16(m11, vget_low_s16(gx), vget_low_s16(gx)), vget_high_s16(gx), vget_high_s16(gx));
+                    m12 = vmlal_s16(vmlal_s16(m12, vget_low_s16(gx), vget_low_s16(gy)), vget_high_s16(gx), vget_high_s16(gy));
+                    m22 = vmlal_s16(vmlal_s16(m22, vget_low_s16(gy), vget_low_s16(gy)), vget_high_s16(gy), vget_high_s16(gy));
+                }
+                int64x2_t const sum11 = vpaddlq_s32(m11), sum12 = vpaddlq_s32(m12), sum22 = vpaddlq_s32(m22);
+                a11 += vgetq_lane_s64(sum11, 0) + vgetq_lane_s64(sum11, 1);
+                a12 += vgetq_lane_s64(sum12, 0) + vgetq_lane_s64(sum12, 1);
+                a22 += vgetq_lane_s64(sum22, 0) + vgetq_lane_s64(sum22, 1);
+                return;
+            }
+#elif defined(RPI_CAM_SIMD_SSE2)
+            if (bSimd)
+            {
+                __m128i const zero = _mm_setzero_si128();
+                __m128i const wTop = _mm_unpacklo_epi16(_mm_set1_epi16(std::int16_t(w[0])), _mm_set1_epi16(std::int16_t(w[1])));
+                __m128i const wBottom = _mm_unpacklo_epi16(_mm_set1_epi16(std::int16_t(w[2])), _mm_set1_epi16(std::int16_t(w[3])));
+                __m128i const lanes = _mm_set_epi16(7, 6, 5, 4, 3, 2, 1, 0);
+                auto load = [](std::int16_t const *p) { return _mm_loadu_si128(reinterpret_cast<__m128i const*>(p)); };
+                auto pixels = [&](std::uint8_t const *p) { return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(p)), zero); };
+                auto sample = [&](__m128i p00, __m128i p01, __m128i p10, __m128i p11, int shift)
+                {
+                    __m128i const round = _mm_set1_epi32(1 << (shift - 1));
+                    __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(p00, p01), wTop), _mm_madd_epi16(_mm_unpacklo_epi16(p10, p11), wBottom));
+                    __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(p00, p01), wTop), _mm_madd_epi16(_mm_unpackhi_epi16(p10, p11), wBottom));
+                    lo = _mm_sra_epi32(_mm_add_epi32(lo, round), _mm_cvtsi32_si128(shift));
+                    hi = _mm_sra_epi32(_mm_add_epi32(hi, round), _mm_cvtsi32_si128(shift));
+                    return _mm_packs_epi32(lo, hi);
+                };
+
+                __m128i m11 = zero, m12 = zero, m22 = zero;
+                for (; x < stride; x += 8)
+                {
+                    __m128i const inside = _mm_cmplt_epi16(_mm_add_epi16(_mm_set1_epi16(std::int16_t(x)), lanes), _mm_set1_epi16(std::int16_t(window)));
+                    __m128i const iv = sample(pixels(src + x), pixels(src + x + 1), pixels(src + width + x), pixels(src + width + x + 1), kPixelShift);
+                    __m128i const gx = _mm_and_si128(sample(load(dx + x), load(dx + x + 1), load(dx + width + x), load(dx + width + x + 1), kWeightBits), inside);
+                    __m128i const gy = _mm_and_si128(sample(load(dy + x), load(dy + x + 1), load(dy + width + x), load(dy + width + x + 1), kWeightBits), inside);
+                    _mm_store_si128(reinterpret_cast<__m128i*>(ival + x), _mm_and_si128(iv, inside));
+                    _mm_store_si128(reinterpret_cast<__m128i*>(ixval + x), gx);
+                    _mm_store_si128(reinterpret_cast<__m128i*>(iyval + x), gy);
+
+                    m11 = _mm_add_epi32(m11, _mm_madd_epi16(gx, gx));
+                    m12 = _mm_add_epi32(m12, _mm_madd_epi16(gx, gy));
+                    m22 = _mm_add_epi32(m22, _mm_madd_epi16(gy, gy));
+                }
+                alignas(16) std::int32_t sums[12];
+                _mm_store_si128(reinterpret_cast<__m128i*>(sums), m11);
+                _mm_store_si128(reinterpret_cast<__m128i*>(sums + 4), m12);
+                _mm_store_si128(reinterpret_cast<__m128i*>(sums + 8), m22);
+                a11 += std::int64_t(sums[0]) + sums[1] + sums[2] + sums[3];
+                a12 += std::int64_t(sums[4]) + sums[5] + sums[6] + sums[7];
+                a22 += std::int64_t(sums[8]) + sums[9] + sums[10] + sums[11];
+                return;
+            }
+#else
+            (void)bSimd;
+#endif
+            for (; x < window; ++x)
+            {
+                std::int32_t const gx = descale(dx[x] * w[0] + dx[x + 1] * w[1] + dx[x + width] * w[2] + dx[x + width + 1] * w[3], kWeightBits);
+                std::int32_t const gy = descale(dy[x] * w[0] + dy[x + 1] * w[1] + dy[x + width] * w[2] + dy[x + width + 1] * w[3], kWeightBits);
+                ival[x] = std::int16_t(descale(src[x] * w[0] + src[x + 1] * w[1] + src[x + width] * w[2] + src[x + width + 1] * w[3], kPixelShift));
+                ixval[x] = std::int16_t(gx);
+                iyval[x] = std::int16_t(gy);
+                a11 += gx * gx;
+                a12 += gx * gy;
+                a22 += gy * gy;
+            }
+            for (; x < stride; ++x)
+            {
+                ival[x] = 0;
+                ixval[x] = 0;
+                iyval[x] = 0;
+            }
+        }
+
+        // sum over the window of (J - I) * Ix and (J - I) * Iy, with J sampled at
+        // w from the window's top left pixel and the padding lanes of the
+        // template gradients set to zero
+        void mismatchRow(std::uint8_t const *row, std::size_t rowBytes, std::int16_t const *ival,
+            std::int16_t const *ixval, std::int16_t const *iyval, std::int32_t window, std::int32_t stride,
+            std::int32_t const w[4], bool bSimd, std::int64_t &b1, std::int64_t &b2)
+        {
+            std::int32_t x = 0;
+#if defined(RPI_CAM_SIMD_NEON)
+            if (bSimd)
+            {
+                int16_t const w0 = int16_t(w[0]), w1 = int16_t(w[1]), w2 = int16_t(w[2]), w3 = int16_t(w[3]);
+                int32x4_t acc1 = vdupq_n_s32(0), acc2 = vdupq_n_s32(0);
+                for (; x < stride; x += 8)
+                {
+                    int16x8_t const j00 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(row + x)));
+                    int16x8_t const j01 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(row + x + 1)));
+                    int16x8_t const j10 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(row + rowBytes + x)));
+                    int16x8_t const j11 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(row + rowBytes + x + 1)));
+
+                    int32x4_t lo = vmull_n_s16(vget_low_s16(j00), w0);
+                    lo = vmlal_n_s16(lo, vget_low_s16(j01), w1);
+                    lo = vmlal_n_s16(lo, vget_low_s16(j10), w2);
+                    lo = vmlal_n_s16(lo, vget_low_s16(j11), w3);
+                    int32x4_t hi = vmull_n_s16(vget_high_s16(j00), w0);
+                    hi = vmlal_n_s16(hi, vget_high_s16(j01), w1);
+                    hi = vmlal_n_s16(hi, vget_high_s16(j10), w2);
+                    hi = vmlal_n_s16(hi, vget_high_s16(j11), w3);
+
+                    int16x8_t const jval = vcombine_s16(vrshrn_n_s32(lo, kPixelShift), vrshrn_n_s32(hi, kPixelShift));
+                    int16x8_t const diff = vsubq_s16(jval, vld1q_s16(ival + x));
+                    int16x8_t const dx = vld1q_s16(ixval + x), dy = vld1q_s16(iyval + x);
+                    acc1 = vmlal_s16(acc1, vget_low_s16(diff), vget_low_s16(dx));
+                    acc1 = vmlal_s16(acc1, vget_high_s16(diff), vget_high_s16(dx));
+                    acc2 = vmlal_s16(acc2, vget_low_s16(diff), vget_low_s16(dy));
+                    acc2 = vmlal_s16(acc2, vget_high_s16(diff), vget_high_s16(dy));
+                }
+                int64x2_t const sum1 = vpaddlq_s32(acc1), sum2 = vpaddlq_s32(acc2);
+                b1 += vgetq_lane_s64(sum1, 0) + vgetq_lane_s64(sum1, 1);
+                b2 += vgetq_lane_s64(sum2, 0) + vgetq_lane_s64(sum2, 1);
+            }
+#elif defined(RPI_CAM_SIMD_SSE2)
+            if (bSimd)
+            {
+                __m128i const zero = _mm_setzero_si128();
+                __m128i const wTop = _mm_unpacklo_epi16(_mm_set1_epi16(std::int16_t(w[0])), _mm_set1_epi16(std::int16_t(w[1])));
+                __m128i const wBottom = _mm_unpacklo_epi16(_mm_set1_epi16(std::int16_t(w[2])), _mm_set1_epi16(std::int16_t(w[3])));
+                __m128i const round = _mm_set1_epi32(1 << (kPixelShift - 1));
+                __m128i acc1 = zero, acc2 = zero;
+                for (; x < stride; x += 8)
+                {
+                    __m128i const j00 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(row + x)), zero);
+                    __m128i const j01 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(row + x + 1)), zero);
+                    __m128i const j10 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(row + rowBytes + x)), zero);
+                    __m128i const j11 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(row + rowBytes + x + 1)), zero);
+
+                    __m128i lo = _mm_add_epi32(
+                        _mm_madd_epi16(_mm_unpacklo_epi16(j00, j01), wTop),
+                        _mm_madd_epi16(_mm_unpacklo_epi16(j10, j11), wBottom));
+                    __m128i hi = _mm_add_epi32(
+                        _mm_madd_epi16(_mm_unpackhi_epi16(j00, j01), wTop),
+                        _mm_madd_epi16(_mm_unpackhi_epi16(j10, j11), wBottom));
+                    lo = _mm_srai_epi32(_mm_add_epi32(lo, round), kPixelShift);
+                    hi = _mm_srai_epi32(_mm_add_epi32(hi, round), kPixelShift);
+
+                    __m128i const diff = _mm_sub_epi16(_mm_packs_epi32(lo, hi), _mm_load_si128(reinterpret_cast<__m128i const*>(ival + x)));
+                    acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(diff, _mm_load_si128(reinterpret_cast<__m128i const*>(ixval + x))));
+                    acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(diff, _mm_load_si128(reinterpret_cast<__m128i const*>(iyval + x))));
+                }
+                alignas(16) std::int32_t sums[8];
+                _mm_store_si128(reinterpret_cast<__m128i*>(sums), acc1);
+                _mm_store_si128(reinterpret_cast<__m128i*>(sums + 4), acc2);
+                b1 += std::int64_t(sums[0]) + sums[1] + sums[2] + sums[3];
+                b2 += std::int64_t(sums[4]) + sums[5] + sums[6] + sums[7];
+            }
+#else
+            (void)bSimd;
+            (void)stride;
+#endif
+            for (; x < window; ++x)
+            {
+                std::uint8_t const *p = row + x;
+                std::int32_t const jval = descale(p[0] * w[0] + p[1] * w[1] + p[rowBytes] * w[2] + p[rowBytes + 1] * w[3], kPixelShift);
+                std::int32_t const diff = jval - ival[x];
+                b1 += diff * ixval[x];
+                b2 += diff * iyval[x];
+            }
+        }
+    }
+
+    OpticalFlowOptions::OpticalFlowOptions()
+        : windowRadius(7)
+        , numLevels(3)
+        , maxIterations(10)
+        , epsilon(0.03f)
+        , minEigenvalue(1.0e-4f)
+        , maxError(0.0f)
+    {
+    }
+
+    TrackedPoint::TrackedPoint()
+        : position(0.0f, 0.0f)
+        , error(0.0f)
+        , bTracked(true)
+    {
+    }
+
+    TrackedPoint::TrackedPoint(Vec2f const &position)
+        : position(position)
+        , error(0.0f)
+        , bTracked(true)
+    {
+    }
+
+    OpticalFlowTracker::Level::Level(std::shared_ptr<ThreadPool> const &pool)
+        : size(0, 0)
+        , pixels()
+        , gradients(scharrOptions(), pool)
+    {
+    }
+
+    OpticalFlowTracker::OpticalFlowTracker(OpticalFlowOptions const &options, std::shared_ptr<ThreadPool> pool)
+        : m_Mutex()
+        , m_Options(isValid(options) ? options : OpticalFlowOptions())
+        , m_Pool(pool)
+        , m_bSimd(true)
+        , m_bReference(false)
+        , m_Levels()
+    {
+        if (!isValid(options))
+            RPI_LOG(WARNING, "OpticalFlowTracker::OpticalFlowTracker(): invalid options, using defaults!");
+
+        m_Levels.reserve(ImagePyramid::kNumLevels + 1);
+        for (std::size_t li = 0; li <= ImagePyramid::kNumLevels; ++li)
+            m_Levels.emplace_back(pool);
+    }
+
+    OpticalFlowTracker::~OpticalFlowTracker()
+    {
+    }
+
+    OpticalFlowOptions OpticalFlowTracker::options() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_Options;
+    }
+
+    std::error_code OpticalFlowTracker::setOptions(OpticalFlowOptions const &options)
+    {
+        if (!isValid(options))
+        {
+            RPI_LOG(ERROR, "OpticalFlowTracker::setOptions(): invalid options!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Options = options;
+        m_bReference = false;
+        return std::error_code();
+    }
+
+    bool OpticalFlowTracker::isSimdEnabled() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_bSimd;
+    }
+
+    void OpticalFlowTracker::setSimdEnabled(bool bEnabled)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bSimd = bEnabled;
+    }
+
+    std::error_code OpticalFlowTracker::process(PixelSampleBuffer &frame, std::vector<TrackedPoint> &points)
+    {
+        if (pixelFormatDescriptor(frame.format()).bytesPerPixel[0] != 1)
+        {
+            RPI_LOG(ERROR, "OpticalFlowTracker::process(): no separate luma plane in this format!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        std::size_t const numLevels = m_Options.numLevels;
+
+        // the pyramid locks the frame itself, so its levels come first
+        Images images;
+        for (std::size_t li = 1; li <= numLevels; ++li)
+        {
+            PixelBuffer *luma = frame.pyramid().level(li);
+            if (!luma)
+            {
+                RPI_LOG(ERROR, "OpticalFlowTracker::process(): no luma level %d for this frame!", int(li));
+                return std::make_error_code(std::errc::invalid_argument);
+            }
+            images[li] = Image{luma, static_cast<std::uint8_t const*>(luma->planeData(0)), luma->planeRowBytes(0), luma->planeSize(0)};
+        }
+
+        if (frame.lock())
+        {
+            RPI_LOG(ERROR, "OpticalFlowTracker::process(): failed to lock the frame!");
+            return std::make_error_code(std::errc::no_lock_available);
+        }
+        images[0] = Image{&frame, static_cast<std::uint8_t const*>(frame.planeData(0)), frame.planeRowBytes(0), frame.planeSize(0)};
+
+        if (m_bReference && m_Levels[0].size == images[0].size)
+        {
+            auto trackRange = [&](std::size_t begin, std::size_t end)
+            {
+                for (std::size_t ip = begin; ip < end; ++ip)
+                {
+                    if (points[ip].bTracked)
+                        trackPoint(images, points[ip]);
+                }
+            };
+
+            if (m_Pool && m_Pool->size() > 0 && points.size() > kPointGrain)
+                m_Pool->parallelFor(0, points.size(), kPointGrain, trackRange);
+            else
+                trackRange(0, points.size());
+        }
+
+        std::error_code const kre = keepReference(images, numLevels);
+        frame.unlock();
+        return kre;
+    }
+
+    void OpticalFlowTracker::reset()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bReference = false;
+    }
+
+    bool OpticalFlowTracker::isValid(OpticalFlowOptions const &options)
+    {
+        return options.windowRadius > 0 && options.windowRadius <= kMaxWindowRadius &&
+            options.numLevels <= ImagePyramid::kNumLevels &&
+            options.maxIterations > 0 &&
+            options.epsilon >= 0.0f &&
+            options.minEigenvalue >= 0.0f &&
+            options.maxError >= 0.0f;
+    }
+
+    void OpticalFlowTracker::trackPoint(Images const &images, TrackedPoint &point) const
+    {
+        static constexpr std::int32_t kMaxWindow = 2 * kMaxWindowRadius + 1;
+        static constexpr std::int32_t kMaxStride = (kMaxWindow + 7) & ~7;
+
+        std::int32_t const radius = std::int32_t(m_Options.windowRadius);
+        std::int32_t const window = 2 * radius + 1;
+        std::int32_t const stride = (window + 7) & ~7;
+        std::int32_t const numLevels = std::int32_t(m_Options.numLevels);
+        float const area = float(window * window);
+        float const epsilon2 = m_Options.epsilon * m_Options.epsilon;
+        bool const bSimd = m_bSimd;
+
+        // the template and its gradients, padding lanes are zero so full
+        // vectors add nothing for them
+        alignas(16) std::int16_t ival[kMaxWindow * kMaxStride];
+        alignas(16) std::int16_t ixval[kMaxWindow * kMaxStride];
+        alignas(16) std::int16_t iyval[kMaxWindow * kMaxStride];
+
+        Vec2f flow(0.0f, 0.0f);
+        std::int32_t w[4];
+        std::int32_t jx = 0, jy = 0;
+        for (std::int32_t li = numLevels; li >= 0; --li)
+        {
+            Level const &level = m_Levels[li];
+            Image const &next = images[li];
+            std::int32_t const width = std::int32_t(level.size(0)), height = std::int32_t(level.size(1));
+            if (li < numLevels)
+                flow *= 2.0f;
+
+            // pixel centers of a level sit on the centers of 2x2 blocks of the one below
+            float const scale = 1.0f / float(1 << li);
+            Vec2f const origin = (point.position + Vec2f(0.5f, 0.5f)) * scale - Vec2f(0.5f + radius, 0.5f + radius);
+            std::int32_t const ix = std::int32_t(std::floor(origin(0))), iy = std::int32_t(std::floor(origin(1)));
+            if (ix < 0 || iy < 0 || ix + window >= width || iy + window >= height)
+            {
+                if (!li)
+                    point.bTracked = false;
+                continue;
+            }
+
+            // full vectors read stride + 1 pixels of every row
+            bilinearWeights(origin(0) - float(ix), origin(1) - float(iy), w);
+            bool const bTemplateSimd = bSimd && ix + stride < width;
+            std::int64_t a11 = 0, a12 = 0, a22 = 0;
+            for (std::int32_t y = 0; y < window; ++y)
+            {
+                std::size_t const offset = std::size_t(iy + y) * width + ix;
+                templateRow(level.pixels.data() + offset, level.gradients.gradientX(0) + offset, level.gradients.gradientY(0) + offset, width,
+                    window, stride, w, bTemplateSimd, ival + y * stride, ixval + y * stride, iyval + y * stride, a11, a12, a22);
+            }
+
+            Eigen::Matrix2f moments;
+            moments << float(a11) * kMomentScale, float(a12) * kMomentScale,
+                       float(a12) * kMomentScale, float(a22) * kMomentScale;
+            float const trace = moments(0, 0) + moments(1, 1);
+            float const spread = moments(0, 0) - moments(1, 1);
+            float const minEigenvalue = 0.5f * (trace - std::sqrt(spread * spread + 4.0f * moments(0, 1) * moments(0, 1))) / area;
+            if (minEigenvalue < m_Options.minEigenvalue || moments.determinant() < 1.0e-7f)
+            {
+                if (!li)
+                    point.bTracked = false;
+                continue;
+            }
+            Eigen::Matrix2f const inverse = moments.inverse();
+
+            Vec2f previousStep(0.0f, 0.0f);
+            for (std::uint32_t it = 0; it < m_Options.maxIterations; ++it)
+            {
+                Vec2f const at = origin + flow;
+                jx = std::int32_t(std::floor(at(0)));
+                jy = std::int32_t(std::floor(at(1)));
+                if (jx < 0 || jy < 0 || jx + window >= width || jy + window >= height)
+                {
+                    if (!li)
+                        point.bTracked = false;
+                    break;
+                }
+
+                // full vectors read stride + 1 pixels of every row
+                bilinearWeights(at(0) - float(jx), at(1) - float(jy), w);
+                bool const bRowSimd = bSimd && jx + stride < width;
+                std::int64_t b1 = 0, b2 = 0;
+                for (std::int32_t y = 0; y < window; ++y)
+                {
+                    mismatchRow(next.data + std::size_t(jy + y) * next.rowBytes + jx, next.rowBytes,
+                        ival + y * stride, ixval + y * stride, iyval + y * stride, window, stride, w, bRowSimd, b1, b2);
+                }
+
+                Vec2f const step = -(inverse * Vec2f(float(b1) * kMomentScale, float(b2) * kMomentScale));
+                flow += step;
+                if (step.squaredNorm() <= epsilon2)
+                    break;
+
+                // oscillating between two positions, settle in the middle
+                if (it > 0 && (step + previousStep).squaredNorm() < 1.0e-4f)
+                {
+                    flow -= 0.5f * step;
+                    break;
+                }
+                previousStep = step;
+            }
+
+            if (!li && !point.bTracked)
+                return;
+        }
+
+        if (!point.bTracked)
+            return;
+
+        // mean difference over the final window
+        Image const &next = images[0];
+        Vec2f const at = point.position + flow - Vec2f(float(radius), float(radius));
+        jx = std::int32_t(std::floor(at(0)));
+        jy = std::int32_t(std::floor(at(1)));
+        if (jx < 0 || jy < 0 || jx + window >= std::int32_t(next.size(0)) || jy + window >= std::int32_t(next.size(1)))
+        {
+            point.bTracked = false;
+            return;
+        }
+
+        bilinearWeights(at(0) - float(jx), at(1) - float(jy), w);
+        std::int64_t sum = 0;
+        for (std::int32_t y = 0; y < window; ++y)
+        {
+            std::uint8_t const *row = next.data + std::size_t(jy + y) * next.rowBytes + jx;
+            for (std::int32_t x = 0; x < window; ++x)
+            {
+                std::uint8_t const *p = row + x;
+                std::int32_t const jval = descale(p[0] * w[0] + p[1] * w[1] + p[next.rowBytes] * w[2] + p[next.rowBytes + 1] * w[3], kPixelShift);
+                sum += std::abs(jval - ival[y * stride + x]);
+            }
+        }
+
+        point.position += flow;
+        point.error = float(sum) / (area * float(1 << kPixelBits));
+        if (m_Options.maxError > 0.0f && point.error > m_Options.maxError)
+            point.bTracked = false;
+    }
+
+    std::error_code OpticalFlowTracker::keepReference(Images const &images, std::size_t numLevels)
+    {
+        m_bReference = false;
+        for (std::size_t li = 0; li <= numLevels; ++li)
+        {
+            Image const &image = images[li];
+            Level &level = m_Levels[li];
+            level.size = image.size;
+            level.pixels.resize(image.size.prod());
+            for (std::uint32_t y = 0; y < image.size(1); ++y)
+                std::memcpy(level.pixels.data() + y * image.size(0), image.data + y * image.rowBytes, image.size(0));
+
+            if (std::error_code cge = level.gradients.computeGradients(*image.buffer))
+                return cge;
+        }
+        m_bReference = true;
+        return std::error_code();
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "Config.hpp"
+#include "PixelSampleBuffer.hpp"
+#include "EdgeDetector.hpp"
+#include "ImagePyramid.hpp"
+#include "ThreadPool.hpp"
+#include <array>
+#include <mutex>
+#include <vector>
+
+namespace rpiCam
+{
+    class OpticalFlowOptions
+    {
+    public:
+        OpticalFlowOptions();
+
+        std::uint32_t windowRadius;     // the window is 2 * windowRadius + 1 pixels square, at most kMaxWindowRadius
+        std::uint32_t numLevels;        // pyramid levels above the Y plane, at most ImagePyramid::kNumLevels
+        std::uint32_t maxIterations;    // per level
+        float epsilon;                  // iterations stop once a step is shorter than this, in level pixels
+        float minEigenvalue;            // points whose window has a smaller gradient matrix eigenvalue per pixel are lost
+        float maxError;                 // mean absolute difference over the final window in grey levels, 0 disables the test
+    };
+
+    class TrackedPoint
+    {
+    public:
+        TrackedPoint();
+        TrackedPoint(Vec2f const &position);
+
+        Vec2f position;     // in frame pixels
+        float error;        // mean absolute difference over the window at the last track, in grey levels
+        bool bTracked;      // cleared once the point is lost, lost points are not tracked any more
+    };
+
+    // Pyramidal Lucas-Kanade tracking of points on the Y plane from one
+    // frame to the next. Scharr gradients of every level of the previous
+    // frame are computed once, when it is processed, and shared by all
+    // points. Each point solves a fixed size 2x2 system per iteration from
+    // fixed point bilinear samples. The previous frame's levels are copied,
+    // frames are not retained.
+    class OpticalFlowTracker
+    {
+    public:
+        static constexpr std::uint32_t kMaxWindowRadius = 15;
+
+        OpticalFlowTracker(OpticalFlowOptions const &options = OpticalFlowOptions(), std::shared_ptr<ThreadPool> pool = nullptr);
+        ~OpticalFlowTracker();
+
+        OpticalFlowOptions options() const;
+        std::error_code setOptions(OpticalFlowOptions const &options);
+
+        bool isSimdEnabled() const;
+        void setSimdEnabled(bool bEnabled);
+
+        // Moves the points from the previously processed frame into frame
+        // and keeps frame as the next reference. The first frame, one of
+        // another size or the first after reset() or setOptions() only
+        // becomes the reference and leaves the points alone. The frame needs
+        // a separate Y plane.
+        std::error_code process(PixelSampleBuffer &frame, std::vector<TrackedPoint> &points);
+
+        // forgets the reference frame
+        void reset();
+
+    private:
+        class Level
+        {
+        public:
+            Level(std::shared_ptr<ThreadPool> const &pool);
+
+            Vec2ui size;
+            std::vector<std::uint8_t> pixels;   // rows of size(0) bytes
+            EdgeDetector gradients;
+        };
+
+        struct Image
+        {
+            PixelBuffer *buffer;
+            std::uint8_t const *data;
+            std::size_t rowBytes;
+            Vec2ui size;
+        };
+
+        using Images = std::array<Image, ImagePyramid::kNumLevels + 1>;
+
+        static bool isValid(OpticalFlowOptions const &options);
+
+        void trackPoint(Images const &images, TrackedPoint &point) const;
+        std::error_code keepReference(Images const &images, std::size_t numLevels);
+
+    private:
+        mutable std::mutex m_Mutex;
+        OpticalFlowOptions m_Options;
+        std::shared_ptr<ThreadPool> m_Pool;
+        bool m_bSimd;
+        bool m_bReference;
+        std::vector<Level> m_Levels;    // the reference frame, Y plane first
+    };
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include "Config.hpp"
+#include "Camera.hpp"
+#include "ThreadPool.hpp"
+#include <vector>
+
+namespace rpiCam
+{
+    // Fans video frames out to a thread pool and delivers the results in submit
+    // order through a reorder buffer, which is capture order for frames coming
+    // from the camera. At most maxInFlight frames are held at once so the camera
+    // always keeps buffers to capture into; frames arriving while the buffer is
+    // full are dropped. Frames lost before submit() show up as gaps in
+    // SampleBuffer::sequence and are counted by numSkipped().
+    template <typename Result>
+    class ParallelFrameProcessor
+        : public Camera::Events
+    {
+    public:
+        using Process = std::function<Result(std::shared_ptr<PixelSampleBuffer> const &buffer)>;
+
+        class Events
+        {
+        public:
+            virtual void onFrameProcessed(std::shared_ptr<PixelSampleBuffer> const &buffer, Result const &result) {}
+            virtual void onFrameDropped(std::shared_ptr<PixelSampleBuffer> const &buffer) {}
+        };
+
+        using ProcessorEvents = EventsDispatcher<Events>;
+
+        ParallelFrameProcessor(Process process, std::size_t maxInFlight, std::shared_ptr<ThreadPool> pool = ThreadPool::shared())
+            : Camera::Events()
+            , m_Process(process)
+            , m_Pool(pool)
+            , m_Mutex()
+            , m_Condition()
+            , m_Slots(std::max<std::size_t>(maxInFlight, 1))
+            , m_Head(0)
+            , m_Tail(0)
+            , m_bDelivering(false)
+            , m_bSequenced(false)
+            , m_NextSequence(0)
+            , m_NumProcessed(0)
+            , m_NumDropped(0)
+            , m_NumSkipped(0)
+            , m_ProcessorEvents()
+        {
+        }
+
+        ~ParallelFrameProcessor()
+        {
+            flush();
+        }
+
+        // leave one buffer of the camera pool for capturing the next frame
+        static std::size_t maxInFlightFor(Camera const &camera)
+        {
+            std::size_t const bufferCount = camera.getVideoBufferCount();
+            return bufferCount > 1 ? bufferCount - 1 : 1;
+        }
+
+        inline ProcessorEvents const& processorEvents() const { return m_ProcessorEvents; }
+
+        inline std::size_t maxInFlight() const { return m_Slots.size(); }
+
+        std::size_t inFlight() const
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            return m_Tail - m_Head;
+        }
+
+        inline std::uint64_t numProcessed() const { return m_NumProcessed; }
+        inline std::uint64_t numDropped() const { return m_NumDropped; }
+
+        // frames missing from the sequence numbers of the submitted ones
+        inline std::uint64_t numSkipped() const { return m_NumSkipped; }
+
+        bool submit(std::shared_ptr<PixelSampleBuffer> const &buffer)
+        {
+            std::uint64_t index;
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                if (m_bSequenced && buffer->sequence > m_NextSequence)
+                    m_NumSkipped += buffer->sequence - m_NextSequence;
+                m_bSequenced = true;
+                m_NextSequence = buffer->sequence + 1;
+
+                if (m_Tail - m_Head >= m_Slots.size())
+                    index = kDropped;
+                else
+                {
+                    index = m_Tail++;
+                    Slot &slot = m_Slots[index % m_Slots.size()];
+                    slot.buffer = buffer;
+                    slot.done = false;
+                }
+            }
+
+            if (index == kDropped)
+            {
+                m_NumDropped++;
+                m_ProcessorEvents.dispatch(&Events::onFrameDropped, buffer);
+                return false;
+            }
+
+            m_Pool->post([this, index, buffer]()
+            {
+                Result result = m_Process(buffer);
+                complete(index, std::move(result));
+            });
+            return true;
+        }
+
+        // waits until every submitted frame has been delivered
+        void flush()
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Condition.wait(lock, [this]() { return m_Head == m_Tail && !m_bDelivering; });
+        }
+
+        // Camera::Events overrides
+        void onCameraVideoFrame(std::shared_ptr<PixelSampleBuffer> const &buffer) override
+        {
+            submit(buffer);
+        }
+
+        void onCameraVideoStopped() override
+        {
+            flush();
+        }
+
+    private:
+        static constexpr std::uint64_t kDropped = ~std::uint64_t(0);
+
+        struct Slot
+        {
+            std::shared_ptr<PixelSampleBuffer> buffer;
+            Result result;
+            bool done = false;
+        };
+
+        void complete(std::uint64_t index, Result &&result)
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            Slot &completed = m_Slots[index % m_Slots.size()];
+            completed.result = std::move(result);
+            completed.done = true;
+
+            // only one thread delivers at a time, which keeps the results in order
+            if (m_bDelivering)
+                return;
+
+            m_bDelivering = true;
+            while (m_Head != m_Tail && m_Slots[m_Head % m_Slots.size()].done)
+            {
+                Slot &slot = m_Slots[m_Head % m_Slots.size()];
+
+                lock.unlock();
+                m_ProcessorEvents.dispatch(&Events::onFrameProcessed, slot.buffer, slot.result);
+                m_NumProcessed++;
+                lock.lock();
+
+                slot.buffer.reset();
+                slot.result = Result();
+                slot.done = false;
+                m_Head++;
+            }
+            m_bDelivering = false;
+            m_Condition.notify_all();
+        }
+
+    private:
+        Process m_Process;
+        std::shared_ptr<ThreadPool> m_Pool;
+        mutable std::mutex m_Mutex;
+        std::condition_variable m_Condition;
+        std::vector<Slot> m_Slots;
+        std::uint64_t m_Head;
+        std::uint64_t m_Tail;
+        bool m_bDelivering;
+        bool m_bSequenced;
+        std::uint64_t m_NextSequence;
+        std::atomic<std::uint64_t> m_NumProcessed;
+        std::atomic<std::uint64_t> m_NumDropped;
+        std::atomic<std::uint64_t> m_NumSkipped;
+        ProcessorEvents m_ProcessorEvents;
+    };
+}
@@ -0,0 +1,193 @@
+#include "Pipeline.hpp"
+#include "Logging.hpp"
+
+namespace rpiCam
+{
+    PipelineStageOptions::PipelineStageOptions(std::string const &n)
+        : name(n)
+        , numThreads(1)
+        , queueCapacity(2)
+        , schedule()
+        , dropWhenFull(false)
+    {
+    }
+
+    PipelineStageStats::PipelineStageStats()
+        : name()
+        , processed(0)
+        , dropped(0)
+        , meanLatency(0)
+        , maxLatency(0)
+        , meanProcessingTime(0)
+        , throughput(0.0)
+        , queueDepth(0)
+    {
+    }
+
+    PipelineNode::PipelineNode(PipelineStageOptions const &options)
+        : m_Options(options)
+        , m_Threads()
+        , m_StatsMutex()
+        , m_StartTime()
+        , m_Processed(0)
+        , m_Dropped(0)
+        , m_TotalLatency(0)
+        , m_MaxLatency(0)
+        , m_TotalProcessingTime(0)
+    {
+    }
+
+    PipelineNode::~PipelineNode()
+    {
+    }
+
+    void PipelineNode::start()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_StatsMutex);
+            m_StartTime = TimeClock::now();
+            m_Processed = 0;
+            m_Dropped = 0;
+            m_TotalLatency = Duration(0);
+            m_MaxLatency = Duration(0);
+            m_TotalProcessingTime = Duration(0);
+        }
+
+        open();
+
+        std::size_t const numThreads = std::max<std::size_t>(m_Options.numThreads, 1);
+        for (std::size_t it = 0; it < numThreads; ++it)
+            m_Threads.emplace_back(&PipelineNode::run, this);
+    }
+
+    void PipelineNode::stop()
+    {
+        close();
+
+        for (auto &thread : m_Threads)
+            thread.join();
+
+        m_Threads.clear();
+    }
+
+    PipelineStageStats PipelineNode::stats() const
+    {
+        PipelineStageStats stats;
+        stats.name = m_Options.name;
+        stats.queueDepth = queueDepth();
+
+        std::lock_guard<std::mutex> lock(m_StatsMutex);
+        stats.processed = m_Processed;
+        stats.dropped = m_Dropped;
+        stats.maxLatency = m_MaxLatency;
+
+        if (m_Processed)
+        {
+            stats.meanLatency = m_TotalLatency / m_Processed;
+            stats.meanProcessingTime = m_TotalProcessingTime / m_Processed;
+        }
+
+        double const seconds = std::chrono::duration<double>(TimeClock::now() - m_StartTime).count();
+        if (seconds > 0.0)
+            stats.throughput = m_Processed / seconds;
+
+        return stats;
+    }
+
+    void PipelineNode::recordProcessed(TimePoint enqueued, TimePoint started, TimePoint finished)
+    {
+        std::lock_guard<std::mutex> lock(m_StatsMutex);
+        Duration const latency = finished - enqueued;
+        m_Processed++;
+        m_TotalLatency += latency;
+        m_MaxLatency = std::max(m_MaxLatency, latency);
+        m_TotalProcessingTime += finished - started;
+    }
+
+    void PipelineNode::recordDropped()
+    {
+        std::lock_guard<std::mutex> lock(m_StatsMutex);
+        m_Dropped++;
+    }
+
+    void PipelineNode::run()
+    {
+        if (!m_Options.schedule.isDefault())
+            applyThreadSchedule(m_Options.schedule);
+
+        while (processNext());
+    }
+
+    Pipeline::Pipeline()
+        : Camera::Events()
+        , m_Nodes()
+        , m_Input(nullptr)
+        , m_bRunning(false)
+        , m_DroppedAtSource(0)
+    {
+    }
+
+    Pipeline::~Pipeline()
+    {
+        stop();
+    }
+
+    Pipeline::Builder<Pipeline::Frame> Pipeline::source()
+    {
+        return Builder<Frame>(this, [this](PipelineInput<Frame> *input) { m_Input = input; });
+    }
+
+    void Pipeline::start()
+    {
+        if (m_bRunning)
+            return;
+
+        m_DroppedAtSource = 0;
+        for (auto &node : m_Nodes)
+            node->start();
+
+        m_bRunning = true;
+    }
+
+    void Pipeline::stop()
+    {
+        if (!m_bRunning)
+            return;
+
+        m_bRunning = false;
+
+        // stages are stopped front to back so every stage drains into a still running one
+        for (auto &node : m_Nodes)
+            node->stop();
+    }
+
+    void Pipeline::attach(Camera const &camera)
+    {
+        camera.cameraEvents() += this;
+    }
+
+    void Pipeline::detach(Camera const &camera)
+    {
+        camera.cameraEvents() -= this;
+    }
+
+    std::vector<PipelineStageStats> Pipeline::stats() const
+    {
+        std::vector<PipelineStageStats> stats;
+        stats.reserve(m_Nodes.size());
+        for (auto const &node : m_Nodes)
+            stats.push_back(node->stats());
+
+        return stats;
+    }
+
+    void Pipeline::onCameraVideoFrame(std::shared_ptr<PixelSampleBuffer> const &buffer)
+    {
+        if (!m_bRunning || !m_Input)
+            return;
+
+        Frame frame = buffer;
+        if (!m_Input->push(std::move(frame), TimeClock::now(), true))
+            m_DroppedAtSource++;
+    }
+}
@@ -0,0 +1,281 @@
+#pragma once
+
+#include "Config.hpp"
+#include "Camera.hpp"
+#include "BoundedQueue.hpp"
+#include "ThreadScheduling.hpp"
+#include <vector>
+#include <functional>
+#include <utility>
+
+namespace rpiCam
+{
+    class PipelineStageOptions
+    {
+    public:
+        PipelineStageOptions(std::string const &n = std::string());
+
+        std::string name;
+        std::size_t numThreads;
+        std::size_t queueCapacity;
+        ThreadSchedule schedule;
+        bool dropWhenFull;
+    };
+
+    class PipelineStageStats
+    {
+    public:
+        PipelineStageStats();
+
+        std::string name;
+        std::uint64_t processed;
+        std::uint64_t dropped;
+        Duration meanLatency;
+        Duration maxLatency;
+        Duration meanProcessingTime;
+        double throughput;
+        std::size_t queueDepth;
+    };
+
+    class PipelineNode
+    {
+    public:
+        PipelineNode(PipelineStageOptions const &options);
+        virtual ~PipelineNode();
+
+        inline PipelineStageOptions const& options() const { return m_Options; }
+
+        void start();
+        void stop();
+
+        PipelineStageStats stats() const;
+
+    protected:
+        virtual void open() = 0;
+        virtual void close() = 0;
+        virtual bool processNext() = 0;
+        virtual std::size_t queueDepth() const = 0;
+
+        void recordProcessed(TimePoint enqueued, TimePoint started, TimePoint finished);
+        void recordDropped();
+
+    private:
+        void run();
+
+    protected:
+        PipelineStageOptions const m_Options;
+
+    private:
+        std::vector<std::thread> m_Threads;
+        mutable std::mutex m_StatsMutex;
+        TimePoint m_StartTime;
+        std::uint64_t m_Processed;
+        std::uint64_t m_Dropped;
+        Duration m_TotalLatency;
+        Duration m_MaxLatency;
+        Duration m_TotalProcessingTime;
+    };
+
+    template <typename T>
+    class PipelineInput
+    {
+    public:
+        virtual ~PipelineInput() {}
+
+        // returns false when the value was dropped
+        virtual bool push(T &&value, TimePoint enqueued, bool nonBlocking) = 0;
+    };
+
+    template <typename In, typename Out>
+    class PipelineStageBase
+        : public PipelineNode
+        , public PipelineInput<In>
+    {
+    protected:
+        struct Item
+        {
+            In value;
+            TimePoint enqueued;
+        };
+
+    public:
+        PipelineStageBase(PipelineStageOptions const &options)
+            : PipelineNode(options)
+            , PipelineInput<In>()
+            , m_Queue(options.queueCapacity)
+        {
+        }
+
+        bool push(In &&value, TimePoint enqueued, bool nonBlocking) override
+        {
+            Item item{std::move(value), enqueued};
+            if (nonBlocking || m_Options.dropWhenFull)
+            {
+                if (m_Queue.tryPush(std::move(item)))
+                    return true;
+
+                recordDropped();
+                return false;
+            }
+            return m_Queue.push(std::move(item));
+        }
+
+    protected:
+        void open() override { m_Queue.reopen(); }
+        void close() override { m_Queue.close(); }
+        std::size_t queueDepth() const override { return m_Queue.size(); }
+
+    protected:
+        BoundedQueue<Item> m_Queue;
+    };
+
+    template <typename In, typename Out>
+    class PipelineStage
+        : public PipelineStageBase<In, Out>
+    {
+    public:
+        using Process = std::function<Out(In &value)>;
+
+        PipelineStage(PipelineStageOptions const &options, Process process)
+            : PipelineStageBase<In, Out>(options)
+            , m_Process(process)
+            , m_Output(nullptr)
+        {
+        }
+
+        void setOutput(PipelineInput<Out> *output) { m_Output = output; }
+
+    protected:
+        bool processNext() override
+        {
+            typename PipelineStageBase<In, Out>::Item item;
+            if (!this->m_Queue.pop(item))
+                return false;
+
+            TimePoint started = TimeClock::now();
+            Out out = m_Process(item.value);
+            TimePoint finished = TimeClock::now();
+            this->recordProcessed(item.enqueued, started, finished);
+
+            // blocking here is what propagates backpressure towards the drop point
+            if (m_Output)
+                m_Output->push(std::move(out), finished, false);
+            return true;
+        }
+
+    private:
+        Process m_Process;
+        PipelineInput<Out> *m_Output;
+    };
+
+    template <typename In>
+    class PipelineStage<In, void>
+        : public PipelineStageBase<In, void>
+    {
+    public:
+        using Process = std::function<void(In &value)>;
+
+        PipelineStage(PipelineStageOptions const &options, Process process)
+            : PipelineStageBase<In, void>(options)
+            , m_Process(process)
+        {
+        }
+
+    protected:
+        bool processNext() override
+        {
+            typename PipelineStageBase<In, void>::Item item;
+            if (!this->m_Queue.pop(item))
+                return false;
+
+            TimePoint started = TimeClock::now();
+            m_Process(item.value);
+            this->recordProcessed(item.enqueued, started, TimeClock::now());
+            return true;
+        }
+
+    private:
+        Process m_Process;
+    };
+
+    // Chain of stages fed with the video frames of any Camera. Each stage runs
+    // on its own threads and reads from a bounded queue; a full queue blocks
+    // the stage before it, up to the first stage marked dropWhenFull. The
+    // camera callback itself never blocks and drops when the first queue is full.
+    class Pipeline
+        : public Camera::Events
+    {
+    public:
+        using Frame = std::shared_ptr<PixelSampleBuffer>;
+
+        template <typename T>
+        class Builder
+        {
+        public:
+            using Connect = std::function<void(PipelineInput<T> *input)>;
+
+            Builder(Pipeline *pipeline, Connect connect)
+                : m_Pipeline(pipeline)
+                , m_Connect(connect)
+            {
+            }
+
+            template <typename F, typename Out = decltype(std::declval<F>()(std::declval<T&>()))>
+            Builder<Out> then(PipelineStageOptions const &options, F &&process)
+            {
+                PipelineStage<T, Out> *stage = new PipelineStage<T, Out>(options, std::forward<F>(process));
+                m_Pipeline->m_Nodes.emplace_back(stage);
+                m_Connect(stage);
+                return next(stage, std::is_void<Out>());
+            }
+
+        private:
+            template <typename Out>
+            Builder<Out> next(PipelineStage<T, Out> *stage, std::false_type)
+            {
+                return Builder<Out>(m_Pipeline, [stage](PipelineInput<Out> *input) { stage->setOutput(input); });
+            }
+
+            // a stage without output ends the chain
+            template <typename Out>
+            Builder<Out> next(PipelineStage<T, Out> *stage, std::true_type)
+            {
+                return Builder<Out>();
+            }
+
+        private:
+            Pipeline *m_Pipeline;
+            Connect m_Connect;
+        };
+
+        Pipeline();
+        ~Pipeline();
+
+        Builder<Frame> source();
+
+        void start();
+        void stop();
+        inline bool isRunning() const { return m_bRunning; }
+
+        void attach(Camera const &camera);
+        void detach(Camera const &camera);
+
+        inline std::uint64_t droppedAtSource() const { return m_DroppedAtSource; }
+        std::vector<PipelineStageStats> stats() const;
+
+        // Camera::Events overrides
+        void onCameraVideoFrame(std::shared_ptr<PixelSampleBuffer> const &buffer) override;
+
+    private:
+        std::vector< std::unique_ptr<PipelineNode> > m_Nodes;
+        PipelineInput<Frame> *m_Input;
+        std::atomic<bool> m_bRunning;
+        std::atomic<std::uint64_t> m_DroppedAtSource;
+    };
+
+    // end of a chain, nothing can follow a stage returning void
+    template <>
+    class Pipeline::Builder<void>
+    {
+    };
+}
@@ -9,4 +9,9 @@ namespace rpiCam
     PixelBuffer::~PixelBuffer()
     {
     }
+
+    Vec2ui PixelBuffer::paddedSize() const
+    {
+        return planeSize(0);
+    }
 }
@@ -19,5 +19,8 @@ namespace rpiCam
         virtual Vec2ui planeSize(std::size_t pi = 0) const = 0;
         virtual void* planeData(std::size_t pi = 0) = 0;
         virtual std::size_t planeRowBytes(std::size_t pi = 0) const = 0;
+
+        // allocated size of the first plane, at least planeSize(0)
+        virtual Vec2ui paddedSize() const;
     };
 }
@@ -0,0 +1,331 @@
+#include "PixelConversion.hpp"
+#include "Logging.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace rpiCam
+{
+    namespace
+    {
+        // one Y, U, V, R, G, B or A component, sample (x, y) is at data + y * rowBytes + x * pixelStride
+        struct Component
+        {
+            std::uint8_t *data;
+            std::size_t rowBytes;
+            std::size_t pixelStride;
+            std::uint32_t widthShift;
+            std::uint32_t heightShift;
+
+            inline std::uint8_t* at(std::uint32_t x, std::uint32_t y) const { return data + y * rowBytes + x * pixelStride; }
+        };
+
+        struct Layout
+        {
+            enum Kind { YUV, RGB };
+
+            Kind kind;
+            std::size_t componentCount;     // 1 for gray, 3, or 4 with alpha
+            Component components[4];        // Y U V or R G B A
+            Vec2ui size;
+        };
+
+        Component component(PixelBuffer &buffer, std::size_t pi, std::size_t offset, std::size_t pixelStride, std::uint32_t widthShift, std::uint32_t heightShift)
+        {
+            return Component{
+                static_cast<std::uint8_t*>(buffer.planeData(pi)) + offset,
+                buffer.planeRowBytes(pi),
+                pixelStride,
+                widthShift,
+                heightShift
+            };
+        }
+
+        bool describe(PixelBuffer &buffer, Layout &layout)
+        {
+            layout.size = buffer.planeSize(0);
+
+            for (std::size_t pi = 0; pi < buffer.planeCount(); ++pi)
+            {
+                if (!buffer.planeData(pi))
+                    return false;
+            }
+
+            switch(buffer.format())
+            {
+            case kPixelFormatRGB8:
+                layout.kind = Layout::RGB;
+                layout.componentCount = 3;
+                layout.components[0] = component(buffer, 0, 0, 3, 0, 0);
+                layout.components[1] = component(buffer, 0, 1, 3, 0, 0);
+                layout.components[2] = component(buffer, 0, 2, 3, 0, 0);
+                return true;
+
+            case kPixelFormatRGBA8:
+                layout.kind = Layout::RGB;
+                layout.componentCount = 4;
+                layout.components[0] = component(buffer, 0, 0, 4, 0, 0);
+                layout.components[1] = component(buffer, 0, 1, 4, 0, 0);
+                layout.components[2] = component(buffer, 0, 2, 4, 0, 0);
+                layout.components[3] = component(buffer, 0, 3, 4, 0, 0);
+                return true;
+
+            case kPixelFormatBGRA8:
+                layout.kind = Layout::RGB;
+                layout.componentCount = 4;
+                layout.components[0] = component(buffer, 0, 2, 4, 0, 0);
+                layout.components[1] = component(buffer, 0, 1, 4, 0, 0);
+                layout.components[2] = component(buffer, 0, 0, 4, 0, 0);
+                layout.components[3] = component(buffer, 0, 3, 4, 0, 0);
+                return true;
+
+            case kPixelFormatGRAY8:
+                layout.kind = Layout::YUV;
+                layout.componentCount = 1;
+                layout.components[0] = component(buffer, 0, 0, 1, 0, 0);
+                return true;
+
+            case kPixelFormatYUV420:
+            case kPixelFormatYUV422:
+                {
+                    std::uint32_t const heightShift = buffer.format() == kPixelFormatYUV420 ? 1 : 0;
+                    layout.kind = Layout::YUV;
+                    layout.componentCount = 3;
+                    layout.components[0] = component(buffer, 0, 0, 1, 0, 0);
+                    layout.components[1] = component(buffer, 1, 0, 1, 1, heightShift);
+                    layout.components[2] = component(buffer, 2, 0, 1, 1, heightShift);
+                }
+                return true;
+
+            case kPixelFormatNV12:
+            case kPixelFormatNV21:
+                {
+                    std::size_t const uOffset = buffer.format() == kPixelFormatNV12 ? 0 : 1;
+                    layout.kind = Layout::YUV;
+                    layout.componentCount = 3;
+                    layout.components[0] = component(buffer, 0, 0, 1, 0, 0);
+                    layout.components[1] = component(buffer, 1, uOffset, 2, 1, 1);
+                    layout.components[2] = component(buffer, 1, 1 - uOffset, 2, 1, 1);
+                }
+                return true;
+
+            case kPixelFormatYUYV:
+                layout.kind = Layout::YUV;
+                layout.componentCount = 3;
+                layout.components[0] = component(buffer, 0, 0, 2, 0, 0);
+                layout.components[1] = component(buffer, 0, 1, 4, 1, 0);
+                layout.components[2] = component(buffer, 0, 3, 4, 1, 0);
+                return true;
+
+            case kPixelFormatUYVY:
+                layout.kind = Layout::YUV;
+                layout.componentCount = 3;
+                layout.components[0] = component(buffer, 0, 1, 2, 0, 0);
+                layout.components[1] = component(buffer, 0, 0, 4, 1, 0);
+                layout.components[2] = component(buffer, 0, 2, 4, 1, 0);
+                return true;
+
+            default:
+                return false;
+            }
+        }
+
+        void fillComponent(Component const &dst, Vec2ui const &size, std::uint8_t value)
+        {
+            std::uint32_t const width = size(0) >> dst.widthShift;
+            std::uint32_t const height = size(1) >> dst.heightShift;
+            for (std::uint32_t y = 0; y < height; ++y)
+            {
+                std::uint8_t *d = dst.at(0, y);
+                if (dst.pixelStride == 1)
+                    std::memset(d, value, width);
+                else
+                    for (std::uint32_t x = 0; x < width; ++x, d += dst.pixelStride)
+                        *d = value;
+            }
+        }
+
+        // resamples one component, averaging the source samples covering each destination sample
+        void convertComponent(Component const &src, Component const &dst, Vec2ui const &size)
+        {
+            std::uint32_t const width = size(0) >> dst.widthShift;
+            std::uint32_t const height = size(1) >> dst.heightShift;
+            std::uint32_t const srcWidth = std::max<std::uint32_t>(size(0) >> src.widthShift, 1);
+            std::uint32_t const srcHeight = std::max<std::uint32_t>(size(1) >> src.heightShift, 1);
+
+            if (src.widthShift == dst.widthShift && src.heightShift == dst.heightShift)
+            {
+                for (std::uint32_t y = 0; y < height; ++y)
+                {
+                    std::uint8_t const *s = src.at(0, y);
+                    std::uint8_t *d = dst.at(0, y);
+                    if (src.pixelStride == 1 && dst.pixelStride == 1)
+                        std::memcpy(d, s, width);
+                    else
+                        for (std::uint32_t x = 0; x < width; ++x, s += src.pixelStride, d += dst.pixelStride)
+                            *d = *s;
+                }
+                return;
+            }
+
+            for (std::uint32_t y = 0; y < height; ++y)
+            {
+                std::uint32_t const y0 = (y << dst.heightShift) >> src.heightShift;
+                std::uint32_t const y1 = std::min(((((y + 1) << dst.heightShift) - 1) >> src.heightShift), srcHeight - 1);
+
+                std::uint8_t *d = dst.at(0, y);
+                for (std::uint32_t x = 0; x < width; ++x, d += dst.pixelStride)
+                {
+                    std::uint32_t const x0 = (x << dst.widthShift) >> src.widthShift;
+                    std::uint32_t const x1 = std::min(((((x + 1) << dst.widthShift) - 1) >> src.widthShift), srcWidth - 1);
+
+                    std::uint32_t sum = 0;
+                    for (std::uint32_t sy = y0; sy <= y1; ++sy)
+                        for (std::uint32_t sx = x0; sx <= x1; ++sx)
+                            sum += *src.at(sx, sy);
+
+                    std::uint32_t const count = (y1 - y0 + 1) * (x1 - x0 + 1);
+                    *d = std::uint8_t((sum + count / 2) / count);
+                }
+            }
+        }
+
+        inline std::uint8_t clampToByte(std::int32_t value)
+        {
+            return std::uint8_t(std::min(std::max(value, 0), 255));
+        }
+
+        // full range BT.601, 16 bit fixed point
+        void convertYUVToRGB(Layout const &src, Layout const &dst)
+        {
+            Component const &sy = src.components[0];
+            for (std::uint32_t y = 0; y < src.size(1); ++y)
+            {
+                for (std::uint32_t x = 0; x < src.size(0); ++x)
+                {
+                    std::int32_t const Y = *sy.at(x, y) << 16;
+                    std::int32_t U = 0, V = 0;
+                    if (src.componentCount == 3)
+                    {
+                        U = std::int32_t(*src.components[1].at(x >> src.components[1].widthShift, y >> src.components[1].heightShift)) - 128;
+                        V = std::int32_t(*src.components[2].at(x >> src.components[2].widthShift, y >> src.components[2].heightShift)) - 128;
+                    }
+
+                    *dst.components[0].at(x, y) = clampToByte((Y + 91881 * V + 32768) >> 16);
+                    *dst.components[1].at(x, y) = clampToByte((Y - 22554 * U - 46802 * V + 32768) >> 16);
+                    *dst.components[2].at(x, y) = clampToByte((Y + 116130 * U + 32768) >> 16);
+                    if (dst.componentCount == 4)
+                        *dst.components[3].at(x, y) = 255;
+                }
+            }
+        }
+
+        void convertRGBToYUV(Layout const &src, Layout const &dst)
+        {
+            Component const &dy = dst.components[0];
+            for (std::uint32_t y = 0; y < src.size(1); ++y)
+            {
+                for (std::uint32_t x = 0; x < src.size(0); ++x)
+                {
+                    std::int32_t const R = *src.components[0].at(x, y);
+                    std::int32_t const G = *src.components[1].at(x, y);
+                    std::int32_t const B = *src.components[2].at(x, y);
+                    *dy.at(x, y) = clampToByte((19595 * R + 38470 * G + 7471 * B + 32768) >> 16);
+                }
+            }
+
+            if (dst.componentCount != 3)
+                return;
+
+            Component const &du = dst.components[1];
+            Component const &dv = dst.components[2];
+            std::uint32_t const width = src.size(0) >> du.widthShift;
+            std::uint32_t const height = src.size(1) >> du.heightShift;
+            std::uint32_t const bw = 1u << du.widthShift;
+            std::uint32_t const bh = 1u << du.heightShift;
+
+            for (std::uint32_t y = 0; y < height; ++y)
+            {
+                for (std::uint32_t x = 0; x < width; ++x)
+                {
+                    std::int32_t R = 0, G = 0, B = 0;
+                    for (std::uint32_t by = 0; by < bh; ++by)
+                    {
+                        for (std::uint32_t bx = 0; bx < bw; ++bx)
+                        {
+                            R += *src.components[0].at(x * bw + bx, y * bh + by);
+                            G += *src.components[1].at(x * bw + bx, y * bh + by);
+                            B += *src.components[2].at(x * bw + bx, y * bh + by);
+                        }
+                    }
+
+                    std::int32_t const count = bw * bh;
+                    R /= count; G /= count; B /= count;
+
+                    *du.at(x, y) = clampToByte(((-11059 * R - 21709 * G + 32768 * B + 32768) >> 16) + 128);
+                    *dv.at(x, y) = clampToByte(((32768 * R - 27439 * G - 5329 * B + 32768) >> 16) + 128);
+                }
+            }
+        }
+    }
+
+    std::error_code convertPixelBuffer(PixelBuffer &src, PixelBuffer &dst)
+    {
+        if (!src.isValid() || !dst.isValid())
+            return std::make_error_code(std::errc::invalid_argument);
+
+        if (src.planeSize(0) != dst.planeSize(0))
+        {
+            RPI_LOG(WARNING, "convertPixelBuffer(): buffer sizes differ!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        Layout srcLayout, dstLayout;
+        if (!describe(src, srcLayout) || !describe(dst, dstLayout))
+        {
+            RPI_LOG(WARNING, "convertPixelBuffer(): unsupported format or buffer not locked!");
+            return std::make_error_code(std::errc::not_supported);
+        }
+
+        if (srcLayout.kind == Layout::YUV && dstLayout.kind == Layout::YUV)
+        {
+            convertComponent(srcLayout.components[0], dstLayout.components[0], srcLayout.size);
+            for (std::size_t ic = 1; ic < dstLayout.componentCount; ++ic)
+            {
+                if (srcLayout.componentCount == 3)
+                    convertComponent(srcLayout.components[ic], dstLayout.components[ic], srcLayout.size);
+                else
+                    fillComponent(dstLayout.components[ic], srcLayout.size, 128);
+            }
+        }
+        else
+        if (srcLayout.kind == Layout::RGB && dstLayout.kind == Layout::RGB)
+        {
+            for (std::size_t ic = 0; ic < 3; ++ic)
+                convertComponent(srcLayout.components[ic], dstLayout.components[ic], srcLayout.size);
+
+            if (dstLayout.componentCount == 4)
+            {
+                if (srcLayout.componentCount == 4)
+                    convertComponent(srcLayout.components[3], dstLayout.components[3], srcLayout.size);
+                else
+                    fillComponent(dstLayout.components[3], srcLayout.size, 255);
+            }
+        }
+        else
+        if (srcLayout.kind == Layout::YUV)
+            convertYUVToRGB(srcLayout, dstLayout);
+        else
+            convertRGBToYUV(srcLayout, dstLayout);
+
+        return std::error_code();
+    }
+
+    std::shared_ptr<MemoryPixelSampleBuffer> convertPixelBuffer(PixelBuffer &src, ePixelFormat format)
+    {
+        std::shared_ptr<MemoryPixelSampleBuffer> dst = std::make_shared<MemoryPixelSampleBuffer>(format, src.planeSize(0));
+        if (convertPixelBuffer(src, *dst))
+            return std::shared_ptr<MemoryPixelSampleBuffer>();
+
+        return dst;
+    }
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "Config.hpp"
+#include "PixelBuffer.hpp"
+#include "MemoryPixelSampleBuffer.hpp"
+#include <system_error>
+
+namespace rpiCam
+{
+    // Converts between any two pixel formats. Both buffers must be locked and
+    // have the same size. YUV uses full range BT.601 as produced by the camera;
+    // chroma is averaged when subsampling and replicated when upsampling.
+    std::error_code convertPixelBuffer(PixelBuffer &src, PixelBuffer &dst);
+
+    // returns nullptr when the conversion is not possible
+    std::shared_ptr<MemoryPixelSampleBuffer> convertPixelBuffer(PixelBuffer &src, ePixelFormat format);
+}
@@ -9,6 +9,50 @@ namespace rpiCam
         kPixelFormatInvalid=0,
         kPixelFormatRGB8,
         kPixelFormatYUV420,
+        kPixelFormatNV12,
+        kPixelFormatNV21,
+        kPixelFormatYUYV,
+        kPixelFormatUYVY,
+        kPixelFormatRGBA8,
+        kPixelFormatBGRA8,
+        kPixelFormatGRAY8,
+        kPixelFormatYUV422,
         kPixelFormatMax
     } ePixelFormat;
+
+    // camera buffers are allocated with VCOS_ALIGN_UP(width, 32) x VCOS_ALIGN_UP(height, 16)
+    static constexpr std::uint32_t kPixelBufferWidthAlignment = 32;
+    static constexpr std::uint32_t kPixelBufferHeightAlignment = 16;
+
+    // packed 4:2:2 formats are described as one plane of 2 bytes per pixel;
+    // blockWidth x blockHeight is the smallest pixel block every plane can address
+    struct PixelFormatDescriptor
+    {
+        static constexpr std::size_t kMaxPlanes = 4;
+
+        std::size_t planeCount;
+        std::size_t bytesPerPixel[kMaxPlanes];
+        std::uint32_t widthShift[kMaxPlanes];
+        std::uint32_t heightShift[kMaxPlanes];
+        std::uint32_t blockWidth;
+        std::uint32_t blockHeight;
+    };
+
+    inline constexpr PixelFormatDescriptor pixelFormatDescriptor(ePixelFormat format)
+    {
+        switch(format)
+        {
+        case kPixelFormatRGB8:      return PixelFormatDescriptor{1, {3, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}, 1, 1};
+        case kPixelFormatYUV420:    return PixelFormatDescriptor{3, {1, 1, 1, 0}, {0, 1, 1, 0}, {0, 1, 1, 0}, 2, 2};
+        case kPixelFormatNV12:      return PixelFormatDescriptor{2, {1, 2, 0, 0}, {0, 1, 0, 0}, {0, 1, 0, 0}, 2, 2};
+        case kPixelFormatNV21:      return PixelFormatDescriptor{2, {1, 2, 0, 0}, {0, 1, 0, 0}, {0, 1, 0, 0}, 2, 2};
+        case kPixelFormatYUYV:      return PixelFormatDescriptor{1, {2, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}, 2, 1};
+        case kPixelFormatUYVY:      return PixelFormatDescriptor{1, {2, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}, 2, 1};
+        case kPixelFormatRGBA8:     return PixelFormatDescriptor{1, {4, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}, 1, 1};
+        case kPixelFormatBGRA8:     return PixelFormatDescriptor{1, {4, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}, 1, 1};
+        case kPixelFormatGRAY8:     return PixelFormatDescriptor{1, {1, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}, 1, 1};
+        case kPixelFormatYUV422:    return PixelFormatDescriptor{3, {1, 1, 1, 0}, {0, 1, 1, 0}, {0, 0, 0, 0}, 2, 1};
+        default:                    return PixelFormatDescriptor{0, {0, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}, 1, 1};
+        }
+    }
 }
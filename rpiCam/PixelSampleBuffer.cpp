@@ -1,4 +1,5 @@
 #include "PixelSampleBuffer.hpp"
+#include "ImagePyramid.hpp"
 
 namespace rpiCam
 {
@@ -6,10 +7,69 @@ namespace rpiCam
         : Buffer()
         , PixelBuffer()
         , SampleBuffer()
+        , m_PyramidOnce()
+        , m_Pyramid()
+        , m_StatisticsMutex()
+        , m_Statistics()
+        , m_FeaturesMutex()
+        , m_Features()
     {
     }
 
     PixelSampleBuffer::~PixelSampleBuffer()
     {
     }
+
+    ImagePyramid& PixelSampleBuffer::pyramid()
+    {
+        std::call_once(m_PyramidOnce, [this]() { m_Pyramid.reset(new ImagePyramid(*this)); });
+        return *m_Pyramid;
+    }
+
+    std::shared_ptr<FrameStatistics const> PixelSampleBuffer::statistics(FrameStatisticsOptions const &options)
+    {
+        // held while computing so concurrent requests for the same options wait and share the result
+        std::lock_guard<std::mutex> lock(m_StatisticsMutex);
+        for (auto const &statistics : m_Statistics)
+        {
+            if (statistics->options == options)
+                return statistics;
+        }
+
+        if (this->lock())
+            return std::shared_ptr<FrameStatistics const>();
+
+        std::shared_ptr<FrameStatistics> statistics = std::make_shared<FrameStatistics>();
+        std::error_code const ec = computeFrameStatistics(*this, options, *statistics);
+        unlock();
+
+        if (ec)
+            return std::shared_ptr<FrameStatistics const>();
+
+        m_Statistics.push_back(statistics);
+        return statistics;
+    }
+
+    std::shared_ptr<FeatureSet const> PixelSampleBuffer::features(FeatureOptions const &options)
+    {
+        std::lock_guard<std::mutex> lock(m_FeaturesMutex);
+        for (auto const &features : m_Features)
+        {
+            if (features->options == options)
+                return features;
+        }
+        return std::shared_ptr<FeatureSet const>();
+    }
+
+    std::shared_ptr<FeatureSet const> PixelSampleBuffer::attachFeatures(std::shared_ptr<FeatureSet const> const &features)
+    {
+        std::lock_guard<std::mutex> lock(m_FeaturesMutex);
+        for (auto const &attached : m_Features)
+        {
+            if (attached->options == features->options)
+                return attached;
+        }
+        m_Features.push_back(features);
+        return features;
+    }
 }
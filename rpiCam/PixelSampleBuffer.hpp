@@ -3,9 +3,14 @@
 #include "Config.hpp"
 #include "PixelBuffer.hpp"
 #include "SampleBuffer.hpp"
+#include "FrameStatistics.hpp"
+#include "Features.hpp"
+#include <vector>
 
 namespace rpiCam
 {
+    class ImagePyramid;
+
     class PixelSampleBuffer
         : public PixelBuffer
         , public SampleBuffer
@@ -13,5 +18,26 @@ namespace rpiCam
     public:
         PixelSampleBuffer();
         virtual ~PixelSampleBuffer();
+
+        // created on first use and released with the frame, safe to call from any subscriber thread
+        ImagePyramid& pyramid();
+
+        // computed on first request for each distinct options and shared by
+        // every subscriber, nullptr when the format is not supported
+        std::shared_ptr<FrameStatistics const> statistics(FrameStatisticsOptions const &options = FrameStatisticsOptions());
+
+        // keypoints attached by FeatureDetector::detect(), one set per distinct options, nullptr when there is none
+        std::shared_ptr<FeatureSet const> features(FeatureOptions const &options);
+
+        // attaches features unless a set with the same options already is, returns the attached set
+        std::shared_ptr<FeatureSet const> attachFeatures(std::shared_ptr<FeatureSet const> const &features);
+
+    private:
+        std::once_flag m_PyramidOnce;
+        std::unique_ptr<ImagePyramid> m_Pyramid;
+        std::mutex m_StatisticsMutex;
+        std::vector< std::shared_ptr<FrameStatistics const> > m_Statistics;
+        std::mutex m_FeaturesMutex;
+        std::vector< std::shared_ptr<FeatureSet const> > m_Features;
     };
 }
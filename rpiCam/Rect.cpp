@@ -0,0 +1,50 @@
+#include "Rect.hpp"
+#include <algorithm>
+
+namespace rpiCam
+{
+    Rect::Rect()
+        : origin(0, 0)
+        , size(0, 0)
+    {
+    }
+
+    Rect::Rect(Vec2ui const &o, Vec2ui const &sz)
+        : origin(o)
+        , size(sz)
+    {
+    }
+
+    Rect::Rect(std::uint32_t x, std::uint32_t y, std::uint32_t width, std::uint32_t height)
+        : origin(x, y)
+        , size(width, height)
+    {
+    }
+
+    Rect Rect::intersected(Rect const &that) const
+    {
+        Vec2ui const o = origin.cwiseMax(that.origin);
+        Vec2ui const e = end().cwiseMin(that.end());
+        if (e(0) <= o(0) || e(1) <= o(1))
+            return Rect();
+
+        return Rect(o, e - o);
+    }
+
+    Rect Rect::aligned(Vec2ui const &block, Vec2ui const &bounds) const
+    {
+        Rect clipped = intersected(Rect(Vec2ui(0, 0), bounds));
+        if (clipped.isEmpty())
+            return Rect();
+
+        Vec2ui o, e;
+        for (int ic = 0; ic < 2; ++ic)
+        {
+            o(ic) = clipped.origin(ic) - clipped.origin(ic) % block(ic);
+            e(ic) = std::min((clipped.end()(ic) + block(ic) - 1) / block(ic) * block(ic), bounds(ic) - bounds(ic) % block(ic));
+            if (e(ic) <= o(ic))
+                return Rect();
+        }
+        return Rect(o, e - o);
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Config.hpp"
+
+namespace rpiCam
+{
+    class Rect
+    {
+    public:
+        Rect();
+        Rect(Vec2ui const &o, Vec2ui const &sz);
+        Rect(std::uint32_t x, std::uint32_t y, std::uint32_t width, std::uint32_t height);
+
+        inline bool isEmpty() const { return size(0) == 0 || size(1) == 0; }
+        inline Vec2ui end() const { return origin + size; }
+
+        inline bool contains(Vec2ui const &p) const
+        {
+            return p(0) >= origin(0) && p(1) >= origin(1) && p(0) < origin(0) + size(0) && p(1) < origin(1) + size(1);
+        }
+
+        inline bool operator ==(Rect const &rhs) const { return origin == rhs.origin && size == rhs.size; }
+        inline bool operator !=(Rect const &rhs) const { return !(*this == rhs); }
+
+        Rect intersected(Rect const &that) const;
+
+        // grows the rect outwards to multiples of block, then clips to bounds
+        Rect aligned(Vec2ui const &block, Vec2ui const &bounds) const;
+
+        Vec2ui origin;
+        Vec2ui size;
+    };
+}
@@ -3,6 +3,8 @@
 namespace rpiCam
 {
     SampleBuffer::SampleBuffer()
+        : time()
+        , sequence(0)
     {
     }
 
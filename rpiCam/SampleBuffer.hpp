@@ -16,5 +16,6 @@ namespace rpiCam
         virtual std::error_code unlock() = 0;
 
         TimePoint time;
+        std::uint64_t sequence;
     };
 }
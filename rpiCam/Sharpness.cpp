@@ -0,0 +1,201 @@
+#include "Sharpness.hpp"
+#include "Simd.hpp"
+#include "Logging.hpp"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace rpiCam
+{
+    namespace
+    {
+        // 32 bit lanes of squares are flushed before they can overflow, a lane
+        // adds up to 4 * 1020^2 for every 8 pixels
+        static constexpr std::uint32_t kMaxChunk = 4096;
+
+        struct Sums
+        {
+            std::int64_t laplacian;
+            std::uint64_t laplacian2;
+            std::uint64_t gradient2;
+        };
+
+        // x in [begin, end) of row c, with rows u above and d below
+        void measureRow(std::uint8_t const *u, std::uint8_t const *c, std::uint8_t const *d,
+            std::uint32_t begin, std::uint32_t end, Sums &sums, bool bSimd)
+        {
+            std::uint32_t x = begin;
+#if defined(RPI_CAM_SIMD_NEON)
+            if (bSimd)
+            {
+                while (x + 8 <= end)
+                {
+                    std::uint32_t const chunkEnd = std::min(end, x + kMaxChunk);
+                    int32x4_t sumL = vdupq_n_s32(0);
+                    int32x4_t sumL2 = vdupq_n_s32(0);
+                    int32x4_t sumG2 = vdupq_n_s32(0);
+                    for (; x + 8 <= chunkEnd; x += 8)
+                    {
+                        int16x8_t const ul = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(u + x - 1)));
+                        int16x8_t const uc = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(u + x)));
+                        int16x8_t const ur = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(u + x + 1)));
+                        int16x8_t const cl = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(c + x - 1)));
+                        int16x8_t const cc = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(c + x)));
+                        int16x8_t const cr = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(c + x + 1)));
+                        int16x8_t const dl = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(d + x - 1)));
+                        int16x8_t const dc = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(d + x)));
+                        int16x8_t const dr = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(d + x + 1)));
+
+                        int16x8_t const l = vsubq_s16(vaddq_s16(vaddq_s16(uc, dc), vaddq_s16(cl, cr)), vshlq_n_s16(cc, 2));
+                        int16x8_t const gx = vaddq_s16(vaddq_s16(vsubq_s16(ur, ul), vsubq_s16(dr, dl)), vshlq_n_s16(vsubq_s16(cr, cl), 1));
+                        int16x8_t const gy = vaddq_s16(vaddq_s16(vsubq_s16(dl, ul), vsubq_s16(dr, ur)), vshlq_n_s16(vsubq_s16(dc, uc), 1));
+
+                        sumL = vpadalq_s16(sumL, l);
+                        sumL2 = vmlal_s16(vmlal_s16(sumL2, vget_low_s16(l), vget_low_s16(l)), vget_high_s16(l), vget_high_s16(l));
+                        sumG2 = vmlal_s16(vmlal_s16(sumG2, vget_low_s16(gx), vget_low_s16(gx)), vget_high_s16(gx), vget_high_s16(gx));
+                        sumG2 = vmlal_s16(vmlal_s16(sumG2, vget_low_s16(gy), vget_low_s16(gy)), vget_high_s16(gy), vget_high_s16(gy));
+                    }
+
+                    // the squares fill all 32 bits, they are read back unsigned
+                    std::int32_t l[4];
+                    std::uint32_t l2[4], g2[4];
+                    vst1q_s32(l, sumL);
+                    vst1q_u32(l2, vreinterpretq_u32_s32(sumL2));
+                    vst1q_u32(g2, vreinterpretq_u32_s32(sumG2));
+                    for (int i = 0; i < 4; ++i)
+                    {
+                        sums.laplacian += l[i];
+                        sums.laplacian2 += l2[i];
+                        sums.gradient2 += g2[i];
+                    }
+                }
+            }
+#elif defined(RPI_CAM_SIMD_SSE2)
+            if (bSimd)
+            {
+                __m128i const zero = _mm_setzero_si128();
+                __m128i const ones = _mm_set1_epi16(1);
+                auto load = [&zero](std::uint8_t const *p) { return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(p)), zero); };
+                while (x + 8 <= end)
+                {
+                    std::uint32_t const chunkEnd = std::min(end, x + kMaxChunk);
+                    __m128i sumL = _mm_setzero_si128();
+                    __m128i sumL2 = _mm_setzero_si128();
+                    __m128i sumG2 = _mm_setzero_si128();
+                    for (; x + 8 <= chunkEnd; x += 8)
+                    {
+                        __m128i const ul = load(u + x - 1), uc = load(u + x), ur = load(u + x + 1);
+                        __m128i const cl = load(c + x - 1), cc = load(c + x), cr = load(c + x + 1);
+                        __m128i const dl = load(d + x - 1), dc = load(d + x), dr = load(d + x + 1);
+
+                        __m128i const l = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(uc, dc), _mm_add_epi16(cl, cr)), _mm_slli_epi16(cc, 2));
+                        __m128i const gx = _mm_add_epi16(_mm_add_epi16(_mm_sub_epi16(ur, ul), _mm_sub_epi16(dr, dl)), _mm_slli_epi16(_mm_sub_epi16(cr, cl), 1));
+                        __m128i const gy = _mm_add_epi16(_mm_add_epi16(_mm_sub_epi16(dl, ul), _mm_sub_epi16(dr, ur)), _mm_slli_epi16(_mm_sub_epi16(dc, uc), 1));
+
+                        sumL = _mm_add_epi32(sumL, _mm_madd_epi16(l, ones));
+                        sumL2 = _mm_add_epi32(sumL2, _mm_madd_epi16(l, l));
+                        sumG2 = _mm_add_epi32(sumG2, _mm_add_epi32(_mm_madd_epi16(gx, gx), _mm_madd_epi16(gy, gy)));
+                    }
+
+                    // the squares fill all 32 bits, they are read back unsigned
+                    std::int32_t l[4];
+                    std::uint32_t l2[4], g2[4];
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(l), sumL);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(l2), sumL2);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(g2), sumG2);
+                    for (int i = 0; i < 4; ++i)
+                    {
+                        sums.laplacian += l[i];
+                        sums.laplacian2 += l2[i];
+                        sums.gradient2 += g2[i];
+                    }
+                }
+            }
+#else
+            (void)bSimd;
+#endif
+            for (; x < end; ++x)
+            {
+                std::int32_t const l = u[x] + d[x] + c[x - 1] + c[x + 1] - 4 * c[x];
+                std::int32_t const gx = (u[x + 1] - u[x - 1]) + (d[x + 1] - d[x - 1]) + 2 * (c[x + 1] - c[x - 1]);
+                std::int32_t const gy = (d[x - 1] - u[x - 1]) + (d[x + 1] - u[x + 1]) + 2 * (d[x] - u[x]);
+                sums.laplacian += l;
+                sums.laplacian2 += std::uint32_t(l * l);
+                sums.gradient2 += std::uint32_t(gx * gx + gy * gy);
+            }
+        }
+    }
+
+    Sharpness::Sharpness()
+        : laplacianVariance(0.0f)
+        , tenengrad(0.0f)
+        , count(0)
+    {
+    }
+
+    std::error_code computeSharpness(PixelBuffer &buffer, std::size_t pi, Rect const &roi, Sharpness &sharpness, bool bSimd)
+    {
+        sharpness = Sharpness();
+
+        if (pi >= buffer.planeCount() || pixelFormatDescriptor(buffer.format()).bytesPerPixel[pi] != 1)
+        {
+            RPI_LOG(ERROR, "computeSharpness(): plane is not one byte per pixel!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        std::uint8_t const *data = static_cast<std::uint8_t const*>(buffer.planeData(pi));
+        if (!data)
+        {
+            RPI_LOG(ERROR, "computeSharpness(): buffer not locked!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        Vec2ui const size = buffer.planeSize(pi);
+        std::size_t const rowBytes = buffer.planeRowBytes(pi);
+        if (size(0) < 3 || size(1) < 3)
+            return std::error_code();
+
+        Rect const interior(1, 1, size(0) - 2, size(1) - 2);
+        Rect const area = roi.isEmpty() ? interior : roi.intersected(interior);
+        if (area.isEmpty())
+            return std::error_code();
+
+        Sums sums{0, 0, 0};
+        for (std::uint32_t y = area.origin(1); y < area.end()(1); ++y)
+        {
+            std::uint8_t const *c = data + y * rowBytes;
+            measureRow(c - rowBytes, c, c + rowBytes, area.origin(0), area.end()(0), sums, bSimd);
+        }
+
+        double const n = double(area.size(0)) * area.size(1);
+        double const mean = double(sums.laplacian) / n;
+        sharpness.laplacianVariance = float(std::max(0.0, double(sums.laplacian2) / n - mean * mean));
+        sharpness.tenengrad = float(double(sums.gradient2) / n);
+        sharpness.count = std::uint64_t(area.size(0)) * area.size(1);
+        return std::error_code();
+    }
+
+    std::istream& operator>>(std::istream &s, SharpnessMetric &v)
+    {
+        std::string sv;
+        s >> sv;
+        if (sv == "LaplacianVariance")
+            v = SharpnessMetric::LaplacianVariance;
+        else if (sv == "Tenengrad")
+            v = SharpnessMetric::Tenengrad;
+        else
+            throw std::invalid_argument("Invalid value for SharpnessMetric: " + sv);
+        return s;
+    }
+
+    std::ostream& operator<<(std::ostream &s, SharpnessMetric v)
+    {
+        switch(v)
+        {
+        case SharpnessMetric::LaplacianVariance:    s << "LaplacianVariance";   break;
+        case SharpnessMetric::Tenengrad:            s << "Tenengrad";           break;
+        }
+        return s;
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Config.hpp"
+#include "PixelBuffer.hpp"
+#include "Rect.hpp"
+#include <system_error>
+
+namespace rpiCam
+{
+    enum class SharpnessMetric : int
+    {
+        LaplacianVariance,
+        Tenengrad
+    };
+
+    class Sharpness
+    {
+    public:
+        Sharpness();
+
+        inline float value(SharpnessMetric metric) const
+        {
+            return metric == SharpnessMetric::Tenengrad ? tenengrad : laplacianVariance;
+        }
+
+        float laplacianVariance;    // variance of the four neighbour Laplacian
+        float tenengrad;            // mean of gx^2 + gy^2 of the Sobel gradient
+        std::uint64_t count;        // pixels measured
+    };
+
+    // Both metrics in one pass over a one byte per pixel plane of the locked
+    // buffer. Pixels of roi with all eight neighbours inside the plane are
+    // measured, an empty roi is the whole plane. Sums are kept exact.
+    std::error_code computeSharpness(PixelBuffer &buffer, std::size_t pi, Rect const &roi, Sharpness &sharpness, bool bSimd = true);
+
+    extern std::istream& operator>>(std::istream &s, SharpnessMetric &v);
+    extern std::ostream& operator<<(std::ostream &s, SharpnessMetric v);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "Config.hpp"
+
+// selects the vector instruction set kernels are compiled for, every kernel
+// keeps a scalar path for the remaining targets and for comparison. Both
+// paths of a kernel give exactly the same output.
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define RPI_CAM_SIMD_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define RPI_CAM_SIMD_SSE2 1
+#endif
+
+#if defined(RPI_CAM_SIMD_NEON) || defined(RPI_CAM_SIMD_SSE2)
+#define RPI_CAM_SIMD 1
+#endif
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "Config.hpp"
+#include "Simd.hpp"
+#include <cstring>
+
+// Vector bilinear sampling shared by the remappers. The two taps of a
+// source row are gathered with one load per pixel and blended in
+// registers, with weights of WeightBits fractional bits. Results round
+// like the scalar ((l * (1 - fx) + r * fx) * (1 - fy) + ...) >> 2 * WeightBits.
+#if defined(RPI_CAM_SIMD)
+namespace rpiCam
+{
+#if defined(RPI_CAM_SIMD_NEON)
+    using BilinearLanes = uint16x8_t;
+#else
+    using BilinearLanes = __m128i;
+#endif
+
+    // the left and right taps of a source row of 2 to 4 channel pixels, 2 * Channels bytes
+    template <std::size_t Channels>
+    inline std::uint64_t loadBilinearTaps(std::uint8_t const *p)
+    {
+        std::uint32_t low;
+        std::memcpy(&low, p, 4);
+        if (Channels == 2)
+            return low;
+
+        std::uint16_t middle;
+        std::memcpy(&middle, p + 4, 2);
+        if (Channels == 3)
+            return low | std::uint64_t(middle) << 32;
+
+        std::uint16_t high;
+        std::memcpy(&high, p + 6, 2);
+        return low | std::uint64_t(middle) << 32 | std::uint64_t(high) << 48;
+    }
+
+    // Eight blends of the taps a b over c d. The horizontal pass fits 16
+    // bits, the vertical one too up to Q4 weights and is widened to 32
+    // bits above.
+    template <std::int32_t WeightBits>
+    inline BilinearLanes bilinearBlend(BilinearLanes a, BilinearLanes b, BilinearLanes c, BilinearLanes d, BilinearLanes wx, BilinearLanes wy)
+    {
+        static_assert(WeightBits > 0 && WeightBits <= 7, "the horizontal pass has to fit 16 bits");
+        static constexpr bool kNarrow = 2 * WeightBits + 8 <= 16;
+#if defined(RPI_CAM_SIMD_NEON)
+        uint16x8_t const one = vdupq_n_u16(1 << WeightBits);
+        uint16x8_t const ifx = vsubq_u16(one, wx), ify = vsubq_u16(one, wy);
+        uint16x8_t const upper = vmlaq_u16(vmulq_u16(a, ifx), b, wx);
+        uint16x8_t const lower = vmlaq_u16(vmulq_u16(c, ifx), d, wx);
+        if (kNarrow)
+            return vrshrq_n_u16(vmlaq_u16(vmulq_u16(upper, ify), lower, wy), 2 * WeightBits);
+
+        uint32x4_t const low = vmlal_u16(vmull_u16(vget_low_u16(upper), vget_low_u16(ify)), vget_low_u16(lower), vget_low_u16(wy));
+        uint32x4_t const high = vmlal_u16(vmull_u16(vget_high_u16(upper), vget_high_u16(ify)), vget_high_u16(lower), vget_high_u16(wy));
+        return vcombine_u16(vrshrn_n_u32(low, 2 * WeightBits), vrshrn_n_u32(high, 2 * WeightBits));
+#else
+        __m128i const one = _mm_set1_epi16(1 << WeightBits);
+        __m128i const ifx = _mm_sub_epi16(one, wx), ify = _mm_sub_epi16(one, wy);
+        __m128i const upper = _mm_add_epi16(_mm_mullo_epi16(a, ifx), _mm_mullo_epi16(b, wx));
+        __m128i const lower = _mm_add_epi16(_mm_mullo_epi16(c, ifx), _mm_mullo_epi16(d, wx));
+        if (kNarrow)
+        {
+            __m128i const v = _mm_add_epi16(_mm_mullo_epi16(upper, ify), _mm_mullo_epi16(lower, wy));
+            return _mm_srli_epi16(_mm_add_epi16(v, _mm_set1_epi16(1 << (2 * WeightBits - 1))), 2 * WeightBits);
+        }
+
+        __m128i const round = _mm_set1_epi32(1 << (2 * WeightBits - 1));
+        __m128i low = _mm_madd_epi16(_mm_unpacklo_epi16(upper, lower), _mm_unpacklo_epi16(ify, wy));
+        __m128i high = _mm_madd_epi16(_mm_unpackhi_epi16(upper, lower), _mm_unpackhi_epi16(ify, wy));
+        low = _mm_srai_epi32(_mm_add_epi32(low, round), 2 * WeightBits);
+        high = _mm_srai_epi32(_mm_add_epi32(high, round), 2 * WeightBits);
+        return _mm_packs_epi32(low, high);
+#endif
+    }
+
+    // Eight single channel pixels into dst. The two taps of a source row
+    // of a pixel are a little endian 16 bit word of top or bottom, the
+    // left one in the low byte.
+    template <std::int32_t WeightBits>
+    inline void bilinearBlock(std::uint16_t const *top, std::uint16_t const *bottom, BilinearLanes wx, BilinearLanes wy, std::uint8_t *dst)
+    {
+#if defined(RPI_CAM_SIMD_NEON)
+        uint16x8_t const low = vdupq_n_u16(0xff);
+        uint16x8_t const t = vld1q_u16(top), b = vld1q_u16(bottom);
+        uint16x8_t const v = bilinearBlend<WeightBits>(vandq_u16(t, low), vshrq_n_u16(t, 8), vandq_u16(b, low), vshrq_n_u16(b, 8), wx, wy);
+        vst1_u8(dst, vmovn_u16(v));
+#else
+        __m128i const low = _mm_set1_epi16(0xff);
+        __m128i const t = _mm_loadu_si128(reinterpret_cast<__m128i const*>(top));
+        __m128i const b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(bottom));
+        __m128i const v = bilinearBlend<WeightBits>(_mm_and_si128(t, low), _mm_srli_epi16(t, 8), _mm_and_si128(b, low), _mm_srli_epi16(b, 8), wx, wy);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(v, v));
+#endif
+    }
+
+    // Two pixels of 2 to 4 channels from the loadBilinearTaps() of their
+    // top and bottom source rows, four lanes each: the first pixel comes
+    // out in the low and the second in the high 32 bits
+    template <std::size_t Channels, std::int32_t WeightBits>
+    inline std::uint64_t bilinearPair(std::uint64_t top0, std::uint64_t bottom0, std::uint32_t fx0, std::uint32_t fy0,
+        std::uint64_t top1, std::uint64_t bottom1, std::uint32_t fx1, std::uint32_t fy1)
+    {
+        static constexpr std::uint64_t kLanes = 0x0001000100010001ull;
+        auto left = [](std::uint64_t v0, std::uint64_t v1) { return (v0 & 0xffffffff) | (v1 << 32); };
+        auto right = [](std::uint64_t v0, std::uint64_t v1) { return ((v0 >> (8 * Channels)) & 0xffffffff) | ((v1 >> (8 * Channels)) << 32); };
+
+        std::uint64_t pixels;
+#if defined(RPI_CAM_SIMD_NEON)
+        auto widen = [](std::uint64_t v) { return vmovl_u8(vcreate_u8(v)); };
+        uint16x8_t const v = bilinearBlend<WeightBits>(widen(left(top0, top1)), widen(right(top0, top1)), widen(left(bottom0, bottom1)), widen(right(bottom0, bottom1)),
+            vcombine_u16(vcreate_u16(fx0 * kLanes), vcreate_u16(fx1 * kLanes)), vcombine_u16(vcreate_u16(fy0 * kLanes), vcreate_u16(fy1 * kLanes)));
+        pixels = vget_lane_u64(vreinterpret_u64_u8(vmovn_u16(v)), 0);
+#else
+        __m128i const zero = _mm_setzero_si128();
+        __m128i const t = _mm_set_epi64x(right(top0, top1), left(top0, top1));
+        __m128i const b = _mm_set_epi64x(right(bottom0, bottom1), left(bottom0, bottom1));
+        __m128i const v = bilinearBlend<WeightBits>(_mm_unpacklo_epi8(t, zero), _mm_unpackhi_epi8(t, zero), _mm_unpacklo_epi8(b, zero), _mm_unpackhi_epi8(b, zero),
+            _mm_set_epi64x(fx1 * kLanes, fx0 * kLanes), _mm_set_epi64x(fy1 * kLanes, fy0 * kLanes));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(&pixels), _mm_packus_epi16(v, v));
+#endif
+        return pixels;
+    }
+
+    // the two pixels of a bilinearPair() result to dst
+    template <std::size_t Channels>
+    inline void storeBilinearPair(std::uint64_t pixels, std::uint8_t *dst)
+    {
+        std::memcpy(dst, &pixels, Channels);
+        pixels >>= 32;
+        std::memcpy(dst + Channels, &pixels, Channels);
+    }
+}
+#endif
@@ -0,0 +1,158 @@
+#include "ThreadPool.hpp"
+
+namespace rpiCam
+{
+    namespace
+    {
+        struct ParallelForState
+        {
+            ParallelForState(std::size_t b, std::size_t e, std::size_t g, ThreadPool::RangeTask const &t)
+                : begin(b)
+                , end(e)
+                , grain(g)
+                , numChunks((e - b + g - 1) / g)
+                , nextChunk(0)
+                , doneChunks(0)
+                , task(t)
+                , mutex()
+                , condition()
+            {
+            }
+
+            // returns false when there are no chunks left to run
+            bool runChunk()
+            {
+                std::size_t chunk = nextChunk++;
+                if (chunk >= numChunks)
+                    return false;
+
+                std::size_t chunkBegin = begin + chunk * grain;
+                task(chunkBegin, std::min(chunkBegin + grain, end));
+
+                if (++doneChunks == numChunks)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    condition.notify_all();
+                }
+                return true;
+            }
+
+            std::size_t const begin;
+            std::size_t const end;
+            std::size_t const grain;
+            std::size_t const numChunks;
+            std::atomic<std::size_t> nextChunk;
+            std::atomic<std::size_t> doneChunks;
+            ThreadPool::RangeTask const &task;
+            std::mutex mutex;
+            std::condition_variable condition;
+        };
+    }
+
+    ThreadPool::ThreadPool(std::size_t numThreads)
+        : m_Mutex()
+        , m_Condition()
+        , m_Tasks()
+        , m_Threads()
+        , m_bStopping(false)
+        , m_SchedulingLatency()
+    {
+        numThreads = std::max<std::size_t>(numThreads, 1);
+        m_Threads.reserve(numThreads);
+        for (std::size_t it = 0; it < numThreads; ++it)
+            m_Threads.emplace_back(&ThreadPool::run, this);
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_bStopping = true;
+        }
+        m_Condition.notify_all();
+
+        for (auto &thread : m_Threads)
+            thread.join();
+    }
+
+    void ThreadPool::post(Task &&task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Tasks.emplace_back(TimeClock::now(), std::move(task));
+        }
+        m_Condition.notify_one();
+    }
+
+    void ThreadPool::parallelFor(std::size_t begin, std::size_t end, std::size_t grain, RangeTask const &task)
+    {
+        if (begin >= end)
+            return;
+
+        grain = std::max<std::size_t>(grain, 1);
+        if (end - begin <= grain)
+        {
+            task(begin, end);
+            return;
+        }
+
+        std::shared_ptr<ParallelForState> state = std::make_shared<ParallelForState>(begin, end, grain, task);
+
+        std::size_t const numHelpers = std::min(state->numChunks - 1, size());
+        for (std::size_t ih = 0; ih < numHelpers; ++ih)
+            post([state]() { while (state->runChunk()); });
+
+        while (state->runChunk());
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->condition.wait(lock, [&state]() { return state->doneChunks == state->numChunks; });
+    }
+
+    std::error_code ThreadPool::setSchedule(ThreadSchedule const &schedule)
+    {
+        std::error_code result;
+        for (auto &thread : m_Threads)
+        {
+            if (std::error_code ase = applyThreadSchedule(thread, schedule))
+                result = ase;
+        }
+        return result;
+    }
+
+    SchedulingLatencyStats ThreadPool::schedulingLatency() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_SchedulingLatency;
+    }
+
+    void ThreadPool::resetSchedulingLatency()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_SchedulingLatency = SchedulingLatencyStats();
+    }
+
+    std::shared_ptr<ThreadPool> const& ThreadPool::shared()
+    {
+        static std::shared_ptr<ThreadPool> pool = std::make_shared<ThreadPool>();
+        return pool;
+    }
+
+    void ThreadPool::run()
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        while (true)
+        {
+            m_Condition.wait(lock, [this]() { return m_bStopping || !m_Tasks.empty(); });
+            if (m_Tasks.empty())
+                break;
+
+            Task task = std::move(m_Tasks.front().second);
+            m_SchedulingLatency.add(TimeClock::now() - m_Tasks.front().first);
+            m_Tasks.pop_front();
+
+            lock.unlock();
+            task();
+            lock.lock();
+        }
+    }
+}
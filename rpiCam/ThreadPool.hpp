@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Config.hpp"
+#include "ThreadScheduling.hpp"
+#include <deque>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+namespace rpiCam
+{
+    class ThreadPool
+    {
+    public:
+        using Task = std::function<void()>;
+        using RangeTask = std::function<void(std::size_t begin, std::size_t end)>;
+
+        explicit ThreadPool(std::size_t numThreads = std::thread::hardware_concurrency());
+        ~ThreadPool();
+
+        inline std::size_t size() const { return m_Threads.size(); }
+
+        void post(Task &&task);
+
+        // splits [begin, end) in chunks of grain, runs them on the pool and on the calling thread, returns when all are done
+        void parallelFor(std::size_t begin, std::size_t end, std::size_t grain, RangeTask const &task);
+
+        std::error_code setSchedule(ThreadSchedule const &schedule);
+
+        // delay between posting a task and a worker starting it
+        SchedulingLatencyStats schedulingLatency() const;
+        void resetSchedulingLatency();
+
+        static std::shared_ptr<ThreadPool> const& shared();
+
+    private:
+        void run();
+
+    private:
+        mutable std::mutex m_Mutex;
+        std::condition_variable m_Condition;
+        std::deque< std::pair<TimePoint, Task> > m_Tasks;
+        std::vector<std::thread> m_Threads;
+        bool m_bStopping;
+        SchedulingLatencyStats m_SchedulingLatency;
+    };
+}
@@ -0,0 +1,197 @@
+#include "ThreadScheduling.hpp"
+#include "Logging.hpp"
+#include <cmath>
+#include <iostream>
+#include <pthread.h>
+#include <sched.h>
+
+namespace rpiCam
+{
+    namespace
+    {
+        std::error_code applyThreadSchedule(pthread_t thread, ThreadSchedule const &schedule)
+        {
+            if (!schedule.cpus.empty())
+            {
+                cpu_set_t cpuSet;
+                CPU_ZERO(&cpuSet);
+                for (int cpu : schedule.cpus)
+                    CPU_SET(cpu, &cpuSet);
+
+                if (int err = pthread_setaffinity_np(thread, sizeof(cpuSet), &cpuSet))
+                {
+                    RPI_LOG(WARNING, "applyThreadSchedule(): pthread_setaffinity_np() failed: %d!", err);
+                    return std::error_code(err, std::system_category());
+                }
+            }
+
+            int policy = SCHED_OTHER;
+            switch (schedule.policy)
+            {
+            case ThreadSchedule::Policy::Fifo:          policy = SCHED_FIFO;    break;
+            case ThreadSchedule::Policy::RoundRobin:    policy = SCHED_RR;      break;
+            default:                                                            break;
+            }
+
+            sched_param param;
+            param.sched_priority = policy == SCHED_OTHER ? 0 : std::min(
+                std::max(schedule.priority, sched_get_priority_min(policy)),
+                sched_get_priority_max(policy)
+            );
+
+            if (int err = pthread_setschedparam(thread, policy, &param))
+            {
+                RPI_LOG(WARNING, "applyThreadSchedule(): pthread_setschedparam() failed: %d!", err);
+                return std::error_code(err, std::system_category());
+            }
+
+            return std::error_code();
+        }
+    }
+
+    ThreadSchedule::ThreadSchedule()
+        : cpus()
+        , policy(Policy::Default)
+        , priority(0)
+    {
+    }
+
+    ThreadSchedule::ThreadSchedule(std::vector<int> const &c, Policy p, int prio)
+        : cpus(c)
+        , policy(p)
+        , priority(prio)
+    {
+    }
+
+    std::error_code applyThreadSchedule(ThreadSchedule const &schedule)
+    {
+        return applyThreadSchedule(pthread_self(), schedule);
+    }
+
+    std::error_code applyThreadSchedule(std::thread &thread, ThreadSchedule const &schedule)
+    {
+        return applyThreadSchedule(thread.native_handle(), schedule);
+    }
+
+    SchedulingLatencyStats::SchedulingLatencyStats()
+        : count(0)
+        , mean(0)
+        , min(Duration::max())
+        , max(Duration::min())
+        , jitter(0)
+        , m_MeanUs(0.0)
+        , m_M2(0.0)
+    {
+    }
+
+    void SchedulingLatencyStats::add(Duration latency)
+    {
+        double const us = std::chrono::duration<double, std::micro>(latency).count();
+
+        count++;
+        double const delta = us - m_MeanUs;
+        m_MeanUs += delta / count;
+        m_M2 += delta * (us - m_MeanUs);
+
+        mean = std::chrono::duration_cast<Duration>(std::chrono::duration<double, std::micro>(m_MeanUs));
+        jitter = std::chrono::duration_cast<Duration>(std::chrono::duration<double, std::micro>(count > 1 ? std::sqrt(m_M2 / (count - 1)) : 0.0));
+        min = std::min(min, latency);
+        max = std::max(max, latency);
+    }
+
+    ScheduledThreadMonitor::ScheduledThreadMonitor()
+        : m_Mutex()
+        , m_Schedule()
+        , m_Generation(0)
+        , m_AppliedGeneration(0)
+        , m_AppliedThread()
+        , m_bAnchored(false)
+        , m_AnchorTime()
+        , m_AnchorCaptureTimeUs(0)
+        , m_Latency()
+    {
+    }
+
+    void ScheduledThreadMonitor::setSchedule(ThreadSchedule const &schedule)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Schedule = schedule;
+        m_Generation++;
+    }
+
+    ThreadSchedule ScheduledThreadMonitor::schedule() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_Schedule;
+    }
+
+    void ScheduledThreadMonitor::reset()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bAnchored = false;
+        m_Latency = SchedulingLatencyStats();
+    }
+
+    void ScheduledThreadMonitor::enter()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_AppliedThread == std::this_thread::get_id() && m_AppliedGeneration == m_Generation)
+            return;
+
+        m_AppliedThread = std::this_thread::get_id();
+        m_AppliedGeneration = m_Generation;
+
+        if (m_Schedule.isDefault() && m_Generation == 0)
+            return;
+
+        applyThreadSchedule(m_Schedule);
+    }
+
+    void ScheduledThreadMonitor::enter(std::int64_t captureTimeUs)
+    {
+        TimePoint const now = TimeClock::now();
+        enter();
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (!m_bAnchored)
+        {
+            m_bAnchored = true;
+            m_AnchorTime = now;
+            m_AnchorCaptureTimeUs = captureTimeUs;
+        }
+
+        m_Latency.add((now - m_AnchorTime) - std::chrono::microseconds(captureTimeUs - m_AnchorCaptureTimeUs));
+    }
+
+    SchedulingLatencyStats ScheduledThreadMonitor::latency() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_Latency;
+    }
+
+    std::istream& operator>>(std::istream &s, ThreadSchedule::Policy &v)
+    {
+        std::string sv;
+        s >> sv;
+        if (sv == "Default")
+            v = ThreadSchedule::Policy::Default;
+        else if (sv == "Fifo")
+            v = ThreadSchedule::Policy::Fifo;
+        else if (sv == "RoundRobin")
+            v = ThreadSchedule::Policy::RoundRobin;
+        else
+            throw std::invalid_argument("Invalid value for ThreadSchedule::Policy: " + sv);
+        return s;
+    }
+
+    std::ostream& operator<<(std::ostream &s, ThreadSchedule::Policy v)
+    {
+        switch(v)
+        {
+        case ThreadSchedule::Policy::Default:       s << "Default";     break;
+        case ThreadSchedule::Policy::Fifo:          s << "Fifo";        break;
+        case ThreadSchedule::Policy::RoundRobin:    s << "RoundRobin";  break;
+        }
+        return s;
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Config.hpp"
+#include <vector>
+#include <system_error>
+
+namespace rpiCam
+{
+    class ThreadSchedule
+    {
+    public:
+        enum class Policy : int
+        {
+            Default,
+            Fifo,
+            RoundRobin
+        };
+
+        ThreadSchedule();
+        ThreadSchedule(std::vector<int> const &c, Policy p = Policy::Default, int prio = 0);
+
+        inline bool isDefault() const { return cpus.empty() && policy == Policy::Default; }
+
+        std::vector<int> cpus;
+        Policy policy;
+        int priority;
+    };
+
+    std::error_code applyThreadSchedule(ThreadSchedule const &schedule);
+    std::error_code applyThreadSchedule(std::thread &thread, ThreadSchedule const &schedule);
+
+    class SchedulingLatencyStats
+    {
+    public:
+        SchedulingLatencyStats();
+
+        void add(Duration latency);
+
+        std::uint64_t count;
+        Duration mean;
+        Duration min;
+        Duration max;
+        Duration jitter;
+
+    private:
+        double m_MeanUs;
+        double m_M2;
+    };
+
+    // Applies a schedule to whichever thread calls enter() - used for threads we do
+    // not own, such as MMAL callback threads - and measures how late each call is
+    // compared with the capture timeline anchored at the first call after reset().
+    class ScheduledThreadMonitor
+    {
+    public:
+        ScheduledThreadMonitor();
+
+        void setSchedule(ThreadSchedule const &schedule);
+        ThreadSchedule schedule() const;
+
+        void reset();
+        void enter();
+        void enter(std::int64_t captureTimeUs);
+
+        SchedulingLatencyStats latency() const;
+
+    private:
+        mutable std::mutex m_Mutex;
+        ThreadSchedule m_Schedule;
+        std::uint32_t m_Generation;
+        std::uint32_t m_AppliedGeneration;
+        std::thread::id m_AppliedThread;
+        bool m_bAnchored;
+        TimePoint m_AnchorTime;
+        std::int64_t m_AnchorCaptureTimeUs;
+        SchedulingLatencyStats m_Latency;
+    };
+
+    extern std::istream& operator>>(std::istream &s, ThreadSchedule::Policy &v);
+    extern std::ostream& operator<<(std::ostream &s, ThreadSchedule::Policy v);
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "Config.hpp"
+#include <tuple>
+#include <vector>
+
+namespace rpiCam
+{
+    using EventSubscription = std::uint32_t;
+
+    template <typename Event, typename Signature = typename Event::Signature>
+    class TypedEventSlots;
+
+    // per-event subscriber array, copy-on-write so dispatch never allocates nor blocks
+    template <typename Event, typename ...Args>
+    class TypedEventSlots<Event, void(Args...)>
+    {
+    protected:
+        using Handler = void (*)(void *context, Args... args);
+
+        struct Slot
+        {
+            EventSubscription id;
+            void *context;
+            Handler handler;
+            std::shared_ptr<void> storage;
+        };
+
+        using SlotArray = std::vector<Slot>;
+
+    public:
+        TypedEventSlots()
+          : m_Mutex()
+          , m_Slots(std::make_shared<SlotArray>())
+        {
+        }
+
+        template <typename Callable>
+        void addCallable(EventSubscription id, Callable &&callable)
+        {
+          using CallableType = typename std::decay<Callable>::type;
+          std::shared_ptr<CallableType> storage = std::make_shared<CallableType>(std::forward<Callable>(callable));
+          add(Slot{id, storage.get(), &ThisType::template invokeCallable<CallableType>, storage});
+        }
+
+        template <typename Listener>
+        void addListener(EventSubscription id, Listener *listener)
+        {
+          add(Slot{id, listener, &ThisType::template invokeListener<Listener>, std::shared_ptr<void>()});
+        }
+
+        bool remove(EventSubscription id)
+        {
+          std::lock_guard<std::mutex> lock(m_Mutex);
+          auto itSlot = std::find_if(m_Slots->begin(), m_Slots->end(), [id](Slot const &slot) { return slot.id == id; });
+          if (itSlot == m_Slots->end())
+            return false;
+
+          std::shared_ptr<SlotArray> slots = std::make_shared<SlotArray>(*m_Slots);
+          slots->erase(slots->begin() + (itSlot - m_Slots->begin()));
+          std::atomic_store(&m_Slots, std::shared_ptr<SlotArray const>(slots));
+          return true;
+        }
+
+        bool empty() const
+        {
+          return std::atomic_load(&m_Slots)->empty();
+        }
+
+        template <typename ...DispatchArgs>
+        inline void dispatch(DispatchArgs &&... args) const
+        {
+          std::shared_ptr<SlotArray const> slots = std::atomic_load(&m_Slots);
+          for (Slot const &slot : *slots)
+          {
+            slot.handler(slot.context, args...);
+          }
+        }
+
+    private:
+        using ThisType = TypedEventSlots<Event, void(Args...)>;
+
+        void add(Slot &&slot)
+        {
+          std::lock_guard<std::mutex> lock(m_Mutex);
+          std::shared_ptr<SlotArray> slots = std::make_shared<SlotArray>();
+          slots->reserve(m_Slots->size() + 1);
+          slots->push_back(std::move(slot));
+          slots->insert(slots->end(), m_Slots->begin(), m_Slots->end());
+          std::atomic_store(&m_Slots, std::shared_ptr<SlotArray const>(slots));
+        }
+
+        template <typename Callable>
+        static void invokeCallable(void *context, Args... args)
+        {
+          (*static_cast<Callable*>(context))(std::forward<Args>(args)...);
+        }
+
+        template <typename Listener>
+        static void invokeListener(void *context, Args... args)
+        {
+          static_cast<Listener*>(context)->on(Event(), std::forward<Args>(args)...);
+        }
+
+    private:
+        std::mutex m_Mutex;
+        std::shared_ptr<SlotArray const> m_Slots;
+    };
+
+    // Subscriptions are made per event type, either with a callable or with a
+    // listener implementing a non-virtual `on(Event, Args...)` overload, so a
+    // dispatch only walks the subscribers of that event and needs no vtable.
+    template <typename ...Events>
+    class TypedEventsDispatcher
+    {
+    public:
+        TypedEventsDispatcher()
+          : m_NextSubscription(1)
+          , m_Slots()
+        {
+        }
+
+        ~TypedEventsDispatcher()
+        {
+        }
+
+        template <typename Event, typename Callable>
+        EventSubscription subscribe(Callable &&callable) const
+        {
+          EventSubscription id = m_NextSubscription++;
+          std::get< TypedEventSlots<Event> >(m_Slots).addCallable(id, std::forward<Callable>(callable));
+          return id;
+        }
+
+        template <typename Event, typename Listener>
+        EventSubscription subscribe(Listener *listener) const
+        {
+          EventSubscription id = m_NextSubscription++;
+          std::get< TypedEventSlots<Event> >(m_Slots).addListener(id, listener);
+          return id;
+        }
+
+        template <typename Event>
+        bool unsubscribe(EventSubscription subscription) const
+        {
+          return std::get< TypedEventSlots<Event> >(m_Slots).remove(subscription);
+        }
+
+        template <typename Event>
+        bool hasSubscribers() const
+        {
+          return !std::get< TypedEventSlots<Event> >(m_Slots).empty();
+        }
+
+        template <typename Event, typename ...Args>
+        inline void dispatch(Args &&... args)
+        {
+          std::get< TypedEventSlots<Event> >(m_Slots).dispatch(std::forward<Args>(args)...);
+        }
+
+    private:
+        mutable std::atomic<EventSubscription> m_NextSubscription;
+        mutable std::tuple< TypedEventSlots<Events>... > m_Slots;
+    };
+}
@@ -0,0 +1,395 @@
+#include "VideoStabilizer.hpp"
+#include "MemoryPixelSampleBuffer.hpp"
+#include "Logging.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace rpiCam
+{
+    namespace
+    {
+        // a camera frame holds one of the few buffers of the video port until
+        // released, so frames waiting for look-ahead are kept as copies
+        std::shared_ptr<PixelSampleBuffer> copyFrame(std::shared_ptr<PixelSampleBuffer> const &frame)
+        {
+            if (std::dynamic_pointer_cast<MemoryPixelSampleBuffer>(frame))
+                return frame;
+
+            if (frame->lock())
+            {
+                RPI_LOG(ERROR, "VideoStabilizer::process(): failed to lock the frame!");
+                return nullptr;
+            }
+
+            std::shared_ptr<MemoryPixelSampleBuffer> copy =
+                std::make_shared<MemoryPixelSampleBuffer>(frame->format(), frame->planeSize(0), BufferArena::shared());
+            PixelFormatDescriptor const descriptor = pixelFormatDescriptor(frame->format());
+            for (std::size_t pi = 0; pi < descriptor.planeCount; ++pi)
+            {
+                std::uint8_t const *src = static_cast<std::uint8_t const*>(frame->planeData(pi));
+                std::uint8_t *dst = static_cast<std::uint8_t*>(copy->planeData(pi));
+                Vec2ui const size = frame->planeSize(pi);
+                for (std::uint32_t y = 0; y < size(1); ++y)
+                    std::memcpy(dst + y * copy->planeRowBytes(pi), src + y * frame->planeRowBytes(pi), size(0) * descriptor.bytesPerPixel[pi]);
+            }
+            frame->unlock();
+
+            copy->time = frame->time;
+            copy->sequence = frame->sequence;
+            return copy;
+        }
+    }
+
+    VideoStabilizerOptions::VideoStabilizerOptions()
+        : lookAhead(15)
+        , smoothing(5.0f)
+        , zoom(1.1f)
+        , bClampCorrection(true)
+        , maxTracks(200)
+        , minTracks(80)
+        , featureThreshold(20)
+        , estimation()
+    {
+    }
+
+    StabilizationStats::StabilizationStats()
+        : motion()
+        , correction()
+        , numTracks(0)
+        , numInliers(0)
+        , estimationTime(0)
+        , warpTime(0)
+        , latency(0)
+    {
+    }
+
+    VideoStabilizerStats::VideoStabilizerStats()
+        : processed(0)
+        , meanProcessingTime(0)
+        , maxProcessingTime(0)
+        , meanLatency(0)
+        , maxLatency(0)
+    {
+    }
+
+    VideoStabilizer::VideoStabilizer(VideoStabilizerOptions const &options, std::shared_ptr<ThreadPool> pool)
+        : Camera::Events()
+        , m_Mutex()
+        , m_Options(isValid(options) ? options : VideoStabilizerOptions())
+        , m_Detector()
+        , m_Tracker(OpticalFlowOptions(), pool)
+        , m_Warper(pool)
+        , m_Size(0, 0)
+        , m_Points()
+        , m_From()
+        , m_To()
+        , m_Pose()
+        , m_Trajectory()
+        , m_Pending()
+        , m_Processed(0)
+        , m_TotalProcessingTime(0)
+        , m_MaxProcessingTime(0)
+        , m_TotalLatency(0)
+        , m_MaxLatency(0)
+        , m_VideoStabilizerEvents()
+    {
+        if (!isValid(options))
+            RPI_LOG(WARNING, "VideoStabilizer::VideoStabilizer(): invalid options, using defaults!");
+
+        m_Warper.setBorder(ImageWarper::Border::Replicate);
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        restart();
+    }
+
+    VideoStabilizer::~VideoStabilizer()
+    {
+    }
+
+    VideoStabilizerOptions VideoStabilizer::options() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_Options;
+    }
+
+    std::error_code VideoStabilizer::setOptions(VideoStabilizerOptions const &options)
+    {
+        if (!isValid(options))
+        {
+            RPI_LOG(ERROR, "VideoStabilizer::setOptions(): invalid options!");
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Options = options;
+        restart();
+        return std::error_code();
+    }
+
+    bool VideoStabilizer::isSimdEnabled() const
+    {
+        return m_Tracker.isSimdEnabled();
+    }
+
+    void VideoStabilizer::setSimdEnabled(bool bEnabled)
+    {
+        m_Detector.setSimdEnabled(bEnabled);
+        m_Tracker.setSimdEnabled(bEnabled);
+        m_Warper.setSimdEnabled(bEnabled);
+    }
+
+    std::shared_ptr<PixelSampleBuffer> VideoStabilizer::process(std::shared_ptr<PixelSampleBuffer> const &frame)
+    {
+        if (!frame)
+        {
+            RPI_LOG(ERROR, "VideoStabilizer::process(): no frame!");
+            return nullptr;
+        }
+
+        if (pixelFormatDescriptor(frame->format()).bytesPerPixel[0] != 1)
+        {
+            RPI_LOG(ERROR, "VideoStabilizer::process(): no separate luma plane in this format!");
+            return nullptr;
+        }
+
+        TimePoint const received = TimeClock::now();
+        std::shared_ptr<PixelSampleBuffer> const held = copyFrame(frame);
+        if (!held)
+            return nullptr;
+
+        std::shared_ptr<PixelSampleBuffer> stabilized;
+        StabilizationStats stats;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (frame->planeSize(0) != m_Size)
+            {
+                if (!m_Pending.empty())
+                    RPI_LOG(WARNING, "VideoStabilizer::process(): frame size changed, dropping %d frames!", int(m_Pending.size()));
+                restart();
+                m_Size = frame->planeSize(0);
+            }
+
+            Pending pending{held, received, StabilizationStats()};
+            estimateMotion(*frame, pending.stats);
+            pending.stats.estimationTime = TimeClock::now() - received;
+            m_Pending.push_back(pending);
+            m_Trajectory.push_back(m_Pose);
+
+            if (m_Pending.size() > m_Options.lookAhead)
+                stabilized = emitFront(stats);
+        }
+
+        if (stabilized)
+            m_VideoStabilizerEvents.dispatch(&Events::onVideoFrameStabilized, stabilized, stats);
+        return stabilized;
+    }
+
+    void VideoStabilizer::finish()
+    {
+        for (;;)
+        {
+            std::shared_ptr<PixelSampleBuffer> stabilized;
+            StabilizationStats stats;
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                if (m_Pending.empty())
+                {
+                    restart();
+                    return;
+                }
+                stabilized = emitFront(stats);
+            }
+
+            if (stabilized)
+                m_VideoStabilizerEvents.dispatch(&Events::onVideoFrameStabilized, stabilized, stats);
+        }
+    }
+
+    void VideoStabilizer::reset()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        restart();
+    }
+
+    VideoStabilizerStats VideoStabilizer::stats() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        VideoStabilizerStats stats;
+        stats.processed = m_Processed;
+        if (m_Processed)
+        {
+            stats.meanProcessingTime = m_TotalProcessingTime / m_Processed;
+            stats.meanLatency = m_TotalLatency / m_Processed;
+        }
+        stats.maxProcessingTime = m_MaxProcessingTime;
+        stats.maxLatency = m_MaxLatency;
+        return stats;
+    }
+
+    void VideoStabilizer::onCameraVideoFrame(std::shared_ptr<PixelSampleBuffer> const &buffer)
+    {
+        process(buffer);
+    }
+
+    void VideoStabilizer::onCameraVideoStopped()
+    {
+        finish();
+    }
+
+    bool VideoStabilizer::isValid(VideoStabilizerOptions const &options)
+    {
+        return options.smoothing > 0.0f &&
+            options.zoom >= 1.0f &&
+            options.maxTracks > 0 &&
+            options.minTracks <= options.maxTracks &&
+            options.estimation.numIterations > 0 &&
+            options.estimation.inlierThreshold > 0.0f;
+    }
+
+    void VideoStabilizer::restart()
+    {
+        FeatureOptions features;
+        features.threshold = m_Options.featureThreshold;
+        features.maxFeatures = m_Options.maxTracks;
+        features.bDescriptors = false;
+        m_Detector.setOptions(features);
+        m_Tracker.reset();
+
+        m_Size = Vec2ui(0, 0);
+        m_Points.clear();
+        m_Pose = Pose{Vec2f(0.0f, 0.0f), 0.0f, 0.0f};
+        m_Trajectory.clear();
+        m_Pending.clear();
+    }
+
+    void VideoStabilizer::estimateMotion(PixelSampleBuffer &frame, StabilizationStats &stats)
+    {
+        Vec2f const center = 0.5f * (m_Size.cast<float>() - Vec2f(1.0f, 1.0f));
+
+        m_From.clear();
+        for (auto const &point : m_Points)
+            m_From.push_back(point.position);
+
+        if (m_Tracker.process(frame, m_Points))
+            m_Points.clear();
+
+        // keep the points still tracked, as pairs about the frame center
+        std::size_t numTracks = 0;
+        m_To.clear();
+        for (std::size_t ip = 0; ip < m_Points.size(); ++ip)
+        {
+            if (!m_Points[ip].bTracked)
+                continue;
+            m_From[numTracks] = m_From[ip] - center;
+            m_To.push_back(m_Points[ip].position - center);
+            m_Points[numTracks++] = m_Points[ip];
+        }
+        m_From.resize(numTracks);
+        m_Points.resize(numTracks);
+
+        stats.numTracks = numTracks;
+        stats.numInliers = estimateSimilarity(m_From, m_To, m_Options.estimation, stats.motion);
+        if (stats.numInliers)
+        {
+            m_Pose.translation += stats.motion.translation;
+            m_Pose.angle += stats.motion.angle;
+            m_Pose.logScale += std::log(stats.motion.scale);
+        }
+
+        // the tracker keeps this frame as its reference, new points start on it
+        if (numTracks < m_Options.minTracks)
+        {
+            m_Points.clear();
+            if (std::shared_ptr<FeatureSet const> features = m_Detector.detect(frame))
+            {
+                for (auto const &keypoint : features->keypoints)
+                    m_Points.emplace_back(keypoint.position);
+            }
+        }
+    }
+
+    std::shared_ptr<PixelSampleBuffer> VideoStabilizer::emitFront(StabilizationStats &stats)
+    {
+        TimePoint const started = TimeClock::now();
+        Pending pending = std::move(m_Pending.front());
+        m_Pending.pop_front();
+
+        // Gaussian over the poses kept on both sides of the frame
+        std::size_t const center = m_Trajectory.size() - m_Pending.size() - 1;
+        float const sigma = m_Options.smoothing;
+        Pose smoothed{Vec2f(0.0f, 0.0f), 0.0f, 0.0f};
+        float weights = 0.0f;
+        for (std::size_t i = 0; i < m_Trajectory.size(); ++i)
+        {
+            float const d = (float(i) - float(center)) / sigma;
+            float const w = std::exp(-0.5f * d * d);
+            smoothed.translation += w * m_Trajectory[i].translation;
+            smoothed.angle += w * m_Trajectory[i].angle;
+            smoothed.logScale += w * m_Trajectory[i].logScale;
+            weights += w;
+        }
+
+        // the frame content sits at its pose, the output follows the smoothed one
+        Pose const &pose = m_Trajectory[center];
+        Vec2f offset = pose.translation - smoothed.translation / weights;
+        if (m_Options.bClampCorrection)
+        {
+            Vec2f const limit = 0.5f * (1.0f - 1.0f / m_Options.zoom) * m_Size.cast<float>();
+            offset = offset.cwiseMax(-limit).cwiseMin(limit);
+        }
+
+        Vec2f const frameCenter = 0.5f * (m_Size.cast<float>() - Vec2f(1.0f, 1.0f));
+        SimilarityTransform &correction = pending.stats.correction;
+        correction.angle = pose.angle - smoothed.angle / weights;
+        correction.scale = std::exp(pose.logScale - smoothed.logScale / weights) / m_Options.zoom;
+        correction.translation = Vec2f(0.0f, 0.0f);
+        correction.translation = frameCenter + offset - correction.apply(frameCenter);
+
+        std::shared_ptr<MemoryPixelSampleBuffer> stabilized =
+            std::make_shared<MemoryPixelSampleBuffer>(pending.frame->format(), m_Size, BufferArena::shared());
+        stabilized->time = pending.frame->time;
+        stabilized->sequence = pending.frame->sequence;
+        std::error_code const we = warp(*pending.frame, *stabilized, correction.matrix());
+
+        while (m_Trajectory.size() - m_Pending.size() > std::max<std::size_t>(m_Options.lookAhead, std::size_t(std::ceil(3.0f * sigma))))
+            m_Trajectory.pop_front();
+
+        TimePoint const finished = TimeClock::now();
+        stats = pending.stats;
+        stats.warpTime = finished - started;
+        stats.latency = finished - pending.received;
+
+        Duration const processingTime = stats.estimationTime + stats.warpTime;
+        m_Processed++;
+        m_TotalProcessingTime += processingTime;
+        m_MaxProcessingTime = std::max(m_MaxProcessingTime, processingTime);
+        m_TotalLatency += stats.latency;
+        m_MaxLatency = std::max(m_MaxLatency, stats.latency);
+
+        if (we)
+            return nullptr;
+        return stabilized;
+    }
+
+    std::error_code VideoStabilizer::warp(PixelSampleBuffer &src, PixelSampleBuffer &dst, Eigen::Matrix3f const &dstToSrc)
+    {
+        if (src.lock())
+        {
+            RPI_LOG(ERROR, "VideoStabilizer::warp(): failed to lock the frame!");
+            return std::make_error_code(std::errc::no_lock_available);
+        }
+        if (dst.lock())
+        {
+            src.unlock();
+            RPI_LOG(ERROR, "VideoStabilizer::warp(): failed to lock the output buffer!");
+            return std::make_error_code(std::errc::no_lock_available);
+        }
+
+        std::error_code const e = m_Warper.warpAffine(src, dst, dstToSrc);
+
+        dst.unlock();
+        src.unlock();
+        return e;
+    }
+}
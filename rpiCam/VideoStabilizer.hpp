@@ -0,0 +1,154 @@
+#pragma once
+
+#include "Config.hpp"
+#include "Camera.hpp"
+#include "FeatureDetector.hpp"
+#include "OpticalFlow.hpp"
+#include "MotionEstimation.hpp"
+#include "ImageWarp.hpp"
+#include "ThreadPool.hpp"
+#include <deque>
+
+namespace rpiCam
+{
+    class VideoStabilizerOptions
+    {
+    public:
+        VideoStabilizerOptions();
+
+        std::uint32_t lookAhead;        // frames held back so the smoothing sees future motion, the latency in frames
+        float smoothing;                // sigma of the Gaussian over the trajectory, in frames
+        float zoom;                     // magnification of the output hiding the borders the correction moves in, at least 1
+        bool bClampCorrection;          // keep translation corrections within the border hidden by the zoom
+        std::uint32_t maxTracks;        // features seeded on the Y plane
+        std::uint32_t minTracks;        // seed again once fewer points are still tracked
+        std::uint8_t featureThreshold;  // FAST threshold of the seeded features
+        MotionEstimationOptions estimation;
+    };
+
+    class StabilizationStats
+    {
+    public:
+        StabilizationStats();
+
+        SimilarityTransform motion;     // of the frame content from the previous frame, about the frame center
+        SimilarityTransform correction; // from output pixels to pixels of the original frame
+        std::size_t numTracks;          // point pairs the motion was fitted to
+        std::size_t numInliers;
+        Duration estimationTime;        // tracking and fitting, when the frame came in
+        Duration warpTime;              // smoothing and warping, when it went out
+        Duration latency;               // from process() receiving the frame to the stabilised copy
+    };
+
+    class VideoStabilizerStats
+    {
+    public:
+        VideoStabilizerStats();
+
+        std::uint64_t processed;
+        Duration meanProcessingTime;    // estimation and warp time per frame
+        Duration maxProcessingTime;
+        Duration meanLatency;
+        Duration maxLatency;
+    };
+
+    // Software video stabilisation of frames with a separate Y plane.
+    // Features seeded on the Y plane are tracked from frame to frame, a
+    // similarity (translation, rotation and scale) is fitted to the tracks
+    // and accumulated into the camera trajectory. Frames wait lookAhead
+    // frames so the trajectory can be smoothed on both sides, then every
+    // plane is warped onto the smoothed path with a fixed point bilinear
+    // remap into a new buffer. Frames other than MemoryPixelSampleBuffers
+    // wait as copies in arena memory, so camera frames go back to the video
+    // port right away however long the look-ahead. Subscribe it to
+    // Camera::cameraEvents() or feed frames to process(), e.g. from a
+    // Pipeline stage.
+    class VideoStabilizer
+        : public Camera::Events
+    {
+    public:
+        class Events
+        {
+        public:
+            virtual void onVideoFrameStabilized(std::shared_ptr<PixelSampleBuffer> const &buffer, StabilizationStats const &stats) {}
+        };
+
+        using VideoStabilizerEvents = EventsDispatcher<Events>;
+
+        VideoStabilizer(VideoStabilizerOptions const &options = VideoStabilizerOptions(), std::shared_ptr<ThreadPool> pool = nullptr);
+        ~VideoStabilizer();
+
+        inline VideoStabilizerEvents const& videoStabilizerEvents() const { return m_VideoStabilizerEvents; }
+
+        VideoStabilizerOptions options() const;
+
+        // drops the frames waiting for look-ahead and starts a new trajectory
+        std::error_code setOptions(VideoStabilizerOptions const &options);
+
+        bool isSimdEnabled() const;
+        void setSimdEnabled(bool bEnabled);
+
+        // Takes in frame and returns the stabilised copy of the frame
+        // lookAhead frames before it, which is dispatched with
+        // onVideoFrameStabilized as well. nullptr while the look-ahead fills
+        // up or on failure. A frame of another size starts over.
+        std::shared_ptr<PixelSampleBuffer> process(std::shared_ptr<PixelSampleBuffer> const &frame);
+
+        // stabilises and dispatches the frames still waiting, smoothing them
+        // with the future frames there are
+        void finish();
+
+        // drops the frames waiting and starts a new trajectory
+        void reset();
+
+        VideoStabilizerStats stats() const;
+
+        // Camera::Events overrides
+        void onCameraVideoFrame(std::shared_ptr<PixelSampleBuffer> const &buffer) override;
+        void onCameraVideoStopped() override;
+
+    private:
+        // accumulated content motion since the first frame
+        struct Pose
+        {
+            Vec2f translation;
+            float angle;
+            float logScale;
+        };
+
+        struct Pending
+        {
+            std::shared_ptr<PixelSampleBuffer> frame;  // never a camera buffer
+            TimePoint received;
+            StabilizationStats stats;
+        };
+
+        static bool isValid(VideoStabilizerOptions const &options);
+
+        // all with m_Mutex held
+        void restart();
+        void estimateMotion(PixelSampleBuffer &frame, StabilizationStats &stats);
+        std::shared_ptr<PixelSampleBuffer> emitFront(StabilizationStats &stats);
+        std::error_code warp(PixelSampleBuffer &src, PixelSampleBuffer &dst, Eigen::Matrix3f const &dstToSrc);
+
+    private:
+        mutable std::mutex m_Mutex;
+        VideoStabilizerOptions m_Options;
+        FeatureDetector m_Detector;
+        OpticalFlowTracker m_Tracker;
+        ImageWarper m_Warper;
+        Vec2ui m_Size;
+        std::vector<TrackedPoint> m_Points;
+        std::vector<Vec2f> m_From;
+        std::vector<Vec2f> m_To;
+        Pose m_Pose;
+        std::deque<Pose> m_Trajectory;      // up to lookAhead emitted frames, then one per pending frame
+        std::deque<Pending> m_Pending;
+        std::uint64_t m_Processed;
+        Duration m_TotalProcessingTime;
+        Duration m_MaxProcessingTime;
+        Duration m_TotalLatency;
+        Duration m_MaxLatency;
+        VideoStabilizerEvents m_VideoStabilizerEvents;
+    };
+}
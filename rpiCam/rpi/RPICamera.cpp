@@ -48,6 +48,25 @@ namespace rpiCam
             }
             return cameras;
         }
+
+        // GRAY8 is served from the luma plane of an I420 buffer
+        MMAL_FOURCC_T mmalEncodingForPixelFormat(ePixelFormat format)
+        {
+            switch(format)
+            {
+            case kPixelFormatRGB8:      return MMAL_ENCODING_RGB24;
+            case kPixelFormatYUV420:    return MMAL_ENCODING_I420;
+            case kPixelFormatNV12:      return MMAL_ENCODING_NV12;
+            case kPixelFormatNV21:      return MMAL_ENCODING_NV21;
+            case kPixelFormatYUYV:      return MMAL_ENCODING_YUYV;
+            case kPixelFormatUYVY:      return MMAL_ENCODING_UYVY;
+            case kPixelFormatRGBA8:     return MMAL_ENCODING_RGBA;
+            case kPixelFormatBGRA8:     return MMAL_ENCODING_BGRA;
+            case kPixelFormatGRAY8:     return MMAL_ENCODING_I420;
+            case kPixelFormatYUV422:    return MMAL_ENCODING_I422;
+            default:                    return 0;
+            }
+        }
     }
 
     RPICamera::RPICamera(std::shared_ptr<MMAL_COMPONENT_T> camera, std::string const &name)
@@ -68,6 +87,7 @@ namespace rpiCam
         , m_VideoFormat(kPixelFormatYUV420)
         , m_VideoSize(1920, 1080)
         , m_VideoFrameRate(60, 1)
+        , m_VideoFrameSequence(0)
         , m_SupportedSnapshotFormats()
         , m_SupportedSnapshotSizes()
         , m_SnapshotFormat(kPixelFormatYUV420)
@@ -97,6 +117,15 @@ namespace rpiCam
         , m_EncoderBufferPool(nullptr)
     {
         m_Camera->userdata = reinterpret_cast<struct MMAL_COMPONENT_USERDATA_T*>(this);
+
+        for (int pf = kPixelFormatInvalid + 1; pf < kPixelFormatMax; ++pf)
+        {
+            if (mmalEncodingForPixelFormat(ePixelFormat(pf)))
+            {
+                m_SupportedVideoFormats.push_back(ePixelFormat(pf));
+                m_SupportedSnapshotFormats.push_back(ePixelFormat(pf));
+            }
+        }
     }
 
     RPICamera::~RPICamera()
@@ -329,6 +358,11 @@ namespace rpiCam
         return std::error_code();
     }
 
+    std::size_t RPICamera::getVideoBufferCount() const
+    {
+        return m_VideoPort->buffer_num;
+    }
+
     std::error_code RPICamera::startVideo()
     {
         RPI_LOG(DEBUG, "Camera::startVideo(): starting video ...");
@@ -345,6 +379,9 @@ namespace rpiCam
             return std::make_error_code(std::errc::already_connected);
         }
 
+        m_VideoFrameSequence = 0;
+        deliveryThreadMonitor(DeliveryThread::Video).reset();
+
         if (std::error_code evpe = enableVideoPort())
         {
             RPI_LOG(WARNING, "Camera::startVideo(): could not enable video port!");
@@ -516,6 +553,8 @@ namespace rpiCam
           }
         }
 
+        deliveryThreadMonitor(DeliveryThread::Snapshot).reset();
+
         if (std::error_code espe = enableSnapshotPort())
         {
             RPI_LOG(WARNING, "Camera::startTakingSnapshots(): could not enable snapshot port!");
@@ -1107,22 +1146,12 @@ namespace rpiCam
     {
         RPI_LOG(DEBUG, "Camera::applyVideoFormat(): applying video format ...");
 
-        switch(fmt)
-        {
-        case kPixelFormatRGB8:
-            m_VideoPort->format->encoding = MMAL_ENCODING_RGB24;
-            m_VideoPort->format->encoding_variant = 0;
-            break;
-
-        case kPixelFormatYUV420:
-            m_VideoPort->format->encoding = MMAL_ENCODING_I420;
-            m_VideoPort->format->encoding_variant = 0;
-            break;
-
-        default:
+        MMAL_FOURCC_T const encoding = mmalEncodingForPixelFormat(fmt);
+        if (!encoding)
             return std::make_error_code(std::errc::io_error);
-            break;
-        }
+
+        m_VideoPort->format->encoding = encoding;
+        m_VideoPort->format->encoding_variant = 0;
 
         if (mmal_port_format_commit(m_VideoPort) != MMAL_SUCCESS)
         {
@@ -1197,22 +1226,12 @@ namespace rpiCam
     {
         RPI_LOG(DEBUG, "Camera::applySnapshotFormat(): applying snapshot format ...");
 
-        switch(fmt)
-        {
-        case kPixelFormatRGB8:
-            m_SnapshotPort->format->encoding = MMAL_ENCODING_RGB24;
-            m_SnapshotPort->format->encoding_variant = 0;
-            break;
-
-        case kPixelFormatYUV420:
-            m_SnapshotPort->format->encoding = MMAL_ENCODING_I420;
-            m_SnapshotPort->format->encoding_variant = 0;
-            break;
-
-        default:
+        MMAL_FOURCC_T const encoding = mmalEncodingForPixelFormat(fmt);
+        if (!encoding)
             return std::make_error_code(std::errc::io_error);
-            break;
-        }
+
+        m_SnapshotPort->format->encoding = encoding;
+        m_SnapshotPort->format->encoding_variant = 0;
 
         if (mmal_port_format_commit(m_SnapshotPort) != MMAL_SUCCESS)
         {
@@ -1383,26 +1402,16 @@ namespace rpiCam
         }
         */
 
-        switch(m_VideoFormat)
+        MMAL_FOURCC_T const encoding = mmalEncodingForPixelFormat(m_VideoFormat);
+        if (!encoding)
         {
-        case kPixelFormatRGB8:
-            m_VideoPort->format->encoding = MMAL_ENCODING_RGB24;
-            m_VideoPort->format->encoding_variant = 0;
-            break;
-
-        case kPixelFormatYUV420:
-            m_VideoPort->format->encoding = MMAL_ENCODING_I420;
-            m_VideoPort->format->encoding_variant = 0;
-            break;
-
-        default:
-            {
-                RPI_LOG(WARNING, "Camera::initializeVideoPort(): unsupported video format %d", m_VideoFormat);
-                return std::make_error_code(std::errc::io_error);
-            }
-            break;
+            RPI_LOG(WARNING, "Camera::initializeVideoPort(): unsupported video format %d", m_VideoFormat);
+            return std::make_error_code(std::errc::io_error);
         }
 
+        m_VideoPort->format->encoding = encoding;
+        m_VideoPort->format->encoding_variant = 0;
+
         m_VideoPort->format->es->video.width = VCOS_ALIGN_UP(m_VideoSize(0), 32);
         m_VideoPort->format->es->video.height = VCOS_ALIGN_UP(m_VideoSize(1), 16);
         m_VideoPort->format->es->video.crop.x = 0;
@@ -1438,26 +1447,16 @@ namespace rpiCam
     {
         RPI_LOG(DEBUG, "Camera::initializeSnapshotPort): initializing capture ...");
 
-        switch(m_SnapshotFormat)
+        MMAL_FOURCC_T const encoding = mmalEncodingForPixelFormat(m_SnapshotFormat);
+        if (!encoding)
         {
-        case kPixelFormatRGB8:
-            m_SnapshotPort->format->encoding = MMAL_ENCODING_RGB24;
-            m_SnapshotPort->format->encoding_variant = 0;
-            break;
-
-        case kPixelFormatYUV420:
-            m_SnapshotPort->format->encoding = MMAL_ENCODING_I420;
-            m_SnapshotPort->format->encoding_variant = 0;
-            break;
-
-        default:
-            {
-                RPI_LOG(WARNING, "Camera::initializeSnapshotPort(): unsupported snapshot format %d", m_SnapshotFormat);
-                return std::make_error_code(std::errc::io_error);
-            }
-            break;
+            RPI_LOG(WARNING, "Camera::initializeSnapshotPort(): unsupported snapshot format %d", m_SnapshotFormat);
+            return std::make_error_code(std::errc::io_error);
         }
 
+        m_SnapshotPort->format->encoding = encoding;
+        m_SnapshotPort->format->encoding_variant = 0;
+
         m_SnapshotPort->format->es->video.width = VCOS_ALIGN_UP(m_SnapshotSize(0), 32);
         m_SnapshotPort->format->es->video.height = VCOS_ALIGN_UP(m_SnapshotSize(1), 16);
         m_SnapshotPort->format->es->video.crop.x = 0;
@@ -1720,6 +1719,7 @@ namespace rpiCam
         return std::make_error_code(std::errc::io_error);
       }
 
+      deliveryThreadMonitor(DeliveryThread::Encoder).reset();
       dispatchOnCameraRecordingStarted();
 
       for (int ieb = 0; ieb < numEncoderBuffers; ieb++)
@@ -1760,6 +1760,14 @@ namespace rpiCam
       m_EncoderBufferPool = nullptr;
     }
 
+    void RPICamera::enterDeliveryThread(DeliveryThread thread, MMAL_BUFFER_HEADER_T *buffer)
+    {
+        if (buffer->pts != MMAL_TIME_UNKNOWN)
+            deliveryThreadMonitor(thread).enter(buffer->pts);
+        else
+            deliveryThreadMonitor(thread).enter();
+    }
+
     void RPICamera::_mmalCameraControlCallback(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T *buffer)
     {
         RPICamera *rpiCamera = reinterpret_cast<RPICamera*>(port->component->userdata);
@@ -1785,6 +1793,8 @@ namespace rpiCam
 
     void RPICamera::mmalCameraVideoBufferCallback(MMAL_BUFFER_HEADER_T *buffer)
     {
+        enterDeliveryThread(DeliveryThread::Video, buffer);
+
         if (m_VideoPort->is_enabled)
         {
             std::shared_ptr<PixelSampleBuffer> pixelSampleBuffer = std::make_shared<RPIPixelSampleBuffer>(
@@ -1793,6 +1803,7 @@ namespace rpiCam
                 Vec2ui(m_VideoPort->format->es->video.width, m_VideoPort->format->es->video.height),
                 m_VideoFormat
             );
+            pixelSampleBuffer->sequence = m_VideoFrameSequence++;
             dispatchOnCameraVideoFrame(pixelSampleBuffer);
         }
 
@@ -1818,6 +1829,8 @@ namespace rpiCam
 
     void RPICamera::mmalCameraSnapshotBufferCallback(MMAL_BUFFER_HEADER_T *buffer)
     {
+        enterDeliveryThread(DeliveryThread::Snapshot, buffer);
+
         if (m_SnapshotPort->is_enabled)
         {
             mmal_port_parameter_set_boolean(m_SnapshotPort, MMAL_PARAMETER_CAPTURE, MMAL_FALSE);
@@ -1856,6 +1869,8 @@ namespace rpiCam
 
     void RPICamera::mmalEncoderBufferCallback(MMAL_BUFFER_HEADER_T *buffer)
     {
+        enterDeliveryThread(DeliveryThread::Encoder, buffer);
+
         if (m_EncoderOutputPort->is_enabled)
         {
           //RPI_LOG(INFO, "RPICamera::mmalEncoderBufferCallback(): flags: %#08X, length: %d, ", buffer->flags, buffer->length);
@@ -40,6 +40,7 @@ namespace rpiCam
         std::error_code setVideoSize(Vec2ui const &sz) override;
         Rational getVideoFrameRate() const override;
         std::error_code setVideoFrameRate(Rational const &rate) override;
+        std::size_t getVideoBufferCount() const override;
 
         std::error_code startVideo() override;
         bool isVideoStarted() const override;
@@ -148,6 +149,8 @@ namespace rpiCam
         void disableEncoder();
         void destroyEncoder();
 
+        void enterDeliveryThread(DeliveryThread thread, MMAL_BUFFER_HEADER_T *buffer);
+
         static void _mmalCameraControlCallback(MMAL_PORT_T *port, MMAL_BUFFER_HEADER_T *buffer);
         void mmalCameraControlCallback(MMAL_BUFFER_HEADER_T *buffer);
 
@@ -177,6 +180,7 @@ namespace rpiCam
         ePixelFormat m_VideoFormat;
         Vec2ui m_VideoSize;
         Rational m_VideoFrameRate;
+        std::uint64_t m_VideoFrameSequence;
         std::list<ePixelFormat> m_SupportedSnapshotFormats;
         std::list<Vec2ui> m_SupportedSnapshotSizes;
         ePixelFormat m_SnapshotFormat;
@@ -67,10 +67,7 @@ namespace rpiCam
         if (!isValid() || pi >= m_PlaneCount)
             return Vec2ui(0,0);
 
-        return Vec2ui(
-            m_Size(0) >> m_PlaneSizeShift[pi][0],
-            m_Size(1) >> m_PlaneSizeShift[pi][1]
-        );
+        return m_PlaneSize[pi];
     }
 
     void* RPIPixelSampleBuffer::planeData(std::size_t pi)
@@ -89,6 +86,14 @@ namespace rpiCam
         return m_PlaneRowBytes[pi];
     }
 
+    Vec2ui RPIPixelSampleBuffer::paddedSize() const
+    {
+        if (!isValid())
+            return Vec2ui(0,0);
+
+        return m_RealSize;
+    }
+
     std::error_code RPIPixelSampleBuffer::lock()
     {
         if (!isValid())
@@ -125,36 +130,20 @@ namespace rpiCam
 
     void RPIPixelSampleBuffer::updatePlanes()
     {
-        switch(m_Format)
-        {
-        case kPixelFormatRGB8:
-            {
-                m_PlaneCount = 1;
-                m_PlaneSizeShift[0] = Vec2ui(0,0);
-                m_PlaneDataOffset[0] = 0;
-                m_PlaneRowBytes[0] = m_RealSize(0) * 3;
-            }
-            break;
-
-        case kPixelFormatYUV420:
-            {
-                m_PlaneCount = 3;
-                m_PlaneSizeShift[0] = Vec2ui(0,0);
-                m_PlaneSizeShift[1] = Vec2ui(1,1);
-                m_PlaneSizeShift[2] = Vec2ui(1,1);
-
-                m_PlaneDataOffset[0] = 0;
-                m_PlaneDataOffset[1] = m_RealSize(0) * m_RealSize(1);
-                m_PlaneDataOffset[2] = m_PlaneDataOffset[1] + (m_RealSize(0) >> 1) * (m_RealSize(1) >> 1);
-
-                m_PlaneRowBytes[0] = m_RealSize(0);
-                m_PlaneRowBytes[1] = m_RealSize(0) >> 1;
-                m_PlaneRowBytes[2] = m_RealSize(0) >> 1;
-            }
-            break;
+        PixelFormatDescriptor const descriptor = pixelFormatDescriptor(m_Format);
 
-        default:
-            break;
+        // planes are stored back to back in the padded allocation
+        std::size_t offset = 0;
+        m_PlaneCount = descriptor.planeCount;
+        for (std::size_t pi = 0; pi < m_PlaneCount; ++pi)
+        {
+            m_PlaneSize[pi] = Vec2ui(
+                m_Size(0) >> descriptor.widthShift[pi],
+                m_Size(1) >> descriptor.heightShift[pi]
+            );
+            m_PlaneDataOffset[pi] = offset;
+            m_PlaneRowBytes[pi] = (m_RealSize(0) >> descriptor.widthShift[pi]) * descriptor.bytesPerPixel[pi];
+            offset += m_PlaneRowBytes[pi] * (m_RealSize(1) >> descriptor.heightShift[pi]);
         }
     }
 }
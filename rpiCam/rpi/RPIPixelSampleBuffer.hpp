@@ -24,6 +24,7 @@ namespace rpiCam
         Vec2ui planeSize(std::size_t pi = 0) const override;
         void* planeData(std::size_t pi = 0) override;
         std::size_t planeRowBytes(std::size_t pi = 0) const override;
+        Vec2ui paddedSize() const override;
 
         // SampleBuffer overrides
         std::error_code lock() override;
@@ -40,8 +41,8 @@ namespace rpiCam
         ePixelFormat m_Format;
         std::atomic<uint32_t> m_LockCounter;
         std::size_t m_PlaneCount;
-        Vec2ui m_PlaneSizeShift[4];
-        std::size_t m_PlaneDataOffset[4];
-        std::size_t m_PlaneRowBytes[4];
+        Vec2ui m_PlaneSize[PixelFormatDescriptor::kMaxPlanes];
+        std::size_t m_PlaneDataOffset[PixelFormatDescriptor::kMaxPlanes];
+        std::size_t m_PlaneRowBytes[PixelFormatDescriptor::kMaxPlanes];
     };
 }